@@ -31,3 +31,7 @@ build() {
 build b
 build b.fix -DTOYWASM_USE_SMALL_CELLS=OFF
 build b.fix.nosimd -DTOYWASM_USE_SMALL_CELLS=OFF -DTOYWASM_ENABLE_WASM_SIMD=OFF
+build b.host-simd -DTOYWASM_USE_HOST_SIMD=ON
+build b.guard-pages -DTOYWASM_USE_GUARD_PAGES=ON
+build b.no-type-registry -DTOYWASM_USE_TYPE_REGISTRY=OFF
+build b.no-call-indirect-cache -DTOYWASM_CALL_INDIRECT_CACHE_SIZE=0
@@ -0,0 +1,32 @@
+#! /bin/sh
+
+# call_indirect micro benchmarks. see call_indirect.md.
+#
+# usage:
+#   ./call_indirect.sh [ITERATIONS]
+#
+# TOYWASM_STRUCTURAL: toywasm built with TOYWASM_USE_TYPE_REGISTRY=OFF
+# TOYWASM_REGISTRY: toywasm built with TOYWASM_USE_TYPE_REGISTRY=ON
+# TOYWASM_NO_CACHE: toywasm built with TOYWASM_CALL_INDIRECT_CACHE_SIZE=0
+
+set -e
+
+. $(dirname $0)/common.sh
+
+TOYWASM_STRUCTURAL=${TOYWASM_STRUCTURAL:-../b.no-type-registry/toywasm}
+TOYWASM_REGISTRY=${TOYWASM_REGISTRY:-../b/toywasm}
+TOYWASM_NO_CACHE=${TOYWASM_NO_CACHE:-../b.no-call-indirect-cache/toywasm}
+WAT2WASM=${WAT2WASM:-wat2wasm}
+N=${1:-10000000}
+
+WASM=$(mktemp)
+trap "rm -f ${WASM}" EXIT
+${WAT2WASM} -o ${WASM} call_indirect.wat
+
+echo "benchmark,structural,type registry,no cache"
+for f in unary wide; do
+    S=$(measure ${TOYWASM_STRUCTURAL} --load ${WASM} --invoke "${f} ${N}")
+    R=$(measure ${TOYWASM_REGISTRY} --load ${WASM} --invoke "${f} ${N}")
+    C=$(measure ${TOYWASM_NO_CACHE} --load ${WASM} --invoke "${f} ${N}")
+    echo "${f},${S},${R},${C}"
+done
@@ -0,0 +1,49 @@
+;; call_indirect micro benchmarks. see call_indirect.md.
+;;
+;; each function takes the number of iterations and calls small
+;; functions through a table like C++ virtual function calls.
+
+(module
+  (type $unary (func (param i32) (result i32)))
+  (type $wide (func (param i32 i32 i64 i64 f64 f32) (result i32)))
+
+  (table 8 funcref)
+  (elem (i32.const 0) $inc $dec $double $half
+                      $wide_a $wide_b $wide_c $wide_d)
+
+  (func $inc (type $unary) (i32.add (local.get 0) (i32.const 1)))
+  (func $dec (type $unary) (i32.sub (local.get 0) (i32.const 1)))
+  (func $double (type $unary) (i32.shl (local.get 0) (i32.const 1)))
+  (func $half (type $unary) (i32.shr_u (local.get 0) (i32.const 1)))
+
+  (func $wide_a (type $wide) (i32.add (local.get 0) (local.get 1)))
+  (func $wide_b (type $wide) (i32.sub (local.get 0) (local.get 1)))
+  (func $wide_c (type $wide) (i32.xor (local.get 0) (local.get 1)))
+  (func $wide_d (type $wide) (i32.or (local.get 0) (local.get 1)))
+
+  ;; a function type with a single parameter
+  (func (export "unary") (param $n i32) (result i32)
+    (local $acc i32)
+    (loop $l
+      (local.set $acc
+        (call_indirect (type $unary)
+                       (local.get $acc)
+                       (i32.and (local.get $n) (i32.const 3))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (local.get $acc))
+
+  ;; a function type with many parameters,
+  ;; which is more expensive to compare structurally
+  (func (export "wide") (param $n i32) (result i32)
+    (local $acc i32)
+    (loop $l
+      (local.set $acc
+        (call_indirect (type $wide)
+                       (local.get $acc) (local.get $n)
+                       (i64.const 0) (i64.const 0)
+                       (f64.const 0) (f32.const 0)
+                       (i32.add (i32.and (local.get $n) (i32.const 3))
+                                (i32.const 4))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (local.get $acc))
+)
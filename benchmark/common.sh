@@ -0,0 +1,22 @@
+# helpers shared by the micro benchmark scripts.
+#
+# usage: . $(dirname $0)/common.sh
+
+# print the "real" seconds of the given command.
+# fail if it didn't print the result of --invoke.
+measure() {
+    OUTPUT=$(mktemp)
+    /usr/bin/time -p "$@" > ${OUTPUT} 2>&1
+    grep -F "Result:" ${OUTPUT} > /dev/null
+    sed -n -e 's/^real *\([0-9.]*\)$/\1/p' ${OUTPUT}
+    rm ${OUTPUT}
+}
+
+# same as measure, but discard the stdout of the command.
+# for commands which write a lot to stdout.
+measure_discard_stdout() {
+    OUTPUT=$(mktemp)
+    /usr/bin/time -p "$@" 2> ${OUTPUT} > /dev/null
+    sed -n -e 's/^real *\([0-9.]*\)$/\1/p' ${OUTPUT}
+    rm ${OUTPUT}
+}
@@ -32,6 +32,15 @@ echo "+++++++++++ Interpreters +++++++++++"
 TOYWASM=${TOYWASM:-toywasm}
 run "$(${TOYWASM} --version | head -1) (default configuration)" ${TOYWASM} --wasi --wasi-dir .video --
 
+# with the pre-decoded instruction stream.
+# it trades memory footprint for speed.
+run "$(${TOYWASM} --version | head -1) (pre-decoded)" ${TOYWASM} --wasi --wasi-dir .video --enable-predecode --
+
+# with the baseline jit. optional as it's a build-time option.
+if [ -n "${TOYWASM_JIT}" ]; then
+    run "$(${TOYWASM_JIT} --version | head -1) (baseline jit)" ${TOYWASM_JIT} --wasi --wasi-dir .video --enable-jit --
+fi
+
 # with fixed sized cells.
 # separate binary as it's a build-time option.
 if [ -n "${TOYWASM_FIXED}" ]; then
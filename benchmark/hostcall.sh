@@ -0,0 +1,27 @@
+#! /bin/sh
+
+# host call micro benchmarks. see hostcall.md.
+#
+# usage:
+#   ./hostcall.sh [ITERATIONS]
+#
+# TOYWASM: toywasm to measure
+
+set -e
+
+. $(dirname $0)/common.sh
+
+TOYWASM=${TOYWASM:-../b/toywasm}
+WAT2WASM=${WAT2WASM:-wat2wasm}
+N=${1:-5000000}
+
+WASM=$(mktemp)
+trap "rm -f ${WASM}" EXIT
+${WAT2WASM} -o ${WASM} hostcall.wat
+
+echo "benchmark,seconds"
+C=$(measure_discard_stdout ${TOYWASM} --wasi --load ${WASM} --invoke "clock_time_get ${N}")
+echo "clock_time_get,${C}"
+# fd 1 is redirected to /dev/null by measure_discard_stdout
+W=$(measure_discard_stdout ${TOYWASM} --wasi --load ${WASM} --invoke "fd_write 1 ${N}")
+echo "fd_write,${W}"
@@ -0,0 +1,37 @@
+;; host call micro benchmarks. see hostcall.md.
+;;
+;; each function takes the number of iterations and calls a cheap
+;; WASI function in a loop.
+
+(module
+  (import "wasi_snapshot_preview1" "clock_time_get"
+    (func $clock_time_get (param i32 i64 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write"
+    (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (memory (export "memory") 1)
+
+  ;; an iovec at 16 for a 1 byte buffer at 0
+  (data (i32.const 0) "x")
+  (data (i32.const 16) "\00\00\00\00\01\00\00\00")
+
+  (func (export "clock_time_get") (param $n i32) (result i32)
+    (local $acc i32)
+    (loop $l
+      (local.set $acc
+        (i32.add (local.get $acc)
+                 (call $clock_time_get (i32.const 1) (i64.const 0)
+                                       (i32.const 32))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (local.get $acc))
+
+  ;; write 1 byte to the given fd. eg. /dev/null
+  (func (export "fd_write") (param $fd i32) (param $n i32) (result i32)
+    (local $acc i32)
+    (loop $l
+      (local.set $acc
+        (i32.add (local.get $acc)
+                 (call $fd_write (local.get $fd) (i32.const 16) (i32.const 1)
+                                 (i32.const 40))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (local.get $acc))
+)
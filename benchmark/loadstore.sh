@@ -0,0 +1,29 @@
+#! /bin/sh
+
+# load/store micro benchmarks. see loadstore.md.
+#
+# usage:
+#   ./loadstore.sh [ITERATIONS]
+#
+# TOYWASM_BOUNDS_CHECK: toywasm built without TOYWASM_USE_GUARD_PAGES
+# TOYWASM_GUARD_PAGES: toywasm built with TOYWASM_USE_GUARD_PAGES=ON
+
+set -e
+
+. $(dirname $0)/common.sh
+
+TOYWASM_BOUNDS_CHECK=${TOYWASM_BOUNDS_CHECK:-../b/toywasm}
+TOYWASM_GUARD_PAGES=${TOYWASM_GUARD_PAGES:-../b.guard-pages/toywasm}
+WAT2WASM=${WAT2WASM:-wat2wasm}
+N=${1:-10000000}
+
+WASM=$(mktemp)
+trap "rm -f ${WASM}" EXIT
+${WAT2WASM} -o ${WASM} loadstore.wat
+
+echo "benchmark,bounds check,guard pages"
+for f in load_i32 store_i64 copy_u8 random_rmw; do
+    B=$(measure ${TOYWASM_BOUNDS_CHECK} --load ${WASM} --invoke "${f} ${N}")
+    G=$(measure ${TOYWASM_GUARD_PAGES} --load ${WASM} --invoke "${f} ${N}")
+    echo "${f},${B},${G}"
+done
@@ -0,0 +1,69 @@
+;; load/store micro benchmarks. see loadstore.md.
+;;
+;; each function takes the number of iterations and runs a loop
+;; dominated by memory accesses within the first 64KB of the memory.
+
+(module
+  (memory 1)
+
+  ;; sum up i32 values
+  (func (export "load_i32") (param $n i32) (result i32)
+    (local $acc i32) (local $p i32)
+    (loop $l
+      (local.set $p (i32.and (i32.shl (local.get $n) (i32.const 2))
+                             (i32.const 0xfff0)))
+      (local.set $acc (i32.add (local.get $acc)
+                               (i32.load (local.get $p))))
+      (local.set $acc (i32.add (local.get $acc)
+                               (i32.load offset=4 (local.get $p))))
+      (local.set $acc (i32.add (local.get $acc)
+                               (i32.load offset=8 (local.get $p))))
+      (local.set $acc (i32.add (local.get $acc)
+                               (i32.load offset=12 (local.get $p))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (local.get $acc))
+
+  ;; fill with i64 values
+  (func (export "store_i64") (param $n i32) (result i32)
+    (local $p i32)
+    (loop $l
+      (local.set $p (i32.and (i32.shl (local.get $n) (i32.const 3))
+                             (i32.const 0xffe0)))
+      (i64.store (local.get $p) (i64.extend_i32_u (local.get $n)))
+      (i64.store offset=8 (local.get $p) (i64.extend_i32_u (local.get $n)))
+      (i64.store offset=16 (local.get $p) (i64.extend_i32_u (local.get $n)))
+      (i64.store offset=24 (local.get $p) (i64.extend_i32_u (local.get $n)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32.load (i32.const 0)))
+
+  ;; byte-wise copy like a naive memcpy
+  (func (export "copy_u8") (param $n i32) (result i32)
+    (local $p i32)
+    (loop $l
+      (local.set $p (i32.and (local.get $n) (i32.const 0x7ffc)))
+      (i32.store8 offset=0x8000 (local.get $p)
+                  (i32.load8_u (local.get $p)))
+      (i32.store8 offset=0x8001 (local.get $p)
+                  (i32.load8_u offset=1 (local.get $p)))
+      (i32.store8 offset=0x8002 (local.get $p)
+                  (i32.load8_u offset=2 (local.get $p)))
+      (i32.store8 offset=0x8003 (local.get $p)
+                  (i32.load8_u offset=3 (local.get $p)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32.load (i32.const 0x8000)))
+
+  ;; read-modify-write at pseudo random addresses
+  (func (export "random_rmw") (param $n i32) (result i32)
+    (local $x i32) (local $p i32)
+    (local.set $x (i32.const 1))
+    (loop $l
+      ;; a linear congruential generator
+      (local.set $x (i32.add (i32.mul (local.get $x) (i32.const 1103515245))
+                             (i32.const 12345)))
+      (local.set $p (i32.and (i32.shr_u (local.get $x) (i32.const 8))
+                             (i32.const 0xfffc)))
+      (i32.store (local.get $p)
+                 (i32.add (i32.load (local.get $p)) (local.get $x)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32.load (local.get $p)))
+)
@@ -0,0 +1,27 @@
+#! /bin/sh
+
+# memory.grow micro benchmark. see memory_grow.md.
+#
+# usage:
+#   ./memory_grow.sh [PAGES]
+#
+# TOYWASM_PLAIN: toywasm built without TOYWASM_USE_RESERVED_MEMORY
+# TOYWASM_RESERVED: toywasm built with TOYWASM_USE_RESERVED_MEMORY=ON
+
+set -e
+
+. $(dirname $0)/common.sh
+
+TOYWASM_PLAIN=${TOYWASM_PLAIN:-../b/toywasm}
+TOYWASM_RESERVED=${TOYWASM_RESERVED:-../b.reserved-memory/toywasm}
+WAT2WASM=${WAT2WASM:-wat2wasm}
+N=${1:-16000}
+
+WASM=$(mktemp)
+trap "rm -f ${WASM}" EXIT
+${WAT2WASM} -o ${WASM} memory_grow.wat
+
+echo "benchmark,plain,reserved"
+P=$(measure ${TOYWASM_PLAIN} --load ${WASM} --invoke "grow ${N}")
+R=$(measure ${TOYWASM_RESERVED} --load ${WASM} --invoke "grow ${N}")
+echo "grow,${P},${R}"
@@ -0,0 +1,19 @@
+;; memory.grow micro benchmark. see memory_grow.md.
+;;
+;; "grow" grows the memory page by page, touching each new page,
+;; like a program whose heap grows with sbrk-like allocations.
+;; it returns the final number of pages.
+
+(module
+  (memory 1 16384)
+
+  (func (export "grow") (param $n i32) (result i32)
+    (local $old i32)
+    (loop $l
+      (local.set $old (memory.grow (i32.const 1)))
+      (if (i32.eq (local.get $old) (i32.const -1))
+        (then unreachable))
+      (i32.store (i32.shl (local.get $old) (i32.const 16)) (i32.const 1))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (memory.size))
+)
@@ -0,0 +1,29 @@
+#! /bin/sh
+
+# SIMD micro benchmarks. see simd.md.
+#
+# usage:
+#   ./simd.sh [ITERATIONS]
+#
+# TOYWASM_PORTABLE: toywasm built without TOYWASM_USE_HOST_SIMD
+# TOYWASM_HOST_SIMD: toywasm built with TOYWASM_USE_HOST_SIMD=ON
+
+set -e
+
+. $(dirname $0)/common.sh
+
+TOYWASM_PORTABLE=${TOYWASM_PORTABLE:-../b/toywasm}
+TOYWASM_HOST_SIMD=${TOYWASM_HOST_SIMD:-../b.host-simd/toywasm}
+WAT2WASM=${WAT2WASM:-wat2wasm}
+N=${1:-10000000}
+
+WASM=$(mktemp)
+trap "rm -f ${WASM}" EXIT
+${WAT2WASM} -o ${WASM} simd.wat
+
+echo "benchmark,portable,host simd"
+for f in int_arith saturating float convert shuffle compare; do
+    P=$(measure ${TOYWASM_PORTABLE} --load ${WASM} --invoke "${f} ${N}")
+    H=$(measure ${TOYWASM_HOST_SIMD} --load ${WASM} --invoke "${f} ${N}")
+    echo "${f},${P},${H}"
+done
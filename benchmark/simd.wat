@@ -0,0 +1,124 @@
+;; SIMD micro benchmarks. see simd.md.
+;;
+;; each function takes the number of iterations and runs a loop which
+;; applies a group of SIMD instructions to vectors loaded from the memory.
+;; the results are folded into an accumulator to keep them alive.
+
+(module
+  (memory 1)
+  ;; some non-trivial data to load
+  (data (i32.const 0)
+    "\01\80\7f\ff\00\10\20\30\40\50\60\70\81\90\a0\fe"
+    "\ff\7f\80\00\02\04\08\10\20\40\80\c0\e0\f0\f8\fc"
+    "\00\00\80\3f\00\00\00\c0\00\00\40\40\00\00\80\c0"
+    "\cd\cc\cc\3d\00\00\c0\7f\00\00\80\7f\00\00\20\41")
+
+  (func $load (param $i i32) (result v128)
+    (v128.load (i32.shl (i32.and (local.get $i) (i32.const 3)) (i32.const 4))))
+
+  (func (export "int_arith") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128) (local $b v128)
+    (loop $l
+      (local.set $a (call $load (local.get $n)))
+      (local.set $b (call $load (i32.add (local.get $n) (i32.const 1))))
+      (local.set $acc (i8x16.add (local.get $acc) (local.get $a)))
+      (local.set $acc (i16x8.sub (local.get $acc) (local.get $b)))
+      (local.set $acc (i16x8.mul (local.get $acc) (local.get $a)))
+      (local.set $acc (i32x4.add (local.get $acc) (local.get $b)))
+      (local.set $acc (i32x4.mul (local.get $acc) (local.get $a)))
+      (local.set $acc (i8x16.min_s (local.get $acc) (local.get $b)))
+      (local.set $acc (i16x8.max_u (local.get $acc) (local.get $a)))
+      (local.set $acc (i8x16.avgr_u (local.get $acc) (local.get $b)))
+      (local.set $acc (i8x16.abs (local.get $acc)))
+      (local.set $acc (i32x4.shl (local.get $acc) (local.get $n)))
+      (local.set $acc (i16x8.shr_s (local.get $acc) (local.get $n)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32x4.extract_lane 0 (local.get $acc)))
+
+  (func (export "saturating") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128) (local $b v128)
+    (loop $l
+      (local.set $a (call $load (local.get $n)))
+      (local.set $b (call $load (i32.add (local.get $n) (i32.const 1))))
+      (local.set $acc (i8x16.add_sat_s (local.get $acc) (local.get $a)))
+      (local.set $acc (i8x16.sub_sat_u (local.get $acc) (local.get $b)))
+      (local.set $acc (i16x8.add_sat_u (local.get $acc) (local.get $a)))
+      (local.set $acc (i16x8.sub_sat_s (local.get $acc) (local.get $b)))
+      (local.set $acc (i16x8.q15mulr_sat_s (local.get $acc) (local.get $a)))
+      (local.set $acc (i8x16.narrow_i16x8_s (local.get $acc) (local.get $b)))
+      (local.set $acc (i16x8.narrow_i32x4_u (local.get $acc) (local.get $a)))
+      (local.set $acc (i32x4.dot_i16x8_s (local.get $acc) (local.get $b)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32x4.extract_lane 0 (local.get $acc)))
+
+  (func (export "float") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128) (local $b v128)
+    (loop $l
+      (local.set $a (call $load (i32.add (local.get $n) (i32.const 2))))
+      (local.set $b (call $load (i32.add (local.get $n) (i32.const 3))))
+      (local.set $acc (f32x4.add (local.get $acc) (local.get $a)))
+      (local.set $acc (f32x4.mul (local.get $acc) (local.get $b)))
+      (local.set $acc (f32x4.div (local.get $acc) (local.get $a)))
+      (local.set $acc (f32x4.sqrt (local.get $acc)))
+      (local.set $acc (f32x4.pmax (local.get $acc) (local.get $b)))
+      (local.set $acc (f32x4.neg (local.get $acc)))
+      (local.set $acc (f32x4.nearest (local.get $acc)))
+      (local.set $acc (f64x2.add (local.get $acc) (local.get $a)))
+      (local.set $acc (f64x2.mul (local.get $acc) (local.get $b)))
+      (local.set $acc (f64x2.floor (local.get $acc)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32x4.extract_lane 0 (local.get $acc)))
+
+  (func (export "convert") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128)
+    (loop $l
+      (local.set $a (call $load (local.get $n)))
+      (local.set $acc (v128.xor (local.get $acc) (local.get $a)))
+      (local.set $acc (i16x8.extend_low_i8x16_s (local.get $acc)))
+      (local.set $acc (i32x4.extend_high_i16x8_u (local.get $acc)))
+      (local.set $acc (f32x4.convert_i32x4_s (local.get $acc)))
+      (local.set $acc (i32x4.trunc_sat_f32x4_s (local.get $acc)))
+      (local.set $acc (f64x2.convert_low_i32x4_u (local.get $acc)))
+      (local.set $acc (f32x4.demote_f64x2_zero (local.get $acc)))
+      (local.set $acc (f64x2.promote_low_f32x4 (local.get $acc)))
+      (local.set $acc (i32x4.trunc_sat_f64x2_s_zero (local.get $acc)))
+      (local.set $acc (i16x8.extadd_pairwise_i8x16_u (local.get $acc)))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32x4.extract_lane 0 (local.get $acc)))
+
+  (func (export "shuffle") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128) (local $b v128)
+    (loop $l
+      (local.set $a (call $load (local.get $n)))
+      (local.set $b (call $load (i32.add (local.get $n) (i32.const 1))))
+      (local.set $acc (i8x16.swizzle (local.get $a) (local.get $acc)))
+      (local.set $acc (i8x16.shuffle 0 17 2 19 4 21 6 23 8 25 10 27 12 29 14 31
+                        (local.get $acc) (local.get $b)))
+      (local.set $acc (i8x16.swizzle (local.get $acc) (local.get $b)))
+      (local.set $acc (i8x16.shuffle 15 14 13 12 11 10 9 8 7 6 5 4 3 2 1 0
+                        (local.get $acc) (local.get $a)))
+      (local.set $acc (i8x16.popcnt (local.get $acc)))
+      (local.set $acc (v128.xor (local.get $acc) (i8x16.splat (local.get $n))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32x4.extract_lane 0 (local.get $acc)))
+
+  (func (export "compare") (param $n i32) (result i32)
+    (local $acc v128) (local $a v128) (local $b v128) (local $m i32)
+    (loop $l
+      (local.set $a (call $load (local.get $n)))
+      (local.set $b (call $load (i32.add (local.get $n) (i32.const 1))))
+      (local.set $acc (v128.bitselect (local.get $a) (local.get $b)
+                        (i8x16.lt_s (local.get $acc) (local.get $a))))
+      (local.set $acc (v128.bitselect (local.get $acc) (local.get $b)
+                        (i16x8.ge_u (local.get $acc) (local.get $b))))
+      (local.set $acc (v128.or (local.get $acc)
+                        (f32x4.lt (local.get $acc) (local.get $a))))
+      (local.set $acc (v128.and (local.get $acc)
+                        (i32x4.eq (local.get $acc) (local.get $b))))
+      (local.set $m (i32.add (local.get $m)
+                      (i8x16.bitmask (local.get $acc))))
+      (local.set $m (i32.add (local.get $m)
+                      (i8x16.all_true (local.get $acc))))
+      (br_if $l (local.tee $n (i32.sub (local.get $n) (i32.const 1)))))
+    (i32.add (local.get $m) (i32x4.extract_lane 0 (local.get $acc))))
+)
@@ -2,19 +2,26 @@
 
 set -e
 
+# run LABEL COMMAND [ARGS]
+#
+# ARGS are the arguments for ffmpeg.wasm. "-version" by default.
+# an empty ARGS only loads the module. (see TOYWASM_LOAD_THREADS below)
 run() {
     printf "$1,"
-    shift
+    CMD=$2
+    ARGS=${3--version}
     OUTPUT=$(mktemp)
 
     sync;sync;sync
 
     # ffmpeg binary downloaded by ../test/run-ffmpeg.sh
-    /usr/bin/time -l $@ ../.ffmpeg/ffmpeg.wasm -version > ${OUTPUT} 2>&1
+    /usr/bin/time -l ${CMD} ../.ffmpeg/ffmpeg.wasm ${ARGS} > ${OUTPUT} 2>&1
 
     # sanity checks
-    grep -F "ffmpeg version" ${OUTPUT} > /dev/null
-    grep -v "(Unrecognized|usage)" ${OUTPUT} > /dev/null
+    if [ -n "${ARGS}" ]; then
+        grep -F "ffmpeg version" ${OUTPUT} > /dev/null
+        grep -v "(Unrecognized|usage)" ${OUTPUT} > /dev/null
+    fi
 
     grep -E "(real.*user.*sys|maximum resident set size)" ${OUTPUT} | \
     sed \
@@ -31,6 +38,15 @@ rm -rf ~/Library/Caches/BytecodeAlliance.wasmtime
 sync;sync;sync;sleep 3
 
 run "toywasm (default)" "../b/toywasm --wasi --"
+run "toywasm (lazy validation)" "../b/toywasm --enable-lazy-validation --wasi --"
+# only load the module. (no execution)
+# used to see the load time vs the number of validation threads.
+# requires toywasm built with TOYWASM_ENABLE_PARALLEL_VALIDATION=ON.
+if [ -n "${TOYWASM_LOAD_THREADS}" ]; then
+for n in ${TOYWASM_LOAD_THREADS}; do
+run "toywasm (load only, ${n} validation threads)" "../b/toywasm --validation-threads=${n} --wasi --load" ""
+done
+fi
 run "toywasm (no annotations)" "../b/toywasm --disable-jump-table --disable-localtype-cellidx --disable-resulttype-cellidx --wasi --"
 run "toywasm (no annotations, fixed cells)" "../b.fix/toywasm --disable-jump-table --disable-localtype-cellidx --disable-resulttype-cellidx --wasi --"
 run "wasm3 (default)" wasm3
@@ -8,6 +8,9 @@
 #include <string.h>
 
 #include "mem.h"
+#if defined(TOYWASM_ENABLE_PROFILER)
+#include "profiler.h"
+#endif
 #include "repl.h"
 #include "str_to_uint.h"
 #include "toywasm_config.h"
@@ -33,6 +36,15 @@ enum longopt {
 #endif
         opt_dyld_path,
         opt_dyld_stack_size,
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        opt_enable_jit,
+#endif
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        opt_enable_lazy_validation,
+#endif
+#if defined(TOYWASM_USE_PREDECODE)
+        opt_enable_predecode,
 #endif
         opt_invoke,
         opt_load,
@@ -41,14 +53,26 @@ enum longopt {
         opt_max_memory,
 #endif
         opt_max_stack_cells,
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        opt_module_cache,
+#endif
         opt_register,
         opt_repl,
         opt_repl_prompt,
         opt_print_build_options,
         opt_print_stats,
+#if defined(TOYWASM_ENABLE_PROFILER)
+        opt_profile,
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        opt_snapshot,
+#endif
         opt_timeout,
 #if defined(TOYWASM_ENABLE_TRACING)
         opt_trace,
+#endif
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        opt_validation_threads,
 #endif
         opt_version,
 #if defined(TOYWASM_ENABLE_WASI)
@@ -119,6 +143,30 @@ static const struct option longopts[] = {
                 NULL,
                 opt_dyld_stack_size,
         },
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        {
+                "enable-jit",
+                no_argument,
+                NULL,
+                opt_enable_jit,
+        },
+#endif
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        {
+                "enable-lazy-validation",
+                no_argument,
+                NULL,
+                opt_enable_lazy_validation,
+        },
+#endif
+#if defined(TOYWASM_USE_PREDECODE)
+        {
+                "enable-predecode",
+                no_argument,
+                NULL,
+                opt_enable_predecode,
+        },
 #endif
         {
                 "invoke",
@@ -152,6 +200,14 @@ static const struct option longopts[] = {
                 NULL,
                 opt_max_stack_cells,
         },
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        {
+                "module-cache",
+                required_argument,
+                NULL,
+                opt_module_cache,
+        },
+#endif
         {
                 "repl",
                 no_argument,
@@ -176,6 +232,22 @@ static const struct option longopts[] = {
                 NULL,
                 opt_print_stats,
         },
+#if defined(TOYWASM_ENABLE_PROFILER)
+        {
+                "profile",
+                required_argument,
+                NULL,
+                opt_profile,
+        },
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        {
+                "snapshot",
+                required_argument,
+                NULL,
+                opt_snapshot,
+        },
+#endif
         {
                 "timeout",
                 required_argument,
@@ -189,6 +261,14 @@ static const struct option longopts[] = {
                 NULL,
                 opt_trace,
         },
+#endif
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        {
+                "validation-threads",
+                required_argument,
+                NULL,
+                opt_validation_threads,
+        },
 #endif
         {
                 "version",
@@ -245,14 +325,26 @@ static const char *opt_metavars[] = {
 #endif
 #if defined(TOYWASM_ENABLE_WASI_LITTLEFS)
         [opt_wasi_littlefs_dir] = "LITTLEFS_IMAGE_PATH::LFS_DIR[::GUEST_DIR]",
+#endif
+#if defined(TOYWASM_ENABLE_PROFILER)
+        [opt_profile] = "FOLDED_STACKS_OUTPUT_PATH",
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+        [opt_snapshot] = "OUTPUT_MODULE_PATH",
 #endif
         [opt_timeout] = "TIMEOUT_MS",
 #if defined(TOYWASM_ENABLE_TRACING)
         [opt_trace] = "LEVEL",
+#endif
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        [opt_validation_threads] = "NUMBER_OF_THREADS",
 #endif
         [opt_repl_prompt] = "STRING",
         [opt_max_frames] = "NUMBER_OF_FRAMES",
         [opt_max_stack_cells] = "NUMBER_OF_CELLS",
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        [opt_module_cache] = "CACHE_DIR",
+#endif
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
         [opt_max_memory] = "MEMORY_LIMIT_IN_BYTES",
 #endif
@@ -299,6 +391,22 @@ print_usage(void)
                "module --invoke \"func arg1 arg2\"\n");
 }
 
+#if defined(TOYWASM_ENABLE_PROFILER)
+static int
+write_profile(const char *path)
+{
+        FILE *fp = fopen(path, "w");
+        if (fp == NULL) {
+                return errno;
+        }
+        int ret = profiler_write(fp);
+        if (fclose(fp) != 0 && ret == 0) {
+                ret = errno;
+        }
+        return ret;
+}
+#endif
+
 int
 main(int argc, char *const *argv)
 {
@@ -322,6 +430,9 @@ main(int argc, char *const *argv)
         int longidx;
         bool do_repl = false;
         bool might_need_help = true;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        const char *profile_path = NULL;
+#endif
 
         int exit_status = 1;
 
@@ -417,6 +528,21 @@ main(int argc, char *const *argv)
                                 goto fail;
                         }
                         break;
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+                case opt_enable_jit:
+                        opts->load_options.generate_jit_code = true;
+                        break;
+#endif
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+                case opt_enable_lazy_validation:
+                        opts->load_options.lazy_validation = true;
+                        break;
+#endif
+#if defined(TOYWASM_USE_PREDECODE)
+                case opt_enable_predecode:
+                        opts->load_options.generate_predecoded_code = true;
+                        break;
 #endif
                 case opt_invoke:
                         ret = toywasm_repl_invoke(state, NULL, optarg, NULL,
@@ -461,6 +587,11 @@ main(int argc, char *const *argv)
                                 goto fail;
                         }
                         break;
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+                case opt_module_cache:
+                        opts->load_options.module_cache_dir = optarg;
+                        break;
+#endif
                 case opt_register:
                         ret = toywasm_repl_register(state, NULL, optarg);
                         if (ret != 0) {
@@ -480,6 +611,30 @@ main(int argc, char *const *argv)
                 case opt_print_stats:
                         opts->print_stats = true;
                         break;
+#if defined(TOYWASM_ENABLE_PROFILER)
+                case opt_profile:
+                        /*
+                         * Note: only the options after this are
+                         * profiled. (eg. --invoke)
+                         */
+                        ret = profiler_start(PROFILER_DEFAULT_HZ);
+                        if (ret != 0) {
+                                xlog_error("failed to start the profiler "
+                                           "with %d",
+                                           ret);
+                                goto fail;
+                        }
+                        profile_path = optarg;
+                        break;
+#endif
+#if defined(TOYWASM_ENABLE_WRITER)
+                case opt_snapshot:
+                        ret = toywasm_repl_snapshot(state, NULL, optarg);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                        break;
+#endif
                 case opt_timeout:
                         toywasm_repl_set_timeout(state, atoi(optarg));
                         break;
@@ -487,6 +642,16 @@ main(int argc, char *const *argv)
                 case opt_trace:
                         xlog_tracing = atoi(optarg);
                         break;
+#endif
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+                case opt_validation_threads:
+                        ret = str_to_u32(
+                                optarg, 0,
+                                &opts->load_options.validation_threads);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                        break;
 #endif
                 case opt_version:
                         toywasm_repl_print_version();
@@ -627,6 +792,19 @@ main(int argc, char *const *argv)
         exit_status = 0;
 #endif
 fail:
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /* write the profile before unloading the modules */
+        if (profile_path != NULL) {
+                profiler_stop();
+                ret = write_profile(profile_path);
+                if (ret != 0) {
+                        xlog_error("failed to write the profile to %s with %d",
+                                   profile_path, ret);
+                        exit_status = 1;
+                }
+                profiler_clear();
+        }
+#endif
         toywasm_repl_reset(state);
 #if defined(TOYWASM_ENABLE_WASI)
         VEC_FREE(mctx, wasi_envs);
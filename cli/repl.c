@@ -29,10 +29,12 @@
 #include "load_context.h"
 #include "mem.h"
 #include "module.h"
+#include "module_stream.h"
 #include "module_writer.h"
 #include "nbio.h"
 #include "repl.h"
 #include "report.h"
+#include "snapshot.h"
 #include "str_to_uint.h"
 #include "suspend.h"
 #include "timeutil.h"
@@ -137,6 +139,12 @@ repl_unload(struct repl_state *state, struct repl_module_state *mod)
                 module_destroy(mod->module_mctx, mod->module);
                 mod->module = NULL;
         }
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        if (mod->stream != NULL) {
+                module_stream_destroy(mod->stream);
+                mod->stream = NULL;
+        }
+#endif
         if (mod->buf != NULL) {
                 if (mod->buf_mapped) {
                         unmap_file(mod->buf, mod->bufsize);
@@ -628,8 +636,14 @@ repl_load_from_buf(struct repl_state *state, const char *modname,
         struct load_context ctx;
         load_context_init(&ctx, mod->module_mctx);
         ctx.options = state->opts.load_options;
-        ret = module_create(&mod->module, mod->buf, mod->buf + mod->bufsize,
-                            &ctx);
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        if (mod->stream != NULL) {
+                ret = module_create_from_stream(&mod->module, mod->stream,
+                                                &ctx);
+        } else
+#endif
+                ret = module_create(&mod->module, mod->buf,
+                                    mod->buf + mod->bufsize, &ctx);
         if (ret != 0) {
                 const char *msg = report_getmessage(&ctx.report);
                 xlog_error("load/validation error: %s", msg);
@@ -756,6 +770,33 @@ toywasm_repl_load(struct repl_state *state, const char *modname,
 #endif
         struct repl_module_state *mod = &mod_u->u.repl;
         memset(mod, 0, sizeof(*mod));
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        if (is_stream_file(filename)) {
+                /*
+                 * eg. a pipe from a fetcher.
+                 * parse the module while receiving it.
+                 */
+                int fd;
+                ret = stream_file_open(filename, &fd);
+                if (ret != 0) {
+                        xlog_error("failed to open %s (error %d)", filename,
+                                   ret);
+                        goto fail;
+                }
+                ret = module_stream_create(&mod->stream, 0, stream_file_read,
+                                           &fd);
+                if (ret == 0) {
+                        ret = repl_load_from_buf(state, modname, mod,
+                                                 trap_ok);
+                }
+                stream_file_close(fd);
+                if (ret != 0) {
+                        goto fail;
+                }
+                state->modules.lsize++;
+                return 0;
+        }
+#endif
         ret = map_file(filename, (void **)&mod->buf, &mod->bufsize);
         if (ret != 0) {
                 xlog_error("failed to map %s (error %d)", filename, ret);
@@ -842,6 +883,32 @@ fail:
 #endif
 }
 
+int
+toywasm_repl_snapshot(struct repl_state *state, const char *modname,
+                      const char *filename)
+{
+#if defined(TOYWASM_ENABLE_WRITER)
+        struct repl_module_state *mod;
+        int ret;
+        ret = find_mod(state, modname, &mod);
+        if (ret != 0) {
+                goto fail;
+        }
+        assert(mod->inst != NULL);
+        ret = instance_snapshot_write(filename, mod->inst, NULL);
+        if (ret != 0) {
+                xlog_error("failed to write snapshot %s (error %d)", filename,
+                           ret);
+                goto fail;
+        }
+        ret = 0;
+fail:
+        return ret;
+#else
+        return ENOTSUP;
+#endif
+}
+
 int
 toywasm_repl_register(struct repl_state *state, const char *modname,
                       const char *register_name)
@@ -1468,6 +1535,11 @@ repl_module_subcmd(struct repl_state *state, const char *cmd,
                 if (ret != 0) {
                         goto fail;
                 }
+        } else if (!strcmp(cmd, "snapshot") && opt != NULL) {
+                ret = toywasm_repl_snapshot(state, modname, opt);
+                if (ret != 0) {
+                        goto fail;
+                }
         } else if (!strcmp(cmd, "global-get") && opt != NULL) {
                 ret = repl_global_get(state, modname, opt);
                 if (ret != 0) {
@@ -25,6 +25,9 @@ struct repl_module_state {
         uint8_t *buf;
         size_t bufsize;
         bool buf_mapped;
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        struct module_stream *stream; /* the binary, instead of buf */
+#endif
         struct module *module;
         struct instance *inst;
 #if defined(TOYWASM_ENABLE_WASI_THREADS)
@@ -85,6 +88,8 @@ int toywasm_repl_register(struct repl_state *state, const char *modname,
 int toywasm_repl_invoke(struct repl_state *state, const char *modname,
                         const char *cmd, uint32_t *exitcodep,
                         bool print_result);
+int toywasm_repl_snapshot(struct repl_state *state, const char *modname,
+                          const char *filename);
 void toywasm_repl_print_build_options(void);
 void toywasm_repl_print_version(void);
 
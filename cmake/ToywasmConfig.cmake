@@ -59,17 +59,70 @@ cmake_dependent_option(TOYWASM_ENABLE_TRACING_INSN
 # O(n^2) -> O(n*log(n))
 option(TOYWASM_SORT_EXPORTS "Sort module export" ON)
 
-# TOYWASM_USE_JUMP_BINARY_SEARCH=ON makes the jump table binary search.
-# otherwise, linear search is used.
-option(TOYWASM_USE_JUMP_BINARY_SEARCH "Enable binary search for jump tables" ON)
-
-# TOYWASM_USE_JUMP_CACHE and TOYWASM_JUMP_CACHE2_SIZE controls
-# two independent jump table caching logic.
-# there is little reasons to enable both of them.
-# (the latter can be disabled with TOYWASM_JUMP_CACHE2_SIZE=0.)
-option(TOYWASM_USE_JUMP_CACHE "Enable single-entry cache for jump tables" OFF)
+# TOYWASM_JUMP_CACHE2_SIZE is the size of the cache of branch targets
+# for the code without jump tables. (see load_options::generate_jump_table)
+# the code with jump tables doesn't need the cache because the branch
+# targets are looked up directly from the labels.
+# it can be disabled with TOYWASM_JUMP_CACHE2_SIZE=0.
 set(TOYWASM_JUMP_CACHE2_SIZE "4" CACHE STRING "The size of jump cache")
 
+# TOYWASM_CALL_INDIRECT_CACHE_SIZE is the size of the cache of
+# call_indirect targets. the entries are keyed by the call site and
+# remember the funcinst found at a table index. they are invalidated
+# when the table is modified. (see tableinst::gen)
+# it can be disabled with TOYWASM_CALL_INDIRECT_CACHE_SIZE=0.
+set(TOYWASM_CALL_INDIRECT_CACHE_SIZE "8" CACHE STRING "The size of call_indirect cache")
+
+# TOYWASM_USE_PREDECODE=ON allows to translate function bodies into
+# a fixed-width internal representation on module load.
+# (see load_options::generate_predecoded_code)
+# it's faster to execute but uses more memory.
+cmake_dependent_option(TOYWASM_USE_PREDECODE
+    "Enable pre-decoded instruction stream"
+    ON
+    "TOYWASM_USE_SEPARATE_EXECUTE"
+    OFF)
+
+# TOYWASM_USE_SUPERINSTRUCTIONS=ON makes the pre-decoder fuse a few
+# common instruction sequences like "local.get; local.get; i32.add"
+# into single instructions.
+cmake_dependent_option(TOYWASM_USE_SUPERINSTRUCTIONS
+    "Enable superinstructions in the pre-decoded code"
+    ON
+    "TOYWASM_USE_PREDECODE"
+    OFF)
+
+# TOYWASM_ENABLE_JIT=ON allows to compile function bodies into
+# machine code on module load. (see load_options::generate_jit_code)
+# only x86-64 with the System V ABI is supported.
+option(TOYWASM_ENABLE_JIT "Enable the baseline JIT compiler" OFF)
+if(TOYWASM_ENABLE_JIT)
+if(NOT CMAKE_SYSTEM_PROCESSOR MATCHES "^(x86_64|amd64|AMD64)$" OR WIN32 OR CMAKE_C_COMPILER_TARGET MATCHES "wasm")
+message(FATAL_ERROR "TOYWASM_ENABLE_JIT is not supported for this target")
+endif()
+endif()
+
+# TOYWASM_ENABLE_LAZY_VALIDATION=ON allows to defer the validation of
+# function bodies until their first calls.
+# (see load_options::lazy_validation)
+option(TOYWASM_ENABLE_LAZY_VALIDATION "Enable lazy validation of functions" ON)
+
+# TOYWASM_ENABLE_MODULE_CACHE=ON allows to cache the side tables of
+# validated function bodies in a directory so that later loads of
+# the same module can skip their validation.
+# (see load_options::module_cache_dir and lib/module_cache.c)
+# it's OFF by default because a cache hit skips the validation.
+# the cache directory should be writable only by its trusted users.
+option(TOYWASM_ENABLE_MODULE_CACHE "Enable the on-disk module cache" OFF)
+if(WIN32 OR CMAKE_C_COMPILER_TARGET MATCHES "wasm")
+set(TOYWASM_ENABLE_MODULE_CACHE OFF)
+endif()
+
+# TOYWASM_ENABLE_MODULE_STREAM=ON provides module_create_from_stream,
+# which parses a module while receiving it. (eg. from a pipe)
+# (see lib/module_stream.c)
+option(TOYWASM_ENABLE_MODULE_STREAM "Enable loading modules from streams" ON)
+
 # TOYWASM_USE_LOCALS_CACHE=ON -> faster execution
 # TOYWASM_USE_LOCALS_CACHE=OFF -> slightly smaller code and exec_context
 option(TOYWASM_USE_LOCALS_CACHE "Enable current_locals" ON)
@@ -121,12 +174,80 @@ cmake_dependent_option(TOYWASM_USE_LOCALS_FAST_PATH
 # TOYWASM_PREALLOC_SHARED_MEMORY=OFF
 #   on-demand (on memory.grow) allocation of shared memories.
 #   can save memory, but slower and very complex memory.grow processing.
+# either way, TOYWASM_USE_RESERVED_MEMORY=ON takes precedence.
 cmake_dependent_option(TOYWASM_PREALLOC_SHARED_MEMORY
     "Preallocate shared memory"
     OFF
     "TOYWASM_ENABLE_WASM_THREADS"
     OFF)
 
+# TOYWASM_USE_RESERVED_MEMORY=ON reserves the address space for the max
+# size of each memory with mmap so that memory.grow doesn't need to copy
+# or move the memory. (see lib/memory_reserve.c)
+# it makes TOYWASM_PREALLOC_SHARED_MEMORY unnecessary.
+option(TOYWASM_USE_RESERVED_MEMORY "Reserve the address space for memories" OFF)
+
+# TOYWASM_USE_GUARD_PAGES=ON reserves the whole 32-bit address range
+# (plus the max offset) of each memory with mmap so that load/store
+# instructions can skip bounds checks. out of bounds accesses fault and
+# are converted to traps by a SIGSEGV handler. (see lib/memory_guard.c)
+# only for 64-bit POSIX hosts. it implies TOYWASM_USE_RESERVED_MEMORY=ON.
+option(TOYWASM_USE_GUARD_PAGES "Use guard pages for bounds checks" OFF)
+if(TOYWASM_USE_GUARD_PAGES)
+if(NOT CMAKE_SIZEOF_VOID_P EQUAL 8)
+message(FATAL_ERROR "TOYWASM_USE_GUARD_PAGES is not supported for this target")
+endif()
+set(TOYWASM_USE_RESERVED_MEMORY ON)
+set(THREADS_PREFER_PTHREAD_FLAG TRUE)
+find_package(Threads)
+if (NOT THREADS_FOUND)
+message(FATAL_ERROR "TOYWASM_USE_GUARD_PAGES requires pthread")
+endif()
+set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pthread")
+set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pthread")
+endif()
+if(TOYWASM_USE_RESERVED_MEMORY)
+if(WIN32 OR CMAKE_C_COMPILER_TARGET MATCHES "wasm")
+message(FATAL_ERROR "TOYWASM_USE_RESERVED_MEMORY is not supported for this target")
+endif()
+endif()
+
+# TOYWASM_ENABLE_INSTANCE_CLONE=ON provides instance_clone, which creates
+# an instance from a snapshot of another instance without instantiation.
+# (see lib/instance_clone.c)
+# on Linux with TOYWASM_USE_RESERVED_MEMORY=ON, memories are cloned
+# copy-on-write with a memfd. otherwise, they are copied.
+option(TOYWASM_ENABLE_INSTANCE_CLONE "Enable instance_clone" ON)
+
+# TOYWASM_ENABLE_INSTANCE_POOL=ON provides a pool of clones which are
+# reset and reused instead of being destroyed. (see lib/instance_pool.c)
+cmake_dependent_option(TOYWASM_ENABLE_INSTANCE_POOL
+    "Enable instance_pool"
+    ON
+    "TOYWASM_ENABLE_INSTANCE_CLONE"
+    OFF)
+
+# TOYWASM_USE_TYPE_REGISTRY=ON interns functypes into a process-wide
+# registry so that each functype and funcinst carries a canonical id.
+# it makes the signature check of call_indirect an integer comparison.
+# (see lib/type_registry.c)
+option(TOYWASM_USE_TYPE_REGISTRY "Intern functypes for faster call_indirect" ON)
+
+# TOYWASM_ENABLE_PROFILER=ON provides a SIGPROF-based sampling profiler
+# for wasm code. (see lib/profiler.c and the --profile option of the cli)
+# it doesn't cost much unless the profiler is actually started.
+option(TOYWASM_ENABLE_PROFILER "Enable the sampling profiler" ON)
+if(WIN32 OR CMAKE_C_COMPILER_TARGET MATCHES "wasm")
+set(TOYWASM_ENABLE_PROFILER OFF)
+endif()
+
+# TOYWASM_ENABLE_INSN_STATS=ON counts the executed instructions per opcode
+# and per function, and the calls per function. they are printed by
+# --print-stats. it's an instrumentation build for tuning. it makes
+# the execution slower.
+# Note: the code executed by the jit compiler is not counted.
+option(TOYWASM_ENABLE_INSN_STATS "Count instructions per opcode and function" OFF)
+
 # enable logic to write a module to a file.
 # currently it's only used by repl ":save" command.
 option(TOYWASM_ENABLE_WRITER "Enable module writer" ON)
@@ -135,6 +256,21 @@ option(TOYWASM_MAINTAIN_EXPR_END "Maintain the end pointer of expr" OFF)
 # enable SIMD. we made this an option because it's large.
 option(TOYWASM_ENABLE_WASM_SIMD "Enable SIMD" ON)
 
+# TOYWASM_USE_HOST_SIMD=ON implements SIMD instructions with the GCC/Clang
+# vector extensions and x86 intrinsics (SSE2/SSSE3/SSE4.1)
+# instead of the portable per-lane C code. (see lib/simd_host.h)
+# the intrinsics are selected with the compiler target. eg. -march=native
+cmake_dependent_option(TOYWASM_USE_HOST_SIMD
+    "Use host vector extensions for SIMD"
+    OFF
+    "TOYWASM_ENABLE_WASM_SIMD"
+    OFF)
+if(TOYWASM_USE_HOST_SIMD)
+if(NOT CMAKE_C_COMPILER_ID MATCHES "GNU|Clang")
+message(FATAL_ERROR "TOYWASM_USE_HOST_SIMD requires GCC or Clang")
+endif()
+endif()
+
 # enable each wasm proposals.
 option(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING "Enable exception-handling proposal" OFF)
 set(TOYWASM_EXCEPTION_MAX_CELLS "4" CACHE STRING "The max size of exception")
@@ -167,6 +303,22 @@ cmake_dependent_option(TOYWASM_ENABLE_WASI_THREADS
     "TOYWASM_ENABLE_WASM_THREADS"
     OFF)
 
+# TOYWASM_USE_FUTEX=ON implements memory.atomic.wait32 and
+# memory.atomic.notify with linux futex on the linear memory address
+# instead of the waiter lists protected by a global lock.
+# memory.atomic.wait64 still uses the waiter lists. (see lib/futex.c)
+# it's only for linux and not compatible with TOYWASM_USE_USER_SCHED.
+cmake_dependent_option(TOYWASM_USE_FUTEX
+    "Use futex for memory.atomic.wait32/notify"
+    OFF
+    "TOYWASM_ENABLE_WASM_THREADS;NOT TOYWASM_USE_USER_SCHED"
+    OFF)
+if(TOYWASM_USE_FUTEX)
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Linux")
+message(FATAL_ERROR "TOYWASM_USE_FUTEX is only for linux")
+endif()
+endif()
+
 # experimental emscripten-style shared library
 # https://github.com/WebAssembly/tool-conventions/blob/main/DynamicLinking.md
 option(TOYWASM_ENABLE_DYLD "Enable shared library support" OFF)
@@ -286,6 +438,39 @@ endif()
 endif()
 endif()
 
+# TOYWASM_ENABLE_PARALLEL_VALIDATION=ON allows to validate function bodies
+# with multiple host threads on module load.
+# (see load_options::validation_threads)
+# it uses the same machinery as TOYWASM_ENABLE_LAZY_VALIDATION.
+cmake_dependent_option(TOYWASM_ENABLE_PARALLEL_VALIDATION
+    "Enable parallel validation of functions"
+    OFF
+    "TOYWASM_ENABLE_LAZY_VALIDATION"
+    OFF)
+if(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+set(THREADS_PREFER_PTHREAD_FLAG TRUE)
+find_package(Threads)
+if (NOT THREADS_FOUND)
+message(FATAL_ERROR "TOYWASM_ENABLE_PARALLEL_VALIDATION requires pthread")
+endif()
+set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pthread")
+set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pthread")
+endif()
+
+# TOYWASM_ENABLE_WSCHED=ON provides a multi-threaded work-stealing
+# scheduler to run many exec_contexts on a pool of host threads.
+# (see lib/wsched.c)
+option(TOYWASM_ENABLE_WSCHED "Enable the work-stealing scheduler" OFF)
+if(TOYWASM_ENABLE_WSCHED)
+set(THREADS_PREFER_PTHREAD_FLAG TRUE)
+find_package(Threads)
+if (NOT THREADS_FOUND)
+message(FATAL_ERROR "TOYWASM_ENABLE_WSCHED requires pthread")
+endif()
+set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pthread")
+set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pthread")
+endif()
+
 # GCC doesn't seem to have a way to only allow statement expressions
 if(CMAKE_C_COMPILER_ID MATCHES "Clang")
 set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -pedantic -Wno-gnu-statement-expression")
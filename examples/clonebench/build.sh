@@ -0,0 +1,8 @@
+#! /bin/sh
+
+set -e
+
+# a release build for the benchmark.
+# TOYWASM_USE_RESERVED_MEMORY=ON enables the copy-on-write cloning.
+TOYWASM_EXTRA_CMAKE_OPTIONS="-DCMAKE_BUILD_TYPE=Release -DTOYWASM_USE_RESERVED_MEMORY=ON" \
+../build-toywasm-and-app.sh
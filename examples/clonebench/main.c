@@ -0,0 +1,298 @@
+/*
+ * a benchmark of instance_clone.
+ *
+ * usage:
+ * % clonebench in.wasm INIT_FUNCTION FUNCTION [ITERATIONS]
+ *
+ * it compares the two ways to run FUNCTION in a fresh instance
+ * initialized by INIT_FUNCTION:
+ *
+ *   create: instance_create + INIT_FUNCTION + FUNCTION + instance_destroy
+ *   clone:  instance_clone + FUNCTION + instance_destroy
+ *   pool:   instance_pool_acquire + FUNCTION + instance_pool_release
+ *
+ * both functions should take no parameters. the results are ignored.
+ * the module should not have imports.
+ */
+
+#define _POSIX_C_SOURCE 199309 /* clock_gettime */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <toywasm/exec_context.h>
+#include <toywasm/fileio.h>
+#include <toywasm/instance.h>
+#include <toywasm/instance_clone.h>
+#include <toywasm/instance_pool.h>
+#include <toywasm/load_context.h>
+#include <toywasm/mem.h>
+#include <toywasm/module.h>
+#include <toywasm/report.h>
+#include <toywasm/type.h>
+#include <toywasm/xlog.h>
+
+struct bench_func {
+        const char *name;
+        uint32_t funcidx;
+        const struct resulttype *pt;
+        const struct resulttype *rt;
+};
+
+static int
+find_func(const struct module *m, const char *cname, struct bench_func *f)
+{
+        struct name name = NAME_FROM_CSTR(cname);
+        int ret;
+        ret = module_find_export_func(m, &name, &f->funcidx);
+        if (ret != 0) {
+                xlog_error("module_find_export_func failed for %s", cname);
+                return ret;
+        }
+        const struct functype *ft = module_functype(m, f->funcidx);
+        if (ft->parameter.ntypes != 0) {
+                xlog_error("unexpected type of %s", cname);
+                return EINVAL;
+        }
+        f->name = cname;
+        f->pt = &ft->parameter;
+        f->rt = &ft->result;
+        return 0;
+}
+
+static int
+invoke_with(struct exec_context *ectx, const struct bench_func *f)
+{
+        int ret;
+        ret = instance_execute_func(ectx, f->funcidx, f->pt, f->rt);
+        ret = instance_execute_handle_restart(ectx, ret);
+        if (ret == ETOYWASMTRAP) {
+                const struct trap_info *trap = &ectx->trap;
+                xlog_error("%s: got a trap %u: %s", f->name,
+                           (unsigned int)trap->trapid,
+                           report_getmessage(ectx->report));
+        } else if (ret != 0) {
+                xlog_error("%s: instance_execute_func failed with %d",
+                           f->name, ret);
+        }
+        return ret;
+}
+
+static int
+invoke(struct mem_context *mctx, struct instance *inst,
+       const struct bench_func *f)
+{
+        struct exec_context ectx;
+        int ret;
+        exec_context_init(&ectx, inst, mctx);
+        ret = invoke_with(&ectx, f);
+        exec_context_clear(&ectx);
+        return ret;
+}
+
+static int
+create(struct mem_context *mctx, const struct module *m,
+       struct instance **instp)
+{
+        struct report report;
+        int ret;
+        report_init(&report);
+        ret = instance_create(mctx, m, instp, NULL, &report);
+        if (ret != 0) {
+                xlog_error("instance_create failed with %d: %s", ret,
+                           report_getmessage(&report));
+        }
+        report_clear(&report);
+        return ret;
+}
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+print_result(const char *label, uint64_t ns, unsigned int n)
+{
+        printf("%-6s %u iterations in %.3f ms: %.3f us/iteration, "
+               "%.0f iterations/s\n",
+               label, n, (double)ns / 1000000, (double)ns / n / 1000,
+               (double)n * 1000000000 / ns);
+}
+
+#if defined(TOYWASM_ENABLE_INSTANCE_POOL)
+static int
+bench_pool(struct mem_context *mctx, const struct instance_template *t,
+           const struct bench_func *func, unsigned int n)
+{
+        struct instance_pool *pool;
+        struct pooled_instance *pi;
+        uint64_t start;
+        unsigned int i;
+        int ret;
+
+        ret = instance_pool_create(mctx, t, 1, &pool);
+        if (ret != 0) {
+                xlog_error("instance_pool_create failed with %d", ret);
+                return ret;
+        }
+        ret = instance_pool_fill(pool, 1);
+        if (ret != 0) {
+                xlog_error("instance_pool_fill failed with %d", ret);
+                goto fail;
+        }
+        start = now_ns();
+        for (i = 0; i < n; i++) {
+                ret = instance_pool_acquire(pool, &pi);
+                if (ret != 0) {
+                        xlog_error("instance_pool_acquire failed with %d",
+                                   ret);
+                        goto fail;
+                }
+                ret = invoke_with(&pi->ectx, func);
+                instance_pool_release(pool, pi);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        print_result("pool", now_ns() - start, n);
+        fflush(stdout);
+        instance_pool_print_stats(pool);
+fail:
+        instance_pool_destroy(pool);
+        return ret;
+}
+#endif
+
+static int
+bench(struct mem_context *mctx, const struct module *m,
+      const struct bench_func *init, const struct bench_func *func,
+      unsigned int n)
+{
+        struct instance_template *t = NULL;
+        struct instance *base = NULL;
+        struct instance *inst;
+        uint64_t start;
+        unsigned int i;
+        int ret;
+
+        start = now_ns();
+        for (i = 0; i < n; i++) {
+                ret = create(mctx, m, &inst);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ret = invoke(mctx, inst, init);
+                if (ret == 0) {
+                        ret = invoke(mctx, inst, func);
+                }
+                instance_destroy(inst);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        print_result("create", now_ns() - start, n);
+
+        ret = create(mctx, m, &base);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = invoke(mctx, base, init);
+        if (ret != 0) {
+                goto fail;
+        }
+        start = now_ns();
+        ret = instance_template_create(mctx, base, &t);
+        if (ret != 0) {
+                xlog_error("instance_template_create failed with %d", ret);
+                goto fail;
+        }
+        printf("template creation took %.3f us\n",
+               (double)(now_ns() - start) / 1000);
+        start = now_ns();
+        for (i = 0; i < n; i++) {
+                ret = instance_clone(mctx, t, &inst);
+                if (ret != 0) {
+                        xlog_error("instance_clone failed with %d", ret);
+                        goto fail;
+                }
+                ret = invoke(mctx, inst, func);
+                instance_destroy(inst);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        print_result("clone", now_ns() - start, n);
+#if defined(TOYWASM_ENABLE_INSTANCE_POOL)
+        ret = bench_pool(mctx, t, func, n);
+#endif
+fail:
+        if (t != NULL) {
+                instance_template_destroy(t);
+        }
+        if (base != NULL) {
+                instance_destroy(base);
+        }
+        return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc != 4 && argc != 5) {
+                xlog_error("unexpected number of args");
+                exit(2);
+        }
+        const char *filename = argv[1];
+        unsigned int n = 10000;
+        if (argc == 5) {
+                n = strtoul(argv[4], NULL, 0);
+                if (n == 0) {
+                        xlog_error("invalid number of iterations");
+                        exit(2);
+                }
+        }
+        struct module *m;
+        int ret;
+        uint8_t *p;
+        size_t sz;
+        ret = map_file(filename, (void **)&p, &sz);
+        if (ret != 0) {
+                xlog_error("map_file failed with %d", ret);
+                exit(1);
+        }
+        struct mem_context mctx;
+        mem_context_init(&mctx);
+        struct load_context ctx;
+        load_context_init(&ctx, &mctx);
+        ret = module_create(&m, p, p + sz, &ctx);
+        if (ret != 0) {
+                xlog_error("module_load failed with %d: %s", ret,
+                           report_getmessage(&ctx.report));
+                exit(1);
+        }
+        load_context_clear(&ctx);
+        struct bench_func init;
+        struct bench_func func;
+        ret = find_func(m, argv[2], &init);
+        if (ret == 0) {
+                ret = find_func(m, argv[3], &func);
+        }
+        if (ret == 0) {
+                ret = bench(&mctx, m, &init, &func, n);
+        }
+        module_destroy(&mctx, m);
+        unmap_file(p, sz);
+        mem_context_clear(&mctx);
+        if (ret != 0) {
+                exit(1);
+        }
+        exit(0);
+}
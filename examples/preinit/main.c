@@ -0,0 +1,183 @@
+/*
+ * an example app to pre-initialize a module.
+ *
+ * usage:
+ * % preinit in.wasm out.wasm [INIT_FUNCTION]
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <toywasm/cconv.h>
+#include <toywasm/exec_context.h>
+#include <toywasm/fileio.h>
+#include <toywasm/instance.h>
+#include <toywasm/load_context.h>
+#include <toywasm/mem.h>
+#include <toywasm/module.h>
+#include <toywasm/report.h>
+#include <toywasm/snapshot.h>
+#include <toywasm/type.h>
+#include <toywasm/wasi.h>
+#include <toywasm/xlog.h>
+
+static int
+preinit(struct mem_context *mctx, const struct module *m,
+        const char *init_func, const char *outfilename)
+{
+        struct wasi_instance *wasi = NULL;
+        struct import_object *wasi_import_object = NULL;
+        struct instance *inst = NULL;
+        const int stdio_fds[3] = {
+                STDIN_FILENO,
+                STDOUT_FILENO,
+                STDERR_FILENO,
+        };
+        int ret;
+
+        /*
+         * find the initialization function
+         */
+        uint32_t funcidx;
+        struct name name = NAME_FROM_CSTR(init_func);
+        ret = module_find_export_func(m, &name, &funcidx);
+        if (ret != 0) {
+                xlog_error("module_find_export_func failed with %d", ret);
+                goto fail;
+        }
+        const struct functype *ft = module_functype(m, funcidx);
+        const struct resulttype *pt = &ft->parameter;
+        const struct resulttype *rt = &ft->result;
+        if (pt->ntypes != 0 || rt->ntypes != 0) {
+                xlog_error("unexpected type of %s", init_func);
+                ret = EINVAL;
+                goto fail;
+        }
+
+        /*
+         * create a wasi instance
+         */
+        ret = wasi_instance_create(mctx, &wasi);
+        if (ret != 0) {
+                xlog_error("wasi_instance_create failed with %d", ret);
+                goto fail;
+        }
+        unsigned int i;
+        for (i = 0; i < 3; i++) {
+                ret = wasi_instance_add_hostfd(wasi, i, stdio_fds[i]);
+                if (ret != 0) {
+                        xlog_error("wasi_instance_add_hostfd failed with %d",
+                                   ret);
+                        goto fail;
+                }
+        }
+        ret = import_object_create_for_wasi(mctx, wasi, &wasi_import_object);
+        if (ret != 0) {
+                xlog_error("import_object_create_for_wasi failed with %d",
+                           ret);
+                goto fail;
+        }
+
+        /*
+         * instantiate the module
+         */
+        struct report report;
+        report_init(&report);
+        ret = instance_create(mctx, m, &inst, wasi_import_object, &report);
+        if (ret != 0) {
+                const char *msg = report_getmessage(&report);
+                xlog_error("instance_create failed with %d: %s", ret, msg);
+                report_clear(&report);
+                goto fail;
+        }
+        report_clear(&report);
+        wasi_instance_set_memory(wasi, cconv_memory(inst));
+
+        /*
+         * run the initialization function
+         */
+        struct exec_context ectx;
+        exec_context_init(&ectx, inst, mctx);
+        ret = instance_execute_func(&ectx, funcidx, pt, rt);
+        ret = instance_execute_handle_restart(&ectx, ret);
+        if (ret == ETOYWASMTRAP) {
+                const struct trap_info *trap = &ectx.trap;
+                xlog_error("got a trap %u: %s", (unsigned int)trap->trapid,
+                           report_getmessage(ectx.report));
+                exec_context_clear(&ectx);
+                goto fail;
+        } else if (ret != 0) {
+                xlog_error("instance_execute_func failed with %d", ret);
+                exec_context_clear(&ectx);
+                goto fail;
+        }
+        exec_context_clear(&ectx);
+
+        /*
+         * write the snapshot
+         */
+        ret = instance_snapshot_write(outfilename, inst, &name);
+        if (ret != 0) {
+                xlog_error("instance_snapshot_write to %s failed with %d",
+                           outfilename, ret);
+                goto fail;
+        }
+fail:
+        if (inst != NULL) {
+                instance_destroy(inst);
+        }
+        if (wasi_import_object != NULL) {
+                import_object_destroy(mctx, wasi_import_object);
+        }
+        if (wasi != NULL) {
+                wasi_instance_destroy(wasi);
+        }
+        return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc != 3 && argc != 4) {
+                xlog_error("unexpected number of args");
+                exit(2);
+        }
+        const char *filename = argv[1];
+        const char *outfilename = argv[2];
+        const char *init_func = "_initialize";
+        if (argc == 4) {
+                init_func = argv[3];
+        }
+        struct module *m;
+        int ret;
+        uint8_t *p;
+        size_t sz;
+        ret = map_file(filename, (void **)&p, &sz);
+        if (ret != 0) {
+                xlog_error("map_file failed with %d", ret);
+                exit(1);
+        }
+        struct mem_context mctx;
+        mem_context_init(&mctx);
+        struct load_context ctx;
+        load_context_init(&ctx, &mctx);
+        ret = module_create(&m, p, p + sz, &ctx);
+        if (ret != 0) {
+                xlog_error("module_load failed with %d: %s", ret,
+                           report_getmessage(&ctx.report));
+                exit(1);
+        }
+        load_context_clear(&ctx);
+        ret = preinit(&mctx, m, init_func, outfilename);
+        module_destroy(&mctx, m);
+        unmap_file(p, sz);
+        mem_context_clear(&mctx);
+        if (ret != 0) {
+                exit(1);
+        }
+        exit(0);
+}
@@ -0,0 +1,15 @@
+#! /bin/sh
+
+set -e
+
+# build the benchmark twice to compare the backends of
+# memory.atomic.wait32/notify.
+OPTIONS="-DCMAKE_BUILD_TYPE=Release -DTOYWASM_ENABLE_WASM_THREADS=ON"
+
+ROOT=build/waitlist \
+TOYWASM_EXTRA_CMAKE_OPTIONS="${OPTIONS} -DTOYWASM_USE_FUTEX=OFF" \
+../build-toywasm-and-app.sh
+
+ROOT=build/futex \
+TOYWASM_EXTRA_CMAKE_OPTIONS="${OPTIONS} -DTOYWASM_USE_FUTEX=ON" \
+../build-toywasm-and-app.sh
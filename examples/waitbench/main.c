@@ -0,0 +1,288 @@
+/*
+ * a contention benchmark of memory.atomic.wait32/notify.
+ *
+ * usage:
+ * % waitbench atomic_mutex.wasm [NTHREADS [ITERATIONS]]
+ *
+ * it creates NTHREADS instances of wat/atomic_mutex.wat sharing
+ * a memory, and calls "run" with ITERATIONS in each of them
+ * concurrently on its own host thread. all threads fight for
+ * the single mutex in the shared memory.
+ *
+ * build it with and without TOYWASM_USE_FUTEX to compare the backends.
+ * (see build.sh)
+ *
+ * wat/atomic_counter.wat, which has the same exports, can be used
+ * to measure contended atomic read-modify-write instructions.
+ */
+
+#define _POSIX_C_SOURCE 199506 /* clock_gettime, pthread */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <toywasm/exec_context.h>
+#include <toywasm/fileio.h>
+#include <toywasm/instance.h>
+#include <toywasm/load_context.h>
+#include <toywasm/mem.h>
+#include <toywasm/module.h>
+#include <toywasm/report.h>
+#include <toywasm/type.h>
+#include <toywasm/xlog.h>
+
+#if !defined(TOYWASM_ENABLE_WASM_THREADS)
+#error this example requires TOYWASM_ENABLE_WASM_THREADS=ON
+#endif
+
+#if defined(TOYWASM_USE_FUTEX)
+#define BACKEND "futex"
+#else
+#define BACKEND "waitlist"
+#endif
+
+struct bench {
+        struct mem_context *mctx;
+        uint32_t run_funcidx;
+        uint32_t count_funcidx;
+        uint32_t iterations;
+
+        /* to start all threads at once */
+        pthread_mutex_t lock;
+        pthread_cond_t cv;
+        bool go;
+};
+
+struct worker {
+        struct bench *b;
+        struct instance *inst;
+        pthread_t t;
+        int ret;
+};
+
+static int
+find_func(const struct module *m, const char *cname, uint32_t *funcidxp)
+{
+        struct name name = NAME_FROM_CSTR(cname);
+        int ret;
+        ret = module_find_export_func(m, &name, funcidxp);
+        if (ret != 0) {
+                xlog_error("module_find_export_func failed for %s", cname);
+        }
+        return ret;
+}
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+call(struct instance *inst, struct mem_context *mctx, uint32_t funcidx,
+     const struct val *params, struct val *results)
+{
+        const struct functype *ft = module_functype(inst->module, funcidx);
+        struct exec_context ectx;
+        int ret;
+
+        exec_context_init(&ectx, inst, mctx);
+        ret = exec_push_vals(&ectx, &ft->parameter, params);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = instance_execute_func(&ectx, funcidx, &ft->parameter,
+                                    &ft->result);
+        ret = instance_execute_handle_restart(&ectx, ret);
+        if (ret == ETOYWASMTRAP) {
+                xlog_error("got a trap %u: %s",
+                           (unsigned int)ectx.trap.trapid,
+                           report_getmessage(ectx.report));
+        } else if (ret != 0) {
+                xlog_error("instance_execute_func failed with %d", ret);
+        } else {
+                exec_pop_vals(&ectx, &ft->result, results);
+        }
+fail:
+        exec_context_clear(&ectx);
+        return ret;
+}
+
+static void *
+worker_main(void *vp)
+{
+        struct worker *w = vp;
+        struct bench *b = w->b;
+
+        pthread_mutex_lock(&b->lock);
+        while (!b->go) {
+                pthread_cond_wait(&b->cv, &b->lock);
+        }
+        pthread_mutex_unlock(&b->lock);
+
+        struct val param;
+        param.u.i32 = b->iterations;
+        w->ret = call(w->inst, b->mctx, b->run_funcidx, &param, NULL);
+        return NULL;
+}
+
+static int
+bench(struct bench *b, struct worker *workers, unsigned int nthreads)
+{
+        unsigned int nstarted = 0;
+        unsigned int i;
+        int ret = 0;
+
+        b->go = false;
+        for (i = 0; i < nthreads; i++) {
+                struct worker *w = &workers[i];
+                w->b = b;
+                ret = pthread_create(&w->t, NULL, worker_main, w);
+                if (ret != 0) {
+                        xlog_error("pthread_create failed with %d", ret);
+                        break;
+                }
+                nstarted++;
+        }
+        pthread_mutex_lock(&b->lock);
+        b->go = true;
+        pthread_cond_broadcast(&b->cv);
+        pthread_mutex_unlock(&b->lock);
+        uint64_t start = now_ns();
+        for (i = 0; i < nstarted; i++) {
+                struct worker *w = &workers[i];
+                pthread_join(w->t, NULL);
+                if (w->ret != 0) {
+                        ret = w->ret;
+                }
+        }
+        uint64_t ns = now_ns() - start;
+        if (ret != 0) {
+                return ret;
+        }
+
+        struct val result;
+        ret = call(workers[0].inst, b->mctx, b->count_funcidx, NULL, &result);
+        if (ret != 0) {
+                return ret;
+        }
+        uint64_t n = (uint64_t)nthreads * b->iterations;
+        if (result.u.i32 != (uint32_t)n) {
+                xlog_error("unexpected count %" PRIu32 " != %" PRIu64,
+                           result.u.i32, n);
+                return EPROTO;
+        }
+        printf("%s: %u threads x %" PRIu32
+               " iterations in %.3f ms: %.0f iterations/s\n",
+               BACKEND, nthreads, b->iterations, (double)ns / 1000000,
+               (double)n * 1000000000 / ns);
+        return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc < 2 || argc > 4) {
+                xlog_error("unexpected number of args");
+                exit(2);
+        }
+        const char *filename = argv[1];
+        unsigned int nthreads = 4;
+        struct bench b;
+        memset(&b, 0, sizeof(b));
+        b.iterations = 100000;
+        if (argc >= 3) {
+                nthreads = strtoul(argv[2], NULL, 0);
+                if (nthreads == 0) {
+                        xlog_error("invalid number of threads");
+                        exit(2);
+                }
+        }
+        if (argc >= 4) {
+                b.iterations = strtoul(argv[3], NULL, 0);
+        }
+        struct module *m;
+        int ret;
+        uint8_t *p;
+        size_t sz;
+        ret = map_file(filename, (void **)&p, &sz);
+        if (ret != 0) {
+                xlog_error("map_file failed with %d", ret);
+                exit(1);
+        }
+        struct mem_context mctx;
+        mem_context_init(&mctx);
+        b.mctx = &mctx;
+        pthread_mutex_init(&b.lock, NULL);
+        pthread_cond_init(&b.cv, NULL);
+        struct load_context ctx;
+        load_context_init(&ctx, &mctx);
+        ret = module_create(&m, p, p + sz, &ctx);
+        if (ret != 0) {
+                xlog_error("module_load failed with %d: %s", ret,
+                           report_getmessage(&ctx.report));
+                exit(1);
+        }
+        load_context_clear(&ctx);
+        ret = find_func(m, "run", &b.run_funcidx);
+        if (ret == 0) {
+                ret = find_func(m, "count", &b.count_funcidx);
+        }
+        if (ret != 0) {
+                exit(1);
+        }
+
+        /* the shared memory imported by all instances */
+        struct import_object *imo;
+        ret = create_satisfying_shared_memories(&mctx, &mctx, m, &imo);
+        if (ret != 0) {
+                xlog_error("create_satisfying_shared_memories failed with %d",
+                           ret);
+                exit(1);
+        }
+        struct worker *workers = calloc(nthreads, sizeof(*workers));
+        if (workers == NULL) {
+                exit(1);
+        }
+        unsigned int ninstances = 0;
+        unsigned int i;
+        for (i = 0; i < nthreads; i++) {
+                struct report report;
+                report_init(&report);
+                ret = instance_create(&mctx, m, &workers[i].inst, imo,
+                                      &report);
+                if (ret != 0) {
+                        xlog_error("instance_create failed with %d: %s", ret,
+                                   report_getmessage(&report));
+                }
+                report_clear(&report);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ninstances++;
+        }
+        ret = bench(&b, workers, nthreads);
+fail:
+        for (i = 0; i < ninstances; i++) {
+                instance_destroy(workers[i].inst);
+        }
+        free(workers);
+        import_object_destroy(&mctx, imo);
+        module_destroy(&mctx, m);
+        unmap_file(p, sz);
+        pthread_cond_destroy(&b.cv);
+        pthread_mutex_destroy(&b.lock);
+        mem_context_clear(&mctx);
+        if (ret != 0) {
+                exit(1);
+        }
+        exit(0);
+}
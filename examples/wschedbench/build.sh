@@ -0,0 +1,6 @@
+#! /bin/sh
+
+set -e
+
+TOYWASM_EXTRA_CMAKE_OPTIONS="-DCMAKE_BUILD_TYPE=Release -DTOYWASM_ENABLE_WSCHED=ON" \
+../build-toywasm-and-app.sh
@@ -0,0 +1,326 @@
+/*
+ * a benchmark of wsched. (lib/wsched.c)
+ *
+ * usage:
+ * % wschedbench in.wasm FUNCTION ARG [NINSTANCES [NWORKERS]]
+ *
+ * it creates NINSTANCES instances of the module and calls FUNCTION
+ * with ARG once in each of them:
+ *
+ *   sequential: one by one on the main thread
+ *   wsched:     concurrently on a wsched with NWORKERS workers
+ *
+ * FUNCTION should take an i64 and return an i64, like fib-slow in
+ * wat/fib.wat. the module should not have imports.
+ */
+
+#define _POSIX_C_SOURCE 199309 /* clock_gettime */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <toywasm/exec_context.h>
+#include <toywasm/fileio.h>
+#include <toywasm/instance.h>
+#include <toywasm/load_context.h>
+#include <toywasm/mem.h>
+#include <toywasm/module.h>
+#include <toywasm/report.h>
+#include <toywasm/type.h>
+#include <toywasm/wsched.h>
+#include <toywasm/xlog.h>
+
+#if !defined(TOYWASM_ENABLE_WSCHED)
+#error this example requires TOYWASM_ENABLE_WSCHED=ON
+#endif
+
+struct bench_instance {
+        struct instance *inst;
+        struct exec_context ectx;
+        struct wsched_task task;
+        uint64_t result;
+        int ret;
+};
+
+struct bench {
+        uint32_t funcidx;
+        const struct resulttype *pt;
+        const struct resulttype *rt;
+        uint64_t arg;
+};
+
+static int
+find_func(const struct module *m, const char *cname, struct bench *b)
+{
+        struct name name = NAME_FROM_CSTR(cname);
+        int ret;
+        ret = module_find_export_func(m, &name, &b->funcidx);
+        if (ret != 0) {
+                xlog_error("module_find_export_func failed for %s", cname);
+                return ret;
+        }
+        const struct functype *ft = module_functype(m, b->funcidx);
+        if (ft->parameter.ntypes != 1 ||
+            ft->parameter.types[0] != TYPE_i64 || ft->result.ntypes != 1 ||
+            ft->result.types[0] != TYPE_i64) {
+                xlog_error("unexpected type of %s", cname);
+                return EINVAL;
+        }
+        b->pt = &ft->parameter;
+        b->rt = &ft->result;
+        return 0;
+}
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+print_result(const char *label, uint64_t ns, unsigned int n)
+{
+        printf("%-10s %u calls in %.3f ms: %.0f calls/s\n", label, n,
+               (double)ns / 1000000, (double)n * 1000000000 / ns);
+}
+
+static int
+push_arg(struct bench_instance *bi, const struct bench *b)
+{
+        struct val param;
+        param.u.i64 = b->arg;
+        return exec_push_vals(&bi->ectx, b->pt, &param);
+}
+
+static void
+pop_result(struct bench_instance *bi, const struct bench *b)
+{
+        struct val result;
+        exec_pop_vals(&bi->ectx, b->rt, &result);
+        bi->result = result.u.i64;
+}
+
+static void
+print_error(struct bench_instance *bi, int ret)
+{
+        if (ret == ETOYWASMTRAP) {
+                const struct trap_info *trap = &bi->ectx.trap;
+                xlog_error("got a trap %u: %s", (unsigned int)trap->trapid,
+                           report_getmessage(bi->ectx.report));
+        } else {
+                xlog_error("instance_execute_func failed with %d", ret);
+        }
+}
+
+static void
+task_done(struct wsched_task *task, int ret)
+{
+        struct bench_instance *bi = task->user;
+        bi->ret = ret;
+}
+
+static int
+bench_sequential(struct bench_instance *bis, unsigned int n,
+                 const struct bench *b)
+{
+        unsigned int i;
+        int ret;
+
+        uint64_t start = now_ns();
+        for (i = 0; i < n; i++) {
+                struct bench_instance *bi = &bis[i];
+                exec_context_reset(&bi->ectx, bi->inst);
+                ret = push_arg(bi, b);
+                if (ret != 0) {
+                        return ret;
+                }
+                ret = instance_execute_func(&bi->ectx, b->funcidx, b->pt,
+                                            b->rt);
+                ret = instance_execute_handle_restart(&bi->ectx, ret);
+                if (ret != 0) {
+                        print_error(bi, ret);
+                        return ret;
+                }
+                pop_result(bi, b);
+        }
+        print_result("sequential", now_ns() - start, n);
+        return 0;
+}
+
+static int
+bench_wsched(struct mem_context *mctx, struct bench_instance *bis,
+             unsigned int n, unsigned int nworkers, const struct bench *b)
+{
+        struct wsched *s;
+        uint64_t expected = bis[0].result;
+        unsigned int i;
+        int ret;
+
+        ret = wsched_create(mctx, nworkers, &s);
+        if (ret != 0) {
+                xlog_error("wsched_create failed with %d", ret);
+                return ret;
+        }
+        uint64_t start = now_ns();
+        for (i = 0; i < n; i++) {
+                struct bench_instance *bi = &bis[i];
+                exec_context_reset(&bi->ectx, bi->inst);
+                ret = push_arg(bi, b);
+                if (ret != 0) {
+                        break;
+                }
+                bi->task.ctx = &bi->ectx;
+                bi->task.done = task_done;
+                bi->task.user = bi;
+                bi->ret = EINPROGRESS;
+                ret = wsched_submit(s, &bi->task, b->funcidx);
+                if (ret != 0) {
+                        xlog_error("wsched_submit failed with %d", ret);
+                        break;
+                }
+        }
+        wsched_wait(s);
+        uint64_t ns = now_ns() - start;
+        if (ret == 0) {
+                for (i = 0; i < n; i++) {
+                        struct bench_instance *bi = &bis[i];
+                        if (bi->ret != 0) {
+                                print_error(bi, bi->ret);
+                                ret = bi->ret;
+                                break;
+                        }
+                        pop_result(bi, b);
+                        if (bi->result != expected) {
+                                xlog_error("unexpected result %" PRIu64
+                                           " != %" PRIu64,
+                                           bi->result, expected);
+                                ret = EPROTO;
+                                break;
+                        }
+                }
+        }
+        if (ret == 0) {
+                char label[32];
+                snprintf(label, sizeof(label), "wsched/%u", nworkers);
+                print_result(label, ns, n);
+                fflush(stdout);
+                wsched_print_stats(s);
+        }
+        wsched_destroy(s);
+        return ret;
+}
+
+static int
+bench(struct mem_context *mctx, const struct module *m, struct bench *b,
+      unsigned int n, unsigned int nworkers)
+{
+        struct bench_instance *bis;
+        unsigned int ninstances = 0;
+        unsigned int i;
+        int ret;
+
+        bis = calloc(n, sizeof(*bis));
+        if (bis == NULL) {
+                return ENOMEM;
+        }
+        for (i = 0; i < n; i++) {
+                struct bench_instance *bi = &bis[i];
+                struct report report;
+                report_init(&report);
+                ret = instance_create(mctx, m, &bi->inst, NULL, &report);
+                if (ret != 0) {
+                        xlog_error("instance_create failed with %d: %s", ret,
+                                   report_getmessage(&report));
+                }
+                report_clear(&report);
+                if (ret != 0) {
+                        goto fail;
+                }
+                exec_context_init(&bi->ectx, bi->inst, mctx);
+                ninstances++;
+        }
+        ret = bench_sequential(bis, n, b);
+        if (ret != 0) {
+                goto fail;
+        }
+        printf("result %" PRIu64 "\n", bis[0].result);
+        ret = bench_wsched(mctx, bis, n, 1, b);
+        if (ret == 0 && nworkers != 1) {
+                ret = bench_wsched(mctx, bis, n, nworkers, b);
+        }
+fail:
+        for (i = 0; i < ninstances; i++) {
+                exec_context_clear(&bis[i].ectx);
+                instance_destroy(bis[i].inst);
+        }
+        free(bis);
+        return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc < 4 || argc > 6) {
+                xlog_error("unexpected number of args");
+                exit(2);
+        }
+        const char *filename = argv[1];
+        struct bench b;
+        memset(&b, 0, sizeof(b));
+        b.arg = strtoull(argv[3], NULL, 0);
+        unsigned int n = 1000;
+        if (argc >= 5) {
+                n = strtoul(argv[4], NULL, 0);
+                if (n == 0) {
+                        xlog_error("invalid number of instances");
+                        exit(2);
+                }
+        }
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned int nworkers = ncpus > 0 ? ncpus : 1;
+        if (argc >= 6) {
+                nworkers = strtoul(argv[5], NULL, 0);
+                if (nworkers == 0) {
+                        xlog_error("invalid number of workers");
+                        exit(2);
+                }
+        }
+        struct module *m;
+        int ret;
+        uint8_t *p;
+        size_t sz;
+        ret = map_file(filename, (void **)&p, &sz);
+        if (ret != 0) {
+                xlog_error("map_file failed with %d", ret);
+                exit(1);
+        }
+        struct mem_context mctx;
+        mem_context_init(&mctx);
+        struct load_context ctx;
+        load_context_init(&ctx, &mctx);
+        ret = module_create(&m, p, p + sz, &ctx);
+        if (ret != 0) {
+                xlog_error("module_load failed with %d: %s", ret,
+                           report_getmessage(&ctx.report));
+                exit(1);
+        }
+        load_context_clear(&ctx);
+        ret = find_func(m, argv[2], &b);
+        if (ret == 0) {
+                ret = bench(&mctx, m, &b, n, nworkers);
+        }
+        module_destroy(&mctx, m);
+        unmap_file(p, sz);
+        mem_context_clear(&mctx);
+        if (ret != 0) {
+                exit(1);
+        }
+        exit(0);
+}
@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "bitmap.h"
 #include "mem.h"
@@ -38,3 +39,11 @@ bitmap_test(const struct bitmap *b, uint32_t idx)
         uint32_t mask = 1U << (idx % 32);
         return (b->data[idx / 32] & mask) != 0;
 }
+
+void
+bitmap_copy(struct bitmap *dst, const struct bitmap *src, uint32_t n)
+{
+        if (n > 0) {
+                memcpy(dst->data, src->data, HOWMANY(n, 32) * sizeof(uint32_t));
+        }
+}
@@ -21,6 +21,7 @@ int bitmap_alloc(struct mem_context *mctx, struct bitmap *b, uint32_t n);
 void bitmap_free(struct mem_context *mctx, struct bitmap *b, uint32_t n);
 void bitmap_set(struct bitmap *b, uint32_t idx);
 bool bitmap_test(const struct bitmap *b, uint32_t idx);
+void bitmap_copy(struct bitmap *dst, const struct bitmap *src, uint32_t n);
 
 __END_EXTERN_C
 
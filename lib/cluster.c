@@ -15,11 +15,17 @@ cluster_init(struct cluster *c)
         c->suspend_state = SUSPEND_STATE_NONE;
         c->nparked = 0;
         toywasm_cv_init(&c->stop_cv);
+#if defined(TOYWASM_USE_FUTEX)
+        futex_waiters_init(&c->futex);
+#endif
 }
 
 void
 cluster_destroy(struct cluster *c)
 {
+#if defined(TOYWASM_USE_FUTEX)
+        futex_waiters_destroy(&c->futex);
+#endif
         toywasm_cv_destroy(&c->cv);
         toywasm_mutex_destroy(&c->lock);
 }
@@ -77,5 +83,9 @@ cluster_set_interrupt(struct cluster *c)
                 return false;
         }
         c->interrupt = 1;
+#if defined(TOYWASM_USE_FUTEX)
+        /* wake up the threads in memory.atomic.wait32 */
+        futex_waiters_kick(&c->futex);
+#endif
         return true;
 }
@@ -5,6 +5,9 @@
 #include <stdint.h>
 
 #include "lock.h"
+#if defined(TOYWASM_USE_FUTEX)
+#include "futex.h"
+#endif
 
 enum suspend_state {
         SUSPEND_STATE_NONE = 0,
@@ -26,6 +29,11 @@ struct cluster {
         _Atomic enum suspend_state suspend_state;
         uint32_t nparked;
         TOYWASM_CV_DEFINE(stop_cv);
+
+#if defined(TOYWASM_USE_FUTEX)
+        /* threads sleeping in memory.atomic.wait32 */
+        struct futex_waiters futex;
+#endif
 };
 
 void cluster_init(struct cluster *c);
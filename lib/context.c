@@ -131,6 +131,13 @@ resulttype_free(struct mem_context *mctx, struct resulttype *p)
 uint32_t
 ptr2pc(const struct module *m, const uint8_t *p)
 {
+#if defined(TOYWASM_USE_PREDECODE)
+        const uint8_t *pd = (const uint8_t *)m->predecoded;
+        if (pd != NULL && p >= pd &&
+            p <= (const uint8_t *)(m->predecoded + m->npredecoded)) {
+                return m->predecoded_pcbase + (p - pd);
+        }
+#endif
         assert(p >= m->bin);
         assert(p - m->bin <= UINT32_MAX);
         return p - m->bin;
@@ -139,5 +146,11 @@ ptr2pc(const struct module *m, const uint8_t *p)
 const uint8_t *
 pc2ptr(const struct module *m, uint32_t pc)
 {
+#if defined(TOYWASM_USE_PREDECODE)
+        if (m->predecoded != NULL && pc >= m->predecoded_pcbase) {
+                return (const uint8_t *)m->predecoded +
+                       (pc - m->predecoded_pcbase);
+        }
+#endif
         return m->bin + pc;
 }
@@ -83,6 +83,9 @@ create_satisfying_functions(struct mem_context *mctx, const struct module *m,
                 fi->u.host.func = dummy_func;
                 fi->u.host.type = ft;
                 fi->u.host.instance = (void *)im;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+                fi->canonid = ft->canonid;
+#endif
                 struct import_object_entry *e = &imo->entries[idx++];
                 e->module_name = &im->module_name;
                 e->name = &im->name;
@@ -0,0 +1,104 @@
+#if !defined(_TOYWASM_ENDIAN_ATOMIC_H)
+#define _TOYWASM_ENDIAN_ATOMIC_H
+
+/*
+ * atomic operations on little endian values in the linear memory.
+ *
+ * the values in the API are in the host byte order.
+ * every operation is sequentially consistent.
+ *
+ * on a little endian host, these are plain C11 atomic operations.
+ * the compiler emits single lock-free instructions (eg. x86 `lock xadd`)
+ * for the widths the host supports natively. (ATOMIC_xxx_LOCK_FREE == 2)
+ * for other widths (eg. 64-bit on some 32-bit hosts), the compiler
+ * runtime (eg. libatomic) implements them with a lock.
+ *
+ * on a big endian host, bitwise operations and exchanges are still
+ * native with byte-swapped operands because they don't carry between
+ * bytes. add and sub are compare-and-swap loops.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "endian.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LE_ATOMIC_HOST_IS_LE
+#define LE_ATOMIC_TO_HOST(N, v) (v)
+#define LE_ATOMIC_FROM_HOST(N, v) (v)
+#else
+#define LE_ATOMIC_TO_HOST(N, v) le##N##_to_host(v)
+#define LE_ATOMIC_FROM_HOST(N, v) host_to_le##N(v)
+#endif
+
+#define LE_ATOMIC_LOAD_STORE(N)                                               \
+        static inline uint##N##_t le##N##_atomic_load(                        \
+                const _Atomic uint##N##_t *p)                                 \
+        {                                                                     \
+                return LE_ATOMIC_TO_HOST(N, atomic_load(p));                  \
+        }                                                                     \
+        static inline void le##N##_atomic_store(_Atomic uint##N##_t *p,       \
+                                                uint##N##_t v)                \
+        {                                                                     \
+                atomic_store(p, LE_ATOMIC_FROM_HOST(N, v));                   \
+        }
+
+/* returns the old value */
+#define LE_ATOMIC_BITWISE(N, NAME)                                            \
+        static inline uint##N##_t le##N##_atomic_##NAME(                      \
+                _Atomic uint##N##_t *p, uint##N##_t v)                        \
+        {                                                                     \
+                return LE_ATOMIC_TO_HOST(                                     \
+                        N, atomic_##NAME(p, LE_ATOMIC_FROM_HOST(N, v)));      \
+        }
+
+#if defined(LE_ATOMIC_HOST_IS_LE)
+#define LE_ATOMIC_ARITH(N, NAME, OP) LE_ATOMIC_BITWISE(N, NAME)
+#else
+#define LE_ATOMIC_ARITH(N, NAME, OP)                                          \
+        static inline uint##N##_t le##N##_atomic_##NAME(                      \
+                _Atomic uint##N##_t *p, uint##N##_t v)                        \
+        {                                                                     \
+                uint##N##_t old_le = atomic_load(p);                          \
+                uint##N##_t old;                                              \
+                uint##N##_t new_le;                                           \
+                do {                                                          \
+                        old = le##N##_to_host(old_le);                        \
+                        new_le = host_to_le##N((uint##N##_t)(old OP v));      \
+                } while (!atomic_compare_exchange_weak(p, &old_le, new_le));  \
+                return old;                                                   \
+        }
+#endif
+
+/*
+ * store replacement if the value is expected.
+ * returns the old value either way.
+ */
+#define LE_ATOMIC_CMPXCHG(N)                                                  \
+        static inline uint##N##_t le##N##_atomic_cmpxchg(                     \
+                _Atomic uint##N##_t *p, uint##N##_t expected,                 \
+                uint##N##_t replacement)                                      \
+        {                                                                     \
+                uint##N##_t old_le = LE_ATOMIC_FROM_HOST(N, expected);        \
+                atomic_compare_exchange_strong(                               \
+                        p, &old_le, LE_ATOMIC_FROM_HOST(N, replacement));     \
+                return LE_ATOMIC_TO_HOST(N, old_le);                          \
+        }
+
+#define LE_ATOMIC_FUNCS(N)                                                    \
+        LE_ATOMIC_LOAD_STORE(N)                                               \
+        LE_ATOMIC_ARITH(N, fetch_add, +)                                      \
+        LE_ATOMIC_ARITH(N, fetch_sub, -)                                      \
+        LE_ATOMIC_BITWISE(N, fetch_and)                                       \
+        LE_ATOMIC_BITWISE(N, fetch_or)                                        \
+        LE_ATOMIC_BITWISE(N, fetch_xor)                                       \
+        LE_ATOMIC_BITWISE(N, exchange)                                        \
+        LE_ATOMIC_CMPXCHG(N)
+
+LE_ATOMIC_FUNCS(8)
+LE_ATOMIC_FUNCS(16)
+LE_ATOMIC_FUNCS(32)
+LE_ATOMIC_FUNCS(64)
+
+#endif /* !defined(_TOYWASM_ENDIAN_ATOMIC_H) */
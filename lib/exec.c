@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,15 +10,23 @@
 #include "context.h"
 #include "exec.h"
 #include "expr.h"
+#include "host_instance.h"
 #include "insn.h"
+#include "jit.h"
+#include "lazy_validation.h"
 #include "leb128.h"
+#include "memory_guard.h"
 #include "platform.h"
+#include "predecode.h"
+#include "profiler.h"
+#include "report.h"
 #include "restart.h"
 #include "suspend.h"
 #include "timeutil.h"
 #include "type.h"
 #include "usched.h"
 #include "util.h"
+#include "wsched.h"
 #include "xlog.h"
 
 /*
@@ -27,8 +36,8 @@
  * > The size, representation, and alignment of an atomic type need not be
  * > the same as those of the corresponding unqualified type.
  *
- * Our atomic opcode implementation in insn_impl_threads.h have stronger
- * assumptions. We try to assert them below.
+ * Our atomic opcode implementation in insn_impl_threads.h and
+ * endian_atomic.h have stronger assumptions. We try to assert them below.
  *
  * Note: on WASM, atomic opcodes trap when the address is not a multiple
  * of the size of value.
@@ -83,9 +92,6 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
                  * Note: because jump cache entires are currently
                  * keyed by PC, they are not safe to use among modules.
                  */
-#if defined(TOYWASM_USE_JUMP_CACHE)
-                ctx->jump_cache = NULL;
-#endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
                 memset(&ctx->cache, 0, sizeof(ctx->cache));
 #endif
@@ -103,6 +109,9 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
                  */
                 assert(ei != NULL);
                 ctx->ei = ei;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                ctx->current_ninsns = &ctx->stats.insn_no_func;
+#endif
         } else {
                 const struct module *m = inst->module;
                 const struct functype *ft = module_functype(m, funcidx);
@@ -135,6 +144,10 @@ set_current_frame(struct exec_context *ctx, const struct funcframe *frame,
                 }
 #endif
                 ctx->ei = &func->e.ei;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                struct funcinst *fi = VEC_ELEM(inst->funcs, funcidx);
+                ctx->current_ninsns = &fi->u.wasm.ninsns;
+#endif
         }
 #if defined(TOYWASM_USE_LOCALS_CACHE)
         ctx->current_locals = frame_locals(ctx, frame);
@@ -177,7 +190,20 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
                 return trap_with_id(ctx, TRAP_TOO_MANY_FRAMES,
                                     "too many frames");
         }
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /*
+         * the signal fences keep the compiler from moving the updates
+         * of ctx->frames out of the frames_busy window.
+         * (see profiler_handler)
+         */
+        ctx->frames_busy = true;
+        atomic_signal_fence(memory_order_seq_cst);
+#endif
         ret = VEC_PREALLOC(exec_mctx(ctx), ctx->frames, 1);
+#if defined(TOYWASM_ENABLE_PROFILER)
+        atomic_signal_fence(memory_order_release);
+        ctx->frames_busy = false;
+#endif
         if (ret != 0) {
                 return ret;
         }
@@ -211,6 +237,7 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
                  * frame->instance here.
                  */
                 frame->callerpc = ptr2pc(ctx->instance->module, ctx->p);
+                frame->callerjumpidx = ctx->jumpidx;
         } else {
                 /*
                  * Note: callerpc of the first frame is unused right now.
@@ -278,6 +305,10 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
         /*
          * commit changes.
          */
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /* publish the new frame to profiler_handler */
+        atomic_signal_fence(memory_order_release);
+#endif
         ctx->frames.lsize++;
 #if defined(TOYWASM_USE_SEPARATE_LOCALS)
         assert(ctx->locals.lsize + nlocals <= ctx->locals.psize);
@@ -288,6 +319,12 @@ frame_enter(struct exec_context *ctx, struct instance *inst, uint32_t funcidx,
 #endif
         set_current_frame(ctx, frame, ei);
         assert(ctx->ei == ei);
+        ctx->jumpidx = 0;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        if (funcidx != FUNCIDX_INVALID) {
+                VEC_ELEM(inst->funcs, funcidx)->u.wasm.ncalls++;
+        }
+#endif
         return 0;
 }
 
@@ -318,6 +355,7 @@ frame_exit(struct exec_context *ctx)
                  * which we have just restored by the set_current_frame above.
                  */
                 ctx->p = pc2ptr(ctx->instance->module, frame->callerpc);
+                ctx->jumpidx = frame->callerjumpidx;
         }
         assert(frame->labelidx <= ctx->labels.lsize);
         ctx->labels.lsize = frame->labelidx;
@@ -327,59 +365,18 @@ frame_exit(struct exec_context *ctx)
 #endif
 }
 
-static const struct jump *
-jump_table_lookup(const struct expr_exec_info *ei, uint32_t blockpc)
-{
-        uint32_t left = 0;
-        uint32_t right = ei->njumps;
-#if defined(TOYWASM_USE_JUMP_BINARY_SEARCH)
-        /*
-         * REVISIT: is it worth to switch to linear search for
-         * small tables/range?
-         */
-        while (true) {
-                assert(left < right);
-                uint32_t mid = (left + right) / 2;
-                const struct jump *jump = &ei->jumps[mid];
-                if (jump->pc == blockpc) {
-                        return jump;
-                }
-                if (jump->pc < blockpc) {
-                        left = mid + 1;
-                } else {
-                        right = mid;
-                }
-        }
-#else  /* defined(TOYWASM_USE_JUMP_BINARY_SEARCH) */
-        uint32_t i;
-        for (i = left; i < right; i++) {
-                const struct jump *jump = &ei->jumps[i];
-                if (jump->pc == blockpc) {
-                        return jump;
-                }
-        }
-#endif /* defined(TOYWASM_USE_JUMP_BINARY_SEARCH) */
-        assert(false);
-}
-
-static const struct jump *
-jump_lookup(struct exec_context *ctx, const struct expr_exec_info *ei,
-            uint32_t blockpc)
+/*
+ * returns the pointer to the first instruction to execute.
+ */
+static const uint8_t *
+expr_exec_start(const struct expr *expr)
 {
-        const struct jump *jump;
-#if defined(TOYWASM_USE_JUMP_CACHE)
-        jump = ctx->jump_cache;
-        if (jump != NULL && jump->pc == blockpc) {
-                STAT_INC(ctx, jump_cache_hit);
-                return jump;
+#if defined(TOYWASM_USE_PREDECODE)
+        if (expr->ei.predecoded != NULL) {
+                return (const uint8_t *)expr->ei.predecoded;
         }
 #endif
-        STAT_INC(ctx, jump_table_search);
-        jump = jump_table_lookup(ei, blockpc);
-#if defined(TOYWASM_USE_JUMP_CACHE)
-        ctx->jump_cache = jump;
-#endif
-        return jump;
+        return expr->start;
 }
 
 const struct func *
@@ -400,6 +397,25 @@ funcinst_func(const struct funcinst *fi)
         return &m->funcs[funcidx - m->nimportedfuncs];
 }
 
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+static int
+lazy_validate(struct exec_context *ctx, const struct module *m,
+              uint32_t funcidx)
+{
+        struct report report;
+        int ret;
+
+        report_init(&report);
+        ret = lazy_validate_func(m, funcidx - m->nimportedfuncs, &report);
+        if (ret == EINVAL) {
+                ret = trap_with_id(ctx, TRAP_INVALID_FUNCTION, "%s",
+                                   report_getmessage(&report));
+        }
+        report_clear(&report);
+        return ret;
+}
+#endif
+
 static int
 do_wasm_call(struct exec_context *ctx, const struct funcinst *finst)
 {
@@ -407,6 +423,17 @@ do_wasm_call(struct exec_context *ctx, const struct funcinst *finst)
         const struct functype *type = funcinst_functype(finst);
         struct instance *callee_inst = finst->u.wasm.instance;
         const struct func *func = funcinst_func(finst);
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        const struct module *m = callee_inst->module;
+        if (__predict_false(m->lazy != NULL) &&
+            !lazy_validation_done(m->lazy, finst->u.wasm.funcidx -
+                                                   m->nimportedfuncs)) {
+                ret = lazy_validate(ctx, m, finst->u.wasm.funcidx);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+#endif
         uint32_t nparams = resulttype_cellsize(&type->parameter);
         uint32_t nresults = resulttype_cellsize(&type->result);
         assert(ctx->stack.lsize >= nparams);
@@ -417,7 +444,7 @@ do_wasm_call(struct exec_context *ctx, const struct funcinst *finst)
         if (ret != 0) {
                 return ret;
         }
-        ctx->p = func->e.start;
+        ctx->p = expr_exec_start(&func->e);
         return 0;
 }
 
@@ -436,7 +463,14 @@ do_host_call(struct exec_context *ctx, const struct funcinst *finst)
                 }
         }
         struct cell *p = &VEC_ELEM(ctx->stack, ctx->stack.lsize - nparams);
-        ret = finst->u.host.func(ctx, finst->u.host.instance, ft, p, p);
+        if (finst->u.host.sig != HOST_FUNC_SIG_GENERIC) {
+                ret = host_func_call_typed(ctx, finst->u.host.instance, ft,
+                                           finst->u.host.sig,
+                                           finst->u.host.typed, p, p);
+        } else {
+                ret = finst->u.host.func(ctx, finst->u.host.instance, ft, p,
+                                         p);
+        }
         assert(IS_RESTARTABLE(ret) || restart_info_is_none(ctx));
         if (ret != 0) {
                 if (IS_RESTARTABLE(ret)) {
@@ -542,6 +576,13 @@ find_catch(const struct exec_context *ctx, const struct taginst *taginst,
                 xlog_trace_insn("%s: looking at frame %" PRIu32
                                 " label %" PRIu32 " pc %06" PRIx32,
                                 __func__, frameidx, labelidx, blockpc);
+#if defined(TOYWASM_USE_PREDECODE)
+                if (m->predecoded != NULL) {
+                        /* a pre-decoded module never has try_table */
+                        xlog_trace_insn("%s: pre-decoded", __func__);
+                        continue;
+                }
+#endif
                 const uint8_t *const blockp = pc2ptr(m, blockpc);
                 const uint8_t *p = blockp;
                 const uint8_t op = *p++;
@@ -732,7 +773,7 @@ do_exception(struct exec_context *ctx)
  * a bit shrinked version of get_functype_for_blocktype.
  * get the number of struct cell for parameters and results.
  */
-static void
+void
 get_arity_for_blocktype(const struct module *m, int64_t blocktype,
                         uint32_t *parameter, uint32_t *result)
 {
@@ -821,7 +862,7 @@ jump_cache2_store(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
  * otherwise always returns false.
  */
 static bool
-block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
+block_exit(struct exec_context *ctx, const struct label *l, bool goto_else,
            uint32_t *param_arityp, uint32_t *arityp)
 {
         /*
@@ -841,7 +882,12 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
          * it isn't for backward jump. (loop)
          * For a random wasm modules I happened to have, it seems
          * 5-10% of jump table entries are for "loop".
+         *
+         * Note: With the jump table, this is O(1). The label has
+         * the index of the jump table entry for the block.
+         * (see push_label)
          */
+        const uint32_t blockpc = l->pc;
 
         /*
          * parse the block op to check
@@ -863,9 +909,11 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                 const struct expr_exec_info *const ei = ctx->ei;
                 if (ei->jumps != NULL) {
                         xlog_trace_insn("jump w/ table");
+                        STAT_INC(ctx, jump_table);
                         bool stay_in_block = false;
-                        const struct jump *jump;
-                        jump = jump_lookup(ctx, ei, blockpc);
+                        assert(l->jumpidx < ei->njumps);
+                        const struct jump *jump = &ei->jumps[l->jumpidx];
+                        assert(jump->pc == blockpc);
                         if (goto_else) {
                                 const struct jump *jump_to_else = jump + 1;
                                 assert(jump_to_else->pc == blockpc + 1);
@@ -876,6 +924,7 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                         }
                         assert(jump->targetpc != 0);
                         ctx->p = pc2ptr(ctx->instance->module, jump->targetpc);
+                        ctx->jumpidx = jump->nextidx;
                         if (stay_in_block) {
                                 xlog_trace_insn("jump inside a block");
                                 return true;
@@ -889,6 +938,7 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                  */
                 if (ei->jumps == NULL) {
                         xlog_trace_insn("jump w/o table");
+                        STAT_INC(ctx, jump_skip_expr);
                         /*
                          * The only way to find out the jump target is
                          * to parse every instructions. This is expensive.
@@ -912,6 +962,7 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
                 const int64_t blocktype = read_leb_s33_nocheck(&p);
                 get_arity_for_blocktype(m, blocktype, &param_arity, &arity);
                 ctx->p = blockp;
+                ctx->jumpidx = l->jumpidx;
                 arity = param_arity;
         }
         *param_arityp = param_arity;
@@ -922,14 +973,22 @@ block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
 /*
  * a cached version of block_exit.
  * the parameters and return values are same as block_exit.
+ *
+ * the cache is only used for the code without the jump table,
+ * for which block_exit is expensive. (skip_expr)
+ * with the jump table, block_exit is cheap enough.
  */
 static bool
-cached_block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
-                  uint32_t *param_arityp, uint32_t *arityp)
+cached_block_exit(struct exec_context *ctx, const struct label *l,
+                  bool goto_else, uint32_t *param_arityp, uint32_t *arityp)
 {
+        if (ctx->ei->jumps != NULL) {
+                return block_exit(ctx, l, goto_else, param_arityp, arityp);
+        }
         uint32_t param_arity;
         uint32_t arity;
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
+        uint32_t blockpc = l->pc;
         const struct jump_cache *cache;
         if ((cache = jump_cache2_lookup(ctx, blockpc, goto_else)) != NULL) {
                 STAT_INC(ctx, jump_cache2_hit);
@@ -944,8 +1003,7 @@ cached_block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
         } else
 #endif
         {
-                if (block_exit(ctx, blockpc, goto_else, &param_arity,
-                               &arity)) {
+                if (block_exit(ctx, l, goto_else, &param_arity, &arity)) {
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
                         jump_cache2_store(ctx, blockpc, goto_else, true, 0, 0,
                                           ctx->p);
@@ -962,6 +1020,45 @@ cached_block_exit(struct exec_context *ctx, uint32_t blockpc, bool goto_else,
         return false;
 }
 
+#if defined(TOYWASM_USE_PREDECODE)
+/*
+ * a version of block_exit for the pre-decoded code.
+ * the parameters and return values are same as block_exit.
+ *
+ * in the pre-decoded code, block-starting instructions are followed by
+ * struct predecoded_block, which has everything we need here.
+ * thus we don't need the jump table or the caches.
+ */
+static bool
+predecoded_block_exit(struct exec_context *ctx, uint32_t blockpc,
+                      bool goto_else, uint32_t *param_arityp,
+                      uint32_t *arityp)
+{
+        const struct module *const m = ctx->instance->module;
+        const uint32_t *const blockp = (const void *)pc2ptr(m, blockpc);
+        const uint32_t op = blockp[0];
+        const struct predecoded_block *b = (const void *)&blockp[1];
+        assert(op == FRAME_OP_LOOP || op == FRAME_OP_IF ||
+               op == FRAME_OP_BLOCK);
+        if (op == FRAME_OP_LOOP) {
+                STAT_INC(ctx, jump_loop);
+                ctx->p = (const void *)blockp;
+                *param_arityp = b->param_arity;
+                *arityp = b->param_arity;
+                return false;
+        }
+        if (goto_else && b->elsepc != 0) {
+                xlog_trace_insn("jump inside a block");
+                ctx->p = pc2ptr(m, b->elsepc);
+                return true;
+        }
+        ctx->p = pc2ptr(m, b->targetpc);
+        *param_arityp = b->param_arity;
+        *arityp = b->arity;
+        return false;
+}
+#endif
+
 static bool
 branch_to_label(struct exec_context *ctx, uint32_t labelidx, bool goto_else,
                 uint32_t *heightp, uint32_t *arityp)
@@ -978,7 +1075,16 @@ branch_to_label(struct exec_context *ctx, uint32_t labelidx, bool goto_else,
         uint32_t arity;
         uint32_t param_arity;
         xlog_trace_insn("branching to the block at %06" PRIx32, blockpc);
-        if (cached_block_exit(ctx, blockpc, goto_else, &param_arity, &arity)) {
+        bool stay_in_block;
+#if defined(TOYWASM_USE_PREDECODE)
+        if (ctx->ei->predecoded != NULL) {
+                stay_in_block = predecoded_block_exit(ctx, blockpc, goto_else,
+                                                      &param_arity, &arity);
+        } else
+#endif
+                stay_in_block = cached_block_exit(ctx, l, goto_else,
+                                                  &param_arity, &arity);
+        if (stay_in_block) {
                 return true;
         }
         xlog_trace_insn("branched to %06" PRIx32,
@@ -1043,6 +1149,7 @@ fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
         uint32_t pc = ptr2pc(ctx->instance->module, p);
 #endif
         uint32_t op = *p++;
+        STAT_INSN(ctx, op);
 #if defined(TOYWASM_USE_SEPARATE_EXECUTE)
         xlog_trace_insn("exec %06" PRIx32 ": %s (%02" PRIx32 ")", pc,
                         instructions[op].name, op);
@@ -1054,8 +1161,24 @@ fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
 #else
         const struct instruction_desc *desc = &instructions[op];
         if (__predict_false(desc->next_table != NULL)) {
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                const uint32_t prefix = op;
+#endif
                 op = read_leb_u32_nocheck(&p);
                 desc = &desc->next_table[op];
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                switch (prefix) {
+                case 0xfc:
+                        STAT_INSN_OPCODE(ctx, PREDECODED_OP_FC + op);
+                        break;
+                case 0xfd:
+                        STAT_INSN_OPCODE(ctx, PREDECODED_OP_FD + op);
+                        break;
+                case 0xfe:
+                        STAT_INSN_OPCODE(ctx, PREDECODED_OP_FE + op);
+                        break;
+                }
+#endif
         }
         xlog_trace_insn("exec %06" PRIx32 ": %s", pc, desc->name);
         assert(desc->process != NULL);
@@ -1102,6 +1225,14 @@ check_interrupt(struct exec_context *ctx)
                         return ETOYWASMUSERINTERRUPT;
                 }
         }
+#if defined(TOYWASM_ENABLE_WSCHED)
+        if (ctx->preempt != NULL && *ctx->preempt != 0) {
+                xlog_trace("%s: wsched preemption ctx %p", __func__,
+                           (void *)ctx);
+                STAT_INC(ctx, interrupt_wsched);
+                return ETOYWASMRESTART;
+        }
+#endif
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
         if (ctx->cluster != NULL) {
                 int ret = cluster_check_interrupt(ctx, ctx->cluster);
@@ -1152,6 +1283,12 @@ check_interrupt_interval_ms(struct exec_context *ctx)
 #else
         int interval_ms = 300;
 #endif
+#if defined(TOYWASM_ENABLE_WSCHED)
+        if (ctx->preempt != NULL) {
+                /* check often enough to honor the time slice */
+                return WSCHED_SLICE_MS / 2;
+        }
+#endif
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
         struct cluster *c = ctx->cluster;
         if (c != NULL) {
@@ -1256,17 +1393,29 @@ exec_expr(uint32_t funcidx, const struct expr *expr,
 
         assert(ctx->instance != NULL);
         assert(ctx->instance->module != NULL);
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        if (ctx->frames.lsize == 0) {
+                /*
+                 * the cache entries are keyed by addresses. forget
+                 * them in case modules and tables have been destroyed
+                 * and their addresses are reused since the last
+                 * execution.
+                 */
+                memset(&ctx->call_indirect_cache, 0,
+                       sizeof(ctx->call_indirect_cache));
+        }
+#endif
         ret = frame_enter(ctx, ctx->instance, funcidx, &expr->ei, localtype,
                           parametertype, nresults, params);
         if (ret != 0) {
                 return ret;
         }
-        ctx->p = expr->start;
+        ctx->p = expr_exec_start(expr);
         return exec_expr_continue(ctx);
 }
 
-int
-exec_expr_continue(struct exec_context *ctx)
+static int
+exec_loop(struct exec_context *ctx)
 {
 #if defined(ADJUST_CHECK_INTERVAL)
         struct timespec last;
@@ -1373,8 +1522,41 @@ exec_expr_continue(struct exec_context *ctx)
                         n = ctx->check_interval;
                         assert(n > 0);
                 }
+#if defined(TOYWASM_ENABLE_JIT)
+                if (ctx->ei->jit != NULL) {
+                        const struct jit_entry *e = jit_lookup(
+                                ctx->ei->jit, ctx->p, ctx->instance->module);
+                        if (e != NULL) {
+                                bool exhausted;
+                                ret = jit_exec(ctx, e, &exhausted);
+                                if (ret != 0) {
+                                        goto after_insn;
+                                }
+                                if (exhausted) {
+                                        /* check_interrupt on the next turn */
+                                        n = 1;
+                                        goto after_insn;
+                                }
+                                /*
+                                 * the generated code exited for us to
+                                 * execute the instruction at ctx->p.
+                                 * (eg. call, or the end of the function)
+                                 * the pc can be an entry as well.
+                                 * interpret the instruction here instead
+                                 * of looking it up again, which would
+                                 * re-enter the generated code forever.
+                                 */
+                        }
+                }
+#endif
                 struct cell *stack = &VEC_NEXTELEM(ctx->stack);
-                ret = fetch_exec_next_insn(ctx->p, stack, ctx);
+#if defined(TOYWASM_USE_PREDECODE)
+                if (ctx->ei->predecoded != NULL) {
+                        ret = fetch_exec_next_insn_predecoded(ctx->p, stack,
+                                                              ctx);
+                } else
+#endif
+                        ret = fetch_exec_next_insn(ctx->p, stack, ctx);
 after_insn:
                 assert(IS_RESTARTABLE(ret) ==
                        (ctx->event == EXEC_EVENT_RESTART_INSN));
@@ -1388,6 +1570,26 @@ after_insn:
         return 0;
 }
 
+int
+exec_expr_continue(struct exec_context *ctx)
+{
+        int ret;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /* tell the profiler which exec_context this thread is running */
+        struct exec_context *saved_profiler_ctx = profiler_set_current(ctx);
+#endif
+#if defined(TOYWASM_USE_GUARD_PAGES)
+        /* convert faults on guard pages to traps */
+        ret = memory_guard_exec(ctx, exec_loop);
+#else
+        ret = exec_loop(ctx);
+#endif
+#if defined(TOYWASM_ENABLE_PROFILER)
+        profiler_set_current(saved_profiler_ctx);
+#endif
+        return ret;
+}
+
 int
 exec_push_vals(struct exec_context *ctx, const struct resulttype *rt,
                const struct val *vals)
@@ -1530,6 +1732,9 @@ exec_context_init(struct exec_context *ctx, struct instance *inst,
         ctx->report = &ctx->report0;
         ctx->check_interval = CHECK_INTERVAL_DEFAULT;
         exec_options_set_defaults(&ctx->options);
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        ctx->current_ninsns = &ctx->stats.insn_no_func;
+#endif
 }
 
 void
@@ -1547,16 +1752,59 @@ exec_context_clear(struct exec_context *ctx)
         VEC_FREE(mctx, ctx->locals);
 #endif
         VEC_FREE(mctx, ctx->restarts);
+#if defined(TOYWASM_USE_USER_SCHED)
+        assert(!ctx->sched_wait.blocked);
+        VEC_FREE(mctx, ctx->sched_wait.fds);
+#endif
         report_clear(&ctx->report0);
         ctx->report = NULL;
 }
 
+/*
+ * re-initialize the context for another execution, possibly for another
+ * instance, keeping the memory allocated for the stacks.
+ * the options and the statistics are reset as well.
+ */
+void
+exec_context_reset(struct exec_context *ctx, struct instance *inst)
+{
+        struct exec_context saved = *ctx;
+        struct funcframe *frame;
+        VEC_FOREACH(frame, saved.frames) {
+                frame_clear(frame);
+        }
+        report_clear(&saved.report0);
+        exec_context_init(ctx, inst, saved.mctx);
+        ctx->frames = saved.frames;
+        ctx->stack = saved.stack;
+        ctx->labels = saved.labels;
+#if defined(TOYWASM_USE_SEPARATE_LOCALS)
+        ctx->locals = saved.locals;
+        ctx->locals.lsize = 0;
+#endif
+        ctx->restarts = saved.restarts;
+#if defined(TOYWASM_USE_USER_SCHED)
+        assert(!saved.sched_wait.blocked);
+        ctx->sched_wait.fds = saved.sched_wait.fds;
+        ctx->sched_wait.fds.lsize = 0;
+#endif
+        ctx->frames.lsize = 0;
+        ctx->stack.lsize = 0;
+        ctx->labels.lsize = 0;
+        ctx->restarts.lsize = 0;
+}
+
 uint32_t
 find_type_annotation(struct exec_context *ctx, const uint8_t *p)
 {
 #if defined(TOYWASM_USE_SMALL_CELLS)
         const struct expr_exec_info *ei = ctx->ei;
         const struct type_annotations *an = &ei->type_annotations;
+        /*
+         * we are executing a drop or select. it's reachable and thus
+         * record_type_annotation has recorded its type.
+         * (unlike the pre-decoder, which visits unreachable code too.)
+         */
         assert(an->default_size > 0);
         if (an->ntypes == 0) {
                 STAT_INC(ctx, type_annotation_lookup1);
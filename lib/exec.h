@@ -12,6 +12,7 @@ struct instance;
 struct funcinst;
 struct tableinst;
 struct meminst;
+struct module;
 struct globalinst;
 struct functype;
 struct localtype;
@@ -47,6 +48,10 @@ void elem_drop(struct exec_context *ectx, uint32_t elemidx);
 bool skip_expr(const uint8_t **p, bool goto_else);
 int fetch_exec_next_insn(const uint8_t *p, struct cell *stack,
                          struct exec_context *ctx);
+#if defined(TOYWASM_USE_PREDECODE)
+int fetch_exec_next_insn_predecoded(const uint8_t *p, struct cell *stack,
+                                    struct exec_context *ctx);
+#endif
 void rewind_stack(struct exec_context *ctx, uint32_t height, uint32_t arity);
 
 int invoke(struct funcinst *finst, const struct resulttype *paramtype,
@@ -72,3 +77,5 @@ struct cell *frame_locals(const struct exec_context *ctx,
                           const struct funcframe *frame) __purefunc;
 
 uint32_t find_type_annotation(struct exec_context *ectx, const uint8_t *p);
+void get_arity_for_blocktype(const struct module *m, int64_t blocktype,
+                             uint32_t *parameter, uint32_t *result);
@@ -1,3 +1,6 @@
+#if !defined(_TOYWASM_EXEC_CONTEXT_H)
+#define _TOYWASM_EXEC_CONTEXT_H
+
 #if __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
 #include <stdatomic.h>
 #endif
@@ -7,10 +10,16 @@
 
 #include "toywasm_config.h"
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+#include "insn.h"
+#endif
 #include "list.h"
 #include "options.h"
 #include "platform.h"
 #include "report.h"
+#if defined(TOYWASM_USE_USER_SCHED)
+#include "usched.h"
+#endif
 #include "vec.h"
 
 struct val;
@@ -18,7 +27,8 @@ struct mem_context;
 
 struct label {
         uint32_t pc;
-        uint32_t height; /* saved height of operand stack */
+        uint32_t height;  /* saved height of operand stack */
+        uint32_t jumpidx; /* exec_context::jumpidx on the block entry */
 };
 
 struct funcframe {
@@ -33,6 +43,7 @@ struct funcframe {
 #endif
 
         uint32_t callerpc;
+        uint32_t callerjumpidx;
         uint32_t height;   /* saved height of operand stack */
         uint32_t nresults; /* number of cells for the result */
 };
@@ -95,6 +106,7 @@ enum trapid {
         TRAP_THROW_REF_NULL,
         TRAP_UNRESOLVED_IMPORTED_FUNC,
         TRAP_MEMORY_NOT_FOUND,
+        TRAP_INVALID_FUNCTION,
 };
 
 enum exec_event {
@@ -125,14 +137,19 @@ struct exec_stat {
 #endif
         uint64_t branch;
         uint64_t branch_goto_else;
-#if defined(TOYWASM_USE_JUMP_CACHE)
-        uint64_t jump_cache_hit;
-#endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
         uint64_t jump_cache2_hit;
 #endif
-        uint64_t jump_table_search;
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        uint64_t call_indirect_cache_hit;
+        uint64_t call_indirect_cache_miss;
+#endif
+        uint64_t jump_table;
+        uint64_t jump_skip_expr;
         uint64_t jump_loop;
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+        uint64_t fused_insn;
+#endif
 #if defined(TOYWASM_USE_SMALL_CELLS)
         uint64_t type_annotation_lookup1;
         uint64_t type_annotation_lookup2;
@@ -142,6 +159,9 @@ struct exec_stat {
         uint64_t interrupt_suspend;
 #if defined(TOYWASM_USE_USER_SCHED)
         uint64_t interrupt_usched;
+#endif
+#if defined(TOYWASM_ENABLE_WSCHED)
+        uint64_t interrupt_wsched;
 #endif
         uint64_t interrupt_user;
         uint64_t interrupt_debug;
@@ -156,6 +176,15 @@ struct exec_stat {
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
         uint64_t exception;
 #endif
+#if defined(TOYWASM_ENABLE_JIT)
+        uint64_t jit_enter;
+#endif
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        /* indexed by the flat opcode space. (PREDECODED_OP_xxx) */
+        uint64_t insn[PREDECODED_NOPS];
+        /* instructions executed outside of functions. eg. const exprs */
+        uint64_t insn_no_func;
+#endif
 };
 
 struct jump_cache {
@@ -166,6 +195,21 @@ struct jump_cache {
         const uint8_t *target;
 };
 
+/*
+ * a monomorphic inline cache for a call_indirect site.
+ *
+ * valid as far as the table is not modified. (tableinst::gen)
+ * the functype check is not repeated on a hit because the type
+ * of the call site and the type of a funcinst never change.
+ */
+struct call_indirect_cache {
+        const uint8_t *site;
+        const struct tableinst *table;
+        uint32_t idx;
+        uint32_t gen;
+        const struct funcinst *func;
+};
+
 struct trap_info {
         enum trapid trapid;
 };
@@ -226,19 +270,31 @@ struct exec_context {
         /* The instruction pointer */
         const uint8_t *p;
 
+        /*
+         * The index of the first entry in ei->jumps for the pc at or
+         * after p. Only maintained for the in-place execution with
+         * a jump table. See push_label.
+         */
+        uint32_t jumpidx;
+
         /* Some cache stuff */
 #if defined(TOYWASM_USE_LOCALS_CACHE)
         struct cell *current_locals;
 #endif
-#if defined(TOYWASM_USE_JUMP_CACHE)
-        const struct jump *jump_cache;
-#endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
         struct jump_cache cache[TOYWASM_JUMP_CACHE2_SIZE];
 #endif
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        struct call_indirect_cache
+                call_indirect_cache[TOYWASM_CALL_INDIRECT_CACHE_SIZE];
+#endif
 
         /* Execution stacks */
         VEC(, struct funcframe) frames;
+#if defined(TOYWASM_ENABLE_PROFILER)
+        /* set while frames might be reallocated. see lib/profiler.c */
+        volatile bool frames_busy;
+#endif
         VEC(, struct cell) stack; /* operand stack */
         VEC(, struct label) labels;
 #if defined(TOYWASM_USE_SEPARATE_LOCALS)
@@ -280,6 +336,14 @@ struct exec_context {
         /* scheduler */
         struct sched *sched;
         LIST_ENTRY(struct exec_context) rq;
+        struct sched_wait sched_wait;
+#endif
+#if defined(TOYWASM_ENABLE_WSCHED)
+        /*
+         * set by wsched while running the context.
+         * a non-zero value requests a yield. (see lib/wsched.c)
+         */
+        const atomic_uint *preempt;
 #endif
 
         /* Trap */
@@ -326,6 +390,10 @@ struct exec_context {
 
         /* Statistics */
         struct exec_stat stats;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        /* funcinst::u.wasm.ninsns of the current function */
+        uint64_t *current_ninsns;
+#endif
 };
 
 #define exec_mctx(ectx) (ectx)->mctx
@@ -336,11 +404,34 @@ struct exec_context {
 /* for exec_stats */
 #define STAT_INC(CTX, NAME) (CTX)->stats.NAME++
 
+/*
+ * for TOYWASM_ENABLE_INSN_STATS.
+ * STAT_INSN counts an instruction for both of the opcode and the current
+ * function. STAT_INSN_OPCODE only counts the opcode. it's used for the
+ * second part of multibyte opcodes.
+ */
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+#define STAT_INSN(CTX, OP)                                                    \
+        do {                                                                  \
+                (CTX)->stats.insn[OP]++;                                      \
+                (*(CTX)->current_ninsns)++;                                   \
+        } while (0)
+#define STAT_INSN_OPCODE(CTX, OP) (CTX)->stats.insn[OP]++
+#else
+#define STAT_INSN(CTX, OP)                                                    \
+        do {                                                                  \
+        } while (0)
+#define STAT_INSN_OPCODE(CTX, OP)                                             \
+        do {                                                                  \
+        } while (0)
+#endif
+
 __BEGIN_EXTERN_C
 
 void exec_context_init(struct exec_context *ctx, struct instance *inst,
                        struct mem_context *mctx);
 void exec_context_clear(struct exec_context *ctx);
+void exec_context_reset(struct exec_context *ctx, struct instance *inst);
 void exec_context_print_stats(struct exec_context *ctx);
 
 int exec_push_vals(struct exec_context *ctx, const struct resulttype *rt,
@@ -357,3 +448,5 @@ int trap_with_id(struct exec_context *ctx, enum trapid id, const char *fmt,
                  ...) __printflike(3, 4);
 
 __END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_EXEC_CONTEXT_H) */
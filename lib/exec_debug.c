@@ -1,9 +1,11 @@
 #include <assert.h>
 #include <inttypes.h>
+#include <stdlib.h>
 
 #include "context.h"
 #include "exec.h"
 #include "exec_debug.h"
+#include "insn.h"
 #include "name.h"
 #include "nbio.h"
 #include "type.h"
@@ -16,6 +18,62 @@
 #define STAT_PRINT(name)                                                      \
         nbio_printf("%23s %12" PRIu64 "\n", #name, ctx->stats.name);
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+struct insn_count {
+        uint32_t op;
+        uint64_t count;
+};
+
+static int
+cmp_insn_count(const void *a, const void *b)
+{
+        const struct insn_count *ca = a;
+        const struct insn_count *cb = b;
+        if (ca->count != cb->count) {
+                return (ca->count > cb->count) ? -1 : 1;
+        }
+        return (ca->op < cb->op) ? -1 : (ca->op > cb->op);
+}
+
+static void
+print_insn_stats(const struct exec_context *ctx)
+{
+        struct insn_count *counts;
+        uint64_t total = 0;
+        uint32_t n = 0;
+        uint32_t op;
+
+        counts = malloc(PREDECODED_NOPS * sizeof(*counts));
+        if (counts == NULL) {
+                return;
+        }
+        for (op = 0; op < PREDECODED_NOPS; op++) {
+                uint64_t count = ctx->stats.insn[op];
+                /*
+                 * skip the prefixes of multibyte opcodes.
+                 * their second parts are counted separately.
+                 */
+                if (count == 0 || (op >= 0xfc && op <= 0xfe)) {
+                        continue;
+                }
+                counts[n].op = op;
+                counts[n].count = count;
+                n++;
+                total += count;
+        }
+        qsort(counts, n, sizeof(*counts), cmp_insn_count);
+        nbio_printf("=== instruction statistics ===\n");
+        uint32_t i;
+        for (i = 0; i < n; i++) {
+                nbio_printf("%12" PRIu64 " %5.1f%% %s\n", counts[i].count,
+                            (double)counts[i].count * 100 / total,
+                            predecoded_instruction_name(counts[i].op));
+        }
+        nbio_printf("%12" PRIu64 " total\n", total);
+        free(counts);
+}
+#endif
+
 void
 exec_context_print_stats(struct exec_context *ctx)
 {
@@ -36,14 +94,19 @@ exec_context_print_stats(struct exec_context *ctx)
 #endif
         STAT_PRINT(branch);
         STAT_PRINT(branch_goto_else);
-#if defined(TOYWASM_USE_JUMP_CACHE)
-        STAT_PRINT(jump_cache_hit);
-#endif
 #if TOYWASM_JUMP_CACHE2_SIZE > 0
         STAT_PRINT(jump_cache2_hit);
 #endif
-        STAT_PRINT(jump_table_search);
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        STAT_PRINT(call_indirect_cache_hit);
+        STAT_PRINT(call_indirect_cache_miss);
+#endif
+        STAT_PRINT(jump_table);
+        STAT_PRINT(jump_skip_expr);
         STAT_PRINT(jump_loop);
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+        STAT_PRINT(fused_insn);
+#endif
 #if defined(TOYWASM_USE_SMALL_CELLS)
         STAT_PRINT(type_annotation_lookup1);
         STAT_PRINT(type_annotation_lookup2);
@@ -53,6 +116,9 @@ exec_context_print_stats(struct exec_context *ctx)
         STAT_PRINT(interrupt_suspend);
 #if defined(TOYWASM_USE_USER_SCHED)
         STAT_PRINT(interrupt_usched);
+#endif
+#if defined(TOYWASM_ENABLE_WSCHED)
+        STAT_PRINT(interrupt_wsched);
 #endif
         STAT_PRINT(interrupt_user);
         STAT_PRINT(interrupt_debug);
@@ -67,6 +133,13 @@ exec_context_print_stats(struct exec_context *ctx)
 #if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
         STAT_PRINT(exception);
 #endif
+#if defined(TOYWASM_ENABLE_JIT)
+        STAT_PRINT(jit_enter);
+#endif
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        STAT_PRINT(insn_no_func);
+        print_insn_stats(ctx);
+#endif
 }
 
 static void
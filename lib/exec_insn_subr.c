@@ -6,9 +6,12 @@
 #include <string.h>
 
 #include "bitmap.h"
+#include "endian.h"
 #include "exec.h"
+#include "instance.h"
 #include "leb128.h"
 #include "mem.h"
+#include "memory_reserve.h"
 #include "platform.h"
 #include "restart.h"
 #include "shared_memory_impl.h"
@@ -18,6 +21,14 @@
 #include "util.h"
 #include "xlog.h"
 
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#include "endian_atomic.h"
+#endif
+#if defined(TOYWASM_USE_FUTEX)
+#include "cluster.h"
+#include "futex.h"
+#endif
+
 int
 vtrap(struct exec_context *ctx, enum trapid id, const char *fmt, va_list ap)
 {
@@ -44,6 +55,24 @@ int
 memory_instance_getptr2(struct meminst *meminst, uint32_t ptr, uint32_t offset,
                         uint32_t size, void **pp, bool *movedp)
 {
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        if (meminst->reserved != 0) {
+                /*
+                 * a memory in a reserved address space is always
+                 * fully allocated.
+                 * check against size_in_pages, which is updated after
+                 * the protection change. (see memory_grow_impl)
+                 */
+                uint64_t ea = (uint64_t)ptr + offset;
+                uint64_t sz = (uint64_t)meminst->size_in_pages
+                              << memtype_page_shift(meminst->type);
+                if (ea + size > sz) {
+                        return ETOYWASMTRAP;
+                }
+                *pp = meminst->data + ea;
+                return 0;
+        }
+#endif
         assert(meminst->allocated <=
                (uint64_t)meminst->size_in_pages
                        << memtype_page_shift(meminst->type));
@@ -266,6 +295,7 @@ table_init(struct exec_context *ectx, uint32_t tableidx, uint32_t elemidx,
         }
         struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
         assert(t->type->et == elem->type);
+        table_modified(t);
         uint32_t csz = valtype_cellsize(t->type->et);
         uint32_t i;
         for (i = 0; i < n; i++) {
@@ -295,6 +325,23 @@ table_set(struct tableinst *tinst, uint32_t elemidx, const struct val *val)
 {
         uint32_t csz = valtype_cellsize(tinst->type->et);
         val_to_cells(val, &tinst->cells[elemidx * csz], csz);
+        table_modified(tinst);
+}
+
+/*
+ * invalidate the call_indirect caches for the table.
+ * it should be called after modifying tableinst::cells.
+ *
+ * Note: a wrap around of the counter can make a stale cache entry
+ * look valid. we ignore it as it needs 2^32 modifications between
+ * two calls from a call site.
+ */
+void
+table_modified(struct tableinst *tinst)
+{
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        tinst->gen++;
+#endif
 }
 
 void
@@ -304,6 +351,17 @@ table_get(struct tableinst *tinst, uint32_t elemidx, struct val *val)
         val_from_cells(val, &tinst->cells[elemidx * csz], csz);
 }
 
+static bool
+funcinst_has_functype(const struct funcinst *fi, const struct functype *ft)
+{
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        if (__predict_true(ft->canonid != 0 && fi->canonid != 0)) {
+                return ft->canonid == fi->canonid;
+        }
+#endif
+        return !compare_functype(ft, funcinst_functype(fi));
+}
+
 int
 table_get_func(struct exec_context *ectx, const struct tableinst *t,
                uint32_t i, const struct functype *ft,
@@ -328,8 +386,7 @@ table_get_func(struct exec_context *ectx, const struct tableinst *t,
                                    "call_indirect (null funcref) %" PRIu32, i);
                 goto fail;
         }
-        const struct functype *actual_ft = funcinst_functype(func);
-        if (__predict_false(compare_functype(ft, actual_ft))) {
+        if (__predict_false(!funcinst_has_functype(func, ft))) {
                 ret = trap_with_id(
                         ectx, TRAP_CALL_INDIRECT_FUNCTYPE_MISMATCH,
                         "call_indirect (functype mismatch) %" PRIu32, i);
@@ -382,6 +439,7 @@ table_grow(struct tableinst *t, const struct val *val, uint32_t n)
         }
         uint32_t oldsize = t->size;
         t->size = newsize;
+        table_modified(t);
         return oldsize;
 }
 
@@ -454,6 +512,26 @@ retry:
         }
         xlog_trace("memory grow %" PRIu32 " -> %" PRIu32, mi->size_in_pages,
                    new_size);
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        if (mi->reserved != 0) {
+                /*
+                 * a memory in a reserved address space never moves.
+                 * we don't need to suspend other threads even for
+                 * a shared memory.
+                 */
+                int ret = memory_reserve_grow(mi, (size_t)new_size
+                                                          << page_shift);
+                if (ret != 0) {
+                        memory_unlock(mi);
+                        xlog_trace("%s: memory_reserve_grow failed with %d",
+                                   __func__, ret);
+                        return (uint32_t)-1; /* fail */
+                }
+                mi->size_in_pages = new_size;
+                memory_unlock(mi);
+                return orig_size; /* success */
+        }
+#endif
         bool do_realloc = new_size != orig_size;
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
         const bool shared = mi->shared != NULL;
@@ -510,6 +588,12 @@ retry:
                                 mi->data = np;
                                 assert(new_size_in_bytes > mi->allocated);
                                 mi->allocated = new_size_in_bytes;
+                                /*
+                                 * update it before resume_threads.
+                                 * memory_getptr2 assumes
+                                 * allocated <= size_in_pages.
+                                 */
+                                mi->size_in_pages = new_size;
                         }
                 }
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
@@ -545,6 +629,39 @@ memory_grow(struct meminst *mi, uint32_t sz)
 }
 
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
+#if defined(TOYWASM_USE_FUTEX)
+/*
+ * memory.atomic.notify on a shared memory with futex.c.
+ *
+ * wake up the memory.atomic.wait32 waiters with FUTEX_WAKE.
+ * then, the memory.atomic.wait64 waiters on the waiter lists, if any.
+ */
+static int
+memory_notify_futex(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
+                    uint32_t offset, uint32_t count, uint32_t *nwokenp)
+{
+        struct meminst *mi = VEC_ELEM(ctx->instance->mems, memidx);
+        struct shared_meminst *shared = mi->shared;
+        void *p;
+        int ret;
+        ret = memory_atomic_getptr(ctx, memidx, addr, offset, 4, &p, NULL);
+        if (ret != 0) {
+                return ret;
+        }
+        uint32_t nwoken = futex_wake(p, count);
+        if (nwoken < count && shared->nwaiters64 > 0) {
+                struct toywasm_mutex *lock =
+                        atomics_mutex_getptr(&shared->tab, addr + offset);
+                toywasm_mutex_lock(lock);
+                nwoken += atomics_notify(&shared->tab, addr + offset,
+                                         count - nwoken);
+                toywasm_mutex_unlock(lock);
+        }
+        *nwokenp = nwoken;
+        return 0;
+}
+#endif
+
 int
 memory_notify(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
               uint32_t offset, uint32_t count, uint32_t *nwokenp)
@@ -557,6 +674,12 @@ memory_notify(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
         struct toywasm_mutex *lock;
         void *p;
         int ret;
+#if defined(TOYWASM_USE_FUTEX)
+        if (shared != NULL) {
+                return memory_notify_futex(ctx, memidx, addr, offset, count,
+                                           nwokenp);
+        }
+#endif
 #if defined(__GNUC__) && !defined(__clang__)
         lock = NULL;
 #endif
@@ -571,12 +694,186 @@ memory_notify(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
                 nwoken = 0;
         } else {
                 nwoken = atomics_notify(&shared->tab, addr + offset, count);
+#if defined(TOYWASM_USE_USER_SCHED)
+                if (ctx->sched != NULL && nwoken < count) {
+                        nwoken += sched_wakeup_wchan(ctx->sched, p,
+                                                     count - nwoken);
+                }
+#endif
         }
         memory_atomic_unlock(lock);
         *nwokenp = nwoken;
         return 0;
 }
 
+#if defined(TOYWASM_USE_USER_SCHED)
+/*
+ * memory.atomic.wait for userland threads.
+ *
+ * instead of sleeping, block the context on the scheduler with
+ * the address as the wait channel. memory_notify wakes it up with
+ * sched_wakeup_wchan.
+ */
+static int
+memory_wait_sched(struct exec_context *ctx, const void *p, uint64_t expected,
+                  uint32_t *resultp, const struct timespec *abstimeout,
+                  bool is64)
+{
+        struct sched_wait *w = &ctx->sched_wait;
+        enum sched_wakeup wakeup = w->wakeup;
+        int ret;
+
+        /* see if we are resuming from our own wait */
+        w->wakeup = SCHED_WAKEUP_NONE;
+        if (w->wchan == p) {
+                if (wakeup == SCHED_WAKEUP_EVENT) {
+                        *resultp = 0; /* ok */
+                        return 0;
+                }
+                if (wakeup == SCHED_WAKEUP_TIMEOUT) {
+                        *resultp = 2; /* timed out */
+                        return 0;
+                }
+        }
+        uint64_t prev;
+        if (is64) {
+                prev = le64_atomic_load(p);
+        } else {
+                prev = le32_atomic_load(p);
+        }
+        if (prev != expected) {
+                *resultp = 1; /* not equal */
+                return 0;
+        }
+        if (abstimeout != NULL) {
+                struct timespec now;
+                ret = timespec_now(CLOCK_REALTIME, &now);
+                if (ret != 0) {
+                        return ret;
+                }
+                if (timespec_cmp(abstimeout, &now) <= 0) {
+                        *resultp = 2; /* timed out */
+                        return 0;
+                }
+        }
+        ret = check_interrupt(ctx);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = sched_block(ctx->sched, ctx, NULL, 0, abstimeout, p);
+        if (ret != 0) {
+                return ret;
+        }
+        return ETOYWASMRESTART;
+}
+#endif
+
+#if defined(TOYWASM_USE_FUTEX)
+/*
+ * memory.atomic.wait32 with futex.c.
+ *
+ * the kernel compares the value with the expected one atomically with
+ * respect to FUTEX_WAKE in memory_notify_futex. unlike the waiter list
+ * version in memory_wait, we don't need the lock.
+ */
+static int
+memory_wait_futex(struct exec_context *ctx, const void *p, uint32_t expected,
+                  uint32_t *resultp, const struct timespec *abstimeout)
+{
+        struct cluster *c = ctx->cluster;
+        int ret;
+
+        /* avoid the syscall for the obvious cases */
+        if (le32_atomic_load(p) != expected) {
+                *resultp = 1; /* not equal */
+                return 0;
+        }
+        /*
+         * usually, an interrupt kicks us out of the futex.
+         * (cluster_set_interrupt and suspend_threads)
+         * however, nothing kicks us without a cluster. also, a user
+         * interrupt (exec_context::intrp) doesn't. in that case,
+         * emulate the long block by looping with a short interval
+         * as the waiter list version does.
+         */
+        const bool kickable = c != NULL && ctx->intrp == NULL;
+retry:;
+        struct futex_waiter w;
+        uint64_t gen = 0;
+        if (kickable) {
+                gen = futex_waiters_gen(&c->futex);
+        }
+        ret = check_interrupt(ctx);
+        if (ret != 0) {
+                return ret;
+        }
+        const struct timespec *tv = abstimeout;
+        struct timespec next_abstimeout;
+        if (kickable) {
+                ret = futex_waiter_register(&c->futex, &w, p, gen);
+                if (ret != 0) {
+                        return ret;
+                }
+        } else {
+                const int interval_ms = check_interrupt_interval_ms(ctx);
+                ret = abstime_from_reltime_ms(CLOCK_REALTIME, &next_abstimeout,
+                                              interval_ms);
+                if (ret != 0) {
+                        return ret;
+                }
+                if (abstimeout == NULL ||
+                    timespec_cmp(&next_abstimeout, abstimeout) < 0) {
+                        tv = &next_abstimeout;
+                }
+        }
+        /* the kernel compares the raw value in the memory */
+        ret = futex_wait32(p, host_to_le32(expected), tv);
+        if (kickable) {
+                futex_waiter_unregister(&c->futex, &w);
+        }
+        switch (ret) {
+        case 0:
+                /*
+                 * either memory.atomic.notify or a kick.
+                 *
+                 * wasm doesn't allow spurious wakeups. after a kick,
+                 * go back to check_interrupt, which returns the
+                 * restart or the interrupt if any. otherwise, we just
+                 * wait again.
+                 *
+                 * Note: if a notify races with a kick, the waiter
+                 * might miss the notify. it's same as the waiter list
+                 * version, which restarts the wait on a kick.
+                 */
+                if (kickable && futex_waiters_gen(&c->futex) != gen) {
+                        goto retry;
+                }
+                /*
+                 * the notifier usually has updated the value before
+                 * memory.atomic.notify. read it to synchronize with
+                 * the notifier. (the kernel doesn't tell the C memory
+                 * model, or tools like tsan, about the ordering.)
+                 */
+                (void)le32_atomic_load(p);
+                *resultp = 0; /* ok */
+                break;
+        case EAGAIN:
+                *resultp = 1; /* not equal */
+                break;
+        case ETIMEDOUT:
+                if (tv != abstimeout) {
+                        goto retry;
+                }
+                *resultp = 2; /* timed out */
+                break;
+        default:
+                assert(ret == EINTR);
+                goto retry;
+        }
+        return 0;
+}
+#endif
+
 int
 memory_wait(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
             uint32_t offset, uint64_t expected, uint32_t *resultp,
@@ -593,6 +890,7 @@ memory_wait(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
                                     "wait on non-shared memory");
         }
         struct toywasm_mutex *lock = NULL;
+        struct toywasm_mutex **lockp = &lock;
         int ret;
 
         /*
@@ -603,6 +901,18 @@ memory_wait(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
         if (ret != 0) {
                 return ret;
         }
+#if defined(TOYWASM_USE_FUTEX)
+        if (!is64) {
+                /* memory_wait_futex doesn't need the lock */
+                lockp = NULL;
+        } else {
+                /*
+                 * tell memory_notify_futex to look at the waiter lists.
+                 * it should be visible before we read the value below.
+                 */
+                shared->nwaiters64++;
+        }
+#endif
         struct restart_info *restart = &VEC_NEXTELEM(ctx->restarts);
         assert(restart->restart_type == RESTART_NONE ||
                restart->restart_type == RESTART_TIMER);
@@ -621,19 +931,33 @@ memory_wait(struct exec_context *ctx, uint32_t memidx, uint32_t addr,
         assert(restart->restart_type == RESTART_NONE);
         const uint32_t sz = is64 ? 8 : 4;
         void *p;
-        ret = memory_atomic_getptr(ctx, memidx, addr, offset, sz, &p, &lock);
+        ret = memory_atomic_getptr(ctx, memidx, addr, offset, sz, &p, lockp);
         if (ret != 0) {
-                return ret;
+                goto fail;
         }
-        assert((lock == NULL) == (shared == NULL));
+        assert(lockp == NULL || lock != NULL);
+#if defined(TOYWASM_USE_FUTEX)
+        if (!is64) {
+                ret = memory_wait_futex(ctx, p, (uint32_t)expected, resultp,
+                                        abstimeout);
+                goto fail;
+        }
+#endif
+#if defined(TOYWASM_USE_USER_SCHED)
+        if (ctx->sched != NULL) {
+                ret = memory_wait_sched(ctx, p, expected, resultp, abstimeout,
+                                        is64);
+                goto fail;
+        }
+#endif
 #if !defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
 retry:;
 #endif
         uint64_t prev;
         if (is64) {
-                prev = *(_Atomic uint64_t *)p;
+                prev = le64_atomic_load(p);
         } else {
-                prev = *(_Atomic uint32_t *)p;
+                prev = le32_atomic_load(p);
         }
         xlog_trace("%s: addr=0x%" PRIx32 " offset=0x%" PRIx32
                    " actual=%" PRIu64 " expected %" PRIu64,
@@ -705,6 +1029,11 @@ fail:
                 STAT_INC(ctx, atomic_wait_restart);
         }
         memory_atomic_unlock(lock);
+#if defined(TOYWASM_USE_FUTEX)
+        if (is64) {
+                shared->nwaiters64--;
+        }
+#endif
         if (ret == 0) {
                 xlog_trace("%s: returning %d result %d", __func__, ret,
                            *resultp);
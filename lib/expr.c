@@ -235,8 +235,8 @@ read_expr_common(const uint8_t **pp, const uint8_t *ep, struct expr *expr,
         for (i = 0; i < ei->njumps; i++) {
                 const struct jump *j = &ei->jumps[i];
                 xlog_trace_insn("jump table [%" PRIu32 "] %06" PRIx32
-                                " -> %06" PRIx32,
-                                i, j->pc, j->targetpc);
+                                " -> %06" PRIx32 " next %" PRIu32,
+                                i, j->pc, j->targetpc, j->nextidx);
         }
 #endif
         *pp = p;
@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #if defined(_WIN32)
 #include <io.h>
@@ -10,6 +12,7 @@
 #define O_BINARY _O_BINARY
 #define read _read
 #define close _close
+#define S_ISREG(m) (((m) & _S_IFMT) == _S_IFREG)
 typedef int ssize_t;
 #else
 #include <unistd.h>
@@ -89,13 +92,20 @@ map_file(const char *path, void **pp, size_t *sizep)
                 close(fd);
                 return ENOMEM;
         }
-        ssz = read(fd, p, size);
-        if (ssz != size) {
-                ret = errno;
-                assert(ret != 0);
-                xlog_trace("failed to read %s (error %d)", path, ret);
-                close(fd);
-                return ret;
+        size_t off = 0;
+        while (off < size) {
+                ssz = read(fd, (uint8_t *)p + off, size - off);
+                if (ssz <= 0) {
+                        /* a file truncated after fstat is an error too */
+                        ret = (ssz == 0) ? EIO : errno;
+                        assert(ret != 0);
+                        xlog_trace("failed to read %s (error %d)", path,
+                                   ret);
+                        free(p);
+                        close(fd);
+                        return ret;
+                }
+                off += ssz;
         }
         close(fd);
         *pp = p;
@@ -128,16 +138,28 @@ map_file(const char *filename, void **pp, size_t *szp)
 
         ret = fstat(fd, &st);
         if (ret == -1) {
+                ret = errno;
                 close(fd);
-                return errno;
+                return ret;
         }
 
+        /*
+         * Note: struct module keeps pointers into the mapping.
+         * (eg. expr::start) the file should not be modified while
+         * the module is loaded.
+         *
+         * the pages are shared with other processes mapping the same file
+         * via the page cache. they are faulted in on demand. with lazy
+         * validation or a module cache hit, most of the code section is
+         * never touched.
+         */
         void *vp;
         size_t sz = st.st_size;
         vp = mmap(NULL, sz, PROT_READ, MAP_SHARED, fd, 0);
         if (vp == (void *)MAP_FAILED) {
+                ret = errno;
                 close(fd);
-                return errno;
+                return ret;
         }
         close(fd);
 
@@ -153,3 +175,61 @@ unmap_file(void *p, size_t sz)
 }
 
 #endif
+
+/*
+ * returns true if the file is not a regular file. (eg. a pipe)
+ * such a file can't be mapped. it can be loaded with
+ * module_create_from_stream instead.
+ */
+bool
+is_stream_file(const char *filename)
+{
+        struct stat st;
+        if (stat(filename, &st) == -1) {
+                /* let map_file report the error */
+                return false;
+        }
+        return !S_ISREG(st.st_mode);
+}
+
+int
+stream_file_open(const char *filename, int *fdp)
+{
+        int fd;
+
+        xlog_trace("opening %s as a stream", filename);
+        fd = open(filename, O_BINARY | O_RDONLY);
+        if (fd == -1) {
+                return errno;
+        }
+        *fdp = fd;
+        return 0;
+}
+
+/*
+ * a module_stream_read_fn. "arg" is a pointer to the file descriptor.
+ */
+int
+stream_file_read(void *arg, void *buf, size_t size, size_t *nreadp)
+{
+        int fd = *(const int *)arg;
+        ssize_t ssz;
+
+        if (size > INT_MAX) {
+                size = INT_MAX;
+        }
+        do {
+                ssz = read(fd, buf, size);
+        } while (ssz == -1 && errno == EINTR);
+        if (ssz == -1) {
+                return errno;
+        }
+        *nreadp = ssz;
+        return 0;
+}
+
+void
+stream_file_close(int fd)
+{
+        close(fd);
+}
@@ -1,3 +1,6 @@
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "platform.h"
 
 __BEGIN_EXTERN_C
@@ -5,4 +8,9 @@ __BEGIN_EXTERN_C
 int map_file(const char *filename, void **pp, size_t *szp);
 void unmap_file(void *p, size_t sz);
 
+bool is_stream_file(const char *filename);
+int stream_file_open(const char *filename, int *fdp);
+int stream_file_read(void *arg, void *buf, size_t size, size_t *nreadp);
+void stream_file_close(int fd);
+
 __END_EXTERN_C
@@ -0,0 +1,165 @@
+/*
+ * memory.atomic.wait32/notify on linux futex
+ *
+ * unlike waitlist.c, where every wait and notify serializes on a global
+ * lock, the waiters sleep in the kernel on the linear memory address
+ * itself. the kernel compares the value atomically with the wakeup.
+ * notify is a single FUTEX_WAKE syscall without any userland locks.
+ *
+ * to deliver interrupts (cluster_set_interrupt, suspend_threads) to
+ * the sleeping waiters without periodic timeouts, they are registered
+ * to futex_waiters while sleeping. futex_waiters_kick wakes them up
+ * with FUTEX_WAKE on their addresses.
+ *
+ * a kick and a wakeup by memory.atomic.notify look the same to
+ * the kernel. the waiter tells them apart with futex_waiters_gen,
+ * which a kick bumps, and retries the wait after a kick instead of
+ * returning "ok" from memory.atomic.wait. (memory_wait_futex)
+ * the interrupt is handled by the check_interrupt before the retry.
+ */
+
+#define _GNU_SOURCE /* syscall */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "futex.h"
+#include "xlog.h"
+
+static long
+futex(const void *p, int op, uint32_t val, const struct timespec *ts,
+      uint32_t val3)
+{
+        return syscall(SYS_futex, p, op, val, ts, NULL, val3);
+}
+
+int
+futex_wait32(const void *p, uint32_t expected,
+             const struct timespec *abstimeout)
+{
+        /*
+         * FUTEX_WAIT takes a relative timeout.
+         * FUTEX_WAIT_BITSET takes an absolute one.
+         */
+        long ret = futex(p,
+                         FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG |
+                                 FUTEX_CLOCK_REALTIME,
+                         expected, abstimeout, FUTEX_BITSET_MATCH_ANY);
+        if (ret == -1) {
+                assert(errno == EAGAIN || errno == ETIMEDOUT ||
+                       errno == EINTR);
+                return errno;
+        }
+        return 0;
+}
+
+uint32_t
+futex_wake(const void *p, uint32_t count)
+{
+        if (count > INT_MAX) {
+                count = INT_MAX;
+        }
+        long ret = futex(p, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, NULL, 0);
+        if (ret == -1) {
+                xlog_error("%s: FUTEX_WAKE failed with %d", __func__, errno);
+                return 0;
+        }
+        assert(ret >= 0 && ret <= count);
+        return ret;
+}
+
+void
+futex_waiters_init(struct futex_waiters *fw)
+{
+        toywasm_mutex_init(&fw->lock);
+        LIST_HEAD_INIT(&fw->waiters);
+        fw->gen = 0;
+}
+
+void
+futex_waiters_destroy(struct futex_waiters *fw)
+{
+        assert(LIST_EMPTY(&fw->waiters));
+        toywasm_mutex_destroy(&fw->lock);
+}
+
+uint64_t
+futex_waiters_gen(struct futex_waiters *fw)
+{
+        return fw->gen;
+}
+
+int
+futex_waiter_register(struct futex_waiters *fw, struct futex_waiter *w,
+                      const void *p, uint64_t gen)
+{
+        int ret = 0;
+        toywasm_mutex_lock(&fw->lock);
+        if (fw->gen != gen) {
+                /*
+                 * we might have missed a kick after checking
+                 * the interrupt conditions.
+                 */
+                ret = ETOYWASMRESTART;
+        } else {
+                w->p = p;
+                w->gen = gen;
+                LIST_INSERT_TAIL(&fw->waiters, w, e);
+        }
+        toywasm_mutex_unlock(&fw->lock);
+        return ret;
+}
+
+void
+futex_waiter_unregister(struct futex_waiters *fw, struct futex_waiter *w)
+{
+        toywasm_mutex_lock(&fw->lock);
+        LIST_REMOVE(&fw->waiters, w, e);
+        toywasm_mutex_unlock(&fw->lock);
+}
+
+void
+futex_waiters_kick(struct futex_waiters *fw)
+{
+        toywasm_mutex_lock(&fw->lock);
+        const uint64_t gen = ++fw->gen;
+        while (true) {
+                /*
+                 * a waiter registered before the gen bump might not
+                 * have entered the kernel yet. in that case, our
+                 * FUTEX_WAKE is a no-op for it. keep waking until all
+                 * of them unregister.
+                 *
+                 * the waiters registered after the bump don't need
+                 * the kick because they have checked the interrupt
+                 * conditions after we (our caller) set them.
+                 */
+                struct futex_waiter *w;
+                bool pending = false;
+                LIST_FOREACH(w, &fw->waiters, e) {
+                        if (w->gen < gen) {
+                                futex_wake(w->p, UINT32_MAX);
+                                pending = true;
+                        }
+                }
+                if (!pending) {
+                        break;
+                }
+                toywasm_mutex_unlock(&fw->lock);
+                const struct timespec ts = {
+                        .tv_sec = 0,
+                        .tv_nsec = 100000, /* 100us */
+                };
+                nanosleep(&ts, NULL);
+                toywasm_mutex_lock(&fw->lock);
+        }
+        toywasm_mutex_unlock(&fw->lock);
+}
@@ -0,0 +1,72 @@
+#if !defined(_TOYWASM_FUTEX_H)
+#define _TOYWASM_FUTEX_H
+
+#include <stdint.h>
+
+#include "list.h"
+#include "lock.h"
+#include "platform.h"
+
+struct timespec;
+
+/*
+ * a context sleeping in futex_wait32.
+ * registered to futex_waiters so that futex_waiters_kick can wake it up.
+ */
+struct futex_waiter {
+        LIST_ENTRY(struct futex_waiter) e;
+        const void *p;
+        uint64_t gen;
+};
+
+/*
+ * the waiters which can be interrupted together. (cluster::futex)
+ */
+struct futex_waiters {
+        TOYWASM_MUTEX_DEFINE(lock);
+        LIST_HEAD(struct futex_waiter) waiters GUARDED_BY(lock);
+        _Atomic uint64_t gen;
+};
+
+__BEGIN_EXTERN_C
+
+void futex_waiters_init(struct futex_waiters *fw);
+void futex_waiters_destroy(struct futex_waiters *fw);
+
+/*
+ * futex_waiters_gen should be called before checking the interrupt
+ * conditions. futex_waiter_register fails with ETOYWASMRESTART if
+ * futex_waiters_kick has been called since then.
+ */
+uint64_t futex_waiters_gen(struct futex_waiters *fw);
+int futex_waiter_register(struct futex_waiters *fw, struct futex_waiter *w,
+                          const void *p, uint64_t gen);
+void futex_waiter_unregister(struct futex_waiters *fw,
+                             struct futex_waiter *w);
+
+/*
+ * wake up all the registered waiters.
+ * the caller should set the interrupt condition before calling this.
+ */
+void futex_waiters_kick(struct futex_waiters *fw);
+
+/*
+ * sleep while the 32-bit value at p is expected.
+ *
+ * abstimeout is in CLOCK_REALTIME. NULL means no timeout.
+ *
+ * returns 0 when woken (possibly spuriously), EAGAIN if the value is not
+ * expected, ETIMEDOUT, or EINTR.
+ */
+int futex_wait32(const void *p, uint32_t expected,
+                 const struct timespec *abstimeout);
+
+/*
+ * wake up at most count waiters sleeping on p.
+ * returns the number of waiters woken.
+ */
+uint32_t futex_wake(const void *p, uint32_t count);
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_FUTEX_H) */
@@ -30,6 +30,27 @@ _dtor(struct mem_context *mctx, struct import_object *im)
         }
 }
 
+/*
+ * the functype for each enum host_func_sig.
+ */
+static const char *const host_func_sig_types[] = {
+        [HOST_FUNC_SIG_i_i] = "(i)i",       [HOST_FUNC_SIG_ii_i] = "(ii)i",
+        [HOST_FUNC_SIG_iii_i] = "(iii)i",   [HOST_FUNC_SIG_iiii_i] = "(iiii)i",
+        [HOST_FUNC_SIG_iIi_i] = "(iIi)i",   [HOST_FUNC_SIG_iIii_i] = "(iIii)i",
+};
+
+static bool
+host_func_sig_matches(const struct host_func *func)
+{
+        if (func->sig == HOST_FUNC_SIG_GENERIC) {
+                return true;
+        }
+        if (func->sig >= ARRAYCOUNT(host_func_sig_types)) {
+                return false;
+        }
+        return !strcmp(host_func_sig_types[func->sig], func->type);
+}
+
 int
 import_object_create_for_host_funcs(struct mem_context *mctx,
                                     const struct host_module *modules,
@@ -67,6 +88,15 @@ import_object_create_for_host_funcs(struct mem_context *mctx,
                 for (j = 0; j < hm->nfuncs; j++) {
                         const struct host_func *func = &hm->funcs[j];
                         struct functype *ft;
+                        if (!host_func_sig_matches(func)) {
+                                xlog_error("host func %.*s: sig %u doesn't "
+                                           "match with functype %s",
+                                           CSTR(&func->name),
+                                           (unsigned int)func->sig,
+                                           func->type);
+                                ret = EINVAL;
+                                goto fail;
+                        }
                         ret = functype_from_string(mctx, func->type, &ft);
                         if (ret != 0) {
                                 xlog_error("failed to parse functype %s with "
@@ -77,8 +107,13 @@ import_object_create_for_host_funcs(struct mem_context *mctx,
                         struct funcinst *fi = &fis[idx];
                         fi->is_host = true;
                         fi->u.host.func = func->func;
+                        fi->u.host.sig = func->sig;
+                        fi->u.host.typed = func->typed;
                         fi->u.host.type = ft;
                         fi->u.host.instance = hi;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+                        fi->canonid = ft->canonid;
+#endif
                         struct import_object_entry *e = &im->entries[idx];
                         e->module_name = hm->module_name;
                         e->name = &func->name;
@@ -131,6 +166,98 @@ host_func_dump_params(const struct functype *ft, const struct cell *params)
 #endif /* defined(TOYWASM_ENABLE_TRACING) */
 }
 
+static uint32_t
+param_i32(const struct cell **cellsp)
+{
+        struct val val;
+        val_from_cells(&val, *cellsp, 1);
+        *cellsp += 1;
+        return val.u.i32;
+}
+
+static uint64_t
+param_i64(const struct cell **cellsp)
+{
+        const uint32_t csz = valtype_cellsize(TYPE_i64);
+        struct val val;
+        val_from_cells(&val, *cellsp, csz);
+        *cellsp += csz;
+        return val.u.i64;
+}
+
+/*
+ * call the typed entry point of a host function with the parameters
+ * in cells. it's the typed counterpart of host_func_t, used by the
+ * interpreter and HOST_FUNC_TYPED_WRAPPER.
+ *
+ * ft is only used to dump the parameters for tracing.
+ *
+ * Note: params and results can overlap.
+ */
+int
+host_func_call_typed(struct exec_context *ctx, struct host_instance *hi,
+                     const struct functype *ft, enum host_func_sig sig,
+                     union host_func_typed f, const struct cell *params,
+                     struct cell *results)
+{
+        const struct cell *p = params;
+        uint32_t a0;
+        uint32_t a1;
+        uint32_t a2;
+        uint32_t a3;
+        uint64_t l1;
+        uint32_t r;
+        int ret;
+        host_func_dump_params(ft, params);
+        switch (sig) {
+        case HOST_FUNC_SIG_i_i:
+                a0 = param_i32(&p);
+                ret = f.i_i(ctx, hi, a0, &r);
+                break;
+        case HOST_FUNC_SIG_ii_i:
+                a0 = param_i32(&p);
+                a1 = param_i32(&p);
+                ret = f.ii_i(ctx, hi, a0, a1, &r);
+                break;
+        case HOST_FUNC_SIG_iii_i:
+                a0 = param_i32(&p);
+                a1 = param_i32(&p);
+                a2 = param_i32(&p);
+                ret = f.iii_i(ctx, hi, a0, a1, a2, &r);
+                break;
+        case HOST_FUNC_SIG_iiii_i:
+                a0 = param_i32(&p);
+                a1 = param_i32(&p);
+                a2 = param_i32(&p);
+                a3 = param_i32(&p);
+                ret = f.iiii_i(ctx, hi, a0, a1, a2, a3, &r);
+                break;
+        case HOST_FUNC_SIG_iIi_i:
+                a0 = param_i32(&p);
+                l1 = param_i64(&p);
+                a2 = param_i32(&p);
+                ret = f.iIi_i(ctx, hi, a0, l1, a2, &r);
+                break;
+        case HOST_FUNC_SIG_iIii_i:
+                a0 = param_i32(&p);
+                l1 = param_i64(&p);
+                a2 = param_i32(&p);
+                a3 = param_i32(&p);
+                ret = f.iIii_i(ctx, hi, a0, l1, a2, a3, &r);
+                break;
+        default:
+                assert(false);
+                ret = EINVAL;
+                break;
+        }
+        if (ret == 0) {
+                struct val val;
+                val.u.i32 = r;
+                val_to_cells(&val, results, 1);
+        }
+        return ret;
+}
+
 /*
  * Trap on unaligned pointers in a host call.
  *
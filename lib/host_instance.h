@@ -11,6 +11,14 @@ struct host_func {
         struct name name;
         const char *type;
         host_func_t func;
+
+        /*
+         * optional typed entry point. see enum host_func_sig.
+         * the type should match with the signature.
+         * func is still necessary. (see HOST_FUNC_TYPED_WRAPPER)
+         */
+        enum host_func_sig sig;
+        union host_func_typed typed;
 };
 
 #define HOST_FUNC_DECL(NAME)                                                  \
@@ -30,6 +38,28 @@ struct host_func {
                 .func = FUNC,                                                 \
         }
 
+/*
+ * a host function with a typed entry point named FUNC_PREFIX##NAME##_typed.
+ */
+#define HOST_FUNC_PREFIX_TYPED(FUNC_PREFIX, NAME, SIG, TYPE)                  \
+        {                                                                     \
+                .name = NAME_FROM_CSTR_LITERAL(#NAME), .type = TYPE,          \
+                .func = FUNC_PREFIX##NAME, .sig = HOST_FUNC_SIG_##SIG,        \
+                .typed.SIG = FUNC_PREFIX##NAME##_typed,                       \
+        }
+
+/*
+ * define the generic entry point NAME for the typed entry point TYPED.
+ */
+#define HOST_FUNC_TYPED_WRAPPER(NAME, SIG, TYPED)                             \
+        HOST_FUNC_DECL(NAME)                                                  \
+        {                                                                     \
+                union host_func_typed f;                                      \
+                f.SIG = TYPED;                                                \
+                return host_func_call_typed(ctx, hi, ft, HOST_FUNC_SIG_##SIG, \
+                                            f, params, results);              \
+        }
+
 #define HOST_FUNC_CONVERT_PARAMS(FT, PARAMS)                                  \
         struct val *converted_params =                                        \
                 calloc((FT)->parameter.ntypes, sizeof(*converted_params));    \
@@ -56,10 +86,17 @@ struct host_func {
                 xlog_trace("host func %s called", __func__);                  \
                 host_func_dump_params(ft, params);                            \
         } while (0)
+#define HOST_FUNC_TYPED_TRACE                                                 \
+        do {                                                                  \
+                xlog_trace("host func %s called", __func__);                  \
+        } while (0)
 #else
 #define HOST_FUNC_TRACE                                                       \
         do {                                                                  \
         } while (0)
+#define HOST_FUNC_TYPED_TRACE                                                 \
+        do {                                                                  \
+        } while (0)
 #endif
 
 /*
@@ -91,6 +128,10 @@ int import_object_create_for_host_funcs(struct mem_context *mctx,
 
 void host_func_dump_params(const struct functype *ft,
                            const struct cell *params);
+int host_func_call_typed(struct exec_context *ctx, struct host_instance *hi,
+                         const struct functype *ft, enum host_func_sig sig,
+                         union host_func_typed f, const struct cell *params,
+                         struct cell *results);
 int host_func_check_align(struct exec_context *ctx, uint32_t wasmaddr,
                           size_t align);
 int host_func_copyout(struct exec_context *ctx, struct meminst *mem,
@@ -12,6 +12,9 @@
 #include "context.h"
 #include "decode.h"
 #include "endian.h"
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#include "endian_atomic.h"
+#endif
 #include "exec.h"
 #include "expr.h"
 #include "insn.h"
@@ -19,9 +22,15 @@
 #include "insn_op.h"
 #include "insn_op_helpers.h"
 #include "instance.h"
+#include "jit.h"
 #include "leb128.h"
 #include "mem.h"
+#include "memory_guard.h"
 #include "platform.h"
+#include "predecode.h"
+#if defined(TOYWASM_USE_HOST_SIMD)
+#include "simd_host.h"
+#endif
 #include "type.h"
 #include "util.h"
 #include "validation.h"
@@ -120,12 +129,31 @@ push_label(const uint8_t *p, struct cell *stack, struct exec_context *ctx)
         struct label *l = VEC_PUSH(ctx->labels);
         l->pc = pc;
         l->height = stack - ctx->stack.p;
+        /*
+         * maintain ctx->jumpidx.
+         *
+         * the jump table has entries for block-starting instructions
+         * in the order of pc. (cf. push_ctrlframe) thus, the entry
+         * for this block, if any, is the next one. remember it in
+         * the label so that block_exit can find the jump target
+         * without searching the table.
+         */
+        l->jumpidx = ctx->jumpidx;
+        const struct expr_exec_info *ei = ctx->ei;
+        if (ei->jumps != NULL) {
+                const uint8_t op = p[-1];
+                if (op != FRAME_OP_LOOP) {
+                        assert(ctx->jumpidx < ei->njumps);
+                        assert(ei->jumps[ctx->jumpidx].pc == pc);
+                        /* "if" has an extra entry for "else" */
+                        ctx->jumpidx += (op == FRAME_OP_IF) ? 2 : 1;
+                }
+        }
 }
 
 static struct cell *
-local_getptr(struct exec_context *ectx, uint32_t localidx, uint32_t *cszp)
+frame_cellptr(struct exec_context *ectx, uint32_t cidx)
 {
-        uint32_t cidx = frame_locals_cellidx(ectx, localidx, cszp);
 #if defined(TOYWASM_USE_LOCALS_CACHE)
         return &ectx->current_locals[cidx];
 #else
@@ -134,6 +162,13 @@ local_getptr(struct exec_context *ectx, uint32_t localidx, uint32_t *cszp)
 #endif
 }
 
+static struct cell *
+local_getptr(struct exec_context *ectx, uint32_t localidx, uint32_t *cszp)
+{
+        uint32_t cidx = frame_locals_cellidx(ectx, localidx, cszp);
+        return frame_cellptr(ectx, cidx);
+}
+
 static void
 local_get(struct exec_context *ctx, uint32_t localidx, struct cell *stack,
           uint32_t *cszp)
@@ -156,18 +191,87 @@ local_set(struct exec_context *ctx, uint32_t localidx,
         cells_copy(cells, stack - *cszp, *cszp);
 }
 
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+/*
+ * accessors for the register-operand instructions. (insn_impl_reg.h)
+ * "cidx" is the cell index of a local, which is resolved by
+ * the pre-decoder.
+ */
+static uint32_t
+frame_cell_get_i32(struct exec_context *ectx, uint32_t cidx)
+{
+        struct val val;
+        val_from_cells(&val, frame_cellptr(ectx, cidx),
+                       valtype_cellsize(TYPE_i32));
+        return val.u.i32;
+}
+
+static uint64_t
+frame_cell_get_i64(struct exec_context *ectx, uint32_t cidx)
+{
+        struct val val;
+        val_from_cells(&val, frame_cellptr(ectx, cidx),
+                       valtype_cellsize(TYPE_i64));
+        return val.u.i64;
+}
+
+static void
+frame_cell_set_i32(struct exec_context *ectx, uint32_t cidx, uint32_t v)
+{
+        struct val val;
+        val.u.i32 = v;
+        val_to_cells(&val, frame_cellptr(ectx, cidx),
+                     valtype_cellsize(TYPE_i32));
+}
+
+static void
+frame_cell_set_i64(struct exec_context *ectx, uint32_t cidx, uint64_t v)
+{
+        struct val val;
+        val.u.i64 = v;
+        val_to_cells(&val, frame_cellptr(ectx, cidx),
+                     valtype_cellsize(TYPE_i64));
+}
+#endif
+
 /*
  * https://webassembly.github.io/spec/core/exec/instructions.html#exec-call-indirect
+ *
+ * "site" is the address of the call_indirect instruction.
+ * it's used as the key of the call_indirect cache.
  */
 static int
-get_func_indirect(struct exec_context *ectx, uint32_t tableidx,
-                  uint32_t typeidx, uint32_t i, const struct funcinst **fip)
+get_func_indirect(struct exec_context *ectx, const uint8_t *site,
+                  uint32_t tableidx, uint32_t typeidx, uint32_t i,
+                  const struct funcinst **fip)
 {
         const struct instance *inst = ectx->instance;
         const struct module *m = inst->module;
         const struct functype *ft = &m->types[typeidx];
         const struct tableinst *t = VEC_ELEM(inst->tables, tableidx);
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        const uint32_t key =
+                ((uintptr_t)site + i) % ARRAYCOUNT(ectx->call_indirect_cache);
+        struct call_indirect_cache *cache = &ectx->call_indirect_cache[key];
+        if (__predict_true(cache->site == site && cache->table == t &&
+                           cache->idx == i && cache->gen == t->gen)) {
+                STAT_INC(ectx, call_indirect_cache_hit);
+                *fip = cache->func;
+                return 0;
+        }
+        STAT_INC(ectx, call_indirect_cache_miss);
+        int ret = table_get_func(ectx, t, i, ft, fip);
+        if (ret == 0) {
+                cache->site = site;
+                cache->table = t;
+                cache->idx = i;
+                cache->gen = t->gen;
+                cache->func = *fip;
+        }
+        return ret;
+#else
         return table_get_func(ectx, t, i, ft, fip);
+#endif
 }
 
 /*
@@ -448,6 +552,25 @@ read_memarg_nocheck(const uint8_t **pp, struct memarg *arg)
         arg->align = align;
 }
 
+static uint8_t
+read_u8_nocheck(const uint8_t **pp)
+{
+        return *(*pp)++;
+}
+
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+/*
+ * returns the pointer to the 16 bytes immediate. (v128.const)
+ */
+static const uint8_t *
+read_v128_nocheck(const uint8_t **pp)
+{
+        const uint8_t *p = *pp;
+        *pp = p + 16;
+        return p;
+}
+#endif
+
 static void
 schedule_br(struct exec_context *ectx, uint32_t labelidx)
 {
@@ -725,6 +848,377 @@ schedule_exception(struct exec_context *ectx)
 #include "insn_undef.h"
 #endif /* defined(TOYWASM_USE_SEPARATE_EXECUTE) */
 
+#if defined(TOYWASM_USE_PREDECODE)
+/*
+ * generate the callbacks to translate instructions into the pre-decoded
+ * form. (see predecode.c)
+ *
+ * these are same as the "process" callbacks with EXECUTING=false and
+ * VALIDATING=false (that is, just skipping instructions) except that
+ * the functions to decode immediates are replaced with the versions
+ * which emit the decoded values.
+ */
+
+static uint32_t
+predecode_read_leb_u32(struct predecode_context *ctx, const uint8_t **pp)
+{
+        uint32_t v = read_leb_u32_nocheck(pp);
+        predecode_emit_u32(ctx, v);
+        return v;
+}
+
+static uint32_t
+predecode_read_leb_i32(struct predecode_context *ctx, const uint8_t **pp)
+{
+        uint32_t v = read_leb_i32_nocheck(pp);
+        predecode_emit_u32(ctx, v);
+        return v;
+}
+
+static uint64_t
+predecode_read_leb_i64(struct predecode_context *ctx, const uint8_t **pp)
+{
+        uint64_t v = read_leb_i64_nocheck(pp);
+        predecode_emit_u64(ctx, v);
+        return v;
+}
+
+static int64_t
+predecode_read_leb_s33(struct predecode_context *ctx, const uint8_t **pp)
+{
+        /*
+         * the blocktype is replaced with struct predecoded_block.
+         * emit a placeholder here. predecode_expr fills it later.
+         */
+        int64_t v = read_leb_s33_nocheck(pp);
+        ctx->blocktype = v;
+        uint32_t i;
+        for (i = 0; i < PREDECODED_BLOCK_NWORDS; i++) {
+                predecode_emit_u32(ctx, 0);
+        }
+        return v;
+}
+
+static void
+predecode_read_memarg(struct predecode_context *ctx, const uint8_t **pp,
+                      struct memarg *arg)
+{
+        read_memarg_nocheck(pp, arg);
+        predecode_emit_u32(ctx, arg->offset);
+        predecode_emit_u32(ctx, arg->align);
+#if defined(TOYWASM_ENABLE_WASM_MULTI_MEMORY)
+        predecode_emit_u32(ctx, arg->memidx);
+#endif
+}
+
+static uint8_t
+predecode_read_u8_nocheck(struct predecode_context *ctx, const uint8_t **pp)
+{
+        uint8_t v = read_u8_nocheck(pp);
+        predecode_emit_u32(ctx, v);
+        return v;
+}
+
+static int
+predecode_read_u8(struct predecode_context *ctx, const uint8_t **pp,
+                  const uint8_t *ep, uint8_t *vp)
+{
+        int ret = read_u8(pp, ep, vp);
+        if (ret == 0) {
+                predecode_emit_u32(ctx, *vp);
+        }
+        return ret;
+}
+
+static int
+predecode_read_u32(struct predecode_context *ctx, const uint8_t **pp,
+                   const uint8_t *ep, uint32_t *vp)
+{
+        int ret = read_u32(pp, ep, vp);
+        if (ret == 0) {
+                predecode_emit_u32(ctx, *vp);
+        }
+        return ret;
+}
+
+static int
+predecode_read_u64(struct predecode_context *ctx, const uint8_t **pp,
+                   const uint8_t *ep, uint64_t *vp)
+{
+        int ret = read_u64(pp, ep, vp);
+        if (ret == 0) {
+                predecode_emit_u64(ctx, *vp);
+        }
+        return ret;
+}
+
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+static const uint8_t *
+predecode_read_v128(struct predecode_context *ctx, const uint8_t **pp)
+{
+        const uint8_t *p = read_v128_nocheck(pp);
+        predecode_emit_bytes(ctx, p, 16);
+        return p;
+}
+#endif
+
+static int
+predecode_read_vec_u32(struct predecode_context *ctx, struct mem_context *mctx,
+                       const uint8_t **pp, const uint8_t *ep,
+                       uint32_t *countp, uint32_t **resultp)
+{
+        int ret = read_vec_u32(mctx, pp, ep, countp, resultp);
+        if (ret == 0) {
+                uint32_t i;
+                predecode_emit_u32(ctx, *countp);
+                for (i = 0; i < *countp; i++) {
+                        predecode_emit_u32(ctx, (*resultp)[i]);
+                }
+        }
+        return ret;
+}
+
+#define EXECUTING false
+#define ECTX ((struct exec_context *)NULL)
+#define VALIDATING false
+#define VCTX ((struct validation_context *)NULL)
+#define INSN_IMPL(NAME)                                                       \
+        static int predecode_##NAME(const uint8_t **pp, const uint8_t *ep,    \
+                                    struct predecode_context *ctx)
+#define LOAD_PC const uint8_t *p __unused = *pp
+#define SAVE_PC *pp = p
+#define RELOAD_PC
+#define SAVE_STACK_PTR
+#define LOAD_STACK_PTR
+#define ORIG_PC (*pp)
+#define INSN_SUCCESS return 0
+#define INSN_SUCCESS_RETURN INSN_SUCCESS
+#define INSN_SUCCESS_BLOCK_END INSN_SUCCESS
+#define PREPARE_FOR_POSSIBLE_RESTART
+#define INSN_FAIL_RESTARTABLE(NAME) INSN_FAIL
+#define INSN_FAIL                                                             \
+        assert(ret != 0);                                                     \
+        assert(!IS_RESTARTABLE(ret));                                         \
+        return ret
+#define push_val(v, csz, ctx)                                                 \
+        do {                                                                  \
+                (void)v;                                                      \
+                (void)csz;                                                    \
+        } while (0)
+#define pop_val(v, csz, ctx)                                                  \
+        do {                                                                  \
+                (void)v;                                                      \
+                (void)csz;                                                    \
+        } while (0)
+#define STACK NULL
+#define STACK_ADJ(n)                                                          \
+        do {                                                                  \
+                (void)n;                                                      \
+        } while (0)
+#define read_leb_u32_nocheck(pp) predecode_read_leb_u32(ctx, pp)
+#define read_leb_i32_nocheck(pp) predecode_read_leb_i32(ctx, pp)
+#define read_leb_i64_nocheck(pp) predecode_read_leb_i64(ctx, pp)
+#define read_leb_s33_nocheck(pp) predecode_read_leb_s33(ctx, pp)
+#define read_memarg_nocheck(pp, arg) predecode_read_memarg(ctx, pp, arg)
+#define read_u8_nocheck(pp) predecode_read_u8_nocheck(ctx, pp)
+#define read_u8(pp, ep, vp) predecode_read_u8(ctx, pp, ep, vp)
+#define read_u32(pp, ep, vp) predecode_read_u32(ctx, pp, ep, vp)
+#define read_u64(pp, ep, vp) predecode_read_u64(ctx, pp, ep, vp)
+#define read_v128_nocheck(pp) predecode_read_v128(ctx, pp)
+#define read_vec_u32(mctx, pp, ep, countp, resultp)                           \
+        predecode_read_vec_u32(ctx, mctx, pp, ep, countp, resultp)
+
+#include "insn_impl.h"
+#include "insn_undef.h"
+#undef read_leb_u32_nocheck
+#undef read_leb_i32_nocheck
+#undef read_leb_i64_nocheck
+#undef read_leb_s33_nocheck
+#undef read_memarg_nocheck
+#undef read_u8_nocheck
+#undef read_u8
+#undef read_u32
+#undef read_u64
+#undef read_v128_nocheck
+#undef read_vec_u32
+
+/*
+ * generate the exec-only callbacks for the pre-decoded code.
+ *
+ * same as the above exec-only callbacks except that immediates are
+ * read from the pre-decoded form.
+ */
+
+static uint32_t
+predecoded_read_u32(const uint8_t **pp)
+{
+        const uint32_t *wp = (const void *)*pp;
+        *pp = (const void *)(wp + 1);
+        return *wp;
+}
+
+static uint64_t
+predecoded_read_u64(const uint8_t **pp)
+{
+        uint64_t v;
+        memcpy(&v, *pp, sizeof(v));
+        *pp += sizeof(v);
+        return v;
+}
+
+static int64_t
+predecoded_skip_block(const uint8_t **pp)
+{
+        /*
+         * skip struct predecoded_block.
+         * the exec logic doesn't need the blocktype itself.
+         */
+        *pp += sizeof(struct predecoded_block);
+        return 0;
+}
+
+static void
+predecoded_read_memarg(const uint8_t **pp, struct memarg *arg)
+{
+        arg->offset = predecoded_read_u32(pp);
+        arg->align = predecoded_read_u32(pp);
+#if defined(TOYWASM_ENABLE_WASM_MULTI_MEMORY)
+        arg->memidx = predecoded_read_u32(pp);
+#else
+        arg->memidx = 0;
+#endif
+}
+
+static int
+predecoded_read_u8(const uint8_t **pp, uint8_t *vp)
+{
+        *vp = (uint8_t)predecoded_read_u32(pp);
+        return 0;
+}
+
+static int
+predecoded_read_u32_to(const uint8_t **pp, uint32_t *vp)
+{
+        *vp = predecoded_read_u32(pp);
+        return 0;
+}
+
+static int
+predecoded_read_u64_to(const uint8_t **pp, uint64_t *vp)
+{
+        *vp = predecoded_read_u64(pp);
+        return 0;
+}
+
+static void
+predecoded_push_label(const uint8_t *p, struct cell *stack,
+                      struct exec_context *ctx)
+{
+        /*
+         * "- sizeof(uint32_t)" for the opcode word.
+         * cf. push_label
+         */
+        uint32_t pc = ptr2pc(ctx->instance->module, p - sizeof(uint32_t));
+        struct label *l = VEC_PUSH(ctx->labels);
+        l->pc = pc;
+        l->height = stack - ctx->stack.p;
+}
+
+#define EXECUTING true
+#define ECTX ctx
+#define VALIDATING false
+#define VCTX ((struct validation_context *)NULL)
+#define INSN_IMPL(NAME)                                                       \
+        static int fetch_exec_pd_##NAME(const uint8_t *p, struct cell *stack, \
+                                        struct exec_context *ctx)
+#define LOAD_PC const uint8_t *p0 __unused = p
+#define SAVE_PC
+#define RELOAD_PC p = ctx->p
+#define SAVE_STACK_PTR ctx->stack.lsize = stack - ctx->stack.p
+#define LOAD_STACK_PTR stack = &VEC_NEXTELEM(ctx->stack)
+#define ORIG_PC p0
+#if defined(TOYWASM_USE_TAILCALL) &&                                          \
+        (defined(__HAVE_MUSTTAIL) || defined(TOYWASM_FORCE_USE_TAILCALL))
+#define INSN_SUCCESS                                                          \
+        __musttail return fetch_exec_next_insn_predecoded(p, stack, ctx)
+#else
+#define INSN_SUCCESS INSN_SUCCESS_RETURN
+#endif
+#define INSN_SUCCESS_RETURN                                                   \
+        SAVE_STACK_PTR;                                                       \
+        ctx->p = p;                                                           \
+        return 0
+#define INSN_SUCCESS_BLOCK_END assert(false)
+#define PREPARE_FOR_POSSIBLE_RESTART struct cell *saved_stack_ptr = stack
+#define INSN_FAIL_RESTARTABLE(NAME)                                           \
+        assert(ret != 0);                                                     \
+        if (IS_RESTARTABLE(ret)) {                                            \
+                ctx->p = ORIG_PC;                                             \
+                stack = saved_stack_ptr;                                      \
+                SAVE_STACK_PTR;                                               \
+                ctx->event = EXEC_EVENT_RESTART_INSN;                         \
+                ctx->event_u.restart_insn.fetch_exec = fetch_exec_pd_##NAME;  \
+        } else {                                                              \
+                ctx->p = p;                                                   \
+        }                                                                     \
+        return ret
+#define INSN_FAIL                                                             \
+        assert(ret != 0);                                                     \
+        assert(!IS_RESTARTABLE(ret));                                         \
+        ctx->p = p;                                                           \
+        return ret
+#define ep NULL
+#define STACK stack
+#define STACK_ADJ(n) stack += (n)
+#if defined(TOYWASM_USE_SMALL_CELLS)
+#define push_val(v, csz, ctx) stack_push_val(ctx, v, &stack, csz)
+#define pop_val(v, csz, ctx) stack_pop_val(ctx, v, &stack, csz)
+#else
+#define push_val(v, csz, ctx)                                                 \
+        do {                                                                  \
+                assert(csz == 1);                                             \
+                *stack++ = (v)->u.cells[0];                                   \
+        } while (0)
+#define pop_val(v, csz, ctx)                                                  \
+        do {                                                                  \
+                assert(csz == 1);                                             \
+                (v)->u.cells[0] = *(--stack);                                 \
+        } while (0)
+#endif
+#define read_leb_u32_nocheck(pp) predecoded_read_u32(pp)
+#define read_leb_i32_nocheck(pp) predecoded_read_u32(pp)
+#define read_leb_i64_nocheck(pp) predecoded_read_u64(pp)
+#define read_leb_s33_nocheck(pp) predecoded_skip_block(pp)
+#define read_memarg_nocheck(pp, arg) predecoded_read_memarg(pp, arg)
+#define read_u8_nocheck(pp) (uint8_t)predecoded_read_u32(pp)
+#define read_u8(pp, ep, vp) predecoded_read_u8(pp, vp)
+#define read_u32(pp, ep, vp) predecoded_read_u32_to(pp, vp)
+#define read_u64(pp, ep, vp) predecoded_read_u64_to(pp, vp)
+#define push_label(p, stack, ctx) predecoded_push_label(p, stack, ctx)
+#if defined(TOYWASM_USE_SMALL_CELLS)
+/* the cell size is embedded in the pre-decoded code */
+#define find_type_annotation(ctx, pv) predecoded_read_u32(&pv)
+#endif
+
+#include "insn_impl.h"
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+#include "insn_impl_fused.h"
+#include "insn_impl_reg.h"
+#endif
+#include "insn_undef.h"
+#undef read_leb_u32_nocheck
+#undef read_leb_i32_nocheck
+#undef read_leb_i64_nocheck
+#undef read_leb_s33_nocheck
+#undef read_memarg_nocheck
+#undef read_u8_nocheck
+#undef read_u8
+#undef read_u32
+#undef read_u64
+#undef push_label
+#undef find_type_annotation
+#endif /* defined(TOYWASM_USE_PREDECODE) */
+
 #if defined(TOYWASM_USE_SEPARATE_VALIDATE)
 /*
  * define the validate-only callbacks.
@@ -849,7 +1343,8 @@ const struct exec_instruction_desc exec_instructions[] __exec_table_align = {
 
 static exec_func_t
 fetch_multibyte_opcode(const uint8_t **pp, struct exec_context *ctx,
-                       const struct exec_instruction_desc *table)
+                       const struct exec_instruction_desc *table,
+                       uint32_t flatbase)
 {
 #if !(defined(TOYWASM_USE_SEPARATE_EXECUTE) && defined(TOYWASM_USE_TAILCALL))
         assert(ctx->p + 1 == *pp);
@@ -861,6 +1356,8 @@ fetch_multibyte_opcode(const uint8_t **pp, struct exec_context *ctx,
 #endif
         uint32_t op = read_leb_u32_nocheck(pp);
         const struct exec_instruction_desc *desc = &table[op];
+        /* the prefix has been counted by fetch_exec_next_insn */
+        STAT_INSN_OPCODE(ctx, flatbase + op);
         xlog_trace_insn("exec %06" PRIx32 ": %s (2nd byte %02" PRIx32 ")", pc,
                         instruction_name(table, op), op);
         return desc->fetch_exec;
@@ -873,8 +1370,8 @@ fetch_exec_next_insn_fc(const uint8_t *p, struct cell *stack,
 #if defined(TOYWASM_USE_TAILCALL)
         __musttail
 #endif
-                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fc)(
-                        p, stack, ctx);
+                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fc,
+                                              PREDECODED_OP_FC)(p, stack, ctx);
 }
 
 #if defined(TOYWASM_ENABLE_WASM_SIMD)
@@ -885,8 +1382,8 @@ fetch_exec_next_insn_fd(const uint8_t *p, struct cell *stack,
 #if defined(TOYWASM_USE_TAILCALL)
         __musttail
 #endif
-                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fd)(
-                        p, stack, ctx);
+                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fd,
+                                              PREDECODED_OP_FD)(p, stack, ctx);
 }
 #endif /* defined(TOYWASM_ENABLE_WASM_SIMD) */
 
@@ -903,11 +1400,170 @@ fetch_exec_next_insn_fe(const uint8_t *p, struct cell *stack,
 #if defined(TOYWASM_USE_TAILCALL)
         __musttail
 #endif
-                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fe)(
-                        p, stack, ctx);
+                return fetch_multibyte_opcode(&p, ctx, exec_instructions_fe,
+                                              PREDECODED_OP_FE)(p, stack, ctx);
 }
 #endif /* defined(TOYWASM_ENABLE_WASM_THREADS) */
 
+#if defined(TOYWASM_USE_PREDECODE)
+/*
+ * dispatch tables for the pre-decoded code.
+ * unlike the above tables, these use the flat opcode space.
+ * (PREDECODED_OP_xxx)
+ */
+
+#define INSTRUCTION(b, n, f, FLAGS)                                           \
+        [PREDECODED_OP_BASE + (b)] = {                                        \
+                .fetch_exec = fetch_exec_pd_##f,                              \
+        },
+
+#define INSTRUCTION_INDIRECT(b, n)
+
+static const struct exec_instruction_desc
+        exec_instructions_predecoded[PREDECODED_NOPS] __exec_table_align = {
+#define PREDECODED_OP_BASE 0
+#include "insn_list_base.h"
+#if defined(TOYWASM_ENABLE_WASM_TAILCALL)
+#include "insn_list_tailcall.h"
+#endif /* defined(TOYWASM_ENABLE_WASM_TAILCALL) */
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#include "insn_list_eh.h"
+#endif /* defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) */
+#undef PREDECODED_OP_BASE
+#define PREDECODED_OP_BASE PREDECODED_OP_FC
+#include "insn_list_fc.h"
+#undef PREDECODED_OP_BASE
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+#define PREDECODED_OP_BASE PREDECODED_OP_FD
+#include "insn_list_simd.h"
+#undef PREDECODED_OP_BASE
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#define PREDECODED_OP_BASE PREDECODED_OP_FE
+#include "insn_list_threads.h"
+#undef PREDECODED_OP_BASE
+#endif
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+#define PREDECODED_OP_BASE PREDECODED_OP_FUSED
+#include "insn_list_fused.h"
+#undef PREDECODED_OP_BASE
+#define REG_INSTRUCTION(idx, op, n, f, BITS)                                  \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR)] =                    \
+                {.fetch_exec = fetch_exec_pd_##f##_rr},                       \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI)] =                    \
+                {.fetch_exec = fetch_exec_pd_##f##_ri},                       \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR_R)] =                  \
+                {.fetch_exec = fetch_exec_pd_##f##_rr_r},                     \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI_R)] =                  \
+                {.fetch_exec = fetch_exec_pd_##f##_ri_r},
+#include "insn_list_reg.h"
+#undef REG_INSTRUCTION
+#endif
+};
+
+#undef INSTRUCTION
+
+#define INSTRUCTION(b, n, f, FLAGS)                                           \
+        [PREDECODED_OP_BASE + (b)] = {                                        \
+                .predecode = predecode_##f,                                   \
+        },
+
+const struct predecode_instruction_desc
+        predecode_instructions[PREDECODED_NOPS] = {
+#define PREDECODED_OP_BASE 0
+#include "insn_list_base.h"
+#if defined(TOYWASM_ENABLE_WASM_TAILCALL)
+#include "insn_list_tailcall.h"
+#endif /* defined(TOYWASM_ENABLE_WASM_TAILCALL) */
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+#include "insn_list_eh.h"
+#endif /* defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING) */
+#undef PREDECODED_OP_BASE
+#define PREDECODED_OP_BASE PREDECODED_OP_FC
+#include "insn_list_fc.h"
+#undef PREDECODED_OP_BASE
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+#define PREDECODED_OP_BASE PREDECODED_OP_FD
+#include "insn_list_simd.h"
+#undef PREDECODED_OP_BASE
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#define PREDECODED_OP_BASE PREDECODED_OP_FE
+#include "insn_list_threads.h"
+#undef PREDECODED_OP_BASE
+#endif
+};
+
+#undef INSTRUCTION
+#undef INSTRUCTION_INDIRECT
+
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS) &&                                 \
+        (defined(TOYWASM_ENABLE_TRACING_INSN) ||                              \
+         defined(TOYWASM_ENABLE_INSN_STATS))
+#define INSTRUCTION(b, n, f, FLAGS) [b] = n,
+static const char *const fused_instruction_names[] = {
+#include "insn_list_fused.h"
+};
+#undef INSTRUCTION
+#define REG_INSTRUCTION(idx, op, n, f, BITS)                                  \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR) - PREDECODED_OP_REG] = \
+                n " (rr)",                                                    \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI) - PREDECODED_OP_REG] = \
+                n " (ri)",                                                    \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR_R) -                   \
+         PREDECODED_OP_REG] = n " (rr_r)",                                    \
+        [PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI_R) -                   \
+         PREDECODED_OP_REG] = n " (ri_r)",
+static const char *const reg_instruction_names[] = {
+#include "insn_list_reg.h"
+};
+#undef REG_INSTRUCTION
+#endif
+
+ctassert(ARRAYCOUNT(exec_instructions_fc) <=
+         PREDECODED_OP_FD - PREDECODED_OP_FC);
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+ctassert(ARRAYCOUNT(exec_instructions_fd) <=
+         PREDECODED_OP_FE - PREDECODED_OP_FD);
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+ctassert(ARRAYCOUNT(exec_instructions_fe) <=
+         PREDECODED_OP_FUSED - PREDECODED_OP_FE);
+#else
+ctassert(ARRAYCOUNT(exec_instructions_fe) <=
+         PREDECODED_NOPS - PREDECODED_OP_FE);
+#endif
+#endif
+
+int
+fetch_exec_next_insn_predecoded(const uint8_t *p, struct cell *stack,
+                                struct exec_context *ctx)
+{
+#if !(defined(TOYWASM_USE_SEPARATE_EXECUTE) && defined(TOYWASM_USE_TAILCALL))
+        assert(ctx->p == p);
+#endif
+        assert(ctx->event == EXEC_EVENT_NONE);
+        assert(ctx->frames.lsize > 0);
+        assert(ctx->ei->predecoded != NULL);
+#if defined(TOYWASM_ENABLE_TRACING_INSN)
+        uint32_t pc = ptr2pc(ctx->instance->module, p);
+#endif
+        uint32_t op = predecoded_read_u32(&p);
+        assert(op < PREDECODED_NOPS);
+        STAT_INSN(ctx, op);
+        xlog_trace_insn("exec %06" PRIx32 ": %s (pre-decoded %03" PRIx32 ")",
+                        pc, predecoded_instruction_name(op), op);
+        const struct exec_instruction_desc *desc =
+                &exec_instructions_predecoded[op];
+        assert(desc->fetch_exec != NULL);
+#if defined(TOYWASM_USE_TAILCALL)
+        __musttail
+#endif
+                return desc->fetch_exec(p, stack, ctx);
+}
+#endif /* defined(TOYWASM_USE_PREDECODE) */
+
 #endif /* defined(TOYWASM_USE_SEPARATE_EXECUTE) */
 
 #if defined(TOYWASM_USE_SEPARATE_VALIDATE)
@@ -994,3 +1650,168 @@ instruction_name(const struct exec_instruction_desc *exec_table, uint32_t op)
 }
 #endif /* defined(TOYWASM_USE_SEPARATE_EXECUTE) &&                            \
           defined(TOYWASM_ENABLE_TRACING_INSN) */
+
+#if (defined(TOYWASM_USE_PREDECODE) &&                                        \
+     defined(TOYWASM_ENABLE_TRACING_INSN)) ||                                 \
+        defined(TOYWASM_ENABLE_INSN_STATS)
+/*
+ * the name of an instruction in the flat opcode space.
+ * (PREDECODED_OP_xxx)
+ */
+const char *
+predecoded_instruction_name(uint32_t op)
+{
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+        if (op >= PREDECODED_OP_REG) {
+                op -= PREDECODED_OP_REG;
+                if (op < ARRAYCOUNT(reg_instruction_names)) {
+                        return reg_instruction_names[op];
+                }
+                return "unknown";
+        }
+        if (op >= PREDECODED_OP_FUSED) {
+                op -= PREDECODED_OP_FUSED;
+                if (op < ARRAYCOUNT(fused_instruction_names)) {
+                        return fused_instruction_names[op];
+                }
+                return "unknown";
+        }
+#endif /* defined(TOYWASM_USE_SUPERINSTRUCTIONS) */
+        if (op < PREDECODED_OP_FC) {
+                return instructions[op].name;
+        }
+        if (op < PREDECODED_OP_FD) {
+                return instructions_fc[op - PREDECODED_OP_FC].name;
+        }
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+        if (op < PREDECODED_OP_FE) {
+                return instructions_fd[op - PREDECODED_OP_FD].name;
+        }
+#endif /* defined(TOYWASM_ENABLE_WASM_SIMD) */
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+        if (op >= PREDECODED_OP_FE) {
+                return instructions_fe[op - PREDECODED_OP_FE].name;
+        }
+#endif /* defined(TOYWASM_ENABLE_WASM_THREADS) */
+        return "unknown";
+}
+#endif /* (defined(TOYWASM_USE_PREDECODE) &&                                  \
+           defined(TOYWASM_ENABLE_TRACING_INSN)) ||                           \
+          defined(TOYWASM_ENABLE_INSN_STATS) */
+
+#if defined(TOYWASM_ENABLE_JIT)
+/*
+ * out-of-line implementations of the instructions which the jit compiler
+ * doesn't generate inline code for. (see jit_x86_64.c)
+ *
+ * they take the operands from the operand stack cells and store
+ * the result into the first cell.
+ */
+
+#define ECTX ctx
+
+#define JIT_UNOP(NAME, T, OP)                                                 \
+        int jit_insn_##NAME(struct exec_context *ctx __unused,                \
+                            struct cell *cells)                               \
+        {                                                                     \
+                struct val val_a;                                             \
+                struct val val_c;                                             \
+                memcpy(&val_a.u.T, cells, sizeof(val_a.u.T));                 \
+                val_c.u.T = OP(val_a.u.T);                                    \
+                memcpy(cells, &val_c.u.T, sizeof(val_c.u.T));                 \
+                return 0;                                                     \
+        }
+
+#define JIT_BINOP(NAME, T, OP)                                                \
+        int jit_insn_##NAME(struct exec_context *ctx __unused,                \
+                            struct cell *cells)                               \
+        {                                                                     \
+                struct val val_a;                                             \
+                struct val val_b;                                             \
+                struct val val_c;                                             \
+                memcpy(&val_a.u.T, cells, sizeof(val_a.u.T));                 \
+                memcpy(&val_b.u.T, cells + valtype_cellsize(TYPE_##T),        \
+                       sizeof(val_b.u.T));                                    \
+                val_c.u.T = OP(0, val_a.u.T, val_b.u.T);                      \
+                memcpy(cells, &val_c.u.T, sizeof(val_c.u.T));                 \
+                return 0;                                                     \
+        }
+
+#define JIT_CVTOP(NAME, T1, T2, OPE)                                          \
+        int jit_insn_##NAME(struct exec_context *ctx, struct cell *cells)     \
+        {                                                                     \
+                struct val val_a;                                             \
+                struct val val_b;                                             \
+                int ret;                                                      \
+                memcpy(&val_a.u.T1, cells, sizeof(val_a.u.T1));               \
+                OPE(val_b.u.T2, val_a.u.T1);                                  \
+                memcpy(cells, &val_b.u.T2, sizeof(val_b.u.T2));               \
+                return 0;                                                     \
+fail:                                                                         \
+                return ret;                                                   \
+        }
+
+#define JIT_CVTOP_NOTRAP(NAME, T1, T2, OPE)                                   \
+        int jit_insn_##NAME(struct exec_context *ctx __unused,                \
+                            struct cell *cells)                               \
+        {                                                                     \
+                struct val val_a;                                             \
+                struct val val_b;                                             \
+                memcpy(&val_a.u.T1, cells, sizeof(val_a.u.T1));               \
+                OPE(val_b.u.T2, val_a.u.T1);                                  \
+                memcpy(cells, &val_b.u.T2, sizeof(val_b.u.T2));               \
+                return 0;                                                     \
+        }
+
+#define JIT_EXTENDOP(NAME, T1, T2, CCAST)                                     \
+        int jit_insn_##NAME(struct exec_context *ctx __unused,                \
+                            struct cell *cells)                               \
+        {                                                                     \
+                struct val val_a;                                             \
+                struct val val_b;                                             \
+                memcpy(&val_a.u.T1, cells, sizeof(val_a.u.T1));               \
+                val_b.u.T2 = CCAST val_a.u.T1;                                \
+                memcpy(cells, &val_b.u.T2, sizeof(val_b.u.T2));               \
+                return 0;                                                     \
+        }
+
+JIT_UNOP(i32_popcnt, i32, wasm_popcount)
+JIT_UNOP(i64_popcnt, i64, wasm_popcount64)
+
+JIT_UNOP(f32_ceil, f32, ceilf)
+JIT_UNOP(f32_floor, f32, floorf)
+JIT_UNOP(f32_trunc, f32, truncf)
+JIT_UNOP(f32_nearest, f32, rintf)
+JIT_BINOP(f32_min, f32, FMIN32)
+JIT_BINOP(f32_max, f32, FMAX32)
+
+JIT_UNOP(f64_ceil, f64, ceil)
+JIT_UNOP(f64_floor, f64, floor)
+JIT_UNOP(f64_trunc, f64, trunc)
+JIT_UNOP(f64_nearest, f64, rint)
+JIT_BINOP(f64_min, f64, FMIN64)
+JIT_BINOP(f64_max, f64, FMAX64)
+
+JIT_CVTOP(i32_trunc_f32_s, f32, i32, TRUNC_S_32_32)
+JIT_CVTOP(i32_trunc_f32_u, f32, i32, TRUNC_U_32_32)
+JIT_CVTOP(i32_trunc_f64_s, f64, i32, TRUNC_S_64_32)
+JIT_CVTOP(i32_trunc_f64_u, f64, i32, TRUNC_U_64_32)
+JIT_CVTOP(i64_trunc_f32_s, f32, i64, TRUNC_S_32_64)
+JIT_CVTOP(i64_trunc_f32_u, f32, i64, TRUNC_U_32_64)
+JIT_CVTOP(i64_trunc_f64_s, f64, i64, TRUNC_S_64_64)
+JIT_CVTOP(i64_trunc_f64_u, f64, i64, TRUNC_U_64_64)
+
+JIT_EXTENDOP(f32_convert_i64_u, i64, f32, (float)(uint64_t))
+JIT_EXTENDOP(f64_convert_i64_u, i64, f64, (double)(uint64_t))
+
+JIT_CVTOP_NOTRAP(i32_trunc_sat_f32_s, f32, i32, TRUNC_SAT_S_32_32)
+JIT_CVTOP_NOTRAP(i32_trunc_sat_f32_u, f32, i32, TRUNC_SAT_U_32_32)
+JIT_CVTOP_NOTRAP(i32_trunc_sat_f64_s, f64, i32, TRUNC_SAT_S_64_32)
+JIT_CVTOP_NOTRAP(i32_trunc_sat_f64_u, f64, i32, TRUNC_SAT_U_64_32)
+JIT_CVTOP_NOTRAP(i64_trunc_sat_f32_s, f32, i64, TRUNC_SAT_S_32_64)
+JIT_CVTOP_NOTRAP(i64_trunc_sat_f32_u, f32, i64, TRUNC_SAT_U_32_64)
+JIT_CVTOP_NOTRAP(i64_trunc_sat_f64_s, f64, i64, TRUNC_SAT_S_64_64)
+JIT_CVTOP_NOTRAP(i64_trunc_sat_f64_u, f64, i64, TRUNC_SAT_U_64_64)
+
+#undef ECTX
+#endif /* defined(TOYWASM_ENABLE_JIT) */
@@ -1,3 +1,6 @@
+#if !defined(_TOYWASM_INSN_H)
+#define _TOYWASM_INSN_H
+
 #include <stddef.h>
 #include <stdint.h>
 
@@ -41,5 +44,61 @@ struct instruction_desc {
 
 extern const struct exec_instruction_desc exec_instructions[];
 
+/*
+ * the flat opcode space used by the pre-decoded code and
+ * exec_stat::insn.
+ * multibyte opcodes are mapped to the base + the second part of
+ * the opcode.
+ */
+#define PREDECODED_OP_FC 0x100
+#define PREDECODED_OP_FD 0x120
+#define PREDECODED_OP_FE 0x240
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+/*
+ * superinstructions, which only appear in the pre-decoded code.
+ * see insn_list_fused.h.
+ */
+#define PREDECODED_OP_FUSED 0x2a0
+/*
+ * register-operand forms of binary instructions.
+ * see insn_list_reg.h.
+ */
+#define PREDECODED_OP_REG 0x2b0
+#define PREDECODED_REG_FORM_RR 0   /* push (local OP local) */
+#define PREDECODED_REG_FORM_RI 1   /* push (local OP imm) */
+#define PREDECODED_REG_FORM_RR_R 2 /* local = local OP local */
+#define PREDECODED_REG_FORM_RI_R 3 /* local = local OP imm */
+#define PREDECODED_REG_NFORMS 4
+#define PREDECODED_REG_OP(idx, form)                                          \
+        (PREDECODED_OP_REG + (idx) * PREDECODED_REG_NFORMS + (form))
+#define PREDECODED_NOPS 0x348
+#else
+#define PREDECODED_NOPS 0x2a0
+#endif
+
+#if defined(TOYWASM_USE_PREDECODE)
+struct predecode_context;
+
+struct predecode_instruction_desc {
+        /*
+         * predecode is called after fetching the opcode.
+         * it parses the immediates of the instruction and emits
+         * their pre-decoded form. see predecode.c.
+         */
+        int (*predecode)(const uint8_t **pp, const uint8_t *ep,
+                         struct predecode_context *ctx);
+};
+
+extern const struct predecode_instruction_desc predecode_instructions[];
+#endif
+
 extern const struct instruction_desc instructions[];
 extern const size_t instructions_size;
+
+#if (defined(TOYWASM_USE_PREDECODE) &&                                        \
+     defined(TOYWASM_ENABLE_TRACING_INSN)) ||                                 \
+        defined(TOYWASM_ENABLE_INSN_STATS)
+const char *predecoded_instruction_name(uint32_t op);
+#endif
+
+#endif /* !defined(_TOYWASM_INSN_H) */
@@ -495,7 +495,8 @@ INSN_IMPL(call_indirect)
 #if defined(__GNUC__) && !defined(__clang__)
                 func = NULL;
 #endif
-                ret = get_func_indirect(ectx, tableidx, typeidx, i, &func);
+                ret = get_func_indirect(ectx, ORIG_PC, tableidx, typeidx, i,
+                                        &func);
                 if (__predict_false(ret != 0)) {
                         goto fail;
                 }
@@ -199,14 +199,14 @@ INSN_IMPL(table_copy)
                 if (ret != 0) {
                         goto fail;
                 }
-                const struct tableinst *t_dst =
-                        VEC_ELEM(inst->tables, tableidx_dst);
+                struct tableinst *t_dst = VEC_ELEM(inst->tables, tableidx_dst);
                 const struct tableinst *t_src =
                         VEC_ELEM(inst->tables, tableidx_src);
                 assert(t_src->type->et == t_dst->type->et);
                 uint32_t csz = valtype_cellsize(t_src->type->et);
                 cells_move(&t_dst->cells[d * csz], &t_src->cells[s * csz],
                            n * csz);
+                table_modified(t_dst);
         }
         SAVE_PC;
         INSN_SUCCESS;
@@ -285,6 +285,7 @@ INSN_IMPL(table_fill)
                 for (i = start; i < end; i++) {
                         val_to_cells(&val_val, &t->cells[i * csz], csz);
                 }
+                table_modified(t);
         }
         SAVE_PC;
         INSN_SUCCESS;
@@ -0,0 +1,85 @@
+/*
+ * superinstructions. see insn_list_fused.h.
+ *
+ * unlike other insn_impl_*.h files, these are only expanded for
+ * the execution of the pre-decoded code.
+ */
+
+INSN_IMPL(local_get2)
+{
+        int ret;
+
+        LOAD_PC;
+        READ_LEB_U32(localidx1);
+        READ_LEB_U32(localidx2);
+        struct exec_context *ectx = ECTX;
+        uint32_t csz;
+        local_get(ectx, localidx1, STACK, &csz);
+        STACK_ADJ(csz);
+        local_get(ectx, localidx2, STACK, &csz);
+        STACK_ADJ(csz);
+        STAT_INC(ectx, fused_insn);
+        SAVE_PC;
+        INSN_SUCCESS;
+fail:
+        INSN_FAIL;
+}
+
+INSN_IMPL(local_get_i32_const)
+{
+        int ret;
+
+        LOAD_PC;
+        READ_LEB_U32(localidx);
+        READ_LEB_I32(v);
+        struct exec_context *ectx = ECTX;
+        uint32_t csz;
+        local_get(ectx, localidx, STACK, &csz);
+        STACK_ADJ(csz);
+        struct val val_c;
+        val_c.u.i32 = v;
+        PUSH_VAL(TYPE_i32, c);
+        STAT_INC(ectx, fused_insn);
+        SAVE_PC;
+        INSN_SUCCESS;
+fail:
+        INSN_FAIL;
+}
+
+INSN_IMPL(local_get_i64_const)
+{
+        int ret;
+
+        LOAD_PC;
+        READ_LEB_U32(localidx);
+        READ_LEB_I64(v);
+        struct exec_context *ectx = ECTX;
+        uint32_t csz;
+        local_get(ectx, localidx, STACK, &csz);
+        STACK_ADJ(csz);
+        struct val val_c;
+        val_c.u.i64 = v;
+        PUSH_VAL(TYPE_i64, c);
+        STAT_INC(ectx, fused_insn);
+        SAVE_PC;
+        INSN_SUCCESS;
+fail:
+        INSN_FAIL;
+}
+
+INSN_IMPL(i32_const_add)
+{
+        int ret;
+
+        LOAD_PC;
+        READ_LEB_I32(v);
+        POP_VAL(TYPE_i32, a);
+        struct val val_c;
+        val_c.u.i32 = val_a.u.i32 + v;
+        PUSH_VAL(TYPE_i32, c);
+        STAT_INC(ECTX, fused_insn);
+        SAVE_PC;
+        INSN_SUCCESS;
+fail:
+        INSN_FAIL;
+}
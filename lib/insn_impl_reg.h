@@ -0,0 +1,126 @@
+/*
+ * register-operand forms of binary instructions.
+ * see insn_list_reg.h.
+ *
+ * the pre-decoder produces them from sequences like
+ * "local.get; local.get; i32.add; local.set". their operands
+ * directly address the cells of the function locals.
+ * the cell indexes are resolved by the pre-decoder.
+ *
+ *   NAME_rr:   push (local OP local)
+ *   NAME_ri:   push (local OP imm)
+ *   NAME_rr_r: local = local OP local
+ *   NAME_ri_r: local = local OP imm
+ *
+ * like insn_impl_fused.h, these are only expanded for the execution
+ * of the pre-decoded code.
+ */
+
+#define REG_READ_R(VAR, BITS)                                                 \
+        READ_LEB_U32(VAR##_cidx);                                             \
+        const uint##BITS##_t VAR = frame_cell_get_i##BITS(ECTX, VAR##_cidx)
+
+#define REG_READ_I(VAR, BITS) READ_LEB_I##BITS(VAR)
+
+#define REG_OP_FORM(NAME, SUFFIX, BITS, RBITS, EXPR, READ_B, TO_LOCAL)        \
+        INSN_IMPL(NAME##_##SUFFIX)                                            \
+        {                                                                     \
+                int ret;                                                      \
+                LOAD_PC;                                                      \
+                REG_READ_R(a, BITS);                                          \
+                READ_B(b, BITS);                                              \
+                const uint##RBITS##_t r = EXPR(BITS, a, b);                   \
+                if (TO_LOCAL) {                                               \
+                        READ_LEB_U32(c_cidx);                                 \
+                        frame_cell_set_i##RBITS(ECTX, c_cidx, r);             \
+                } else {                                                      \
+                        struct val val_c;                                     \
+                        val_c.u.i##RBITS = r;                                 \
+                        PUSH_VAL(TYPE_i##RBITS, c);                           \
+                }                                                             \
+                STAT_INC(ECTX, fused_insn);                                   \
+                SAVE_PC;                                                      \
+                INSN_SUCCESS;                                                 \
+fail:                                                                         \
+                INSN_FAIL;                                                    \
+        }
+
+#define REG_OP(NAME, BITS, RBITS, EXPR)                                       \
+        REG_OP_FORM(NAME, rr, BITS, RBITS, EXPR, REG_READ_R, false)           \
+        REG_OP_FORM(NAME, ri, BITS, RBITS, EXPR, REG_READ_I, false)           \
+        REG_OP_FORM(NAME, rr_r, BITS, RBITS, EXPR, REG_READ_R, true)          \
+        REG_OP_FORM(NAME, ri_r, BITS, RBITS, EXPR, REG_READ_I, true)
+
+#define REG_BINOP(NAME, BITS, OP) REG_OP(NAME, BITS, BITS, OP)
+
+#define REG_CMP_EQ(N, a, b) ((a) == (b))
+#define REG_CMP_NE(N, a, b) ((a) != (b))
+#define REG_CMP_LT_S(N, a, b) ((int##N##_t)(a) < (int##N##_t)(b))
+#define REG_CMP_LT_U(N, a, b) ((a) < (b))
+#define REG_CMP_GT_S(N, a, b) ((int##N##_t)(a) > (int##N##_t)(b))
+#define REG_CMP_GT_U(N, a, b) ((a) > (b))
+#define REG_CMP_LE_S(N, a, b) ((int##N##_t)(a) <= (int##N##_t)(b))
+#define REG_CMP_LE_U(N, a, b) ((a) <= (b))
+#define REG_CMP_GE_S(N, a, b) ((int##N##_t)(a) >= (int##N##_t)(b))
+#define REG_CMP_GE_U(N, a, b) ((a) >= (b))
+
+#define REG_CMPOP(NAME, BITS, CMP) REG_OP(NAME, BITS, 32, CMP)
+
+REG_CMPOP(i32_eq, 32, REG_CMP_EQ)
+REG_CMPOP(i32_ne, 32, REG_CMP_NE)
+REG_CMPOP(i32_lt_s, 32, REG_CMP_LT_S)
+REG_CMPOP(i32_lt_u, 32, REG_CMP_LT_U)
+REG_CMPOP(i32_gt_s, 32, REG_CMP_GT_S)
+REG_CMPOP(i32_gt_u, 32, REG_CMP_GT_U)
+REG_CMPOP(i32_le_s, 32, REG_CMP_LE_S)
+REG_CMPOP(i32_le_u, 32, REG_CMP_LE_U)
+REG_CMPOP(i32_ge_s, 32, REG_CMP_GE_S)
+REG_CMPOP(i32_ge_u, 32, REG_CMP_GE_U)
+
+REG_CMPOP(i64_eq, 64, REG_CMP_EQ)
+REG_CMPOP(i64_ne, 64, REG_CMP_NE)
+REG_CMPOP(i64_lt_s, 64, REG_CMP_LT_S)
+REG_CMPOP(i64_lt_u, 64, REG_CMP_LT_U)
+REG_CMPOP(i64_gt_s, 64, REG_CMP_GT_S)
+REG_CMPOP(i64_gt_u, 64, REG_CMP_GT_U)
+REG_CMPOP(i64_le_s, 64, REG_CMP_LE_S)
+REG_CMPOP(i64_le_u, 64, REG_CMP_LE_U)
+REG_CMPOP(i64_ge_s, 64, REG_CMP_GE_S)
+REG_CMPOP(i64_ge_u, 64, REG_CMP_GE_U)
+
+REG_BINOP(i32_add, 32, ADD)
+REG_BINOP(i32_sub, 32, SUB)
+REG_BINOP(i32_mul, 32, MUL)
+REG_BINOP(i32_and, 32, AND)
+REG_BINOP(i32_or, 32, OR)
+REG_BINOP(i32_xor, 32, XOR)
+REG_BINOP(i32_shl, 32, SHL)
+REG_BINOP(i32_shr_s, 32, SHR_S)
+REG_BINOP(i32_shr_u, 32, SHR_U)
+
+REG_BINOP(i64_add, 64, ADD)
+REG_BINOP(i64_sub, 64, SUB)
+REG_BINOP(i64_mul, 64, MUL)
+REG_BINOP(i64_and, 64, AND)
+REG_BINOP(i64_or, 64, OR)
+REG_BINOP(i64_xor, 64, XOR)
+REG_BINOP(i64_shl, 64, SHL)
+REG_BINOP(i64_shr_s, 64, SHR_S)
+REG_BINOP(i64_shr_u, 64, SHR_U)
+
+#undef REG_READ_R
+#undef REG_READ_I
+#undef REG_OP_FORM
+#undef REG_OP
+#undef REG_BINOP
+#undef REG_CMP_EQ
+#undef REG_CMP_NE
+#undef REG_CMP_LT_S
+#undef REG_CMP_LT_U
+#undef REG_CMP_GT_S
+#undef REG_CMP_GT_U
+#undef REG_CMP_LE_S
+#undef REG_CMP_LE_U
+#undef REG_CMP_GE_S
+#undef REG_CMP_GE_U
+#undef REG_CMPOP
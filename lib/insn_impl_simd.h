@@ -5,13 +5,33 @@
  *
  * this is a dumb pure C implementation, mainly for portability reasons.
  *
- * if performance matters, it's probably better to use vector instrinsics
- * available on host:
- * https://gcc.gnu.org/onlinedocs/gcc/Vector-Extensions.html
- * https://clang.llvm.org/docs/LanguageExtensions.html#vectors-and-extended-vectors
- * https://github.com/simd-everywhere/simde
+ * with TOYWASM_USE_HOST_SIMD, most of the operations are replaced with
+ * the implementations in simd_host.h, which use the vector extensions
+ * and intrinsics available on host. the ops here are the fallback.
  */
 
+/*
+ * SIMD_HOST(OP) is the OP argument for SIMD_OPn etc.
+ * it's HOST_OP from simd_host.h if TOYWASM_USE_HOST_SIMD, otherwise OP.
+ *
+ * SIMD_HOST_LANES_OPn is SIMD_FOREACH_LANES_OPn with the same selection.
+ * the host version of the per-lane OP is HOST_OP_<I_OR_F><LS>.
+ * eg. HOST_LT_S_i32 for LT_S on i32x4.
+ */
+#if defined(TOYWASM_USE_HOST_SIMD)
+#define SIMD_HOST(OP) HOST_##OP
+#define SIMD_HOST_LANES_OP1(NAME, I_OR_F, LS, OP)                             \
+        SIMD_OP1(NAME, HOST_##OP##_##I_OR_F##LS)
+#define SIMD_HOST_LANES_OP2(NAME, I_OR_F, LS, OP)                             \
+        SIMD_OP2(NAME, HOST_##OP##_##I_OR_F##LS)
+#else
+#define SIMD_HOST(OP) OP
+#define SIMD_HOST_LANES_OP1(NAME, I_OR_F, LS, OP)                             \
+        SIMD_FOREACH_LANES_OP1(NAME, I_OR_F, LS, OP)
+#define SIMD_HOST_LANES_OP2(NAME, I_OR_F, LS, OP)                             \
+        SIMD_FOREACH_LANES_OP2(NAME, I_OR_F, LS, OP)
+#endif
+
 #define READ_LANEIDX(VAR, N)                                                  \
         READ_U8(VAR);                                                         \
         CHECK(VAR < N)
@@ -89,8 +109,9 @@
                 POP_VAL(TYPE_i32, i);                                         \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
-                                            memarg.offset, MEM / 8, &datap);  \
+                        ret = memory_access_getptr(                           \
+                                ECTX, memarg.memidx, val_i.u.i32,             \
+                                memarg.offset, MEM / 8, &datap, p);           \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
@@ -121,8 +142,9 @@ fail:                                                                         \
                 POP_VAL(TYPE_i32, i);                                         \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
-                                            memarg.offset, MEM / 8, &datap);  \
+                        ret = memory_access_getptr(                           \
+                                ECTX, memarg.memidx, val_i.u.i32,             \
+                                memarg.offset, MEM / 8, &datap, p);           \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
@@ -185,7 +207,7 @@ fail:                                                                         \
                 if (EXECUTING) {                                              \
                         uint##LS##_t le;                                      \
                         le##LS##_encode(&le, (uint##LS##_t)val_x.u.i##STACK); \
-                        FOREACH_LANES(LS, &val_v.u.v128, &le, SPLAT1);        \
+                        SIMD_HOST(SPLAT_##LS)(&val_v.u.v128, &le);            \
                 }                                                             \
                 PUSH_VAL(TYPE_v128, v);                                       \
                 SAVE_PC;                                                      \
@@ -202,8 +224,7 @@ fail:                                                                         \
                 if (VALIDATING) {                                             \
                         CHECK((const uint8_t *)ep - p >= 16);                 \
                 }                                                             \
-                const uint8_t *immp = p;                                      \
-                p += 16;                                                      \
+                const uint8_t *immp = read_v128_nocheck(&p);                  \
                 struct val val_v;                                             \
                 if (EXECUTING) {                                              \
                         COPYBITS128(&val_v.u.v128, immp);                     \
@@ -471,10 +492,10 @@ SIMD_LOADOP(v128_load16x4_s, 64, v128, EXTEND_16x4_s)
 SIMD_LOADOP(v128_load16x4_u, 64, v128, EXTEND_16x4_u)
 SIMD_LOADOP(v128_load32x2_s, 64, v128, EXTEND_32x2_s)
 SIMD_LOADOP(v128_load32x2_u, 64, v128, EXTEND_32x2_u)
-SIMD_LOADOP(v128_load8_splat, 8, v128, SPLAT_8)
-SIMD_LOADOP(v128_load16_splat, 16, v128, SPLAT_16)
-SIMD_LOADOP(v128_load32_splat, 32, v128, SPLAT_32)
-SIMD_LOADOP(v128_load64_splat, 64, v128, SPLAT_64)
+SIMD_LOADOP(v128_load8_splat, 8, v128, SIMD_HOST(SPLAT_8))
+SIMD_LOADOP(v128_load16_splat, 16, v128, SIMD_HOST(SPLAT_16))
+SIMD_LOADOP(v128_load32_splat, 32, v128, SIMD_HOST(SPLAT_32))
+SIMD_LOADOP(v128_load64_splat, 64, v128, SIMD_HOST(SPLAT_64))
 
 #define ZERO32(D, S)                                                          \
         memcpy(&(D)->i32[0], (S), 4);                                         \
@@ -551,21 +572,21 @@ SIMD_SPLATOP(f64x2_splat, f, 64, 64)
 #define SHR_u_32(a, b, c) FOREACH_LANES3(32, a, b, c, SHR_u1)
 #define SHR_u_64(a, b, c) FOREACH_LANES3(64, a, b, c, SHR_u1)
 
-SIMD_SHIFTOP(i8x16_shl, SHL_8)
-SIMD_SHIFTOP(i8x16_shr_s, SHR_s_8)
-SIMD_SHIFTOP(i8x16_shr_u, SHR_u_8)
+SIMD_SHIFTOP(i8x16_shl, SIMD_HOST(SHL_8))
+SIMD_SHIFTOP(i8x16_shr_s, SIMD_HOST(SHR_s_8))
+SIMD_SHIFTOP(i8x16_shr_u, SIMD_HOST(SHR_u_8))
 
-SIMD_SHIFTOP(i16x8_shl, SHL_16)
-SIMD_SHIFTOP(i16x8_shr_s, SHR_s_16)
-SIMD_SHIFTOP(i16x8_shr_u, SHR_u_16)
+SIMD_SHIFTOP(i16x8_shl, SIMD_HOST(SHL_16))
+SIMD_SHIFTOP(i16x8_shr_s, SIMD_HOST(SHR_s_16))
+SIMD_SHIFTOP(i16x8_shr_u, SIMD_HOST(SHR_u_16))
 
-SIMD_SHIFTOP(i32x4_shl, SHL_32)
-SIMD_SHIFTOP(i32x4_shr_s, SHR_s_32)
-SIMD_SHIFTOP(i32x4_shr_u, SHR_u_32)
+SIMD_SHIFTOP(i32x4_shl, SIMD_HOST(SHL_32))
+SIMD_SHIFTOP(i32x4_shr_s, SIMD_HOST(SHR_s_32))
+SIMD_SHIFTOP(i32x4_shr_u, SIMD_HOST(SHR_u_32))
 
-SIMD_SHIFTOP(i64x2_shl, SHL_64)
-SIMD_SHIFTOP(i64x2_shr_s, SHR_s_64)
-SIMD_SHIFTOP(i64x2_shr_u, SHR_u_64)
+SIMD_SHIFTOP(i64x2_shl, SIMD_HOST(SHL_64))
+SIMD_SHIFTOP(i64x2_shr_s, SIMD_HOST(SHR_s_64))
+SIMD_SHIFTOP(i64x2_shr_u, SIMD_HOST(SHR_u_64))
 
 #define V128_OP1(a, b, OP)                                                    \
         do {                                                                  \
@@ -599,12 +620,12 @@ SIMD_SHIFTOP(i64x2_shr_u, SHR_u_64)
 #define V128_ANDNOT(a, b, c) V128_OP2(a, b, c, ANDNOT)
 #define V128_BITSELECT(a, b, c, d) V128_OP3(a, b, c, d, BITSELECT)
 
-SIMD_OP1(v128_not, V128_NOT)
-SIMD_OP2(v128_and, V128_AND)
-SIMD_OP2(v128_or, V128_OR)
-SIMD_OP2(v128_xor, V128_XOR)
-SIMD_OP2(v128_andnot, V128_ANDNOT)
-SIMD_OP3(v128_bitselect, V128_BITSELECT)
+SIMD_OP1(v128_not, SIMD_HOST(V128_NOT))
+SIMD_OP2(v128_and, SIMD_HOST(V128_AND))
+SIMD_OP2(v128_or, SIMD_HOST(V128_OR))
+SIMD_OP2(v128_xor, SIMD_HOST(V128_XOR))
+SIMD_OP2(v128_andnot, SIMD_HOST(V128_ANDNOT))
+SIMD_OP3(v128_bitselect, SIMD_HOST(V128_BITSELECT))
 
 #define V128_ANY_TRUE(r, v)                                                   \
         r = ((v)->u.v128.i64[0] != 0 || (v)->u.v128.i64[1] != 0)
@@ -618,10 +639,10 @@ SIMD_BOOLOP(v128_any_true, 0, V128_ANY_TRUE)
 #define ALL_TRUE_32x4(r, v) FOREACH_LANES(32, r, v, ALL_TRUE)
 #define ALL_TRUE_64x2(r, v) FOREACH_LANES(64, r, v, ALL_TRUE)
 
-SIMD_BOOLOP(i8x16_all_true, 1, ALL_TRUE_8x16)
-SIMD_BOOLOP(i16x8_all_true, 1, ALL_TRUE_16x8)
-SIMD_BOOLOP(i32x4_all_true, 1, ALL_TRUE_32x4)
-SIMD_BOOLOP(i64x2_all_true, 1, ALL_TRUE_64x2)
+SIMD_BOOLOP(i8x16_all_true, 1, SIMD_HOST(ALL_TRUE_8x16))
+SIMD_BOOLOP(i16x8_all_true, 1, SIMD_HOST(ALL_TRUE_16x8))
+SIMD_BOOLOP(i32x4_all_true, 1, SIMD_HOST(ALL_TRUE_32x4))
+SIMD_BOOLOP(i64x2_all_true, 1, SIMD_HOST(ALL_TRUE_64x2))
 
 #define BITMASK(LS, a, b, I)                                                  \
         a |= (uint32_t)((int##LS##_t)GET_LANE(i, LS, b, I) < 0) << I
@@ -631,10 +652,10 @@ SIMD_BOOLOP(i64x2_all_true, 1, ALL_TRUE_64x2)
 #define BITMASK_32x4(r, v) FOREACH_LANES(32, r, v, BITMASK)
 #define BITMASK_64x2(r, v) FOREACH_LANES(64, r, v, BITMASK)
 
-SIMD_BOOLOP(i8x16_bitmask, 0, BITMASK_8x16)
-SIMD_BOOLOP(i16x8_bitmask, 0, BITMASK_16x8)
-SIMD_BOOLOP(i32x4_bitmask, 0, BITMASK_32x4)
-SIMD_BOOLOP(i64x2_bitmask, 0, BITMASK_64x2)
+SIMD_BOOLOP(i8x16_bitmask, 0, SIMD_HOST(BITMASK_8x16))
+SIMD_BOOLOP(i16x8_bitmask, 0, SIMD_HOST(BITMASK_16x8))
+SIMD_BOOLOP(i32x4_bitmask, 0, SIMD_HOST(BITMASK_32x4))
+SIMD_BOOLOP(i64x2_bitmask, 0, SIMD_HOST(BITMASK_64x2))
 
 /* "SIMPLE" version doesn't pass LS to OP */
 #define LANE_OP2_SIMPLE(I_OR_F, LS, a, b, I, OP)                              \
@@ -665,12 +686,12 @@ SIMD_BOOLOP(i64x2_bitmask, 0, BITMASK_64x2)
 #define FADD_32x4(a, b, c) FOREACH_LANES3(32, a, b, c, FADD1)
 #define FADD_64x2(a, b, c) FOREACH_LANES3(64, a, b, c, FADD1)
 
-SIMD_OP2(i8x16_add, ADD_8x16)
-SIMD_OP2(i16x8_add, ADD_16x8)
-SIMD_OP2(i32x4_add, ADD_32x4)
-SIMD_OP2(i64x2_add, ADD_64x2)
-SIMD_OP2(f32x4_add, FADD_32x4)
-SIMD_OP2(f64x2_add, FADD_64x2)
+SIMD_OP2(i8x16_add, SIMD_HOST(ADD_8x16))
+SIMD_OP2(i16x8_add, SIMD_HOST(ADD_16x8))
+SIMD_OP2(i32x4_add, SIMD_HOST(ADD_32x4))
+SIMD_OP2(i64x2_add, SIMD_HOST(ADD_64x2))
+SIMD_OP2(f32x4_add, SIMD_HOST(FADD_32x4))
+SIMD_OP2(f64x2_add, SIMD_HOST(FADD_64x2))
 
 #define SUB1(LS, a, b, c, I) LANE_OP3(i, LS, a, b, c, I, SUB)
 #define FSUB1(LS, a, b, c, I) LANE_OP3(f, LS, a, b, c, I, FSUB)
@@ -682,12 +703,12 @@ SIMD_OP2(f64x2_add, FADD_64x2)
 #define FSUB_32x4(a, b, c) FOREACH_LANES3(32, a, b, c, FSUB1)
 #define FSUB_64x2(a, b, c) FOREACH_LANES3(64, a, b, c, FSUB1)
 
-SIMD_OP2(i8x16_sub, SUB_8x16)
-SIMD_OP2(i16x8_sub, SUB_16x8)
-SIMD_OP2(i32x4_sub, SUB_32x4)
-SIMD_OP2(i64x2_sub, SUB_64x2)
-SIMD_OP2(f32x4_sub, FSUB_32x4)
-SIMD_OP2(f64x2_sub, FSUB_64x2)
+SIMD_OP2(i8x16_sub, SIMD_HOST(SUB_8x16))
+SIMD_OP2(i16x8_sub, SIMD_HOST(SUB_16x8))
+SIMD_OP2(i32x4_sub, SIMD_HOST(SUB_32x4))
+SIMD_OP2(i64x2_sub, SIMD_HOST(SUB_64x2))
+SIMD_OP2(f32x4_sub, SIMD_HOST(FSUB_32x4))
+SIMD_OP2(f64x2_sub, SIMD_HOST(FSUB_64x2))
 
 #define SAT_s(LS, a)                                                          \
         (uint##LS##_t)((a >= INT##LS##_MAX)   ? INT##LS##_MAX                 \
@@ -718,14 +739,14 @@ SIMD_OP2(f64x2_sub, FSUB_64x2)
 #define SUB_SAT_16_s(a, b, c) FOREACH_LANES3(16, a, b, c, SUB_SAT_s1)
 #define SUB_SAT_16_u(a, b, c) FOREACH_LANES3(16, a, b, c, SUB_SAT_u1)
 
-SIMD_OP2(i8x16_add_sat_s, ADD_SAT_8_s)
-SIMD_OP2(i16x8_add_sat_s, ADD_SAT_16_s)
-SIMD_OP2(i8x16_sub_sat_s, SUB_SAT_8_s)
-SIMD_OP2(i16x8_sub_sat_s, SUB_SAT_16_s)
-SIMD_OP2(i8x16_add_sat_u, ADD_SAT_8_u)
-SIMD_OP2(i16x8_add_sat_u, ADD_SAT_16_u)
-SIMD_OP2(i8x16_sub_sat_u, SUB_SAT_8_u)
-SIMD_OP2(i16x8_sub_sat_u, SUB_SAT_16_u)
+SIMD_OP2(i8x16_add_sat_s, SIMD_HOST(ADD_SAT_8_s))
+SIMD_OP2(i16x8_add_sat_s, SIMD_HOST(ADD_SAT_16_s))
+SIMD_OP2(i8x16_sub_sat_s, SIMD_HOST(SUB_SAT_8_s))
+SIMD_OP2(i16x8_sub_sat_s, SIMD_HOST(SUB_SAT_16_s))
+SIMD_OP2(i8x16_add_sat_u, SIMD_HOST(ADD_SAT_8_u))
+SIMD_OP2(i16x8_add_sat_u, SIMD_HOST(ADD_SAT_16_u))
+SIMD_OP2(i8x16_sub_sat_u, SIMD_HOST(SUB_SAT_8_u))
+SIMD_OP2(i16x8_sub_sat_u, SIMD_HOST(SUB_SAT_16_u))
 
 #define MUL1(LS, a, b, c, I) LANE_OP3(i, LS, a, b, c, I, MUL)
 #define FMUL1(LS, a, b, c, I) LANE_OP3(f, LS, a, b, c, I, FMUL)
@@ -736,19 +757,19 @@ SIMD_OP2(i16x8_sub_sat_u, SUB_SAT_16_u)
 #define FMUL_32x4(a, b, c) FOREACH_LANES3(32, a, b, c, FMUL1)
 #define FMUL_64x2(a, b, c) FOREACH_LANES3(64, a, b, c, FMUL1)
 
-SIMD_OP2(i16x8_mul, MUL_16x8)
-SIMD_OP2(i32x4_mul, MUL_32x4)
-SIMD_OP2(i64x2_mul, MUL_64x2)
-SIMD_OP2(f32x4_mul, FMUL_32x4)
-SIMD_OP2(f64x2_mul, FMUL_64x2)
+SIMD_OP2(i16x8_mul, SIMD_HOST(MUL_16x8))
+SIMD_OP2(i32x4_mul, SIMD_HOST(MUL_32x4))
+SIMD_OP2(i64x2_mul, SIMD_HOST(MUL_64x2))
+SIMD_OP2(f32x4_mul, SIMD_HOST(FMUL_32x4))
+SIMD_OP2(f64x2_mul, SIMD_HOST(FMUL_64x2))
 
 #define FDIV1(LS, a, b, c, I) LANE_OP3(f, LS, a, b, c, I, FDIV)
 
 #define FDIV_32x4(a, b, c) FOREACH_LANES3(32, a, b, c, FDIV1)
 #define FDIV_64x2(a, b, c) FOREACH_LANES3(64, a, b, c, FDIV1)
 
-SIMD_OP2(f32x4_div, FDIV_32x4)
-SIMD_OP2(f64x2_div, FDIV_64x2)
+SIMD_OP2(f32x4_div, SIMD_HOST(FDIV_32x4))
+SIMD_OP2(f64x2_div, SIMD_HOST(FDIV_64x2))
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MAX_s(N, a, b) (uint##N##_t) MAX((int##N##_t)a, (int##N##_t)b)
@@ -776,18 +797,18 @@ SIMD_OP2(f64x2_div, FDIV_64x2)
 #define MIN_u_16x8(a, b, c) FOREACH_LANES3(16, a, b, c, MIN_u1)
 #define MIN_u_32x4(a, b, c) FOREACH_LANES3(32, a, b, c, MIN_u1)
 
-SIMD_OP2(i8x16_max_s, MAX_s_8x16)
-SIMD_OP2(i16x8_max_s, MAX_s_16x8)
-SIMD_OP2(i32x4_max_s, MAX_s_32x4)
-SIMD_OP2(i8x16_max_u, MAX_u_8x16)
-SIMD_OP2(i16x8_max_u, MAX_u_16x8)
-SIMD_OP2(i32x4_max_u, MAX_u_32x4)
-SIMD_OP2(i8x16_min_s, MIN_s_8x16)
-SIMD_OP2(i16x8_min_s, MIN_s_16x8)
-SIMD_OP2(i32x4_min_s, MIN_s_32x4)
-SIMD_OP2(i8x16_min_u, MIN_u_8x16)
-SIMD_OP2(i16x8_min_u, MIN_u_16x8)
-SIMD_OP2(i32x4_min_u, MIN_u_32x4)
+SIMD_OP2(i8x16_max_s, SIMD_HOST(MAX_s_8x16))
+SIMD_OP2(i16x8_max_s, SIMD_HOST(MAX_s_16x8))
+SIMD_OP2(i32x4_max_s, SIMD_HOST(MAX_s_32x4))
+SIMD_OP2(i8x16_max_u, SIMD_HOST(MAX_u_8x16))
+SIMD_OP2(i16x8_max_u, SIMD_HOST(MAX_u_16x8))
+SIMD_OP2(i32x4_max_u, SIMD_HOST(MAX_u_32x4))
+SIMD_OP2(i8x16_min_s, SIMD_HOST(MIN_s_8x16))
+SIMD_OP2(i16x8_min_s, SIMD_HOST(MIN_s_16x8))
+SIMD_OP2(i32x4_min_s, SIMD_HOST(MIN_s_32x4))
+SIMD_OP2(i8x16_min_u, SIMD_HOST(MIN_u_8x16))
+SIMD_OP2(i16x8_min_u, SIMD_HOST(MIN_u_16x8))
+SIMD_OP2(i32x4_min_u, SIMD_HOST(MIN_u_32x4))
 
 #define FPMAX(N, a, b) ((a) < (b) ? (b) : (a))
 #define FPMIN(N, a, b) ((b) < (a) ? (b) : (a))
@@ -812,10 +833,10 @@ SIMD_OP2(f32x4_max, FMAX_32x4)
 SIMD_OP2(f64x2_max, FMAX_64x2)
 SIMD_OP2(f32x4_min, FMIN_32x4)
 SIMD_OP2(f64x2_min, FMIN_64x2)
-SIMD_OP2(f32x4_pmax, FPMAX_32x4)
-SIMD_OP2(f64x2_pmax, FPMAX_64x2)
-SIMD_OP2(f32x4_pmin, FPMIN_32x4)
-SIMD_OP2(f64x2_pmin, FPMIN_64x2)
+SIMD_OP2(f32x4_pmax, SIMD_HOST(FPMAX_32x4))
+SIMD_OP2(f64x2_pmax, SIMD_HOST(FPMAX_64x2))
+SIMD_OP2(f32x4_pmin, SIMD_HOST(FPMIN_32x4))
+SIMD_OP2(f64x2_pmin, SIMD_HOST(FPMIN_64x2))
 
 #define FABS32(a) fabsf(a)
 #define FNEG32(a) (-(a))
@@ -839,12 +860,12 @@ SIMD_OP2(f64x2_pmin, FPMIN_64x2)
 #define FNEG_64(a, b) FOREACH_LANES(64, a, b, FNEG1)
 #define FSQRT_64(a, b) FOREACH_LANES(64, a, b, FSQRT1)
 
-SIMD_OP1(f32x4_abs, FABS_32)
-SIMD_OP1(f32x4_neg, FNEG_32)
-SIMD_OP1(f32x4_sqrt, FSQRT_32)
-SIMD_OP1(f64x2_abs, FABS_64)
-SIMD_OP1(f64x2_neg, FNEG_64)
-SIMD_OP1(f64x2_sqrt, FSQRT_64)
+SIMD_OP1(f32x4_abs, SIMD_HOST(FABS_32))
+SIMD_OP1(f32x4_neg, SIMD_HOST(FNEG_32))
+SIMD_OP1(f32x4_sqrt, SIMD_HOST(FSQRT_32))
+SIMD_OP1(f64x2_abs, SIMD_HOST(FABS_64))
+SIMD_OP1(f64x2_neg, SIMD_HOST(FNEG_64))
+SIMD_OP1(f64x2_sqrt, SIMD_HOST(FSQRT_64))
 
 #define CONVERT_s1(LS, a, b, I)                                               \
         lef##LS##_encode(&LANEPTRf##LS(a)[I],                                 \
@@ -863,10 +884,10 @@ SIMD_OP1(f64x2_sqrt, FSQRT_64)
 #define CONVERT_LOW_64_s(a, b) FOREACH_LANES(64, a, b, CONVERT_LOW_s1)
 #define CONVERT_LOW_64_u(a, b) FOREACH_LANES(64, a, b, CONVERT_LOW_u1)
 
-SIMD_OP1(f32x4_convert_i32x4_s, CONVERT_32_s)
-SIMD_OP1(f32x4_convert_i32x4_u, CONVERT_32_u)
-SIMD_OP1(f64x2_convert_low_i32x4_s, CONVERT_LOW_64_s)
-SIMD_OP1(f64x2_convert_low_i32x4_u, CONVERT_LOW_64_u)
+SIMD_OP1(f32x4_convert_i32x4_s, SIMD_HOST(CONVERT_32_s))
+SIMD_OP1(f32x4_convert_i32x4_u, SIMD_HOST(CONVERT_32_u))
+SIMD_OP1(f64x2_convert_low_i32x4_s, SIMD_HOST(CONVERT_LOW_64_s))
+SIMD_OP1(f64x2_convert_low_i32x4_u, SIMD_HOST(CONVERT_LOW_64_u))
 
 /*
  * Note: for narrowing ops, the input lanes are always interpreted signed.
@@ -895,10 +916,10 @@ SIMD_OP1(f64x2_convert_low_i32x4_u, CONVERT_LOW_64_u)
 #define NARROW_16_s(a, b, c) FOREACH_LANES3(16, a, b, c, NARROW_s1)
 #define NARROW_16_u(a, b, c) FOREACH_LANES3(16, a, b, c, NARROW_u1)
 
-SIMD_OP2(i8x16_narrow_i16x8_s, NARROW_8_s)
-SIMD_OP2(i8x16_narrow_i16x8_u, NARROW_8_u)
-SIMD_OP2(i16x8_narrow_i32x4_s, NARROW_16_s)
-SIMD_OP2(i16x8_narrow_i32x4_u, NARROW_16_u)
+SIMD_OP2(i8x16_narrow_i16x8_s, SIMD_HOST(NARROW_8_s))
+SIMD_OP2(i8x16_narrow_i16x8_u, SIMD_HOST(NARROW_8_u))
+SIMD_OP2(i16x8_narrow_i32x4_s, SIMD_HOST(NARROW_16_s))
+SIMD_OP2(i16x8_narrow_i32x4_u, SIMD_HOST(NARROW_16_u))
 
 #define DEMOTE_32(a, b)                                                       \
         SET_LANE(f, 32, a, 0, GET_LANE(f, 64, b, 0));                         \
@@ -909,8 +930,8 @@ SIMD_OP2(i16x8_narrow_i32x4_u, NARROW_16_u)
         SET_LANE(f, 64, a, 0, GET_LANE(f, 32, b, 0));                         \
         SET_LANE(f, 64, a, 1, GET_LANE(f, 32, b, 1))
 
-SIMD_OP1(f32x4_demote_f64x2_zero, DEMOTE_32)
-SIMD_OP1(f64x2_promote_low_f32x4, PROMOTE_LOW_64)
+SIMD_OP1(f32x4_demote_f64x2_zero, SIMD_HOST(DEMOTE_32))
+SIMD_OP1(f64x2_promote_low_f32x4, SIMD_HOST(PROMOTE_LOW_64))
 
 #define EXTEND_LOW_16_s(a, b) EXTEND_8x8_s(LANEPTRi128(a), LANEPTRi8(b))
 #define EXTEND_HIGH_16_s(a, b) EXTEND_8x8_s(LANEPTRi128(a), &LANEPTRi8(b)[8])
@@ -930,23 +951,23 @@ SIMD_OP1(f64x2_promote_low_f32x4, PROMOTE_LOW_64)
 #define EXTADD_32_s(a, b) EXTADD_32x4_s(LANEPTRi32(a), LANEPTRi16(b))
 #define EXTADD_32_u(a, b) EXTADD_32x4_u(LANEPTRi32(a), LANEPTRi16(b))
 
-SIMD_OP1(i16x8_extend_low_i8x16_s, EXTEND_LOW_16_s)
-SIMD_OP1(i16x8_extend_high_i8x16_s, EXTEND_HIGH_16_s)
-SIMD_OP1(i16x8_extend_low_i8x16_u, EXTEND_LOW_16_u)
-SIMD_OP1(i16x8_extend_high_i8x16_u, EXTEND_HIGH_16_u)
-SIMD_OP1(i32x4_extend_low_i16x8_s, EXTEND_LOW_32_s)
-SIMD_OP1(i32x4_extend_high_i16x8_s, EXTEND_HIGH_32_s)
-SIMD_OP1(i32x4_extend_low_i16x8_u, EXTEND_LOW_32_u)
-SIMD_OP1(i32x4_extend_high_i16x8_u, EXTEND_HIGH_32_u)
-SIMD_OP1(i64x2_extend_low_i32x4_s, EXTEND_LOW_64_s)
-SIMD_OP1(i64x2_extend_high_i32x4_s, EXTEND_HIGH_64_s)
-SIMD_OP1(i64x2_extend_low_i32x4_u, EXTEND_LOW_64_u)
-SIMD_OP1(i64x2_extend_high_i32x4_u, EXTEND_HIGH_64_u)
-
-SIMD_OP1(i16x8_extadd_pairwise_i8x16_s, EXTADD_16_s)
-SIMD_OP1(i16x8_extadd_pairwise_i8x16_u, EXTADD_16_u)
-SIMD_OP1(i32x4_extadd_pairwise_i16x8_s, EXTADD_32_s)
-SIMD_OP1(i32x4_extadd_pairwise_i16x8_u, EXTADD_32_u)
+SIMD_OP1(i16x8_extend_low_i8x16_s, SIMD_HOST(EXTEND_LOW_16_s))
+SIMD_OP1(i16x8_extend_high_i8x16_s, SIMD_HOST(EXTEND_HIGH_16_s))
+SIMD_OP1(i16x8_extend_low_i8x16_u, SIMD_HOST(EXTEND_LOW_16_u))
+SIMD_OP1(i16x8_extend_high_i8x16_u, SIMD_HOST(EXTEND_HIGH_16_u))
+SIMD_OP1(i32x4_extend_low_i16x8_s, SIMD_HOST(EXTEND_LOW_32_s))
+SIMD_OP1(i32x4_extend_high_i16x8_s, SIMD_HOST(EXTEND_HIGH_32_s))
+SIMD_OP1(i32x4_extend_low_i16x8_u, SIMD_HOST(EXTEND_LOW_32_u))
+SIMD_OP1(i32x4_extend_high_i16x8_u, SIMD_HOST(EXTEND_HIGH_32_u))
+SIMD_OP1(i64x2_extend_low_i32x4_s, SIMD_HOST(EXTEND_LOW_64_s))
+SIMD_OP1(i64x2_extend_high_i32x4_s, SIMD_HOST(EXTEND_HIGH_64_s))
+SIMD_OP1(i64x2_extend_low_i32x4_u, SIMD_HOST(EXTEND_LOW_64_u))
+SIMD_OP1(i64x2_extend_high_i32x4_u, SIMD_HOST(EXTEND_HIGH_64_u))
+
+SIMD_OP1(i16x8_extadd_pairwise_i8x16_s, SIMD_HOST(EXTADD_16_s))
+SIMD_OP1(i16x8_extadd_pairwise_i8x16_u, SIMD_HOST(EXTADD_16_u))
+SIMD_OP1(i32x4_extadd_pairwise_i16x8_s, SIMD_HOST(EXTADD_32_s))
+SIMD_OP1(i32x4_extadd_pairwise_i16x8_u, SIMD_HOST(EXTADD_32_u))
 
 #define EXTMUL_LOW_16_s(a, b, c)                                              \
         EXTMUL_16_s(LANEPTRi16(a), &LANEPTRi8(b)[0], &LANEPTRi8(c)[0])
@@ -973,18 +994,18 @@ SIMD_OP1(i32x4_extadd_pairwise_i16x8_u, EXTADD_32_u)
 #define EXTMUL_HIGH_64_u(a, b, c)                                             \
         EXTMUL_64_u(LANEPTRi64(a), &LANEPTRi32(b)[2], &LANEPTRi32(c)[2])
 
-SIMD_OP2(i16x8_extmul_low_i8x16_s, EXTMUL_LOW_16_s)
-SIMD_OP2(i16x8_extmul_low_i8x16_u, EXTMUL_LOW_16_u)
-SIMD_OP2(i32x4_extmul_low_i16x8_s, EXTMUL_LOW_32_s)
-SIMD_OP2(i32x4_extmul_low_i16x8_u, EXTMUL_LOW_32_u)
-SIMD_OP2(i64x2_extmul_low_i32x4_s, EXTMUL_LOW_64_s)
-SIMD_OP2(i64x2_extmul_low_i32x4_u, EXTMUL_LOW_64_u)
-SIMD_OP2(i16x8_extmul_high_i8x16_s, EXTMUL_HIGH_16_s)
-SIMD_OP2(i16x8_extmul_high_i8x16_u, EXTMUL_HIGH_16_u)
-SIMD_OP2(i32x4_extmul_high_i16x8_s, EXTMUL_HIGH_32_s)
-SIMD_OP2(i32x4_extmul_high_i16x8_u, EXTMUL_HIGH_32_u)
-SIMD_OP2(i64x2_extmul_high_i32x4_s, EXTMUL_HIGH_64_s)
-SIMD_OP2(i64x2_extmul_high_i32x4_u, EXTMUL_HIGH_64_u)
+SIMD_OP2(i16x8_extmul_low_i8x16_s, SIMD_HOST(EXTMUL_LOW_16_s))
+SIMD_OP2(i16x8_extmul_low_i8x16_u, SIMD_HOST(EXTMUL_LOW_16_u))
+SIMD_OP2(i32x4_extmul_low_i16x8_s, SIMD_HOST(EXTMUL_LOW_32_s))
+SIMD_OP2(i32x4_extmul_low_i16x8_u, SIMD_HOST(EXTMUL_LOW_32_u))
+SIMD_OP2(i64x2_extmul_low_i32x4_s, SIMD_HOST(EXTMUL_LOW_64_s))
+SIMD_OP2(i64x2_extmul_low_i32x4_u, SIMD_HOST(EXTMUL_LOW_64_u))
+SIMD_OP2(i16x8_extmul_high_i8x16_s, SIMD_HOST(EXTMUL_HIGH_16_s))
+SIMD_OP2(i16x8_extmul_high_i8x16_u, SIMD_HOST(EXTMUL_HIGH_16_u))
+SIMD_OP2(i32x4_extmul_high_i16x8_s, SIMD_HOST(EXTMUL_HIGH_32_s))
+SIMD_OP2(i32x4_extmul_high_i16x8_u, SIMD_HOST(EXTMUL_HIGH_32_u))
+SIMD_OP2(i64x2_extmul_high_i32x4_s, SIMD_HOST(EXTMUL_HIGH_64_s))
+SIMD_OP2(i64x2_extmul_high_i32x4_u, SIMD_HOST(EXTMUL_HIGH_64_u))
 
 #define EQ(I_OR_F, LS, a, b, c, I) CMP_LANE(I_OR_F, LS, a, b, c, I, , ==)
 #define NE(I_OR_F, LS, a, b, c, I) CMP_LANE(I_OR_F, LS, a, b, c, I, , !=)
@@ -1006,62 +1027,62 @@ SIMD_OP2(i64x2_extmul_high_i32x4_u, EXTMUL_HIGH_64_u)
 #define LANE_AVGR(I_OR_F, LS, a, b, c, I)                                     \
         LANE_OP3(I_OR_F, LS, a, b, c, I, AVGR)
 
-SIMD_FOREACH_LANES_OP2(f32x4_eq, f, 32, EQ)
-SIMD_FOREACH_LANES_OP2(f32x4_ne, f, 32, NE)
-SIMD_FOREACH_LANES_OP2(f32x4_lt, f, 32, LT)
-SIMD_FOREACH_LANES_OP2(f32x4_gt, f, 32, GT)
-SIMD_FOREACH_LANES_OP2(f32x4_le, f, 32, LE)
-SIMD_FOREACH_LANES_OP2(f32x4_ge, f, 32, GE)
-
-SIMD_FOREACH_LANES_OP2(f64x2_eq, f, 64, EQ)
-SIMD_FOREACH_LANES_OP2(f64x2_ne, f, 64, NE)
-SIMD_FOREACH_LANES_OP2(f64x2_lt, f, 64, LT)
-SIMD_FOREACH_LANES_OP2(f64x2_gt, f, 64, GT)
-SIMD_FOREACH_LANES_OP2(f64x2_le, f, 64, LE)
-SIMD_FOREACH_LANES_OP2(f64x2_ge, f, 64, GE)
-
-SIMD_FOREACH_LANES_OP2(i8x16_eq, i, 8, EQ)
-SIMD_FOREACH_LANES_OP2(i8x16_ne, i, 8, NE)
-SIMD_FOREACH_LANES_OP2(i8x16_lt_s, i, 8, LT_S)
-SIMD_FOREACH_LANES_OP2(i8x16_lt_u, i, 8, LT)
-SIMD_FOREACH_LANES_OP2(i8x16_gt_s, i, 8, GT_S)
-SIMD_FOREACH_LANES_OP2(i8x16_gt_u, i, 8, GT)
-SIMD_FOREACH_LANES_OP2(i8x16_le_s, i, 8, LE_S)
-SIMD_FOREACH_LANES_OP2(i8x16_le_u, i, 8, LE)
-SIMD_FOREACH_LANES_OP2(i8x16_ge_s, i, 8, GE_S)
-SIMD_FOREACH_LANES_OP2(i8x16_ge_u, i, 8, GE)
-
-SIMD_FOREACH_LANES_OP2(i16x8_eq, i, 16, EQ)
-SIMD_FOREACH_LANES_OP2(i16x8_ne, i, 16, NE)
-SIMD_FOREACH_LANES_OP2(i16x8_lt_s, i, 16, LT_S)
-SIMD_FOREACH_LANES_OP2(i16x8_lt_u, i, 16, LT)
-SIMD_FOREACH_LANES_OP2(i16x8_gt_s, i, 16, GT_S)
-SIMD_FOREACH_LANES_OP2(i16x8_gt_u, i, 16, GT)
-SIMD_FOREACH_LANES_OP2(i16x8_le_s, i, 16, LE_S)
-SIMD_FOREACH_LANES_OP2(i16x8_le_u, i, 16, LE)
-SIMD_FOREACH_LANES_OP2(i16x8_ge_s, i, 16, GE_S)
-SIMD_FOREACH_LANES_OP2(i16x8_ge_u, i, 16, GE)
-
-SIMD_FOREACH_LANES_OP2(i32x4_eq, i, 32, EQ)
-SIMD_FOREACH_LANES_OP2(i32x4_ne, i, 32, NE)
-SIMD_FOREACH_LANES_OP2(i32x4_lt_s, i, 32, LT_S)
-SIMD_FOREACH_LANES_OP2(i32x4_lt_u, i, 32, LT)
-SIMD_FOREACH_LANES_OP2(i32x4_gt_s, i, 32, GT_S)
-SIMD_FOREACH_LANES_OP2(i32x4_gt_u, i, 32, GT)
-SIMD_FOREACH_LANES_OP2(i32x4_le_s, i, 32, LE_S)
-SIMD_FOREACH_LANES_OP2(i32x4_le_u, i, 32, LE)
-SIMD_FOREACH_LANES_OP2(i32x4_ge_s, i, 32, GE_S)
-SIMD_FOREACH_LANES_OP2(i32x4_ge_u, i, 32, GE)
-
-SIMD_FOREACH_LANES_OP2(i64x2_eq, i, 64, EQ)
-SIMD_FOREACH_LANES_OP2(i64x2_ne, i, 64, NE)
-SIMD_FOREACH_LANES_OP2(i64x2_lt_s, i, 64, LT_S)
-SIMD_FOREACH_LANES_OP2(i64x2_gt_s, i, 64, GT_S)
-SIMD_FOREACH_LANES_OP2(i64x2_le_s, i, 64, LE_S)
-SIMD_FOREACH_LANES_OP2(i64x2_ge_s, i, 64, GE_S)
-
-SIMD_FOREACH_LANES_OP2(i8x16_avgr_u, i, 8, LANE_AVGR)
-SIMD_FOREACH_LANES_OP2(i16x8_avgr_u, i, 16, LANE_AVGR)
+SIMD_HOST_LANES_OP2(f32x4_eq, f, 32, EQ)
+SIMD_HOST_LANES_OP2(f32x4_ne, f, 32, NE)
+SIMD_HOST_LANES_OP2(f32x4_lt, f, 32, LT)
+SIMD_HOST_LANES_OP2(f32x4_gt, f, 32, GT)
+SIMD_HOST_LANES_OP2(f32x4_le, f, 32, LE)
+SIMD_HOST_LANES_OP2(f32x4_ge, f, 32, GE)
+
+SIMD_HOST_LANES_OP2(f64x2_eq, f, 64, EQ)
+SIMD_HOST_LANES_OP2(f64x2_ne, f, 64, NE)
+SIMD_HOST_LANES_OP2(f64x2_lt, f, 64, LT)
+SIMD_HOST_LANES_OP2(f64x2_gt, f, 64, GT)
+SIMD_HOST_LANES_OP2(f64x2_le, f, 64, LE)
+SIMD_HOST_LANES_OP2(f64x2_ge, f, 64, GE)
+
+SIMD_HOST_LANES_OP2(i8x16_eq, i, 8, EQ)
+SIMD_HOST_LANES_OP2(i8x16_ne, i, 8, NE)
+SIMD_HOST_LANES_OP2(i8x16_lt_s, i, 8, LT_S)
+SIMD_HOST_LANES_OP2(i8x16_lt_u, i, 8, LT)
+SIMD_HOST_LANES_OP2(i8x16_gt_s, i, 8, GT_S)
+SIMD_HOST_LANES_OP2(i8x16_gt_u, i, 8, GT)
+SIMD_HOST_LANES_OP2(i8x16_le_s, i, 8, LE_S)
+SIMD_HOST_LANES_OP2(i8x16_le_u, i, 8, LE)
+SIMD_HOST_LANES_OP2(i8x16_ge_s, i, 8, GE_S)
+SIMD_HOST_LANES_OP2(i8x16_ge_u, i, 8, GE)
+
+SIMD_HOST_LANES_OP2(i16x8_eq, i, 16, EQ)
+SIMD_HOST_LANES_OP2(i16x8_ne, i, 16, NE)
+SIMD_HOST_LANES_OP2(i16x8_lt_s, i, 16, LT_S)
+SIMD_HOST_LANES_OP2(i16x8_lt_u, i, 16, LT)
+SIMD_HOST_LANES_OP2(i16x8_gt_s, i, 16, GT_S)
+SIMD_HOST_LANES_OP2(i16x8_gt_u, i, 16, GT)
+SIMD_HOST_LANES_OP2(i16x8_le_s, i, 16, LE_S)
+SIMD_HOST_LANES_OP2(i16x8_le_u, i, 16, LE)
+SIMD_HOST_LANES_OP2(i16x8_ge_s, i, 16, GE_S)
+SIMD_HOST_LANES_OP2(i16x8_ge_u, i, 16, GE)
+
+SIMD_HOST_LANES_OP2(i32x4_eq, i, 32, EQ)
+SIMD_HOST_LANES_OP2(i32x4_ne, i, 32, NE)
+SIMD_HOST_LANES_OP2(i32x4_lt_s, i, 32, LT_S)
+SIMD_HOST_LANES_OP2(i32x4_lt_u, i, 32, LT)
+SIMD_HOST_LANES_OP2(i32x4_gt_s, i, 32, GT_S)
+SIMD_HOST_LANES_OP2(i32x4_gt_u, i, 32, GT)
+SIMD_HOST_LANES_OP2(i32x4_le_s, i, 32, LE_S)
+SIMD_HOST_LANES_OP2(i32x4_le_u, i, 32, LE)
+SIMD_HOST_LANES_OP2(i32x4_ge_s, i, 32, GE_S)
+SIMD_HOST_LANES_OP2(i32x4_ge_u, i, 32, GE)
+
+SIMD_HOST_LANES_OP2(i64x2_eq, i, 64, EQ)
+SIMD_HOST_LANES_OP2(i64x2_ne, i, 64, NE)
+SIMD_HOST_LANES_OP2(i64x2_lt_s, i, 64, LT_S)
+SIMD_HOST_LANES_OP2(i64x2_gt_s, i, 64, GT_S)
+SIMD_HOST_LANES_OP2(i64x2_le_s, i, 64, LE_S)
+SIMD_HOST_LANES_OP2(i64x2_ge_s, i, 64, GE_S)
+
+SIMD_HOST_LANES_OP2(i8x16_avgr_u, i, 8, LANE_AVGR)
+SIMD_HOST_LANES_OP2(i16x8_avgr_u, i, 16, LANE_AVGR)
 
 #define LANE_CEILF(I_OR_F, LS, a, b, I)                                       \
         LANE_OP2_SIMPLE(I_OR_F, LS, a, b, I, ceilf)
@@ -1087,24 +1108,24 @@ SIMD_FOREACH_LANES_OP2(i16x8_avgr_u, i, 16, LANE_AVGR)
 #define LANE_ABS(I_OR_F, LS, a, b, I) LANE_OP2(I_OR_F, LS, a, b, I, INT_ABS)
 #define LANE_NEG(I_OR_F, LS, a, b, I) LANE_OP2(I_OR_F, LS, a, b, I, INT_NEG)
 
-SIMD_FOREACH_LANES_OP1(f32x4_ceil, f, 32, LANE_CEILF)
-SIMD_FOREACH_LANES_OP1(f32x4_trunc, f, 32, LANE_TRUNCF)
-SIMD_FOREACH_LANES_OP1(f32x4_floor, f, 32, LANE_FLOORF)
-SIMD_FOREACH_LANES_OP1(f32x4_nearest, f, 32, LANE_NEARESTF)
-
-SIMD_FOREACH_LANES_OP1(f64x2_ceil, f, 64, LANE_CEIL)
-SIMD_FOREACH_LANES_OP1(f64x2_trunc, f, 64, LANE_TRUNC)
-SIMD_FOREACH_LANES_OP1(f64x2_floor, f, 64, LANE_FLOOR)
-SIMD_FOREACH_LANES_OP1(f64x2_nearest, f, 64, LANE_NEAREST)
-
-SIMD_FOREACH_LANES_OP1(i8x16_abs, i, 8, LANE_ABS)
-SIMD_FOREACH_LANES_OP1(i8x16_neg, i, 8, LANE_NEG)
-SIMD_FOREACH_LANES_OP1(i16x8_abs, i, 16, LANE_ABS)
-SIMD_FOREACH_LANES_OP1(i16x8_neg, i, 16, LANE_NEG)
-SIMD_FOREACH_LANES_OP1(i32x4_abs, i, 32, LANE_ABS)
-SIMD_FOREACH_LANES_OP1(i32x4_neg, i, 32, LANE_NEG)
-SIMD_FOREACH_LANES_OP1(i64x2_abs, i, 64, LANE_ABS)
-SIMD_FOREACH_LANES_OP1(i64x2_neg, i, 64, LANE_NEG)
+SIMD_HOST_LANES_OP1(f32x4_ceil, f, 32, LANE_CEILF)
+SIMD_HOST_LANES_OP1(f32x4_trunc, f, 32, LANE_TRUNCF)
+SIMD_HOST_LANES_OP1(f32x4_floor, f, 32, LANE_FLOORF)
+SIMD_HOST_LANES_OP1(f32x4_nearest, f, 32, LANE_NEARESTF)
+
+SIMD_HOST_LANES_OP1(f64x2_ceil, f, 64, LANE_CEIL)
+SIMD_HOST_LANES_OP1(f64x2_trunc, f, 64, LANE_TRUNC)
+SIMD_HOST_LANES_OP1(f64x2_floor, f, 64, LANE_FLOOR)
+SIMD_HOST_LANES_OP1(f64x2_nearest, f, 64, LANE_NEAREST)
+
+SIMD_HOST_LANES_OP1(i8x16_abs, i, 8, LANE_ABS)
+SIMD_HOST_LANES_OP1(i8x16_neg, i, 8, LANE_NEG)
+SIMD_HOST_LANES_OP1(i16x8_abs, i, 16, LANE_ABS)
+SIMD_HOST_LANES_OP1(i16x8_neg, i, 16, LANE_NEG)
+SIMD_HOST_LANES_OP1(i32x4_abs, i, 32, LANE_ABS)
+SIMD_HOST_LANES_OP1(i32x4_neg, i, 32, LANE_NEG)
+SIMD_HOST_LANES_OP1(i64x2_abs, i, 64, LANE_ABS)
+SIMD_HOST_LANES_OP1(i64x2_neg, i, 64, LANE_NEG)
 
 #define Q15MULR(N, a, b)                                                      \
         (uint##N##_t) SAT_s(                                                  \
@@ -1114,7 +1135,7 @@ SIMD_FOREACH_LANES_OP1(i64x2_neg, i, 64, LANE_NEG)
 #define LANE_Q15MULR(I_OR_F, LS, a, b, c, I)                                  \
         LANE_OP3(I_OR_F, LS, a, b, c, I, Q15MULR)
 
-SIMD_FOREACH_LANES_OP2(i16x8_q15mulr_sat_s, i, 16, LANE_Q15MULR)
+SIMD_HOST_LANES_OP2(i16x8_q15mulr_sat_s, i, 16, LANE_Q15MULR)
 
 #define DOT32_1(LS, a, b, c, I)                                               \
         le32_encode(                                                          \
@@ -1130,7 +1151,7 @@ SIMD_FOREACH_LANES_OP2(i16x8_q15mulr_sat_s, i, 16, LANE_Q15MULR)
 
 #define DOT32(a, b, c) FOREACH_LANES3(32, a, b, c, DOT32_1)
 
-SIMD_OP2(i32x4_dot_i16x8_s, DOT32)
+SIMD_OP2(i32x4_dot_i16x8_s, SIMD_HOST(DOT32))
 
 #define TRUNC_SAT_s1(LS, a, b, I)                                             \
         do {                                                                  \
@@ -1151,8 +1172,8 @@ SIMD_OP2(i32x4_dot_i16x8_s, DOT32)
 #define TRUNC_SAT_32_s(a, b) FOREACH_LANES(32, a, b, TRUNC_SAT_s1)
 #define TRUNC_SAT_32_u(a, b) FOREACH_LANES(32, a, b, TRUNC_SAT_u1)
 
-SIMD_OP1(i32x4_trunc_sat_f32x4_s, TRUNC_SAT_32_s)
-SIMD_OP1(i32x4_trunc_sat_f32x4_u, TRUNC_SAT_32_u)
+SIMD_OP1(i32x4_trunc_sat_f32x4_s, SIMD_HOST(TRUNC_SAT_32_s))
+SIMD_OP1(i32x4_trunc_sat_f32x4_u, SIMD_HOST(TRUNC_SAT_32_u))
 
 #define TRUNC_SAT_64_s1(LS, a, b, I)                                          \
         do {                                                                  \
@@ -1179,14 +1200,14 @@ SIMD_OP1(i32x4_trunc_sat_f32x4_u, TRUNC_SAT_32_u)
         LANEPTRi32(a)[2] = 0;                                                 \
         LANEPTRi32(a)[3] = 0
 
-SIMD_OP1(i32x4_trunc_sat_f64x2_s_zero, TRUNC_SAT_64_s)
-SIMD_OP1(i32x4_trunc_sat_f64x2_u_zero, TRUNC_SAT_64_u)
+SIMD_OP1(i32x4_trunc_sat_f64x2_s_zero, SIMD_HOST(TRUNC_SAT_64_s))
+SIMD_OP1(i32x4_trunc_sat_f64x2_u_zero, SIMD_HOST(TRUNC_SAT_64_u))
 
 #define POPCNT(LS, a) wasm_popcount(a)
 
 #define LANE_POPCNT(I_OR_F, LS, a, b, I) LANE_OP2(I_OR_F, LS, a, b, I, POPCNT)
 
-SIMD_FOREACH_LANES_OP1(i8x16_popcnt, i, 8, LANE_POPCNT)
+SIMD_HOST_LANES_OP1(i8x16_popcnt, i, 8, LANE_POPCNT)
 
 #define LANE_SWIZZLE(I_OR_F, LS, a, b, c, I)                                  \
         do {                                                                  \
@@ -1200,7 +1221,20 @@ SIMD_FOREACH_LANES_OP1(i8x16_popcnt, i, 8, LANE_POPCNT)
                 LANEPTR##I_OR_F##LS(a)[I] = r;                                \
         } while (0)
 
-SIMD_FOREACH_LANES_OP2(i8x16_swizzle, i, 8, LANE_SWIZZLE)
+SIMD_HOST_LANES_OP2(i8x16_swizzle, i, 8, LANE_SWIZZLE)
+
+#define SHUFFLE(result, a, b, lane)                                           \
+        do {                                                                  \
+                uint32_t _i;                                                  \
+                for (_i = 0; _i < 16; _i++) {                                 \
+                        uint8_t s = lane[_i];                                 \
+                        if (s < 16) {                                         \
+                                result[_i] = a[s];                            \
+                        } else {                                              \
+                                result[_i] = b[s - 16];                       \
+                        }                                                     \
+                }                                                             \
+        } while (0)
 
 INSN_IMPL(i8x16_shuffle)
 {
@@ -1218,14 +1252,7 @@ INSN_IMPL(i8x16_shuffle)
                 uint8_t *result = val_c.u.v128.i8;
                 const uint8_t *a = val_a.u.v128.i8;
                 const uint8_t *b = val_b.u.v128.i8;
-                for (i = 0; i < 16; i++) {
-                        uint8_t s = lane[i];
-                        if (s < 16) {
-                                result[i] = a[s];
-                        } else {
-                                result[i] = b[s - 16];
-                        }
-                }
+                SIMD_HOST(SHUFFLE)(result, a, b, lane);
         }
         PUSH_VAL(TYPE_v128, c);
         SAVE_PC;
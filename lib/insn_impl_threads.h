@@ -1,5 +1,4 @@
 
-#define CMPXCHG(p, op, n) atomic_compare_exchange_strong(p, op, n)
 #define FENCE() atomic_thread_fence(memory_order_seq_cst)
 
 #define ATOMIC_WAIT(NAME, BITS)                                               \
@@ -56,8 +55,7 @@ fail:                                                                         \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
-                        _Atomic uint##MEM##_t *ap = vp;                       \
-                        uint##STACK##_t v = le##MEM##_to_host(*ap);           \
+                        uint##STACK##_t v = le##MEM##_atomic_load(vp);        \
                         val_c.u.i##STACK = CAST v;                            \
                 }                                                             \
                 PUSH_VAL(TYPE_##I_OR_F##STACK, c);                            \
@@ -87,8 +85,7 @@ fail:                                                                         \
                                 goto fail;                                    \
                         }                                                     \
                         uint##STACK##_t v = CAST val_v.u.i##STACK;            \
-                        _Atomic uint##MEM##_t *ap = vp;                       \
-                        *ap = host_to_le##MEM((uint##MEM##_t)v);              \
+                        le##MEM##_atomic_store(vp, (uint##MEM##_t)v);         \
                 }                                                             \
                 SAVE_PC;                                                      \
                 INSN_SUCCESS;                                                 \
@@ -96,6 +93,10 @@ fail:                                                                         \
                 INSN_FAIL;                                                    \
         }
 
+/*
+ * OP is one of the read-modify-write operations in endian_atomic.h.
+ * (eg. fetch_add for le32_atomic_fetch_add)
+ */
 #define ATOMIC_RMW(NAME, MEM, STACK, OP)                                      \
         INSN_IMPL(NAME)                                                       \
         {                                                                     \
@@ -116,20 +117,8 @@ fail:                                                                         \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
-                        _Atomic uint##MEM##_t *ap = vp;                       \
-                        uint##MEM##_t old_le;                                 \
-                        uint##STACK##_t old_h;                                \
-                        uint##MEM##_t new_le;                                 \
-                        do {                                                  \
-                                old_le = *ap;                                 \
-                                old_h = (uint##STACK##_t)le##MEM##_to_host(   \
-                                        old_le);                              \
-                                uint##STACK##_t new_h =                       \
-                                        OP(STACK, old_h, val_v.u.i##STACK);   \
-                                new_le = host_to_le##MEM(                     \
-                                        (uint##MEM##_t)new_h);                \
-                        } while (!CMPXCHG(ap, &old_le, new_le));              \
-                        val_readv.u.i##STACK = old_h;                         \
+                        val_readv.u.i##STACK = le##MEM##_atomic_##OP(         \
+                                vp, (uint##MEM##_t)val_v.u.i##STACK);         \
                 }                                                             \
                 PUSH_VAL(TYPE_i##STACK, readv);                               \
                 SAVE_PC;                                                      \
@@ -178,21 +167,16 @@ fail:                                                                         \
                         _Atomic uint##MEM##_t *ap = vp;                       \
                         uint##MEM##_t truncated =                             \
                                 (uint##MEM##_t)val_expected.u.i##STACK;       \
-                        uint##MEM##_t read_le;                                \
+                        uint##MEM##_t replacement =                           \
+                                (uint##MEM##_t)val_replacement.u.i##STACK;    \
+                        uint##MEM##_t read;                                   \
                         if (truncated == val_expected.u.i##STACK) {           \
-                                uint##MEM##_t expected_le =                   \
-                                        host_to_le##MEM(truncated);           \
-                                uint##MEM##_t replacement_le =                \
-                                        host_to_le##MEM(                      \
-                                                (uint##MEM##_t)               \
-                                                        val_replacement.u     \
-                                                                .i##STACK);   \
-                                CMPXCHG(ap, &expected_le, replacement_le);    \
-                                read_le = expected_le;                        \
+                                read = le##MEM##_atomic_cmpxchg(              \
+                                        ap, truncated, replacement);          \
                         } else {                                              \
-                                read_le = *ap;                                \
+                                read = le##MEM##_atomic_load(ap);             \
                         }                                                     \
-                        val_readv.u.i##STACK = le##MEM##_to_host(read_le);    \
+                        val_readv.u.i##STACK = read;                          \
                 }                                                             \
                 PUSH_VAL(TYPE_i##STACK, readv);                               \
                 SAVE_PC;                                                      \
@@ -267,53 +251,53 @@ ATOMIC_STOREOP2(i64_atomic_store8_u, 8, 64, , i)
 ATOMIC_STOREOP2(i64_atomic_store16_u, 16, 64, , i)
 ATOMIC_STOREOP2(i64_atomic_store32_u, 32, 64, , i)
 
-ATOMIC_RMW(i32_atomic_rmw8_add_u, 8, 32, ADD)
-ATOMIC_RMW(i32_atomic_rmw16_add_u, 16, 32, ADD)
-ATOMIC_RMW(i32_atomic_rmw_add, 32, 32, ADD)
-ATOMIC_RMW(i64_atomic_rmw8_add_u, 8, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw16_add_u, 16, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw32_add_u, 32, 64, ADD)
-ATOMIC_RMW(i64_atomic_rmw_add, 64, 64, ADD)
+ATOMIC_RMW(i32_atomic_rmw8_add_u, 8, 32, fetch_add)
+ATOMIC_RMW(i32_atomic_rmw16_add_u, 16, 32, fetch_add)
+ATOMIC_RMW(i32_atomic_rmw_add, 32, 32, fetch_add)
+ATOMIC_RMW(i64_atomic_rmw8_add_u, 8, 64, fetch_add)
+ATOMIC_RMW(i64_atomic_rmw16_add_u, 16, 64, fetch_add)
+ATOMIC_RMW(i64_atomic_rmw32_add_u, 32, 64, fetch_add)
+ATOMIC_RMW(i64_atomic_rmw_add, 64, 64, fetch_add)
 
-ATOMIC_RMW(i32_atomic_rmw8_sub_u, 8, 32, SUB)
-ATOMIC_RMW(i32_atomic_rmw16_sub_u, 16, 32, SUB)
-ATOMIC_RMW(i32_atomic_rmw_sub, 32, 32, SUB)
-ATOMIC_RMW(i64_atomic_rmw8_sub_u, 8, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw16_sub_u, 16, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw32_sub_u, 32, 64, SUB)
-ATOMIC_RMW(i64_atomic_rmw_sub, 64, 64, SUB)
+ATOMIC_RMW(i32_atomic_rmw8_sub_u, 8, 32, fetch_sub)
+ATOMIC_RMW(i32_atomic_rmw16_sub_u, 16, 32, fetch_sub)
+ATOMIC_RMW(i32_atomic_rmw_sub, 32, 32, fetch_sub)
+ATOMIC_RMW(i64_atomic_rmw8_sub_u, 8, 64, fetch_sub)
+ATOMIC_RMW(i64_atomic_rmw16_sub_u, 16, 64, fetch_sub)
+ATOMIC_RMW(i64_atomic_rmw32_sub_u, 32, 64, fetch_sub)
+ATOMIC_RMW(i64_atomic_rmw_sub, 64, 64, fetch_sub)
 
-ATOMIC_RMW(i32_atomic_rmw8_and_u, 8, 32, AND)
-ATOMIC_RMW(i32_atomic_rmw16_and_u, 16, 32, AND)
-ATOMIC_RMW(i32_atomic_rmw_and, 32, 32, AND)
-ATOMIC_RMW(i64_atomic_rmw8_and_u, 8, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw16_and_u, 16, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw32_and_u, 32, 64, AND)
-ATOMIC_RMW(i64_atomic_rmw_and, 64, 64, AND)
+ATOMIC_RMW(i32_atomic_rmw8_and_u, 8, 32, fetch_and)
+ATOMIC_RMW(i32_atomic_rmw16_and_u, 16, 32, fetch_and)
+ATOMIC_RMW(i32_atomic_rmw_and, 32, 32, fetch_and)
+ATOMIC_RMW(i64_atomic_rmw8_and_u, 8, 64, fetch_and)
+ATOMIC_RMW(i64_atomic_rmw16_and_u, 16, 64, fetch_and)
+ATOMIC_RMW(i64_atomic_rmw32_and_u, 32, 64, fetch_and)
+ATOMIC_RMW(i64_atomic_rmw_and, 64, 64, fetch_and)
 
-ATOMIC_RMW(i32_atomic_rmw8_or_u, 8, 32, OR)
-ATOMIC_RMW(i32_atomic_rmw16_or_u, 16, 32, OR)
-ATOMIC_RMW(i32_atomic_rmw_or, 32, 32, OR)
-ATOMIC_RMW(i64_atomic_rmw8_or_u, 8, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw16_or_u, 16, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw32_or_u, 32, 64, OR)
-ATOMIC_RMW(i64_atomic_rmw_or, 64, 64, OR)
+ATOMIC_RMW(i32_atomic_rmw8_or_u, 8, 32, fetch_or)
+ATOMIC_RMW(i32_atomic_rmw16_or_u, 16, 32, fetch_or)
+ATOMIC_RMW(i32_atomic_rmw_or, 32, 32, fetch_or)
+ATOMIC_RMW(i64_atomic_rmw8_or_u, 8, 64, fetch_or)
+ATOMIC_RMW(i64_atomic_rmw16_or_u, 16, 64, fetch_or)
+ATOMIC_RMW(i64_atomic_rmw32_or_u, 32, 64, fetch_or)
+ATOMIC_RMW(i64_atomic_rmw_or, 64, 64, fetch_or)
 
-ATOMIC_RMW(i32_atomic_rmw8_xor_u, 8, 32, XOR)
-ATOMIC_RMW(i32_atomic_rmw16_xor_u, 16, 32, XOR)
-ATOMIC_RMW(i32_atomic_rmw_xor, 32, 32, XOR)
-ATOMIC_RMW(i64_atomic_rmw8_xor_u, 8, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw16_xor_u, 16, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw32_xor_u, 32, 64, XOR)
-ATOMIC_RMW(i64_atomic_rmw_xor, 64, 64, XOR)
+ATOMIC_RMW(i32_atomic_rmw8_xor_u, 8, 32, fetch_xor)
+ATOMIC_RMW(i32_atomic_rmw16_xor_u, 16, 32, fetch_xor)
+ATOMIC_RMW(i32_atomic_rmw_xor, 32, 32, fetch_xor)
+ATOMIC_RMW(i64_atomic_rmw8_xor_u, 8, 64, fetch_xor)
+ATOMIC_RMW(i64_atomic_rmw16_xor_u, 16, 64, fetch_xor)
+ATOMIC_RMW(i64_atomic_rmw32_xor_u, 32, 64, fetch_xor)
+ATOMIC_RMW(i64_atomic_rmw_xor, 64, 64, fetch_xor)
 
-ATOMIC_RMW(i32_atomic_rmw8_xchg_u, 8, 32, XCHG)
-ATOMIC_RMW(i32_atomic_rmw16_xchg_u, 16, 32, XCHG)
-ATOMIC_RMW(i32_atomic_rmw_xchg, 32, 32, XCHG)
-ATOMIC_RMW(i64_atomic_rmw8_xchg_u, 8, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw16_xchg_u, 16, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw32_xchg_u, 32, 64, XCHG)
-ATOMIC_RMW(i64_atomic_rmw_xchg, 64, 64, XCHG)
+ATOMIC_RMW(i32_atomic_rmw8_xchg_u, 8, 32, exchange)
+ATOMIC_RMW(i32_atomic_rmw16_xchg_u, 16, 32, exchange)
+ATOMIC_RMW(i32_atomic_rmw_xchg, 32, 32, exchange)
+ATOMIC_RMW(i64_atomic_rmw8_xchg_u, 8, 64, exchange)
+ATOMIC_RMW(i64_atomic_rmw16_xchg_u, 16, 64, exchange)
+ATOMIC_RMW(i64_atomic_rmw32_xchg_u, 32, 64, exchange)
+ATOMIC_RMW(i64_atomic_rmw_xchg, 64, 64, exchange)
 
 ATOMIC_RMW_CMPXCHG(i32_atomic_rmw8_cmpxchg_u, 8, 32)
 ATOMIC_RMW_CMPXCHG(i32_atomic_rmw16_cmpxchg_u, 16, 32)
@@ -0,0 +1,20 @@
+/* clang-format off */
+
+/*
+ * superinstructions for the pre-decoded code.
+ * the opcodes are relative to PREDECODED_OP_FUSED.
+ *
+ * the immediates of the original instructions are concatenated.
+ * eg. local_get_i32_const has a localidx and an i32 immediate.
+ *
+ * the pre-decoder also uses i32_const_add for "i32.const; i32.sub"
+ * by negating the constant.
+ *
+ * see also insn_list_reg.h for the register-operand forms, which
+ * are produced by fusing more instructions to these.
+ */
+
+INSTRUCTION(0x00, "local.get+local.get", local_get2, 0)
+INSTRUCTION(0x01, "local.get+i32.const", local_get_i32_const, 0)
+INSTRUCTION(0x02, "i32.const+i32.add", i32_const_add, 0)
+INSTRUCTION(0x03, "local.get+i64.const", local_get_i64_const, 0)
@@ -0,0 +1,50 @@
+/* clang-format off */
+
+/*
+ * binary instructions which have register-operand forms in
+ * the pre-decoded code. see insn_impl_reg.h.
+ *
+ * REG_INSTRUCTION(index, opcode, name, func, operand bits)
+ */
+
+REG_INSTRUCTION(0x00, 0x46, "i32.eq", i32_eq, 32)
+REG_INSTRUCTION(0x01, 0x47, "i32.ne", i32_ne, 32)
+REG_INSTRUCTION(0x02, 0x48, "i32.lt_s", i32_lt_s, 32)
+REG_INSTRUCTION(0x03, 0x49, "i32.lt_u", i32_lt_u, 32)
+REG_INSTRUCTION(0x04, 0x4a, "i32.gt_s", i32_gt_s, 32)
+REG_INSTRUCTION(0x05, 0x4b, "i32.gt_u", i32_gt_u, 32)
+REG_INSTRUCTION(0x06, 0x4c, "i32.le_s", i32_le_s, 32)
+REG_INSTRUCTION(0x07, 0x4d, "i32.le_u", i32_le_u, 32)
+REG_INSTRUCTION(0x08, 0x4e, "i32.ge_s", i32_ge_s, 32)
+REG_INSTRUCTION(0x09, 0x4f, "i32.ge_u", i32_ge_u, 32)
+
+REG_INSTRUCTION(0x0a, 0x51, "i64.eq", i64_eq, 64)
+REG_INSTRUCTION(0x0b, 0x52, "i64.ne", i64_ne, 64)
+REG_INSTRUCTION(0x0c, 0x53, "i64.lt_s", i64_lt_s, 64)
+REG_INSTRUCTION(0x0d, 0x54, "i64.lt_u", i64_lt_u, 64)
+REG_INSTRUCTION(0x0e, 0x55, "i64.gt_s", i64_gt_s, 64)
+REG_INSTRUCTION(0x0f, 0x56, "i64.gt_u", i64_gt_u, 64)
+REG_INSTRUCTION(0x10, 0x57, "i64.le_s", i64_le_s, 64)
+REG_INSTRUCTION(0x11, 0x58, "i64.le_u", i64_le_u, 64)
+REG_INSTRUCTION(0x12, 0x59, "i64.ge_s", i64_ge_s, 64)
+REG_INSTRUCTION(0x13, 0x5a, "i64.ge_u", i64_ge_u, 64)
+
+REG_INSTRUCTION(0x14, 0x6a, "i32.add", i32_add, 32)
+REG_INSTRUCTION(0x15, 0x6b, "i32.sub", i32_sub, 32)
+REG_INSTRUCTION(0x16, 0x6c, "i32.mul", i32_mul, 32)
+REG_INSTRUCTION(0x17, 0x71, "i32.and", i32_and, 32)
+REG_INSTRUCTION(0x18, 0x72, "i32.or", i32_or, 32)
+REG_INSTRUCTION(0x19, 0x73, "i32.xor", i32_xor, 32)
+REG_INSTRUCTION(0x1a, 0x74, "i32.shl", i32_shl, 32)
+REG_INSTRUCTION(0x1b, 0x75, "i32.shr_s", i32_shr_s, 32)
+REG_INSTRUCTION(0x1c, 0x76, "i32.shr_u", i32_shr_u, 32)
+
+REG_INSTRUCTION(0x1d, 0x7c, "i64.add", i64_add, 64)
+REG_INSTRUCTION(0x1e, 0x7d, "i64.sub", i64_sub, 64)
+REG_INSTRUCTION(0x1f, 0x7e, "i64.mul", i64_mul, 64)
+REG_INSTRUCTION(0x20, 0x83, "i64.and", i64_and, 64)
+REG_INSTRUCTION(0x21, 0x84, "i64.or", i64_or, 64)
+REG_INSTRUCTION(0x22, 0x85, "i64.xor", i64_xor, 64)
+REG_INSTRUCTION(0x23, 0x86, "i64.shl", i64_shl, 64)
+REG_INSTRUCTION(0x24, 0x87, "i64.shr_s", i64_shr_s, 64)
+REG_INSTRUCTION(0x25, 0x88, "i64.shr_u", i64_shr_u, 64)
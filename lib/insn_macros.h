@@ -134,5 +134,7 @@
         READ_IMM(uint64_t, VAR, read_leb_i64(&p, ep, &VAR),                   \
                  read_leb_i64_nocheck(&p))
 
-#define READ_U8(VAR) READ_IMM(uint8_t, VAR, read_u8(&p, ep, &VAR), *p++)
-#define READ_U8_TO(VAR) READ_IMM_TO(VAR, read_u8(&p, ep, &VAR), *p++)
+#define READ_U8(VAR)                                                          \
+        READ_IMM(uint8_t, VAR, read_u8(&p, ep, &VAR), read_u8_nocheck(&p))
+#define READ_U8_TO(VAR)                                                       \
+        READ_IMM_TO(VAR, read_u8(&p, ep, &VAR), read_u8_nocheck(&p))
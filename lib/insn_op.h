@@ -126,8 +126,9 @@ fail:                                                                         \
                 struct val val_c;                                             \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
-                                            memarg.offset, MEM / 8, &datap);  \
+                        ret = memory_access_getptr(                           \
+                                ECTX, memarg.memidx, val_i.u.i32,             \
+                                memarg.offset, MEM / 8, &datap, p);           \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
@@ -157,8 +158,9 @@ fail:                                                                         \
                 POP_VAL(TYPE_i32, i);                                         \
                 if (EXECUTING) {                                              \
                         void *datap;                                          \
-                        ret = memory_getptr(ECTX, memarg.memidx, val_i.u.i32, \
-                                            memarg.offset, MEM / 8, &datap);  \
+                        ret = memory_access_getptr(                           \
+                                ECTX, memarg.memidx, val_i.u.i32,             \
+                                memarg.offset, MEM / 8, &datap, p);           \
                         if (ret != 0) {                                       \
                                 goto fail;                                    \
                         }                                                     \
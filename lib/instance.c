@@ -9,7 +9,10 @@
 #include "exec.h"
 #include "instance.h"
 #include "mem.h"
+#include "memory_guard.h"
+#include "memory_reserve.h"
 #include "module.h"
+#include "name.h"
 #include "nbio.h"
 #include "shared_memory_impl.h"
 #include "suspend.h"
@@ -157,6 +160,31 @@ check_tagtype(const struct import_object_entry *e, const void *vp)
 }
 #endif
 
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+/*
+ * try to place the memory in a reserved address space.
+ * returns ENOTSUP if it isn't possible.
+ */
+static int
+memory_instance_reserve(struct meminst *mi)
+{
+        const struct memtype *mt = mi->type;
+        const uint32_t page_shift = memtype_page_shift(mt);
+        uint64_t size = (uint64_t)mt->lim.min << page_shift;
+        uint64_t max_size = (uint64_t)mt->lim.max << page_shift;
+        if (max_size > SIZE_MAX) {
+                return ENOTSUP;
+        }
+#if defined(TOYWASM_USE_GUARD_PAGES)
+        int ret = memory_guard_create(mi, size);
+        if (ret != ENOTSUP) {
+                return ret;
+        }
+#endif
+        return memory_reserve_create(mi, max_size, size);
+}
+#endif
+
 int
 memory_instance_create(struct mem_context *mctx, struct meminst **mip,
                        const struct memtype *mt) NO_THREAD_SAFETY_ANALYSIS
@@ -169,6 +197,15 @@ memory_instance_create(struct mem_context *mctx, struct meminst **mip,
                 ret = ENOMEM;
                 goto fail;
         }
+        mp->type = mt;
+        mp->mctx = mctx;
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        ret = memory_instance_reserve(mp);
+        if (ret != 0 && ret != ENOTSUP) {
+                mem_free(mctx, mp, sizeof(*mp));
+                goto fail;
+        }
+#endif
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
         if ((mt->flags & MEMTYPE_FLAG_SHARED) != 0) {
 #if defined(TOYWASM_PREALLOC_SHARED_MEMORY)
@@ -193,10 +230,24 @@ memory_instance_create(struct mem_context *mctx, struct meminst **mip,
                 }
                 mp->shared = mem_zalloc(mctx, sizeof(*mp->shared));
                 if (mp->shared == NULL) {
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+                        if (mp->reserved != 0) {
+                                memory_reserve_destroy(mp);
+                        }
+#endif
                         mem_free(mctx, mp, sizeof(*mp));
                         ret = ENOMEM;
                         goto fail;
                 }
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+                if (mp->reserved != 0) {
+                        /*
+                         * a memory in a reserved address space never
+                         * moves. no need to preallocate.
+                         */
+                        need_in_bytes = 0;
+                }
+#endif
                 if (need_in_bytes > 0) {
                         mp->data = mem_zalloc(mctx, need_in_bytes);
                         if (mp->data == NULL) {
@@ -206,15 +257,16 @@ memory_instance_create(struct mem_context *mctx, struct meminst **mip,
                                 ret = ENOMEM;
                                 goto fail;
                         }
+                        mp->allocated = need_in_bytes;
                 }
-                mp->allocated = need_in_bytes;
                 waiter_list_table_init(&mp->shared->tab);
+#if defined(TOYWASM_USE_FUTEX)
+                atomic_init(&mp->shared->nwaiters64, 0);
+#endif
                 toywasm_mutex_init(&mp->shared->lock);
         }
 #endif
         mp->size_in_pages = mt->lim.min;
-        mp->type = mt;
-        mp->mctx = mctx;
         *mip = mp;
         return 0;
 fail:
@@ -234,6 +286,11 @@ memory_instance_destroy(struct mem_context *mctx, struct meminst *mi)
                 toywasm_mutex_destroy(&shared->lock);
                 mem_free(mctx, shared, sizeof(*shared));
         }
+#endif
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        if (mi->reserved != 0) {
+                memory_reserve_destroy(mi);
+        }
 #endif
         mem_free(mctx, mi->data, mi->allocated);
         mem_free(mctx, mi, sizeof(*mi));
@@ -465,11 +522,41 @@ fail:
         return ret;
 }
 
-int
-instance_create_no_init(struct mem_context *mctx, const struct module *m,
-                        struct instance **instp,
-                        const struct import_object *imports,
-                        struct report *report)
+static void
+copy_imports(struct instance *inst, const struct instance *src)
+{
+        const struct module *m = inst->module;
+        uint32_t i;
+
+        assert(src->module == m);
+        for (i = 0; i < m->nimportedfuncs; i++) {
+                VEC_ELEM(inst->funcs, i) = VEC_ELEM(src->funcs, i);
+        }
+        for (i = 0; i < m->nimportedtables; i++) {
+                VEC_ELEM(inst->tables, i) = VEC_ELEM(src->tables, i);
+        }
+        for (i = 0; i < m->nimportedmems; i++) {
+                VEC_ELEM(inst->mems, i) = VEC_ELEM(src->mems, i);
+        }
+        for (i = 0; i < m->nimportedglobals; i++) {
+                VEC_ELEM(inst->globals, i) = VEC_ELEM(src->globals, i);
+        }
+#if defined(TOYWASM_ENABLE_WASM_EXCEPTION_HANDLING)
+        for (i = 0; i < m->nimportedtags; i++) {
+                VEC_ELEM(inst->tags, i) = VEC_ELEM(src->tags, i);
+        }
+#endif
+}
+
+/*
+ * the imports are taken from either of "imports" or "imports_from".
+ */
+static int
+instance_create_no_init1(struct mem_context *mctx, const struct module *m,
+                         struct instance **instp,
+                         const struct import_object *imports,
+                         const struct instance *imports_from,
+                         struct report *report)
 {
         struct instance *inst;
         uint32_t i;
@@ -511,9 +598,13 @@ instance_create_no_init(struct mem_context *mctx, const struct module *m,
         }
 #endif
 
-        ret = resolve_imports(inst, imports, report);
-        if (ret != 0) {
-                goto fail;
+        if (imports_from != NULL) {
+                copy_imports(inst, imports_from);
+        } else {
+                ret = resolve_imports(inst, imports, report);
+                if (ret != 0) {
+                        goto fail;
+                }
         }
 
         for (i = m->nimportedfuncs; i < nfuncs; i++) {
@@ -525,6 +616,9 @@ instance_create_no_init(struct mem_context *mctx, const struct module *m,
                 fp->is_host = false;
                 fp->u.wasm.instance = inst;
                 fp->u.wasm.funcidx = i;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+                fp->canonid = module_functype(m, i)->canonid;
+#endif
                 VEC_ELEM(inst->funcs, i) = fp;
         }
 
@@ -587,6 +681,25 @@ fail:
         return ret;
 }
 
+int
+instance_create_no_init(struct mem_context *mctx, const struct module *m,
+                        struct instance **instp,
+                        const struct import_object *imports,
+                        struct report *report)
+{
+        return instance_create_no_init1(mctx, m, instp, imports, NULL,
+                                        report);
+}
+
+int
+instance_create_no_init_from(struct mem_context *mctx,
+                             const struct instance *src,
+                             struct instance **instp)
+{
+        return instance_create_no_init1(mctx, src->module, instp, NULL, src,
+                                        NULL);
+}
+
 int
 instance_execute_init(struct exec_context *ctx)
 {
@@ -769,6 +882,57 @@ instance_execute_handle_restart(struct exec_context *ctx, int exec_ret)
         return ret;
 }
 
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+static int
+cmp_func_ninsns(const void *a, const void *b)
+{
+        const struct funcinst *fa = *(const struct funcinst *const *)a;
+        const struct funcinst *fb = *(const struct funcinst *const *)b;
+        if (fa->u.wasm.ninsns != fb->u.wasm.ninsns) {
+                return (fa->u.wasm.ninsns > fb->u.wasm.ninsns) ? -1 : 1;
+        }
+        return (fa->u.wasm.funcidx < fb->u.wasm.funcidx) ? -1 : 1;
+}
+
+static void
+print_func_stats(const struct instance *inst)
+{
+        const struct module *m = inst->module;
+        const struct funcinst **fis;
+        struct nametable table;
+        uint32_t n = 0;
+        uint32_t i;
+
+        fis = malloc(m->nfuncs * sizeof(*fis));
+        if (fis == NULL) {
+                return;
+        }
+        for (i = 0; i < m->nfuncs; i++) {
+                const struct funcinst *fi =
+                        VEC_ELEM(inst->funcs, m->nimportedfuncs + i);
+                if (fi->u.wasm.ncalls == 0 && fi->u.wasm.ninsns == 0) {
+                        continue;
+                }
+                fis[n++] = fi;
+        }
+        qsort(fis, n, sizeof(*fis), cmp_func_ninsns);
+        nbio_printf("=== function statistics ===\n");
+        nbio_printf("%12s %12s %s\n", "insns", "calls", "function");
+        nametable_init(&table);
+        for (i = 0; i < n; i++) {
+                const struct funcinst *fi = fis[i];
+                struct name name;
+                nametable_lookup_func(&table, m, fi->u.wasm.funcidx, &name);
+                nbio_printf("%12" PRIu64 " %12" PRIu64 " %.*s[%" PRIu32
+                            "]\n",
+                            fi->u.wasm.ninsns, fi->u.wasm.ncalls, CSTR(&name),
+                            fi->u.wasm.funcidx);
+        }
+        nametable_clear(&table);
+        free(fis);
+}
+#endif
+
 void
 instance_print_stats(const struct instance *inst)
 {
@@ -784,4 +948,7 @@ instance_print_stats(const struct instance *inst)
                             i, mi->allocated, mi->size_in_pages, lim->min,
                             lim->max, 1 << memtype_page_shift(mi->type));
         }
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+        print_func_stats(inst);
+#endif
 }
@@ -44,6 +44,15 @@ int instance_create_no_init(struct mem_context *mctx, const struct module *m,
                             struct report *report);
 int instance_execute_init(struct exec_context *ctx);
 
+/*
+ * instance_create_no_init_from is instance_create_no_init with the
+ * imports resolved to the same entities as the existing instance "src"
+ * of the same module. it's used by instance_clone.
+ */
+int instance_create_no_init_from(struct mem_context *mctx,
+                                 const struct instance *src,
+                                 struct instance **instp);
+
 /*
  * Note: If you have multiple instances linked together
  * with import/export, usually the only safe way to destroy those
@@ -155,6 +164,7 @@ void table_instance_destroy(struct mem_context *mctx, struct tableinst *ti);
 void table_set(struct tableinst *tinst, uint32_t elemidx,
                const struct val *val);
 void table_get(struct tableinst *tinst, uint32_t elemidx, struct val *val);
+void table_modified(struct tableinst *tinst);
 int table_grow(struct tableinst *tinst, const struct val *val, uint32_t n);
 int table_get_func(struct exec_context *ectx, const struct tableinst *t,
                    uint32_t i, const struct functype *ft,
@@ -0,0 +1,659 @@
+/*
+ * instance cloning
+ *
+ * instance_template_create takes a snapshot of the state of an instance:
+ * memories, globals, tables and the dropped segments.
+ * instance_clone creates a new instance in the state of the snapshot
+ * without the instantiation process. (running the data and element
+ * segments, the start function, etc.) it's useful to run many short-lived
+ * instances of the same initialized module. eg. an instance per request.
+ *
+ * memories:
+ *
+ * with TOYWASM_USE_RESERVED_MEMORY on Linux, the snapshot of a memory
+ * is a memfd. instance_clone maps it over the reserved address space
+ * of the new memory with MAP_PRIVATE. this way, cloning a memory is
+ * O(1) and its pages are copied by the kernel only when written.
+ * the pages of the snapshot which are all zero are not written to the
+ * memfd to keep it sparse.
+ *
+ * otherwise, the snapshot is a plain copy and instance_clone copies
+ * the contents to the new memory.
+ *
+ * instance_clone_reset restores a clone to the state of the snapshot
+ * so that it can be reused. (see instance_pool.c) with the memfd,
+ * it's MADV_DONTNEED, which only costs for the pages actually modified.
+ * the memories and tables which have grown are shrunk back.
+ *
+ * globals and tables:
+ *
+ * they are simply copied. funcref values which refer to the functions
+ * of the original instance are converted to the ones of the clone.
+ *
+ * imports:
+ *
+ * a clone shares the imports with the original instance.
+ * (instance_create_no_init_from)
+ *
+ * limitations:
+ *
+ * - shared memories are not supported. ENOTSUP.
+ *
+ * - host state, like wasi file descriptors, is not a part of
+ *   the snapshot. a clone uses the same host instances as the original.
+ */
+
+#define _GNU_SOURCE      /* memfd_create */
+#define _DARWIN_C_SOURCE /* MAP_ANON */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "instance.h"
+#include "instance_clone.h"
+#include "mem.h"
+#include "memory_reserve.h"
+#include "type.h"
+#include "xlog.h"
+
+#if defined(__linux__) && defined(TOYWASM_USE_RESERVED_MEMORY)
+#define INSTANCE_CLONE_COW
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct template_mem {
+        uint32_t size_in_pages;
+        size_t size; /* bytes in the snapshot. the rest are zero. */
+#if defined(INSTANCE_CLONE_COW)
+        int fd; /* a memfd. -1 if not used. */
+#endif
+        uint8_t *data; /* a copy. NULL if fd is used. */
+};
+
+struct instance_template {
+        const struct instance *inst;
+        struct mem_context *mctx;
+
+        uint32_t nmems;
+        struct template_mem *mems;
+
+        uint32_t ntables;
+        struct tableinst **tables;
+
+        uint32_t nglobals;
+        struct val *globals;
+
+        struct bitmap data_dropped;
+        struct bitmap elem_dropped;
+};
+
+#if defined(INSTANCE_CLONE_COW)
+static size_t
+host_page_size(void)
+{
+        long sz = sysconf(_SC_PAGESIZE);
+        if (sz <= 0) {
+                return 4096;
+        }
+        return (size_t)sz;
+}
+
+static size_t
+round_up_to_host_page(size_t sz)
+{
+        size_t pgsz = host_page_size();
+        return (sz + pgsz - 1) / pgsz * pgsz;
+}
+
+static bool
+is_zero(const uint8_t *p, size_t sz)
+{
+        return sz == 0 || (p[0] == 0 && !memcmp(p, p + 1, sz - 1));
+}
+
+/*
+ * write the non-zero pages of the memory to a memfd.
+ */
+static int
+template_mem_memfd(struct template_mem *tm, const uint8_t *p)
+{
+        const size_t pgsz = host_page_size();
+        int ret;
+        int fd = memfd_create("toywasm-instance-template", MFD_CLOEXEC);
+        if (fd == -1) {
+                ret = errno;
+                xlog_trace("%s: memfd_create failed with %d", __func__, ret);
+                return ret;
+        }
+        if (ftruncate(fd, round_up_to_host_page(tm->size)) != 0) {
+                ret = errno;
+                goto fail;
+        }
+        size_t off;
+        for (off = 0; off < tm->size; off += pgsz) {
+                size_t n = tm->size - off;
+                if (n > pgsz) {
+                        n = pgsz;
+                }
+                if (is_zero(p + off, n)) {
+                        continue;
+                }
+                size_t done = 0;
+                while (done < n) {
+                        ssize_t ssz = pwrite(fd, p + off + done, n - done,
+                                             off + done);
+                        if (ssz == -1) {
+                                ret = errno;
+                                if (ret == EINTR) {
+                                        continue;
+                                }
+                                goto fail;
+                        }
+                        done += ssz;
+                }
+        }
+        tm->fd = fd;
+        return 0;
+fail:
+        close(fd);
+        return ret;
+}
+
+static int
+template_mem_read(const struct template_mem *tm, uint8_t *p)
+{
+        size_t done = 0;
+        while (done < tm->size) {
+                ssize_t ssz = pread(tm->fd, p + done, tm->size - done, done);
+                if (ssz == -1) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        return errno;
+                }
+                if (ssz == 0) {
+                        return EIO;
+                }
+                done += ssz;
+        }
+        return 0;
+}
+#endif /* defined(INSTANCE_CLONE_COW) */
+
+static int
+template_mem_init(struct mem_context *mctx, struct template_mem *tm,
+                  const struct meminst *mi)
+{
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+        if (mi->shared != NULL) {
+                xlog_trace("%s: shared memory", __func__);
+                return ENOTSUP;
+        }
+#endif
+        uint64_t size_in_bytes = (uint64_t)mi->size_in_pages
+                                 << memtype_page_shift(mi->type);
+        tm->size_in_pages = mi->size_in_pages;
+        tm->size = mi->allocated;
+        if (tm->size > size_in_bytes) {
+                tm->size = size_in_bytes;
+        }
+        if (tm->size == 0) {
+                return 0;
+        }
+#if defined(INSTANCE_CLONE_COW)
+        if (template_mem_memfd(tm, mi->data) == 0) {
+                return 0;
+        }
+        /* fall back to a copy */
+#endif
+        tm->data = mem_alloc(mctx, tm->size);
+        if (tm->data == NULL) {
+                return ENOMEM;
+        }
+        memcpy(tm->data, mi->data, tm->size);
+        return 0;
+}
+
+static void
+template_mem_clear(struct mem_context *mctx, struct template_mem *tm)
+{
+#if defined(INSTANCE_CLONE_COW)
+        if (tm->fd != -1) {
+                close(tm->fd);
+        }
+#endif
+        if (tm->data != NULL) {
+                mem_free(mctx, tm->data, tm->size);
+        }
+}
+
+static int
+template_table_init(struct mem_context *mctx, struct tableinst **tip,
+                    const struct tableinst *src)
+{
+        struct tableinst *ti;
+        int ret;
+        ret = table_instance_create(mctx, &ti, src->type);
+        if (ret != 0) {
+                return ret;
+        }
+        if (src->size > ti->size) {
+                struct val null;
+                memset(&null, 0, sizeof(null));
+                if ((uint32_t)table_grow(ti, &null, src->size - ti->size) ==
+                    (uint32_t)-1) {
+                        table_instance_destroy(mctx, ti);
+                        return ENOMEM;
+                }
+        }
+        uint32_t csz = valtype_cellsize(src->type->et);
+        if (src->size > 0) {
+                memcpy(ti->cells, src->cells,
+                       (size_t)src->size * csz * sizeof(*ti->cells));
+        }
+        *tip = ti;
+        return 0;
+}
+
+static int
+bitmap_dup(struct mem_context *mctx, struct bitmap *dst,
+           const struct bitmap *src, uint32_t n)
+{
+        int ret = bitmap_alloc(mctx, dst, n);
+        if (ret != 0) {
+                return ret;
+        }
+        bitmap_copy(dst, src, n);
+        return 0;
+}
+
+int
+instance_template_create(struct mem_context *mctx,
+                         const struct instance *inst,
+                         struct instance_template **tp)
+{
+        const struct module *m = inst->module;
+        struct instance_template *t;
+        uint32_t i;
+        int ret;
+
+        t = mem_zalloc(mctx, sizeof(*t));
+        if (t == NULL) {
+                return ENOMEM;
+        }
+        t->inst = inst;
+        t->mctx = mctx;
+        if (m->nmems > 0) {
+                t->mems = mem_calloc(mctx, m->nmems, sizeof(*t->mems));
+                if (t->mems == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+                t->nmems = m->nmems;
+        }
+#if defined(INSTANCE_CLONE_COW)
+        for (i = 0; i < t->nmems; i++) {
+                t->mems[i].fd = -1;
+        }
+#endif
+        for (i = 0; i < t->nmems; i++) {
+                const struct meminst *mi =
+                        VEC_ELEM(inst->mems, m->nimportedmems + i);
+                ret = template_mem_init(mctx, &t->mems[i], mi);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        if (m->ntables > 0) {
+                t->tables = mem_calloc(mctx, m->ntables, sizeof(*t->tables));
+                if (t->tables == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+                t->ntables = m->ntables;
+        }
+        for (i = 0; i < t->ntables; i++) {
+                const struct tableinst *ti =
+                        VEC_ELEM(inst->tables, m->nimportedtables + i);
+                ret = template_table_init(mctx, &t->tables[i], ti);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        if (m->nglobals > 0) {
+                t->globals = mem_calloc(mctx, m->nglobals, sizeof(*t->globals));
+                if (t->globals == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+                t->nglobals = m->nglobals;
+        }
+        for (i = 0; i < t->nglobals; i++) {
+                const struct globalinst *gi =
+                        VEC_ELEM(inst->globals, m->nimportedglobals + i);
+                t->globals[i] = gi->val;
+        }
+        ret = bitmap_dup(mctx, &t->data_dropped, &inst->data_dropped,
+                         m->ndatas);
+        if (ret != 0) {
+                goto fail;
+        }
+        ret = bitmap_dup(mctx, &t->elem_dropped, &inst->elem_dropped,
+                         m->nelems);
+        if (ret != 0) {
+                bitmap_free(mctx, &t->data_dropped, m->ndatas);
+                goto fail;
+        }
+        *tp = t;
+        return 0;
+fail:
+        if (t->mems != NULL) {
+                for (i = 0; i < t->nmems; i++) {
+                        template_mem_clear(mctx, &t->mems[i]);
+                }
+                mem_free(mctx, t->mems, t->nmems * sizeof(*t->mems));
+        }
+        if (t->tables != NULL) {
+                for (i = 0; i < t->ntables; i++) {
+                        table_instance_destroy(mctx, t->tables[i]);
+                }
+                mem_free(mctx, t->tables, t->ntables * sizeof(*t->tables));
+        }
+        if (t->globals != NULL) {
+                mem_free(mctx, t->globals, t->nglobals * sizeof(*t->globals));
+        }
+        mem_free(mctx, t, sizeof(*t));
+        return ret;
+}
+
+void
+instance_template_destroy(struct instance_template *t)
+{
+        struct mem_context *mctx = t->mctx;
+        const struct module *m = t->inst->module;
+        uint32_t i;
+        for (i = 0; i < t->nmems; i++) {
+                template_mem_clear(mctx, &t->mems[i]);
+        }
+        if (t->mems != NULL) {
+                mem_free(mctx, t->mems, t->nmems * sizeof(*t->mems));
+        }
+        for (i = 0; i < t->ntables; i++) {
+                table_instance_destroy(mctx, t->tables[i]);
+        }
+        if (t->tables != NULL) {
+                mem_free(mctx, t->tables, t->ntables * sizeof(*t->tables));
+        }
+        if (t->globals != NULL) {
+                mem_free(mctx, t->globals, t->nglobals * sizeof(*t->globals));
+        }
+        bitmap_free(mctx, &t->data_dropped, m->ndatas);
+        bitmap_free(mctx, &t->elem_dropped, m->nelems);
+        mem_free(mctx, t, sizeof(*t));
+}
+
+/*
+ * convert a funcref to a function of the original instance to
+ * the corresponding function of the clone.
+ */
+static void
+clone_val(const struct instance_template *t, struct instance *inst,
+          enum valtype type, struct val *val)
+{
+        if (type != TYPE_funcref) {
+                return;
+        }
+        const struct funcinst *fi = val->u.funcref.func;
+        if (fi != NULL && !fi->is_host && fi->u.wasm.instance == t->inst) {
+                val->u.funcref.func = VEC_ELEM(inst->funcs, fi->u.wasm.funcidx);
+        }
+}
+
+static int
+copy_memory(const struct template_mem *tm, struct meminst *mi)
+{
+        assert(tm->size > 0);
+        assert(mi->allocated >= tm->size);
+#if defined(INSTANCE_CLONE_COW)
+        if (tm->fd != -1) {
+                /* the memory of the clone is not in a reserved space */
+                return template_mem_read(tm, mi->data);
+        }
+#endif
+        memcpy(mi->data, tm->data, tm->size);
+        return 0;
+}
+
+static int
+clone_memory(const struct template_mem *tm, struct meminst *mi)
+{
+        if (tm->size_in_pages > mi->size_in_pages) {
+                if (memory_grow(mi, tm->size_in_pages - mi->size_in_pages) ==
+                    (uint32_t)-1) {
+                        return ENOMEM;
+                }
+        }
+        if (tm->size == 0) {
+                return 0;
+        }
+#if defined(INSTANCE_CLONE_COW)
+        if (tm->fd != -1 && mi->reserved != 0) {
+                assert(mi->allocated >= tm->size);
+                void *p = mmap(mi->data, round_up_to_host_page(tm->size),
+                               PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                               tm->fd, 0);
+                if (p == MAP_FAILED) {
+                        return errno;
+                }
+                assert(p == mi->data);
+                return 0;
+        }
+#endif
+        if (mi->allocated < tm->size) {
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+                assert(mi->reserved == 0);
+#endif
+                void *np = mem_extend_zero(mi->mctx, mi->data, mi->allocated,
+                                           tm->size);
+                if (np == NULL) {
+                        return ENOMEM;
+                }
+                mi->data = np;
+                mi->allocated = tm->size;
+        }
+        return copy_memory(tm, mi);
+}
+
+/*
+ * restore a memory of a clone to the state of the template.
+ */
+static int
+reset_memory(const struct template_mem *tm, struct meminst *mi)
+{
+        size_t size = (size_t)tm->size_in_pages
+                      << memtype_page_shift(mi->type);
+
+        assert(mi->size_in_pages >= tm->size_in_pages);
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        if (mi->reserved != 0) {
+                int ret = memory_reserve_shrink(mi, size);
+                if (ret != 0) {
+                        return ret;
+                }
+                mi->size_in_pages = tm->size_in_pages;
+#if defined(INSTANCE_CLONE_COW)
+                /*
+                 * MADV_DONTNEED discards the modified pages of a
+                 * MAP_PRIVATE mapping. the next access sees the contents
+                 * of the memfd, or zero for anonymous pages.
+                 * only the pages actually touched cost.
+                 */
+                if (size > 0 && madvise(mi->data, round_up_to_host_page(size),
+                                        MADV_DONTNEED) != 0) {
+                        return errno;
+                }
+                if (tm->data != NULL) {
+                        memcpy(mi->data, tm->data, tm->size);
+                }
+                return 0;
+#endif
+        }
+#endif
+        if (mi->allocated > size) {
+                if (size == 0) {
+                        mem_free(mi->mctx, mi->data, mi->allocated);
+                        mi->data = NULL;
+                } else {
+                        void *np = mem_shrink(mi->mctx, mi->data,
+                                              mi->allocated, size);
+                        if (np == NULL) {
+                                return ENOMEM;
+                        }
+                        mi->data = np;
+                }
+                mi->allocated = size;
+        }
+        mi->size_in_pages = tm->size_in_pages;
+        assert(mi->allocated >= tm->size);
+        memset(mi->data + tm->size, 0, mi->allocated - tm->size);
+        if (tm->size == 0) {
+                return 0;
+        }
+        return copy_memory(tm, mi);
+}
+
+static int
+clone_table(const struct instance_template *t, struct instance *inst,
+            const struct tableinst *src, struct tableinst *ti)
+{
+        if (src->size > ti->size) {
+                struct val null;
+                memset(&null, 0, sizeof(null));
+                if ((uint32_t)table_grow(ti, &null, src->size - ti->size) ==
+                    (uint32_t)-1) {
+                        return ENOMEM;
+                }
+        }
+        uint32_t i;
+        for (i = 0; i < src->size; i++) {
+                struct val val;
+                table_get((struct tableinst *)src, i, &val);
+                clone_val(t, inst, src->type->et, &val);
+                table_set(ti, i, &val);
+        }
+        return 0;
+}
+
+/*
+ * shrink a table of a clone to the size of the template.
+ */
+static int
+reset_table(const struct tableinst *src, struct tableinst *ti)
+{
+        if (ti->size <= src->size) {
+                return 0;
+        }
+        uint32_t csz = valtype_cellsize(ti->type->et);
+        size_t obytes = (size_t)ti->size * csz * sizeof(*ti->cells);
+        size_t nbytes = (size_t)src->size * csz * sizeof(*ti->cells);
+        if (nbytes == 0) {
+                mem_free(ti->mctx, ti->cells, obytes);
+                ti->cells = NULL;
+        } else {
+                void *np = mem_shrink(ti->mctx, ti->cells, obytes, nbytes);
+                if (np == NULL) {
+                        return ENOMEM;
+                }
+                ti->cells = np;
+        }
+        ti->size = src->size;
+        table_modified(ti);
+        return 0;
+}
+
+static void
+clone_globals_and_segments(const struct instance_template *t,
+                           struct instance *inst)
+{
+        const struct module *m = t->inst->module;
+        uint32_t i;
+        for (i = 0; i < t->nglobals; i++) {
+                struct globalinst *gi =
+                        VEC_ELEM(inst->globals, m->nimportedglobals + i);
+                gi->val = t->globals[i];
+                clone_val(t, inst, gi->type->t, &gi->val);
+        }
+        bitmap_copy(&inst->data_dropped, &t->data_dropped, m->ndatas);
+        bitmap_copy(&inst->elem_dropped, &t->elem_dropped, m->nelems);
+}
+
+int
+instance_clone(struct mem_context *mctx, const struct instance_template *t,
+               struct instance **instp)
+{
+        const struct module *m = t->inst->module;
+        struct instance *inst;
+        uint32_t i;
+        int ret;
+
+        ret = instance_create_no_init_from(mctx, t->inst, &inst);
+        if (ret != 0) {
+                return ret;
+        }
+        for (i = 0; i < t->nmems; i++) {
+                struct meminst *mi = VEC_ELEM(inst->mems, m->nimportedmems + i);
+                ret = clone_memory(&t->mems[i], mi);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        for (i = 0; i < t->ntables; i++) {
+                struct tableinst *ti =
+                        VEC_ELEM(inst->tables, m->nimportedtables + i);
+                ret = clone_table(t, inst, t->tables[i], ti);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+        clone_globals_and_segments(t, inst);
+        *instp = inst;
+        return 0;
+fail:
+        instance_destroy(inst);
+        return ret;
+}
+
+int
+instance_clone_reset(const struct instance_template *t, struct instance *inst)
+{
+        const struct module *m = t->inst->module;
+        uint32_t i;
+        int ret;
+
+        assert(inst->module == m);
+        for (i = 0; i < t->nmems; i++) {
+                struct meminst *mi = VEC_ELEM(inst->mems, m->nimportedmems + i);
+                ret = reset_memory(&t->mems[i], mi);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        for (i = 0; i < t->ntables; i++) {
+                struct tableinst *ti =
+                        VEC_ELEM(inst->tables, m->nimportedtables + i);
+                ret = reset_table(t->tables[i], ti);
+                if (ret != 0) {
+                        return ret;
+                }
+                ret = clone_table(t, inst, t->tables[i], ti);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        clone_globals_and_segments(t, inst);
+        return 0;
+}
@@ -0,0 +1,48 @@
+#if !defined(_TOYWASM_INSTANCE_CLONE_H)
+#define _TOYWASM_INSTANCE_CLONE_H
+
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct instance;
+struct instance_template;
+struct mem_context;
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_INSTANCE_CLONE)
+/*
+ * take a snapshot of the state of an instance.
+ * see instance_clone.c.
+ *
+ * the instance should be kept alive and not destroyed until the
+ * template is destroyed. (but it can be executed)
+ */
+int instance_template_create(struct mem_context *mctx,
+                             const struct instance *inst,
+                             struct instance_template **tp);
+void instance_template_destroy(struct instance_template *t);
+
+/*
+ * create an instance from the template.
+ * the new instance is in the state of the snapshot. the start function
+ * and the segment initialization are not executed.
+ * it's destroyed with instance_destroy as usual.
+ */
+int instance_clone(struct mem_context *mctx,
+                   const struct instance_template *t,
+                   struct instance **instp);
+
+/*
+ * restore an instance created by instance_clone to the state of
+ * the template.
+ * on an error, the instance is in an unspecified state. it should
+ * be destroyed.
+ */
+int instance_clone_reset(const struct instance_template *t,
+                         struct instance *inst);
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_INSTANCE_CLONE_H) */
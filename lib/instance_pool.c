@@ -0,0 +1,287 @@
+/*
+ * instance pool
+ *
+ * a pool of instances in the same state, for short-lived uses like
+ * serverless-style request handling. instead of instance_create and
+ * instance_destroy for each request:
+ *
+ * - instance_pool_acquire takes an idle instance from the pool.
+ *   only when the pool is empty, a new instance is created with
+ *   instance_clone. (see instance_clone.c)
+ *
+ * - instance_pool_release resets the instance to the state of the
+ *   template with instance_clone_reset and puts it back to the pool.
+ *   it restores the contents of memories (with MADV_DONTNEED where
+ *   possible), globals, tables and dropped segments.
+ *   the instance is destroyed instead if the pool already has
+ *   max_idle instances.
+ *
+ * each pooled instance has its own exec_context, which is reused with
+ * exec_context_reset. the stacks grown by previous requests are kept.
+ *
+ * the pool itself is protected by a lock. resetting and cloning are
+ * done without the lock held.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "exec_context.h"
+#include "instance.h"
+#include "instance_clone.h"
+#include "instance_pool.h"
+#include "list.h"
+#include "lock.h"
+#include "mem.h"
+#include "nbio.h"
+#include "timeutil.h"
+#include "xlog.h"
+
+struct instance_pool {
+        TOYWASM_MUTEX_DEFINE(lock);
+        LIST_HEAD(struct pooled_instance) idle;
+        struct instance_pool_stats stats;
+        uint32_t max_idle;
+        const struct instance_template *t;
+        struct mem_context *mctx;
+};
+
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+        if (timespec_now(CLOCK_MONOTONIC, &ts) != 0) {
+                return 0;
+        }
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+account_latency(uint64_t *total, uint64_t *max, uint64_t ns)
+{
+        *total += ns;
+        if (*max < ns) {
+                *max = ns;
+        }
+}
+
+static int
+pooled_instance_create(struct instance_pool *pool,
+                       struct pooled_instance **pip)
+{
+        struct pooled_instance *pi;
+        int ret;
+
+        pi = mem_zalloc(pool->mctx, sizeof(*pi));
+        if (pi == NULL) {
+                return ENOMEM;
+        }
+        ret = instance_clone(pool->mctx, pool->t, &pi->inst);
+        if (ret != 0) {
+                xlog_trace("%s: instance_clone failed with %d", __func__,
+                           ret);
+                mem_free(pool->mctx, pi, sizeof(*pi));
+                return ret;
+        }
+        exec_context_init(&pi->ectx, pi->inst, pool->mctx);
+        *pip = pi;
+        return 0;
+}
+
+static void
+pooled_instance_destroy(struct instance_pool *pool, struct pooled_instance *pi)
+{
+        exec_context_clear(&pi->ectx);
+        instance_destroy(pi->inst);
+        mem_free(pool->mctx, pi, sizeof(*pi));
+}
+
+int
+instance_pool_create(struct mem_context *mctx,
+                     const struct instance_template *t, uint32_t max_idle,
+                     struct instance_pool **poolp)
+{
+        struct instance_pool *pool;
+
+        pool = mem_zalloc(mctx, sizeof(*pool));
+        if (pool == NULL) {
+                return ENOMEM;
+        }
+        toywasm_mutex_init(&pool->lock);
+        LIST_HEAD_INIT(&pool->idle);
+        pool->max_idle = max_idle;
+        pool->t = t;
+        pool->mctx = mctx;
+        *poolp = pool;
+        return 0;
+}
+
+void
+instance_pool_destroy(struct instance_pool *pool)
+{
+        struct pooled_instance *pi;
+
+        assert(pool->stats.nbusy == 0);
+        while ((pi = LIST_FIRST(&pool->idle)) != NULL) {
+                LIST_REMOVE(&pool->idle, pi, q);
+                pooled_instance_destroy(pool, pi);
+        }
+        toywasm_mutex_destroy(&pool->lock);
+        mem_free(pool->mctx, pool, sizeof(*pool));
+}
+
+int
+instance_pool_fill(struct instance_pool *pool, uint32_t n)
+{
+        uint32_t i;
+        int ret;
+
+        for (i = 0; i < n; i++) {
+                struct pooled_instance *pi;
+                ret = pooled_instance_create(pool, &pi);
+                if (ret != 0) {
+                        return ret;
+                }
+                toywasm_mutex_lock(&pool->lock);
+                if (pool->stats.nidle >= pool->max_idle) {
+                        toywasm_mutex_unlock(&pool->lock);
+                        pooled_instance_destroy(pool, pi);
+                        break;
+                }
+                LIST_INSERT_TAIL(&pool->idle, pi, q);
+                pool->stats.nidle++;
+                toywasm_mutex_unlock(&pool->lock);
+        }
+        return 0;
+}
+
+int
+instance_pool_acquire(struct instance_pool *pool,
+                      struct pooled_instance **pip)
+{
+        struct instance_pool_stats *st = &pool->stats;
+        struct pooled_instance *pi;
+        uint64_t start = now_ns();
+        int ret;
+
+        toywasm_mutex_lock(&pool->lock);
+        pi = LIST_FIRST(&pool->idle);
+        if (pi != NULL) {
+                LIST_REMOVE(&pool->idle, pi, q);
+                st->nidle--;
+        }
+        toywasm_mutex_unlock(&pool->lock);
+        const bool reuse = pi != NULL;
+        if (!reuse) {
+                ret = pooled_instance_create(pool, &pi);
+                if (ret != 0) {
+                        return ret;
+                }
+        } else {
+                exec_context_reset(&pi->ectx, pi->inst);
+        }
+        uint64_t ns = now_ns() - start;
+
+        toywasm_mutex_lock(&pool->lock);
+        st->nacquire++;
+        if (reuse) {
+                st->nreuse++;
+        } else {
+                st->nclone++;
+        }
+        st->nbusy++;
+        if (st->peak_nbusy < st->nbusy) {
+                st->peak_nbusy = st->nbusy;
+        }
+        account_latency(&st->acquire_ns_total, &st->acquire_ns_max, ns);
+        toywasm_mutex_unlock(&pool->lock);
+        *pip = pi;
+        return 0;
+}
+
+void
+instance_pool_release(struct instance_pool *pool, struct pooled_instance *pi)
+{
+        struct instance_pool_stats *st = &pool->stats;
+        bool discard;
+        int ret;
+
+        toywasm_mutex_lock(&pool->lock);
+        assert(st->nbusy > 0);
+        st->nbusy--;
+        st->nrelease++;
+        discard = st->nidle >= pool->max_idle;
+        if (discard) {
+                st->ndiscard++;
+        }
+        toywasm_mutex_unlock(&pool->lock);
+        if (discard) {
+                pooled_instance_destroy(pool, pi);
+                return;
+        }
+
+        uint64_t start = now_ns();
+        ret = instance_clone_reset(pool->t, pi->inst);
+        uint64_t ns = now_ns() - start;
+        if (ret != 0) {
+                xlog_trace("%s: instance_clone_reset failed with %d",
+                           __func__, ret);
+        }
+
+        toywasm_mutex_lock(&pool->lock);
+        if (ret == 0) {
+                st->nreset++;
+                account_latency(&st->reset_ns_total, &st->reset_ns_max, ns);
+        }
+        /* re-check max_idle as we dropped the lock */
+        discard = ret != 0 || st->nidle >= pool->max_idle;
+        if (discard) {
+                st->ndiscard++;
+        } else {
+                /* LIFO to reuse the most recently used instance */
+                LIST_INSERT_HEAD(&pool->idle, pi, q);
+                st->nidle++;
+        }
+        toywasm_mutex_unlock(&pool->lock);
+        if (discard) {
+                pooled_instance_destroy(pool, pi);
+        }
+}
+
+void
+instance_pool_get_stats(struct instance_pool *pool,
+                        struct instance_pool_stats *stats)
+{
+        toywasm_mutex_lock(&pool->lock);
+        *stats = pool->stats;
+        toywasm_mutex_unlock(&pool->lock);
+}
+
+void
+instance_pool_print_stats(struct instance_pool *pool)
+{
+        struct instance_pool_stats st;
+        instance_pool_get_stats(pool, &st);
+        nbio_printf("=== instance pool statistics ===\n");
+        nbio_printf("idle %" PRIu32 " busy %" PRIu32 " (peak %" PRIu32
+                    ") max_idle %" PRIu32 "\n",
+                    st.nidle, st.nbusy, st.peak_nbusy, pool->max_idle);
+        nbio_printf("acquire %" PRIu64 " (reuse %" PRIu64 " clone %" PRIu64
+                    ")\n",
+                    st.nacquire, st.nreuse, st.nclone);
+        nbio_printf("release %" PRIu64 " (discard %" PRIu64 ")\n",
+                    st.nrelease, st.ndiscard);
+        if (st.nacquire > 0) {
+                nbio_printf("acquire latency avg %" PRIu64 " ns max %" PRIu64
+                            " ns\n",
+                            st.acquire_ns_total / st.nacquire,
+                            st.acquire_ns_max);
+        }
+        if (st.nreset > 0) {
+                nbio_printf("reset latency avg %" PRIu64 " ns max %" PRIu64
+                            " ns\n",
+                            st.reset_ns_total / st.nreset, st.reset_ns_max);
+        }
+}
@@ -0,0 +1,93 @@
+#if !defined(_TOYWASM_INSTANCE_POOL_H)
+#define _TOYWASM_INSTANCE_POOL_H
+
+#include <stdint.h>
+
+#include "exec_context.h"
+#include "list.h"
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct instance;
+struct instance_pool;
+struct instance_template;
+struct mem_context;
+
+/*
+ * an instance and an exec_context to execute it.
+ * the ectx has been initialized (exec_context_reset) for the instance
+ * by instance_pool_acquire.
+ */
+struct pooled_instance {
+        struct instance *inst;
+        struct exec_context ectx;
+
+        /* private */
+        LIST_ENTRY(struct pooled_instance) q;
+};
+
+struct instance_pool_stats {
+        uint32_t nidle;      /* instances in the pool */
+        uint32_t nbusy;      /* instances acquired and not released yet */
+        uint32_t peak_nbusy; /* max of nbusy */
+
+        uint64_t nacquire;  /* instance_pool_acquire */
+        uint64_t nreuse;    /* ... served by an idle instance */
+        uint64_t nclone;    /* ... served by instance_clone */
+        uint64_t nrelease;  /* instance_pool_release */
+        uint64_t ndiscard;  /* ... destroyed instead of being reused */
+        uint64_t nreset;    /* instance_clone_reset */
+
+        /* latency in ns */
+        uint64_t acquire_ns_total;
+        uint64_t acquire_ns_max;
+        uint64_t reset_ns_total; /* instance_clone_reset on release */
+        uint64_t reset_ns_max;
+};
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_INSTANCE_POOL)
+/*
+ * create a pool of clones of the template.
+ * see instance_pool.c.
+ *
+ * max_idle is the max number of idle instances kept in the pool.
+ * the template should outlive the pool.
+ */
+int instance_pool_create(struct mem_context *mctx,
+                         const struct instance_template *t, uint32_t max_idle,
+                         struct instance_pool **poolp);
+
+/*
+ * destroy the pool and its idle instances.
+ * all instances should have been released.
+ */
+void instance_pool_destroy(struct instance_pool *pool);
+
+/*
+ * create n idle instances in advance.
+ */
+int instance_pool_fill(struct instance_pool *pool, uint32_t n);
+
+/*
+ * take an instance in the state of the template from the pool.
+ */
+int instance_pool_acquire(struct instance_pool *pool,
+                          struct pooled_instance **pip);
+
+/*
+ * return the instance to the pool.
+ * the instance is reset to the state of the template for the next user.
+ */
+void instance_pool_release(struct instance_pool *pool,
+                           struct pooled_instance *pi);
+
+void instance_pool_get_stats(struct instance_pool *pool,
+                             struct instance_pool_stats *stats);
+void instance_pool_print_stats(struct instance_pool *pool);
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_INSTANCE_POOL_H) */
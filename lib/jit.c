@@ -0,0 +1,333 @@
+/*
+ * a baseline jit compiler
+ *
+ * when load_options::generate_jit_code is set, module_load compiles
+ * function bodies into machine code with a simple single-pass
+ * template compiler. (jit_x86_64.c)
+ *
+ * the generated code is not a complete replacement of the interpreter.
+ * it runs within the interpreter's function frames and uses the same
+ * operand stack and locals. it leaves the following things to
+ * the interpreter by returning to exec_expr_continue with ctx->p pointing
+ * to the instruction to execute:
+ *
+ * - calls. the interpreter executes the call instruction and enters
+ *   the callee as usual. when the callee returns, the execution of
+ *   the caller resumes at the instruction next to the call, which is
+ *   an entry point of the generated code.
+ *
+ * - function returns. the generated code moves the results to the
+ *   bottom of the operand stack and exits at the "end" of the function.
+ *
+ * - interrupt checks. the generated code counts down the iterations of
+ *   loops and exits at the loop instruction when it reaches
+ *   exec_context::check_interval so that exec_expr_continue can call
+ *   check_interrupt. ETOYWASMRESTART is handled by the interpreter as
+ *   usual. the execution resumes at the loop instruction, which is
+ *   an entry point of the generated code.
+ *
+ * it means that a function frame never has labels while executing
+ * the generated code.
+ *
+ * functions containing instructions which the compiler doesn't support
+ * are not compiled and entirely executed by the interpreter.
+ */
+
+#define _DEFAULT_SOURCE  /* MAP_ANON */
+#define _DARWIN_C_SOURCE /* MAP_ANON */
+#define _NETBSD_SOURCE   /* MAP_ANON */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#include "context.h"
+#include "exec.h"
+#include "instance.h"
+#include "jit.h"
+#include "mem.h"
+#include "type.h"
+#include "util.h"
+#include "xlog.h"
+
+/*
+ * the trampoline at the beginning of the code buffer.
+ * see jit_arch_emit_trampoline.
+ */
+typedef int (*jit_trampoline_t)(struct exec_context *ctx, struct cell *stack,
+                                struct cell *locals, struct meminst *mi,
+                                const uint8_t *entry, struct jit_state *st);
+
+int
+jit_module(struct module *m, struct mem_context *mctx)
+{
+        struct jit_compile_context jc;
+        struct jit_code *jit = NULL;
+        struct jit_func *funcs = NULL;
+        uint8_t *code = MAP_FAILED;
+        size_t size = 0;
+        uint32_t ncompiled = 0;
+        uint32_t i;
+        int ret;
+
+        assert(m->jit == NULL);
+        memset(&jc, 0, sizeof(jc));
+        if (m->nfuncs == 0) {
+                return 0;
+        }
+        jc.mctx = mctx;
+        jc.m = m;
+        funcs = mem_calloc(mctx, m->nfuncs, sizeof(*funcs));
+        if (funcs == NULL) {
+                ret = ENOMEM;
+                goto fail;
+        }
+        jit_arch_emit_trampoline(&jc);
+        for (i = 0; i < m->nfuncs; i++) {
+                struct jit_func *jf = &funcs[i];
+                uint32_t start = jc.code.lsize;
+                jc.entries.lsize = 0;
+                ret = jit_arch_compile_func(&jc, i);
+                if (ret == ENOTSUP) {
+                        /* leave the function to the interpreter */
+                        xlog_trace("jit: func %" PRIu32 " is not compiled",
+                                   m->nimportedfuncs + i);
+                        jc.code.lsize = start;
+                        continue;
+                }
+                if (ret != 0) {
+                        goto fail;
+                }
+                assert(jc.entries.lsize > 0);
+                jf->entries = mem_alloc(
+                        mctx, jc.entries.lsize * sizeof(*jf->entries));
+                if (jf->entries == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+                memcpy(jf->entries, jc.entries.p,
+                       jc.entries.lsize * sizeof(*jf->entries));
+                jf->nentries = jc.entries.lsize;
+                ncompiled++;
+        }
+        if (ncompiled == 0) {
+                ret = 0;
+                goto fail;
+        }
+        size = jc.code.lsize;
+        code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                    -1, 0);
+        if (code == MAP_FAILED) {
+                ret = ENOMEM;
+                goto fail;
+        }
+        memcpy(code, jc.code.p, size);
+        if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+                ret = errno;
+                goto fail;
+        }
+        jit = mem_zalloc(mctx, sizeof(*jit));
+        if (jit == NULL) {
+                ret = ENOMEM;
+                goto fail;
+        }
+        jit->code = code;
+        jit->size = size;
+        jit->nfuncs = m->nfuncs;
+        jit->funcs = funcs;
+        m->jit = jit;
+        for (i = 0; i < m->nfuncs; i++) {
+                struct func *func = &m->funcs[i];
+                if (funcs[i].nentries == 0) {
+                        continue;
+                }
+                func->e.ei.jit = &funcs[i];
+#if defined(TOYWASM_USE_PREDECODE)
+                /* the generated code uses pcs in the original binary */
+                func->e.ei.predecoded = NULL;
+#endif
+        }
+        xlog_trace("jit: compiled %" PRIu32 " of %" PRIu32
+                   " functions into %zu bytes",
+                   ncompiled, m->nfuncs, size);
+        funcs = NULL;
+        code = MAP_FAILED;
+        ret = 0;
+fail:
+        if (code != MAP_FAILED) {
+                munmap(code, size);
+        }
+        if (funcs != NULL) {
+                for (i = 0; i < m->nfuncs; i++) {
+                        struct jit_func *jf = &funcs[i];
+                        if (jf->entries != NULL) {
+                                mem_free(mctx, jf->entries,
+                                         jf->nentries * sizeof(*jf->entries));
+                        }
+                }
+                mem_free(mctx, funcs, m->nfuncs * sizeof(*funcs));
+        }
+        VEC_FREE(mctx, jc.code);
+        VEC_FREE(mctx, jc.entries);
+        VEC_FREE(mctx, jc.blocks);
+        VEC_FREE(mctx, jc.fixups);
+        VEC_FREE(mctx, jc.labels);
+        return ret;
+}
+
+void
+jit_code_free(struct mem_context *mctx, struct module *m)
+{
+        struct jit_code *jit = m->jit;
+        uint32_t i;
+
+        if (jit == NULL) {
+                return;
+        }
+        for (i = 0; i < jit->nfuncs; i++) {
+                struct jit_func *jf = &jit->funcs[i];
+                if (jf->entries != NULL) {
+                        mem_free(mctx, jf->entries,
+                                 jf->nentries * sizeof(*jf->entries));
+                }
+        }
+        mem_free(mctx, jit->funcs, jit->nfuncs * sizeof(*jit->funcs));
+        munmap(jit->code, jit->size);
+        mem_free(mctx, jit, sizeof(*jit));
+        m->jit = NULL;
+}
+
+const struct jit_entry *
+jit_lookup(const struct jit_func *jf, const uint8_t *p,
+           const struct module *m)
+{
+        uint32_t pc = ptr2pc(m, p);
+        uint32_t left = 0;
+        uint32_t right = jf->nentries;
+        while (left < right) {
+                uint32_t mid = left + (right - left) / 2;
+                const struct jit_entry *e = &jf->entries[mid];
+                if (e->pc == pc) {
+                        return e;
+                }
+                if (e->pc < pc) {
+                        left = mid + 1;
+                } else {
+                        right = mid;
+                }
+        }
+        return NULL;
+}
+
+int
+jit_exec(struct exec_context *ctx, const struct jit_entry *e,
+         bool *exhaustedp)
+{
+        const struct instance *inst = ctx->instance;
+        const struct jit_code *jit = inst->module->jit;
+        struct funcframe *frame = &VEC_LASTELEM(ctx->frames);
+        struct meminst *mi = NULL;
+        struct jit_state st;
+        int ret;
+
+        assert(jit != NULL);
+        assert(ctx->stack.lsize >= e->height);
+        uint32_t base = ctx->stack.lsize - e->height;
+        if (inst->mems.lsize > 0) {
+                mi = VEC_ELEM(inst->mems, 0);
+        }
+        st.budget = ctx->check_interval;
+        st.exhausted = 0;
+        STAT_INC(ctx, jit_enter);
+        jit_trampoline_t trampoline = (jit_trampoline_t)(void *)jit->code;
+        ret = trampoline(ctx, &ctx->stack.p[base], frame_locals(ctx, frame),
+                         mi, jit->code + e->offset, &st);
+        ctx->p = st.p;
+        ctx->stack.lsize = base + st.height;
+        *exhaustedp = st.exhausted != 0;
+        return ret;
+}
+
+int
+jit_trap(struct exec_context *ctx, uint32_t id, uint32_t pc)
+{
+        switch (id) {
+        case TRAP_DIV_BY_ZERO:
+                return trap_with_id(ctx, id, "division by zero");
+        case TRAP_INTEGER_OVERFLOW:
+                return trap_with_id(ctx, id, "integer overflow");
+        case TRAP_UNREACHABLE:
+                return trap_with_id(ctx, id, "unreachable at %06" PRIx32, pc);
+        default:
+                assert(false);
+                return trap_with_id(ctx, id, "unknown trap at %06" PRIx32,
+                                    pc);
+        }
+}
+
+int
+jit_memory_grow(struct exec_context *ctx, struct cell *cells)
+{
+        uint32_t n;
+        memcpy(&n, cells, sizeof(n));
+        n = memory_grow2(ctx, 0, n);
+        memcpy(cells, &n, sizeof(n));
+        return 0;
+}
+
+int
+jit_memory_copy(struct exec_context *ctx, struct cell *cells)
+{
+        uint32_t d;
+        uint32_t s;
+        uint32_t n;
+        void *dst_p;
+        void *src_p;
+        int ret;
+
+        memcpy(&d, &cells[0], sizeof(d));
+        memcpy(&s, &cells[1], sizeof(s));
+        memcpy(&n, &cells[2], sizeof(n));
+        ret = memory_getptr(ctx, 0, s, 0, n, &src_p);
+        if (ret != 0) {
+                return ret;
+        }
+        bool moved = false;
+        ret = memory_getptr2(ctx, 0, d, 0, n, &dst_p, &moved);
+        if (ret != 0) {
+                return ret;
+        }
+        if (moved) {
+                ret = memory_getptr(ctx, 0, s, 0, n, &src_p);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        memmove(dst_p, src_p, n);
+        return 0;
+}
+
+int
+jit_memory_fill(struct exec_context *ctx, struct cell *cells)
+{
+        uint32_t d;
+        uint32_t val;
+        uint32_t n;
+        void *vp;
+        int ret;
+
+        memcpy(&d, &cells[0], sizeof(d));
+        memcpy(&val, &cells[1], sizeof(val));
+        memcpy(&n, &cells[2], sizeof(n));
+        ret = memory_getptr(ctx, 0, d, 0, n, &vp);
+        if (ret != 0) {
+                return ret;
+        }
+        memset(vp, (uint8_t)val, n);
+        return 0;
+}
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+#include "vec.h"
+
+struct cell;
+struct exec_context;
+struct expr_exec_info;
+struct functype;
+struct localtype;
+struct mem_context;
+struct module;
+
+/*
+ * a point where the generated code of a function can be entered.
+ *
+ * pc:     the pc of the instruction in the original binary.
+ *         (the function start, a loop, or the instruction next to a call)
+ * height: the operand stack height of the function at the pc, in cells.
+ * offset: the offset of the corresponding machine code in jit_code::code.
+ */
+struct jit_entry {
+        uint32_t pc;
+        uint32_t height;
+        uint32_t offset;
+};
+
+/*
+ * per-function jit info. entries are sorted by pc.
+ */
+struct jit_func {
+        uint32_t nentries;
+        struct jit_entry *entries;
+};
+
+/*
+ * the generated code for a module.
+ */
+struct jit_code {
+        uint8_t *code; /* mmap'ed, read-only and executable */
+        size_t size;
+        uint32_t nfuncs;
+        struct jit_func *funcs;
+};
+
+/*
+ * the state shared between jit_exec and the generated code.
+ * the generated code stores the pc and the operand stack height to
+ * resume the execution from when exiting to the interpreter.
+ */
+struct jit_state {
+        const uint8_t *p;
+        uint32_t height;
+        uint32_t budget; /* the number of loop iterations before exiting */
+        uint32_t exhausted;
+        void *ptr; /* scratch for memory_getptr */
+};
+
+/*
+ * the context for the compiler. (jit_x86_64.c)
+ */
+struct jit_block {
+        uint8_t op; /* 0 for the function body itself */
+        uint32_t height;
+        uint32_t param_arity;
+        uint32_t arity;
+        uint32_t loop_offset;
+        uint32_t else_fixup; /* UINT32_MAX if none */
+};
+
+struct jit_fixup {
+        uint32_t blockidx;
+        uint32_t offset; /* the offset of rel32 */
+};
+
+struct jit_compile_context {
+        struct mem_context *mctx;
+        const struct module *m;
+        bool has_memory; /* memory 0 is available for the generated code */
+
+        /* the function being compiled */
+        const struct functype *ft;
+        const struct localtype *lt;
+        const struct expr_exec_info *ei;
+
+        VEC(, uint8_t) code;
+        VEC(, struct jit_entry) entries;
+        VEC(, struct jit_block) blocks;
+        VEC(, struct jit_fixup) fixups;
+        VEC(, uint32_t) labels; /* br_table */
+        uint32_t epilogue;        /* the offset of the common epilogue */
+        uint32_t height;          /* the current operand stack height */
+        uint32_t dead_depth;      /* nesting level in unreachable code */
+        bool dead;                /* the current code is unreachable */
+        int error;
+};
+
+__BEGIN_EXTERN_C
+
+int jit_module(struct module *m, struct mem_context *mctx);
+void jit_code_free(struct mem_context *mctx, struct module *m);
+
+const struct jit_entry *jit_lookup(const struct jit_func *jf, const uint8_t *p,
+                                   const struct module *m);
+int jit_exec(struct exec_context *ctx, const struct jit_entry *e,
+             bool *exhaustedp);
+
+/* jit_x86_64.c */
+void jit_arch_emit_trampoline(struct jit_compile_context *jc);
+int jit_arch_compile_func(struct jit_compile_context *jc, uint32_t funcidx);
+
+/* called by the generated code */
+int jit_trap(struct exec_context *ctx, uint32_t id, uint32_t pc);
+int jit_memory_grow(struct exec_context *ctx, struct cell *cells);
+int jit_memory_copy(struct exec_context *ctx, struct cell *cells);
+int jit_memory_fill(struct exec_context *ctx, struct cell *cells);
+
+/* insn.c */
+#define JIT_INSN_HELPER(NAME)                                                 \
+        int jit_insn_##NAME(struct exec_context *ctx, struct cell *cells)
+JIT_INSN_HELPER(i32_popcnt);
+JIT_INSN_HELPER(i64_popcnt);
+JIT_INSN_HELPER(f32_ceil);
+JIT_INSN_HELPER(f32_floor);
+JIT_INSN_HELPER(f32_trunc);
+JIT_INSN_HELPER(f32_nearest);
+JIT_INSN_HELPER(f32_min);
+JIT_INSN_HELPER(f32_max);
+JIT_INSN_HELPER(f64_ceil);
+JIT_INSN_HELPER(f64_floor);
+JIT_INSN_HELPER(f64_trunc);
+JIT_INSN_HELPER(f64_nearest);
+JIT_INSN_HELPER(f64_min);
+JIT_INSN_HELPER(f64_max);
+JIT_INSN_HELPER(i32_trunc_f32_s);
+JIT_INSN_HELPER(i32_trunc_f32_u);
+JIT_INSN_HELPER(i32_trunc_f64_s);
+JIT_INSN_HELPER(i32_trunc_f64_u);
+JIT_INSN_HELPER(i64_trunc_f32_s);
+JIT_INSN_HELPER(i64_trunc_f32_u);
+JIT_INSN_HELPER(i64_trunc_f64_s);
+JIT_INSN_HELPER(i64_trunc_f64_u);
+JIT_INSN_HELPER(f32_convert_i64_u);
+JIT_INSN_HELPER(f64_convert_i64_u);
+JIT_INSN_HELPER(i32_trunc_sat_f32_s);
+JIT_INSN_HELPER(i32_trunc_sat_f32_u);
+JIT_INSN_HELPER(i32_trunc_sat_f64_s);
+JIT_INSN_HELPER(i32_trunc_sat_f64_u);
+JIT_INSN_HELPER(i64_trunc_sat_f32_s);
+JIT_INSN_HELPER(i64_trunc_sat_f32_u);
+JIT_INSN_HELPER(i64_trunc_sat_f64_s);
+JIT_INSN_HELPER(i64_trunc_sat_f64_u);
+#undef JIT_INSN_HELPER
+
+__END_EXTERN_C
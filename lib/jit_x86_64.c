@@ -0,0 +1,2037 @@
+/*
+ * x86-64 backend of the baseline jit compiler. (see jit.c)
+ *
+ * it's a single-pass compiler which emits a fixed template for each
+ * instruction. the operand stack is kept in memory; the compiler tracks
+ * the stack height statically and accesses an operand as
+ * [r12 + height * sizeof(struct cell)].
+ *
+ * register usage in the generated code:
+ *
+ *   rbx      struct exec_context *
+ *   rbp      struct jit_state *
+ *   r12      the bottom of the operand stack of the function frame
+ *   r13      the locals of the function frame
+ *   r14      struct meminst * of the memory 0
+ *   r15      the remaining loop budget
+ *   rax, rcx, rdx, xmm0
+ *            scratch
+ *
+ * only the System V ABI is supported.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cell.h"
+#include "context.h"
+#include "exec.h"
+#include "insn.h"
+#include "jit.h"
+#include "leb128.h"
+#include "type.h"
+#include "util.h"
+#include "xlog.h"
+
+#define CELLSZ ((int32_t)sizeof(struct cell))
+#define S(h) ((int32_t)(h) * CELLSZ)
+
+enum reg {
+        RAX = 0,
+        RCX = 1,
+        RDX = 2,
+        RBX = 3,
+        RSP = 4,
+        RBP = 5,
+        RSI = 6,
+        RDI = 7,
+        R8 = 8,
+        R9 = 9,
+        R12 = 12,
+        R13 = 13,
+        R14 = 14,
+        R15 = 15,
+};
+
+/* condition codes for jcc and setcc */
+enum cc {
+        CC_B = 0x2,
+        CC_AE = 0x3,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_BE = 0x6,
+        CC_A = 0x7,
+        CC_P = 0xa,
+        CC_NP = 0xb,
+        CC_L = 0xc,
+        CC_GE = 0xd,
+        CC_LE = 0xe,
+        CC_G = 0xf,
+};
+
+/* opcodes */
+#define OP_ADD_RM 0x01   /* add r/m, r */
+#define OP_OR_RM 0x09    /* or r/m, r */
+#define OP_AND_RM 0x21   /* and r/m, r */
+#define OP_XOR_RM 0x31   /* xor r/m, r */
+#define OP_CMP_RM 0x39   /* cmp r/m, r */
+#define OP_ADD 0x03      /* add r, r/m */
+#define OP_OR 0x0b       /* or r, r/m */
+#define OP_AND 0x23      /* and r, r/m */
+#define OP_SUB 0x2b      /* sub r, r/m */
+#define OP_XOR 0x33      /* xor r, r/m */
+#define OP_CMP 0x3b      /* cmp r, r/m */
+#define OP_IMUL 0x0faf   /* imul r, r/m */
+#define OP_MOVSXD 0x63   /* movsxd r, r/m32 */
+#define OP_GRP1_IMM8 0x83
+#define OP_GRP1_IMM32 0x81
+#define OP_GRP1_BYTE_IMM8 0x80
+#define OP_TEST 0x85
+#define OP_MOV_STORE8 0x88
+#define OP_MOV_STORE 0x89
+#define OP_MOV_LOAD 0x8b
+#define OP_LEA 0x8d
+#define OP_MOV_IMM32 0xc7
+#define OP_SHIFT_CL 0xd3
+#define OP_GRP3 0xf7
+#define OP_GRP5 0xff
+#define OP_MOVZX8 0x0fb6
+#define OP_MOVZX16 0x0fb7
+#define OP_MOVSX8 0x0fbe
+#define OP_MOVSX16 0x0fbf
+#define OP_BSF 0x0fbc
+#define OP_BSR 0x0fbd
+#define OP_SETCC 0x0f90
+#define OP_SSE_LOAD 0x0f10 /* movss/movsd xmm, m */
+#define OP_SSE_STORE 0x0f11
+#define OP_SSE_CVTSI2S 0x0f2a
+#define OP_SSE_UCOMIS 0x0f2e
+#define OP_SSE_SQRT 0x0f51
+#define OP_SSE_ADD 0x0f58
+#define OP_SSE_MUL 0x0f59
+#define OP_SSE_CVT 0x0f5a /* cvtss2sd/cvtsd2ss */
+#define OP_SSE_SUB 0x0f5c
+#define OP_SSE_DIV 0x0f5e
+
+#define PREFIX_NONE 0
+#define PREFIX_66 0x66
+#define PREFIX_SS 0xf3
+#define PREFIX_SD 0xf2
+
+/* /digit of group 1, 2, 3 opcodes */
+#define GRP1_ADD 0
+#define GRP1_OR 1
+#define GRP1_AND 4
+#define GRP1_SUB 5
+#define GRP1_XOR 6
+#define GRP1_CMP 7
+#define GRP2_ROL 0
+#define GRP2_ROR 1
+#define GRP2_SHL 4
+#define GRP2_SHR 5
+#define GRP2_SAR 7
+#define GRP3_NOT 2
+#define GRP3_NEG 3
+#define GRP3_DIV 6
+#define GRP3_IDIV 7
+#define GRP5_CALL 2
+
+typedef int (*jit_helper_t)(struct exec_context *ctx, struct cell *cells);
+
+static void
+emit_u8(struct jit_compile_context *jc, uint8_t v)
+{
+        if (jc->code.lsize == jc->code.psize) {
+                uint32_t n = jc->code.psize;
+                if (n < 4096) {
+                        n = 4096;
+                }
+                int ret = VEC_PREALLOC(jc->mctx, jc->code, n);
+                if (ret != 0) {
+                        /* jit_arch_compile_func checks this */
+                        jc->error = ret;
+                        return;
+                }
+        }
+        *VEC_PUSH(jc->code) = v;
+}
+
+static void
+emit_u32(struct jit_compile_context *jc, uint32_t v)
+{
+        emit_u8(jc, (uint8_t)v);
+        emit_u8(jc, (uint8_t)(v >> 8));
+        emit_u8(jc, (uint8_t)(v >> 16));
+        emit_u8(jc, (uint8_t)(v >> 24));
+}
+
+static void
+emit_u64(struct jit_compile_context *jc, uint64_t v)
+{
+        emit_u32(jc, (uint32_t)v);
+        emit_u32(jc, (uint32_t)(v >> 32));
+}
+
+static uint32_t
+code_offset(const struct jit_compile_context *jc)
+{
+        return jc->code.lsize;
+}
+
+static void
+patch_rel32(struct jit_compile_context *jc, uint32_t at, uint32_t target)
+{
+        if (jc->error != 0) {
+                return;
+        }
+        assert(at + 4 <= jc->code.lsize);
+        uint32_t rel = target - (at + 4);
+        memcpy(&jc->code.p[at], &rel, sizeof(rel));
+}
+
+static void
+emit_prefix_rex_opcode(struct jit_compile_context *jc, uint8_t prefix, bool w,
+                       unsigned int r, unsigned int b, uint32_t op)
+{
+        if (prefix != PREFIX_NONE) {
+                emit_u8(jc, prefix);
+        }
+        uint8_t rex = 0x40;
+        if (w) {
+                rex |= 0x08;
+        }
+        if ((r & 8) != 0) {
+                rex |= 0x04;
+        }
+        if ((b & 8) != 0) {
+                rex |= 0x01;
+        }
+        if (rex != 0x40) {
+                emit_u8(jc, rex);
+        }
+        if (op > 0xff) {
+                emit_u8(jc, (uint8_t)(op >> 8));
+        }
+        emit_u8(jc, (uint8_t)op);
+}
+
+/* op r, [base + disp] */
+static void
+emit_op_mem(struct jit_compile_context *jc, uint8_t prefix, bool w,
+            uint32_t op, unsigned int r, unsigned int base, int32_t disp)
+{
+        emit_prefix_rex_opcode(jc, prefix, w, r, base, op);
+        bool disp8 = disp >= -128 && disp <= 127;
+        emit_u8(jc, (disp8 ? 0x40 : 0x80) | ((r & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) {
+                emit_u8(jc, 0x24); /* SIB for rsp/r12 base */
+        }
+        if (disp8) {
+                emit_u8(jc, (uint8_t)disp);
+        } else {
+                emit_u32(jc, (uint32_t)disp);
+        }
+}
+
+/* op r, rm (register-direct) */
+static void
+emit_op_reg(struct jit_compile_context *jc, uint8_t prefix, bool w,
+            uint32_t op, unsigned int r, unsigned int rm)
+{
+        emit_prefix_rex_opcode(jc, prefix, w, r, rm, op);
+        emit_u8(jc, 0xc0 | ((r & 7) << 3) | (rm & 7));
+}
+
+static void
+emit_load(struct jit_compile_context *jc, bool w, unsigned int r,
+          unsigned int base, int32_t disp)
+{
+        emit_op_mem(jc, PREFIX_NONE, w, OP_MOV_LOAD, r, base, disp);
+}
+
+static void
+emit_store(struct jit_compile_context *jc, bool w, unsigned int base,
+           int32_t disp, unsigned int r)
+{
+        emit_op_mem(jc, PREFIX_NONE, w, OP_MOV_STORE, r, base, disp);
+}
+
+static void
+emit_store_imm32(struct jit_compile_context *jc, bool w, unsigned int base,
+                 int32_t disp, uint32_t imm)
+{
+        emit_op_mem(jc, PREFIX_NONE, w, OP_MOV_IMM32, 0, base, disp);
+        emit_u32(jc, imm);
+}
+
+static void
+emit_mov_imm32(struct jit_compile_context *jc, unsigned int r, uint32_t imm)
+{
+        emit_prefix_rex_opcode(jc, PREFIX_NONE, false, 0, r, 0xb8 + (r & 7));
+        emit_u32(jc, imm);
+}
+
+static void
+emit_mov_imm64(struct jit_compile_context *jc, unsigned int r, uint64_t imm)
+{
+        emit_prefix_rex_opcode(jc, PREFIX_NONE, true, 0, r, 0xb8 + (r & 7));
+        emit_u64(jc, imm);
+}
+
+static void
+emit_mov_reg(struct jit_compile_context *jc, unsigned int dst,
+             unsigned int src)
+{
+        emit_op_reg(jc, PREFIX_NONE, true, OP_MOV_STORE, src, dst);
+}
+
+static void
+emit_push(struct jit_compile_context *jc, unsigned int r)
+{
+        emit_prefix_rex_opcode(jc, PREFIX_NONE, false, 0, r, 0x50 + (r & 7));
+}
+
+static void
+emit_pop(struct jit_compile_context *jc, unsigned int r)
+{
+        emit_prefix_rex_opcode(jc, PREFIX_NONE, false, 0, r, 0x58 + (r & 7));
+}
+
+static void
+emit_jmp(struct jit_compile_context *jc, uint32_t target)
+{
+        emit_u8(jc, 0xe9);
+        uint32_t at = code_offset(jc);
+        emit_u32(jc, 0);
+        patch_rel32(jc, at, target);
+}
+
+/* returns the offset of rel32 to patch later */
+static uint32_t
+emit_jmp_fwd(struct jit_compile_context *jc)
+{
+        emit_u8(jc, 0xe9);
+        uint32_t at = code_offset(jc);
+        emit_u32(jc, 0);
+        return at;
+}
+
+static void
+emit_jcc(struct jit_compile_context *jc, enum cc cc, uint32_t target)
+{
+        emit_u8(jc, 0x0f);
+        emit_u8(jc, 0x80 | cc);
+        uint32_t at = code_offset(jc);
+        emit_u32(jc, 0);
+        patch_rel32(jc, at, target);
+}
+
+static uint32_t
+emit_jcc_fwd(struct jit_compile_context *jc, enum cc cc)
+{
+        emit_u8(jc, 0x0f);
+        emit_u8(jc, 0x80 | cc);
+        uint32_t at = code_offset(jc);
+        emit_u32(jc, 0);
+        return at;
+}
+
+static void
+patch_here(struct jit_compile_context *jc, uint32_t at)
+{
+        patch_rel32(jc, at, code_offset(jc));
+}
+
+/* setcc al; movzx eax, al */
+static void
+emit_setcc_eax(struct jit_compile_context *jc, enum cc cc)
+{
+        emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | cc, 0, RAX);
+        emit_op_reg(jc, PREFIX_NONE, false, OP_MOVZX8, RAX, RAX);
+}
+
+static void
+emit_call(struct jit_compile_context *jc, uintptr_t fn)
+{
+        emit_mov_imm64(jc, RAX, fn);
+        emit_op_reg(jc, PREFIX_NONE, false, OP_GRP5, GRP5_CALL, RAX);
+}
+
+/* copy nbytes using rax */
+static void
+emit_copy(struct jit_compile_context *jc, unsigned int dbase, int32_t ddisp,
+          unsigned int sbase, int32_t sdisp, uint32_t nbytes)
+{
+        uint32_t i;
+        assert(nbytes % 4 == 0);
+        for (i = 0; i + 8 <= nbytes; i += 8) {
+                emit_load(jc, true, RAX, sbase, sdisp + (int32_t)i);
+                emit_store(jc, true, dbase, ddisp + (int32_t)i, RAX);
+        }
+        if (i < nbytes) {
+                emit_load(jc, false, RAX, sbase, sdisp + (int32_t)i);
+                emit_store(jc, false, dbase, ddisp + (int32_t)i, RAX);
+        }
+}
+
+/* move ncells cells on the operand stack */
+static void
+emit_move_cells(struct jit_compile_context *jc, uint32_t dst, uint32_t src,
+                uint32_t ncells)
+{
+        if (dst == src || ncells == 0) {
+                return;
+        }
+        /* forward copy is safe for overlapping regions as dst < src */
+        assert(dst < src);
+        emit_copy(jc, R12, S(dst), R12, S(src), ncells * CELLSZ);
+}
+
+static void
+emit_exit_info(struct jit_compile_context *jc, const uint8_t *p,
+               uint32_t height)
+{
+        emit_mov_imm64(jc, RAX, (uintptr_t)p);
+        emit_store(jc, true, RBP, offsetof(struct jit_state, p), RAX);
+        emit_store_imm32(jc, false, RBP, offsetof(struct jit_state, height),
+                         height);
+}
+
+/*
+ * save the state for an instruction which can trap.
+ *
+ * trap_p is the pc to report as the current pc on a trap. (print_trace)
+ * it's usually the end of the instruction, which is what the interpreter
+ * would report.
+ */
+static void
+emit_trap_info(struct jit_compile_context *jc, const uint8_t *trap_p)
+{
+        emit_exit_info(jc, trap_p, jc->height);
+}
+
+/* return to the interpreter to execute the instruction at p */
+static void
+emit_exit(struct jit_compile_context *jc, const uint8_t *p, uint32_t height)
+{
+        emit_exit_info(jc, p, height);
+        emit_op_reg(jc, PREFIX_NONE, false, OP_XOR_RM, RAX, RAX);
+        emit_jmp(jc, jc->epilogue);
+}
+
+static void
+emit_trap(struct jit_compile_context *jc, const uint8_t *trap_p, uint32_t id)
+{
+        emit_trap_info(jc, trap_p);
+        emit_mov_reg(jc, RDI, RBX);
+        emit_mov_imm32(jc, RSI, id);
+        emit_mov_imm32(jc, RDX, ptr2pc(jc->m, trap_p));
+        emit_call(jc, (uintptr_t)jit_trap);
+        emit_jmp(jc, jc->epilogue);
+}
+
+/*
+ * call an out-of-line implementation with the operands at the stack
+ * height h. if trap_p is not NULL, the helper can fail.
+ */
+static void
+emit_call_helper(struct jit_compile_context *jc, jit_helper_t fn, uint32_t h,
+                 const uint8_t *trap_p)
+{
+        if (trap_p != NULL) {
+                emit_trap_info(jc, trap_p);
+        }
+        emit_mov_reg(jc, RDI, RBX);
+        emit_op_mem(jc, PREFIX_NONE, true, OP_LEA, RSI, R12, S(h));
+        emit_call(jc, (uintptr_t)fn);
+        if (trap_p != NULL) {
+                emit_op_reg(jc, PREFIX_NONE, false, OP_TEST, RAX, RAX);
+                emit_jcc(jc, CC_NE, jc->epilogue);
+        }
+}
+
+void
+jit_arch_emit_trampoline(struct jit_compile_context *jc)
+{
+        /*
+         * int trampoline(struct exec_context *ctx, struct cell *stack,
+         *                struct cell *locals, struct meminst *mi,
+         *                const uint8_t *entry, struct jit_state *st);
+         */
+        assert(code_offset(jc) == 0);
+        emit_push(jc, RBX);
+        emit_push(jc, RBP);
+        emit_push(jc, R12);
+        emit_push(jc, R13);
+        emit_push(jc, R14);
+        emit_push(jc, R15);
+        /* sub rsp, 8 to keep the stack 16-byte aligned */
+        emit_op_reg(jc, PREFIX_NONE, true, OP_GRP1_IMM8, GRP1_SUB, RSP);
+        emit_u8(jc, 8);
+        emit_mov_reg(jc, RBX, RDI);
+        emit_mov_reg(jc, R12, RSI);
+        emit_mov_reg(jc, R13, RDX);
+        emit_mov_reg(jc, R14, RCX);
+        emit_mov_reg(jc, RBP, R9);
+        emit_load(jc, false, R15, RBP, offsetof(struct jit_state, budget));
+        /* jmp r8 */
+        emit_op_reg(jc, PREFIX_NONE, false, OP_GRP5, 4, R8);
+
+        jc->epilogue = code_offset(jc);
+        emit_op_reg(jc, PREFIX_NONE, true, OP_GRP1_IMM8, GRP1_ADD, RSP);
+        emit_u8(jc, 8);
+        emit_pop(jc, R15);
+        emit_pop(jc, R14);
+        emit_pop(jc, R13);
+        emit_pop(jc, R12);
+        emit_pop(jc, RBP);
+        emit_pop(jc, RBX);
+        emit_u8(jc, 0xc3); /* ret */
+}
+
+static void
+add_entry(struct jit_compile_context *jc, const uint8_t *p)
+{
+        const uint32_t pc = ptr2pc(jc->m, p);
+        if (jc->entries.lsize > 0) {
+                const struct jit_entry *last = &VEC_LASTELEM(jc->entries);
+                /* the pc of the instructions increases monotonically */
+                assert(last->pc <= pc);
+                if (last->pc == pc) {
+                        /*
+                         * eg. a loop at the beginning of a function.
+                         * no code has been emitted since the last entry.
+                         */
+                        assert(last->height == jc->height);
+                        assert(last->offset == code_offset(jc));
+                        return;
+                }
+        }
+        if (jc->entries.lsize == jc->entries.psize) {
+                uint32_t n = jc->entries.psize;
+                if (n < 16) {
+                        n = 16;
+                }
+                int ret = VEC_PREALLOC(jc->mctx, jc->entries, n);
+                if (ret != 0) {
+                        jc->error = ret;
+                        return;
+                }
+        }
+        struct jit_entry *e = VEC_PUSH(jc->entries);
+        e->pc = pc;
+        e->height = jc->height;
+        e->offset = code_offset(jc);
+}
+
+static void
+add_fixup(struct jit_compile_context *jc, uint32_t blockidx, uint32_t at)
+{
+        if (jc->fixups.lsize == jc->fixups.psize) {
+                uint32_t n = jc->fixups.psize;
+                if (n < 16) {
+                        n = 16;
+                }
+                int ret = VEC_PREALLOC(jc->mctx, jc->fixups, n);
+                if (ret != 0) {
+                        jc->error = ret;
+                        return;
+                }
+        }
+        struct jit_fixup *f = VEC_PUSH(jc->fixups);
+        f->blockidx = blockidx;
+        f->offset = at;
+}
+
+/* resolve the forward branches to the end of the block */
+static void
+resolve_fixups(struct jit_compile_context *jc, uint32_t blockidx)
+{
+        uint32_t i = 0;
+        while (i < jc->fixups.lsize) {
+                struct jit_fixup *f = &jc->fixups.p[i];
+                if (f->blockidx != blockidx) {
+                        i++;
+                        continue;
+                }
+                patch_here(jc, f->offset);
+                *f = VEC_LASTELEM(jc->fixups);
+                jc->fixups.lsize--;
+        }
+}
+
+static int
+push_block(struct jit_compile_context *jc, uint8_t op, int64_t blocktype)
+{
+        struct jit_block *b;
+        uint32_t param_arity;
+        uint32_t arity;
+        int ret;
+
+        if (blocktype == INT64_MAX) {
+                /* the function body */
+                param_arity = 0;
+                arity = resulttype_cellsize(&jc->ft->result);
+        } else {
+                get_arity_for_blocktype(jc->m, blocktype, &param_arity,
+                                        &arity);
+        }
+        ret = VEC_PREALLOC(jc->mctx, jc->blocks, 1);
+        if (ret != 0) {
+                return ret;
+        }
+        assert(jc->height >= param_arity);
+        b = VEC_PUSH(jc->blocks);
+        b->op = op;
+        b->height = jc->height - param_arity;
+        b->param_arity = param_arity;
+        b->arity = arity;
+        b->loop_offset = 0;
+        b->else_fixup = UINT32_MAX;
+        return 0;
+}
+
+/*
+ * branch to the label. depth is the relative label index.
+ */
+static void
+emit_br(struct jit_compile_context *jc, uint32_t depth)
+{
+        assert(depth < jc->blocks.lsize);
+        uint32_t blockidx = jc->blocks.lsize - 1 - depth;
+        const struct jit_block *b = &jc->blocks.p[blockidx];
+        uint32_t arity;
+        if (b->op == FRAME_OP_LOOP) {
+                arity = b->param_arity;
+        } else {
+                arity = b->arity;
+        }
+        assert(jc->height >= b->height + arity);
+        emit_move_cells(jc, b->height, jc->height - arity, arity);
+        if (b->op == FRAME_OP_LOOP) {
+                emit_jmp(jc, b->loop_offset);
+        } else {
+                add_fixup(jc, blockidx, emit_jmp_fwd(jc));
+        }
+}
+
+static bool
+br_needs_move(const struct jit_compile_context *jc, uint32_t depth)
+{
+        const struct jit_block *b =
+                &jc->blocks.p[jc->blocks.lsize - 1 - depth];
+        uint32_t arity;
+        if (b->op == FRAME_OP_LOOP) {
+                arity = b->param_arity;
+        } else {
+                arity = b->arity;
+        }
+        return arity > 0 && b->height != jc->height - arity;
+}
+
+/* pop an i32 into eax */
+static void
+emit_pop_i32(struct jit_compile_context *jc)
+{
+        assert(jc->height >= 1);
+        jc->height--;
+        emit_load(jc, false, RAX, R12, S(jc->height));
+}
+
+static uint32_t
+cellsize(bool is64)
+{
+        return valtype_cellsize(is64 ? TYPE_i64 : TYPE_i32);
+}
+
+/*
+ * cf. frame_locals_cellidx
+ */
+static uint32_t
+local_cellidx(const struct jit_compile_context *jc, uint32_t localidx,
+              uint32_t *cszp)
+{
+        const struct resulttype *pt = &jc->ft->parameter;
+        if (localidx < pt->ntypes) {
+                return resulttype_cellidx(pt, localidx, cszp);
+        }
+        return resulttype_cellsize(pt) +
+               localtype_cellidx(jc->lt, localidx - pt->ntypes, cszp);
+}
+
+/*
+ * cf. find_type_annotation
+ */
+static uint32_t
+lookup_type_annotation(const struct jit_compile_context *jc,
+                       const uint8_t *p)
+{
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        const struct type_annotations *an = &jc->ei->type_annotations;
+        const uint32_t pc = ptr2pc(jc->m, p);
+        uint32_t i;
+        if (an->default_size == 0) {
+                /*
+                 * all drop/select in the function are unreachable.
+                 * (record_type_annotation doesn't record them.)
+                 * jit_arch_compile_func skips dead code, so we don't
+                 * usually get here. any size is fine for unreachable
+                 * instructions anyway.
+                 */
+                return 1;
+        }
+        for (i = 0; i < an->ntypes; i++) {
+                if (pc < an->types[i].pc) {
+                        break;
+                }
+        }
+        if (i == 0) {
+                return an->default_size;
+        }
+        return an->types[i - 1].size;
+#else
+        return 1;
+#endif
+}
+
+static void
+emit_const(struct jit_compile_context *jc, bool is64, uint64_t v)
+{
+        if (is64 && (int64_t)v != (int64_t)(int32_t)v) {
+                emit_mov_imm64(jc, RAX, v);
+                emit_store(jc, true, R12, S(jc->height), RAX);
+        } else {
+                emit_store_imm32(jc, is64, R12, S(jc->height), (uint32_t)v);
+        }
+        jc->height += cellsize(is64);
+}
+
+static void
+emit_int_unop_eqz(struct jit_compile_context *jc, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_TEST, RAX, RAX);
+        emit_setcc_eax(jc, CC_E);
+        emit_store(jc, false, R12, S(a), RAX);
+        jc->height = a + 1;
+}
+
+static void
+emit_int_cmp(struct jit_compile_context *jc, bool is64, enum cc cc)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_op_mem(jc, PREFIX_NONE, is64, OP_CMP, RAX, R12, S(a + c));
+        emit_setcc_eax(jc, cc);
+        emit_store(jc, false, R12, S(a), RAX);
+        jc->height = a + 1;
+}
+
+static void
+emit_int_binop(struct jit_compile_context *jc, bool is64, uint32_t op)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_op_mem(jc, PREFIX_NONE, is64, op, RAX, R12, S(a + c));
+        emit_store(jc, is64, R12, S(a), RAX);
+        jc->height = a + c;
+}
+
+static void
+emit_int_shift(struct jit_compile_context *jc, bool is64, unsigned int digit)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_load(jc, false, RCX, R12, S(a + c));
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_SHIFT_CL, digit, RAX);
+        emit_store(jc, is64, R12, S(a), RAX);
+        jc->height = a + c;
+}
+
+static void
+emit_int_divrem(struct jit_compile_context *jc, const uint8_t *trap_p,
+                bool is64, bool is_signed, bool is_rem)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        uint32_t at;
+        uint32_t notm1 = 0;
+        uint32_t done = 0;
+
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_load(jc, is64, RCX, R12, S(a + c));
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_TEST, RCX, RCX);
+        at = emit_jcc_fwd(jc, CC_NE);
+        emit_trap(jc, trap_p, TRAP_DIV_BY_ZERO);
+        patch_here(jc, at);
+        if (is_signed) {
+                /* cmp rcx, -1 */
+                emit_op_reg(jc, PREFIX_NONE, is64, OP_GRP1_IMM8, GRP1_CMP,
+                            RCX);
+                emit_u8(jc, 0xff);
+                notm1 = emit_jcc_fwd(jc, CC_NE);
+                if (is_rem) {
+                        /* INT_MIN % -1 is 0. so is anything % -1. */
+                        emit_op_reg(jc, PREFIX_NONE, false, OP_XOR_RM, RDX,
+                                    RDX);
+                        done = emit_jmp_fwd(jc);
+                } else {
+                        if (is64) {
+                                emit_mov_imm64(jc, RDX,
+                                               UINT64_C(0x8000000000000000));
+                                emit_op_reg(jc, PREFIX_NONE, true, OP_CMP_RM,
+                                            RDX, RAX);
+                        } else {
+                                emit_op_reg(jc, PREFIX_NONE, false,
+                                            OP_GRP1_IMM32, GRP1_CMP, RAX);
+                                emit_u32(jc, 0x80000000);
+                        }
+                        at = emit_jcc_fwd(jc, CC_NE);
+                        emit_trap(jc, trap_p, TRAP_INTEGER_OVERFLOW);
+                        patch_here(jc, at);
+                }
+                patch_here(jc, notm1);
+                /* cdq/cqo */
+                emit_prefix_rex_opcode(jc, PREFIX_NONE, is64, 0, 0, 0x99);
+                emit_op_reg(jc, PREFIX_NONE, is64, OP_GRP3, GRP3_IDIV, RCX);
+                if (is_rem) {
+                        patch_here(jc, done);
+                }
+        } else {
+                emit_op_reg(jc, PREFIX_NONE, false, OP_XOR_RM, RDX, RDX);
+                emit_op_reg(jc, PREFIX_NONE, is64, OP_GRP3, GRP3_DIV, RCX);
+        }
+        emit_store(jc, is64, R12, S(a), is_rem ? RDX : RAX);
+        jc->height = a + c;
+}
+
+static void
+emit_int_clz(struct jit_compile_context *jc, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        uint32_t at;
+        /* (bits - 1) - bsr(x), where bsr(0) is treated as -1 */
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_BSR, RAX, RAX);
+        at = emit_jcc_fwd(jc, CC_NE);
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_MOV_IMM32, 0, RAX);
+        emit_u32(jc, UINT32_MAX);
+        patch_here(jc, at);
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_GRP3, GRP3_NEG, RAX);
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_GRP1_IMM8, GRP1_ADD, RAX);
+        emit_u8(jc, is64 ? 63 : 31);
+        emit_store(jc, is64, R12, S(a), RAX);
+}
+
+static void
+emit_int_ctz(struct jit_compile_context *jc, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        uint32_t at;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_BSF, RAX, RAX);
+        at = emit_jcc_fwd(jc, CC_NE);
+        emit_mov_imm32(jc, RAX, is64 ? 64 : 32);
+        patch_here(jc, at);
+        emit_store(jc, is64, R12, S(a), RAX);
+}
+
+/* sign-extend the value on the stack top */
+static void
+emit_int_extend(struct jit_compile_context *jc, bool is64, uint32_t op)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        emit_op_mem(jc, PREFIX_NONE, is64, op, RAX, R12, S(a));
+        emit_store(jc, is64, R12, S(a), RAX);
+}
+
+static uint8_t
+sse_prefix(bool is64)
+{
+        return is64 ? PREFIX_SD : PREFIX_SS;
+}
+
+static void
+emit_float_binop(struct jit_compile_context *jc, bool is64, uint32_t op)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        uint8_t prefix = sse_prefix(is64);
+        emit_op_mem(jc, prefix, false, OP_SSE_LOAD, 0, R12, S(a));
+        emit_op_mem(jc, prefix, false, op, 0, R12, S(a + c));
+        emit_op_mem(jc, prefix, false, OP_SSE_STORE, 0, R12, S(a));
+        jc->height = a + c;
+}
+
+static void
+emit_float_sqrt(struct jit_compile_context *jc, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        uint8_t prefix = sse_prefix(is64);
+        emit_op_mem(jc, prefix, false, OP_SSE_SQRT, 0, R12, S(a));
+        emit_op_mem(jc, prefix, false, OP_SSE_STORE, 0, R12, S(a));
+}
+
+/* abs and neg only touch the sign bit */
+static void
+emit_float_sign(struct jit_compile_context *jc, bool is64, unsigned int digit,
+                uint8_t imm)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c;
+        int32_t msb = is64 ? 7 : 3;
+        emit_op_mem(jc, PREFIX_NONE, false, OP_GRP1_BYTE_IMM8, digit, R12,
+                    S(a) + msb);
+        emit_u8(jc, imm);
+}
+
+static void
+emit_float_copysign(struct jit_compile_context *jc, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        emit_load(jc, is64, RAX, R12, S(a));
+        emit_load(jc, is64, RCX, R12, S(a + c));
+        if (is64) {
+                emit_mov_imm64(jc, RDX, UINT64_C(0x7fffffffffffffff));
+                emit_op_reg(jc, PREFIX_NONE, true, OP_AND_RM, RDX, RAX);
+                emit_op_reg(jc, PREFIX_NONE, true, OP_GRP3, GRP3_NOT, RDX);
+                emit_op_reg(jc, PREFIX_NONE, true, OP_AND_RM, RDX, RCX);
+        } else {
+                emit_op_reg(jc, PREFIX_NONE, false, OP_GRP1_IMM32, GRP1_AND,
+                            RAX);
+                emit_u32(jc, 0x7fffffff);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_GRP1_IMM32, GRP1_AND,
+                            RCX);
+                emit_u32(jc, 0x80000000);
+        }
+        emit_op_reg(jc, PREFIX_NONE, is64, OP_OR_RM, RCX, RAX);
+        emit_store(jc, is64, R12, S(a), RAX);
+        jc->height = a + c;
+}
+
+enum fcmp {
+        FCMP_EQ,
+        FCMP_NE,
+        FCMP_LT,
+        FCMP_GT,
+        FCMP_LE,
+        FCMP_GE,
+};
+
+/*
+ * ucomiss/ucomisd set ZF, PF, and CF for unordered results.
+ * lt/le are implemented as gt/ge with the operands swapped so that
+ * unordered results are false.
+ */
+static void
+emit_float_cmp(struct jit_compile_context *jc, bool is64, enum fcmp kind)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        uint32_t b = a + c;
+        uint8_t prefix = sse_prefix(is64);
+        uint8_t ucomis_prefix = is64 ? PREFIX_66 : PREFIX_NONE;
+        if (kind == FCMP_LT || kind == FCMP_LE) {
+                uint32_t tmp = a;
+                a = b;
+                b = tmp;
+        }
+        emit_op_mem(jc, prefix, false, OP_SSE_LOAD, 0, R12, S(a));
+        emit_op_mem(jc, ucomis_prefix, false, OP_SSE_UCOMIS, 0, R12, S(b));
+        switch (kind) {
+        case FCMP_EQ:
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_E, 0, RAX);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_NP, 0, RCX);
+                emit_op_reg(jc, PREFIX_NONE, false, 0x20, RCX, RAX);
+                break;
+        case FCMP_NE:
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_NE, 0, RAX);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_P, 0, RCX);
+                emit_op_reg(jc, PREFIX_NONE, false, 0x08, RCX, RAX);
+                break;
+        case FCMP_LT:
+        case FCMP_GT:
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_A, 0, RAX);
+                break;
+        case FCMP_LE:
+        case FCMP_GE:
+                emit_op_reg(jc, PREFIX_NONE, false, OP_SETCC | CC_AE, 0, RAX);
+                break;
+        }
+        emit_op_reg(jc, PREFIX_NONE, false, OP_MOVZX8, RAX, RAX);
+        a = jc->height - 2 * c;
+        emit_store(jc, false, R12, S(a), RAX);
+        jc->height = a + 1;
+}
+
+/* convert an integer on the stack top to a float */
+static void
+emit_float_convert(struct jit_compile_context *jc, bool to64, bool from64,
+                   bool is_unsigned)
+{
+        uint32_t a = jc->height - cellsize(from64);
+        uint8_t prefix = sse_prefix(to64);
+        if (is_unsigned) {
+                /* zero-extended u32 is safe to convert as s64 */
+                assert(!from64);
+                emit_load(jc, false, RAX, R12, S(a));
+                emit_op_reg(jc, prefix, true, OP_SSE_CVTSI2S, 0, RAX);
+        } else {
+                emit_op_mem(jc, prefix, from64, OP_SSE_CVTSI2S, 0, R12, S(a));
+        }
+        emit_op_mem(jc, prefix, false, OP_SSE_STORE, 0, R12, S(a));
+        jc->height = a + cellsize(to64);
+}
+
+/* f32.demote_f64 and f64.promote_f32 */
+static void
+emit_float_cvt(struct jit_compile_context *jc, bool to64)
+{
+        uint32_t a = jc->height - cellsize(!to64);
+        emit_op_mem(jc, sse_prefix(!to64), false, OP_SSE_CVT, 0, R12, S(a));
+        emit_op_mem(jc, sse_prefix(to64), false, OP_SSE_STORE, 0, R12, S(a));
+        jc->height = a + cellsize(to64);
+}
+
+static void
+emit_unop_helper(struct jit_compile_context *jc, jit_helper_t fn,
+                 const uint8_t *trap_p, uint32_t from_csz, uint32_t to_csz)
+{
+        uint32_t a = jc->height - from_csz;
+        emit_call_helper(jc, fn, a, trap_p);
+        jc->height = a + to_csz;
+}
+
+static void
+emit_binop_helper(struct jit_compile_context *jc, jit_helper_t fn,
+                  bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - 2 * c;
+        emit_call_helper(jc, fn, a, NULL);
+        jc->height = a + c;
+}
+
+/*
+ * compute the host address for a memory access into rdx.
+ * the address operand is at the stack height h.
+ */
+static void
+emit_memory_address(struct jit_compile_context *jc, const uint8_t *trap_p,
+                    uint32_t h, uint32_t offset, uint32_t size)
+{
+        uint32_t slow;
+        uint32_t done;
+
+        /* rax = (uint64_t)addr + offset */
+        emit_load(jc, false, RAX, R12, S(h));
+        if (offset != 0) {
+                emit_mov_imm32(jc, RCX, offset);
+                emit_op_reg(jc, PREFIX_NONE, true, OP_ADD_RM, RCX, RAX);
+        }
+        /* fast path: rax + size <= meminst->allocated */
+        emit_op_mem(jc, PREFIX_NONE, true, OP_LEA, RCX, RAX, (int32_t)size);
+        emit_op_mem(jc, PREFIX_NONE, true, OP_CMP, RCX, R14,
+                    offsetof(struct meminst, allocated));
+        slow = emit_jcc_fwd(jc, CC_A);
+        emit_load(jc, true, RDX, R14, offsetof(struct meminst, data));
+        emit_op_reg(jc, PREFIX_NONE, true, OP_ADD_RM, RAX, RDX);
+        done = emit_jmp_fwd(jc);
+
+        /*
+         * slow path: let memory_getptr extend the buffer or trap.
+         */
+        patch_here(jc, slow);
+        emit_trap_info(jc, trap_p);
+        emit_mov_reg(jc, RDI, RBX);
+        emit_op_reg(jc, PREFIX_NONE, false, OP_XOR_RM, RSI, RSI);
+        emit_load(jc, false, RDX, R12, S(h));
+        emit_mov_imm32(jc, RCX, offset);
+        emit_mov_imm32(jc, R8, size);
+        emit_op_mem(jc, PREFIX_NONE, true, OP_LEA, R9, RBP,
+                    offsetof(struct jit_state, ptr));
+        emit_call(jc, (uintptr_t)memory_getptr);
+        emit_op_reg(jc, PREFIX_NONE, false, OP_TEST, RAX, RAX);
+        emit_jcc(jc, CC_NE, jc->epilogue);
+        emit_load(jc, true, RDX, RBP, offsetof(struct jit_state, ptr));
+        patch_here(jc, done);
+}
+
+static void
+emit_load_insn(struct jit_compile_context *jc, const uint8_t *trap_p,
+               uint32_t offset, uint32_t size, bool w, uint32_t op,
+               bool is64)
+{
+        uint32_t a = jc->height - 1;
+        emit_memory_address(jc, trap_p, a, offset, size);
+        emit_op_mem(jc, PREFIX_NONE, w, op, RAX, RDX, 0);
+        emit_store(jc, is64, R12, S(a), RAX);
+        jc->height = a + cellsize(is64);
+}
+
+static void
+emit_store_insn(struct jit_compile_context *jc, const uint8_t *trap_p,
+                uint32_t offset, uint32_t size, bool is64)
+{
+        uint32_t c = cellsize(is64);
+        uint32_t a = jc->height - c - 1;
+        emit_memory_address(jc, trap_p, a, offset, size);
+        emit_load(jc, is64, RCX, R12, S(a + 1));
+        switch (size) {
+        case 1:
+                emit_op_mem(jc, PREFIX_NONE, false, OP_MOV_STORE8, RCX, RDX,
+                            0);
+                break;
+        case 2:
+                emit_op_mem(jc, PREFIX_66, false, OP_MOV_STORE, RCX, RDX, 0);
+                break;
+        case 4:
+                emit_store(jc, false, RDX, 0, RCX);
+                break;
+        default:
+                assert(size == 8);
+                emit_store(jc, true, RDX, 0, RCX);
+                break;
+        }
+        jc->height = a;
+}
+
+/*
+ * cf. read_memarg_nocheck
+ */
+static void
+read_memarg(const uint8_t **pp, uint32_t *memidxp, uint32_t *offsetp)
+{
+        uint32_t memidx = 0;
+#if defined(TOYWASM_ENABLE_WASM_MULTI_MEMORY)
+        uint32_t align = read_leb_u32_nocheck(pp);
+        /* if bit 6 is set, memidx follows. otherwise memidx is 0. */
+        if ((align & (1 << 6)) != 0) {
+                memidx = read_leb_u32_nocheck(pp);
+        }
+#else
+        read_leb_u32_nocheck(pp); /* align */
+#endif
+        *offsetp = read_leb_u32_nocheck(pp);
+        *memidxp = memidx;
+}
+
+/*
+ * skip an instruction in unreachable code.
+ * cf. skip_expr
+ */
+static void
+skip_insn(const uint8_t **pp)
+{
+        const uint8_t *p = *pp;
+        struct context ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        uint32_t op = *p++;
+        const struct instruction_desc *desc = &instructions[op];
+        if (desc->next_table != NULL) {
+                uint32_t op2 = read_leb_u32_nocheck(&p);
+                desc = &desc->next_table[op2];
+        }
+        assert(desc->process != NULL);
+        int ret = desc->process(&p, NULL, &ctx);
+        assert(ret == 0);
+        *pp = p;
+}
+
+static int
+compile_fc(struct jit_compile_context *jc, const uint8_t **pp)
+{
+        const uint8_t *p = *pp;
+        uint32_t op = read_leb_u32_nocheck(&p);
+        uint32_t c32 = cellsize(false);
+        uint32_t c64 = cellsize(true);
+        uint32_t memidx;
+
+        switch (op) {
+        case 0x00: /* i32.trunc_sat_f32_s */
+                emit_unop_helper(jc, jit_insn_i32_trunc_sat_f32_s, NULL, c32,
+                                 c32);
+                break;
+        case 0x01: /* i32.trunc_sat_f32_u */
+                emit_unop_helper(jc, jit_insn_i32_trunc_sat_f32_u, NULL, c32,
+                                 c32);
+                break;
+        case 0x02: /* i32.trunc_sat_f64_s */
+                emit_unop_helper(jc, jit_insn_i32_trunc_sat_f64_s, NULL, c64,
+                                 c32);
+                break;
+        case 0x03: /* i32.trunc_sat_f64_u */
+                emit_unop_helper(jc, jit_insn_i32_trunc_sat_f64_u, NULL, c64,
+                                 c32);
+                break;
+        case 0x04: /* i64.trunc_sat_f32_s */
+                emit_unop_helper(jc, jit_insn_i64_trunc_sat_f32_s, NULL, c32,
+                                 c64);
+                break;
+        case 0x05: /* i64.trunc_sat_f32_u */
+                emit_unop_helper(jc, jit_insn_i64_trunc_sat_f32_u, NULL, c32,
+                                 c64);
+                break;
+        case 0x06: /* i64.trunc_sat_f64_s */
+                emit_unop_helper(jc, jit_insn_i64_trunc_sat_f64_s, NULL, c64,
+                                 c64);
+                break;
+        case 0x07: /* i64.trunc_sat_f64_u */
+                emit_unop_helper(jc, jit_insn_i64_trunc_sat_f64_u, NULL, c64,
+                                 c64);
+                break;
+        case 0x0a: /* memory.copy */
+                memidx = read_leb_u32_nocheck(&p);
+                memidx |= read_leb_u32_nocheck(&p);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                jc->height -= 3;
+                emit_call_helper(jc, jit_memory_copy, jc->height, p);
+                break;
+        case 0x0b: /* memory.fill */
+                memidx = read_leb_u32_nocheck(&p);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                jc->height -= 3;
+                emit_call_helper(jc, jit_memory_fill, jc->height, p);
+                break;
+        default:
+                return ENOTSUP;
+        }
+        *pp = p;
+        return 0;
+}
+
+/*
+ * compile an instruction.
+ * returns -1 when the function body is done.
+ */
+static int
+compile_insn(struct jit_compile_context *jc, const uint8_t **pp)
+{
+        const struct module *m = jc->m;
+        const uint8_t *insn = *pp;
+        const uint8_t *p = insn;
+        const uint32_t c32 = cellsize(false);
+        const uint32_t c64 = cellsize(true);
+        struct jit_block *b;
+        uint32_t idx;
+        uint32_t csz;
+        uint32_t cidx;
+        uint32_t memidx;
+        uint32_t offset;
+        uint32_t at;
+        uint64_t u64;
+        uint32_t u32;
+        int ret;
+
+        uint8_t op = *p++;
+        switch (op) {
+        case 0x00: /* unreachable */
+                emit_trap(jc, insn, TRAP_UNREACHABLE);
+                jc->dead = true;
+                break;
+        case 0x01: /* nop */
+                break;
+        case FRAME_OP_BLOCK:
+                ret = push_block(jc, op, read_leb_s33_nocheck(&p));
+                if (ret != 0) {
+                        return ret;
+                }
+                break;
+        case FRAME_OP_LOOP:
+                ret = push_block(jc, op, read_leb_s33_nocheck(&p));
+                if (ret != 0) {
+                        return ret;
+                }
+                b = &VEC_LASTELEM(jc->blocks);
+                b->loop_offset = code_offset(jc);
+                add_entry(jc, insn);
+                /*
+                 * count down the budget and exit to the interpreter
+                 * when it's exhausted. see jit_exec.
+                 */
+                emit_op_reg(jc, PREFIX_NONE, false, OP_GRP1_IMM8, GRP1_SUB,
+                            R15);
+                emit_u8(jc, 1);
+                at = emit_jcc_fwd(jc, CC_NE);
+                emit_exit_info(jc, insn, jc->height);
+                emit_store_imm32(jc, false, RBP,
+                                 offsetof(struct jit_state, exhausted), 1);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_XOR_RM, RAX, RAX);
+                emit_jmp(jc, jc->epilogue);
+                patch_here(jc, at);
+                break;
+        case FRAME_OP_IF:
+                emit_pop_i32(jc);
+                ret = push_block(jc, op, read_leb_s33_nocheck(&p));
+                if (ret != 0) {
+                        return ret;
+                }
+                emit_op_reg(jc, PREFIX_NONE, false, OP_TEST, RAX, RAX);
+                VEC_LASTELEM(jc->blocks).else_fixup =
+                        emit_jcc_fwd(jc, CC_E);
+                break;
+        case FRAME_OP_ELSE:
+                b = &VEC_LASTELEM(jc->blocks);
+                assert(b->op == FRAME_OP_IF);
+                if (!jc->dead) {
+                        add_fixup(jc, jc->blocks.lsize - 1, emit_jmp_fwd(jc));
+                }
+                assert(b->else_fixup != UINT32_MAX);
+                patch_here(jc, b->else_fixup);
+                b->else_fixup = UINT32_MAX;
+                jc->height = b->height + b->param_arity;
+                jc->dead = false;
+                break;
+        case FRAME_OP_END:
+                b = &VEC_LASTELEM(jc->blocks);
+                if (b->else_fixup != UINT32_MAX) {
+                        /* "if" without "else" */
+                        patch_here(jc, b->else_fixup);
+                }
+                resolve_fixups(jc, jc->blocks.lsize - 1);
+                jc->height = b->height + b->arity;
+                jc->dead = false;
+                jc->blocks.lsize--;
+                if (jc->blocks.lsize == 0) {
+                        /*
+                         * the end of the function.
+                         * let the interpreter execute the "end" to
+                         * return from the function.
+                         */
+                        emit_exit(jc, insn, jc->height);
+                        *pp = p;
+                        return -1;
+                }
+                break;
+        case 0x0c: /* br */
+                emit_br(jc, read_leb_u32_nocheck(&p));
+                jc->dead = true;
+                break;
+        case 0x0d: /* br_if */
+                idx = read_leb_u32_nocheck(&p);
+                emit_pop_i32(jc);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_TEST, RAX, RAX);
+                if (br_needs_move(jc, idx)) {
+                        at = emit_jcc_fwd(jc, CC_E);
+                        emit_br(jc, idx);
+                        patch_here(jc, at);
+                } else {
+                        uint32_t blockidx = jc->blocks.lsize - 1 - idx;
+                        b = &jc->blocks.p[blockidx];
+                        if (b->op == FRAME_OP_LOOP) {
+                                emit_jcc(jc, CC_NE, b->loop_offset);
+                        } else {
+                                add_fixup(jc, blockidx,
+                                          emit_jcc_fwd(jc, CC_NE));
+                        }
+                }
+                break;
+        case 0x0e: /* br_table */
+        {
+                uint32_t n = read_leb_u32_nocheck(&p);
+                uint32_t i;
+                uint32_t table;
+                ret = VEC_PREALLOC(jc->mctx, jc->labels, n);
+                if (ret != 0) {
+                        return ret;
+                }
+                jc->labels.lsize = 0;
+                for (i = 0; i < n; i++) {
+                        *VEC_PUSH(jc->labels) = read_leb_u32_nocheck(&p);
+                }
+                uint32_t defidx = read_leb_u32_nocheck(&p);
+                emit_pop_i32(jc);
+                /* cmp eax, n */
+                emit_op_reg(jc, PREFIX_NONE, false, OP_GRP1_IMM32, GRP1_CMP,
+                            RAX);
+                emit_u32(jc, n);
+                at = emit_jcc_fwd(jc, CC_AE);
+                /*
+                 * lea rcx, [rip + table]
+                 * movsxd rax, dword [rcx + rax * 4]
+                 * add rax, rcx
+                 * jmp rax
+                 */
+                emit_u8(jc, 0x48);
+                emit_u8(jc, OP_LEA);
+                emit_u8(jc, 0x0d);
+                uint32_t lea = code_offset(jc);
+                emit_u32(jc, 0);
+                emit_u8(jc, 0x48);
+                emit_u8(jc, OP_MOVSXD);
+                emit_u8(jc, 0x04);
+                emit_u8(jc, 0x81);
+                emit_op_reg(jc, PREFIX_NONE, true, OP_ADD_RM, RCX, RAX);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_GRP5, 4, RAX);
+                table = code_offset(jc);
+                patch_rel32(jc, lea, table);
+                for (i = 0; i < n; i++) {
+                        emit_u32(jc, 0);
+                }
+                for (i = 0; i < n; i++) {
+                        uint32_t stub = code_offset(jc);
+                        if (jc->error == 0) {
+                                uint32_t rel = stub - table;
+                                memcpy(&jc->code.p[table + i * 4], &rel,
+                                       sizeof(rel));
+                        }
+                        emit_br(jc, jc->labels.p[i]);
+                }
+                patch_here(jc, at);
+                emit_br(jc, defidx);
+                jc->dead = true;
+                break;
+        }
+        case 0x0f: /* return */
+                emit_br(jc, jc->blocks.lsize - 1);
+                jc->dead = true;
+                break;
+        case 0x10: /* call */
+        {
+                uint32_t funcidx = read_leb_u32_nocheck(&p);
+                const struct functype *ft = module_functype(m, funcidx);
+                emit_exit(jc, insn, jc->height);
+                jc->height -= resulttype_cellsize(&ft->parameter);
+                jc->height += resulttype_cellsize(&ft->result);
+                add_entry(jc, p);
+                break;
+        }
+        case 0x11: /* call_indirect */
+        {
+                uint32_t typeidx = read_leb_u32_nocheck(&p);
+                read_leb_u32_nocheck(&p); /* tableidx */
+                const struct functype *ft = &m->types[typeidx];
+                emit_exit(jc, insn, jc->height);
+                jc->height -= 1 + resulttype_cellsize(&ft->parameter);
+                jc->height += resulttype_cellsize(&ft->result);
+                add_entry(jc, p);
+                break;
+        }
+#if defined(TOYWASM_ENABLE_WASM_TAILCALL)
+        case 0x12: /* return_call */
+                read_leb_u32_nocheck(&p);
+                emit_exit(jc, insn, jc->height);
+                jc->dead = true;
+                break;
+        case 0x13: /* return_call_indirect */
+                read_leb_u32_nocheck(&p);
+                read_leb_u32_nocheck(&p);
+                emit_exit(jc, insn, jc->height);
+                jc->dead = true;
+                break;
+#endif
+        case 0x1a: /* drop */
+                jc->height -= lookup_type_annotation(jc, p);
+                break;
+        case 0x1b: /* select */
+        case 0x1c: /* select t */
+                if (op == 0x1b) {
+                        csz = lookup_type_annotation(jc, p);
+                } else {
+                        u32 = read_leb_u32_nocheck(&p);
+                        assert(u32 == 1);
+                        csz = valtype_cellsize(*p++);
+                }
+                emit_pop_i32(jc);
+                emit_op_reg(jc, PREFIX_NONE, false, OP_TEST, RAX, RAX);
+                at = emit_jcc_fwd(jc, CC_NE);
+                emit_move_cells(jc, jc->height - 2 * csz, jc->height - csz,
+                                csz);
+                patch_here(jc, at);
+                jc->height -= csz;
+                break;
+        case 0x20: /* local.get */
+                cidx = local_cellidx(jc, read_leb_u32_nocheck(&p), &csz);
+                emit_copy(jc, R12, S(jc->height), R13, S(cidx), csz * CELLSZ);
+                jc->height += csz;
+                break;
+        case 0x21: /* local.set */
+                cidx = local_cellidx(jc, read_leb_u32_nocheck(&p), &csz);
+                jc->height -= csz;
+                emit_copy(jc, R13, S(cidx), R12, S(jc->height), csz * CELLSZ);
+                break;
+        case 0x22: /* local.tee */
+                cidx = local_cellidx(jc, read_leb_u32_nocheck(&p), &csz);
+                emit_copy(jc, R13, S(cidx), R12, S(jc->height - csz),
+                          csz * CELLSZ);
+                break;
+        case 0x23: /* global.get */
+        case 0x24: /* global.set */
+        {
+                idx = read_leb_u32_nocheck(&p);
+                enum valtype t = module_globaltype(m, idx)->t;
+                uint32_t nbytes;
+                if (t == TYPE_i32 || t == TYPE_f32) {
+                        nbytes = 4;
+                } else if (t == TYPE_i64 || t == TYPE_f64) {
+                        nbytes = 8;
+                } else {
+                        return ENOTSUP;
+                }
+                csz = valtype_cellsize(t);
+                /* rdx = ctx->instance->globals.p[idx] */
+                emit_load(jc, true, RDX, RBX,
+                          offsetof(struct exec_context, instance));
+                emit_load(jc, true, RDX, RDX,
+                          offsetof(struct instance, globals.p));
+                emit_load(jc, true, RDX, RDX,
+                          (int32_t)(idx * sizeof(struct globalinst *)));
+                if (op == 0x23) {
+                        emit_copy(jc, R12, S(jc->height), RDX,
+                                  offsetof(struct globalinst, val), nbytes);
+                        jc->height += csz;
+                } else {
+                        jc->height -= csz;
+                        emit_copy(jc, RDX, offsetof(struct globalinst, val),
+                                  R12, S(jc->height), nbytes);
+                }
+                break;
+        }
+        case 0x28: /* i32.load */
+        case 0x29: /* i64.load */
+        case 0x2a: /* f32.load */
+        case 0x2b: /* f64.load */
+        case 0x2c: /* i32.load8_s */
+        case 0x2d: /* i32.load8_u */
+        case 0x2e: /* i32.load16_s */
+        case 0x2f: /* i32.load16_u */
+        case 0x30: /* i64.load8_s */
+        case 0x31: /* i64.load8_u */
+        case 0x32: /* i64.load16_s */
+        case 0x33: /* i64.load16_u */
+        case 0x34: /* i64.load32_s */
+        case 0x35: /* i64.load32_u */
+        {
+                static const struct load_desc {
+                        uint8_t size;
+                        bool w;
+                        uint16_t op;
+                        bool is64;
+                } loads[] = {
+                        {4, false, OP_MOV_LOAD, false},
+                        {8, true, OP_MOV_LOAD, true},
+                        {4, false, OP_MOV_LOAD, false},
+                        {8, true, OP_MOV_LOAD, true},
+                        {1, false, OP_MOVSX8, false},
+                        {1, false, OP_MOVZX8, false},
+                        {2, false, OP_MOVSX16, false},
+                        {2, false, OP_MOVZX16, false},
+                        {1, true, OP_MOVSX8, true},
+                        {1, false, OP_MOVZX8, true},
+                        {2, true, OP_MOVSX16, true},
+                        {2, false, OP_MOVZX16, true},
+                        {4, true, OP_MOVSXD, true},
+                        {4, false, OP_MOV_LOAD, true},
+                };
+                read_memarg(&p, &memidx, &offset);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                const struct load_desc *l = &loads[op - 0x28];
+                emit_load_insn(jc, p, offset, l->size, l->w, l->op,
+                               l->is64);
+                break;
+        }
+        case 0x36: /* i32.store */
+        case 0x37: /* i64.store */
+        case 0x38: /* f32.store */
+        case 0x39: /* f64.store */
+        case 0x3a: /* i32.store8 */
+        case 0x3b: /* i32.store16 */
+        case 0x3c: /* i64.store8 */
+        case 0x3d: /* i64.store16 */
+        case 0x3e: /* i64.store32 */
+        {
+                static const struct {
+                        uint8_t size;
+                        bool is64;
+                } stores[] = {
+                        {4, false}, {8, true}, {4, false},
+                        {8, true},  {1, false}, {2, false},
+                        {1, true},  {2, true},  {4, true},
+                };
+                read_memarg(&p, &memidx, &offset);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                emit_store_insn(jc, p, offset, stores[op - 0x36].size,
+                                stores[op - 0x36].is64);
+                break;
+        }
+        case 0x3f: /* memory.size */
+                memidx = read_leb_u32_nocheck(&p);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                emit_load(jc, false, RAX, R14,
+                          offsetof(struct meminst, size_in_pages));
+                emit_store(jc, false, R12, S(jc->height), RAX);
+                jc->height += c32;
+                break;
+        case 0x40: /* memory.grow */
+                memidx = read_leb_u32_nocheck(&p);
+                if (!jc->has_memory || memidx != 0) {
+                        return ENOTSUP;
+                }
+                emit_call_helper(jc, jit_memory_grow, jc->height - c32, NULL);
+                break;
+        case 0x41: /* i32.const */
+                emit_const(jc, false, (uint32_t)read_leb_i32_nocheck(&p));
+                break;
+        case 0x42: /* i64.const */
+                emit_const(jc, true, read_leb_i64_nocheck(&p));
+                break;
+        case 0x43: /* f32.const */
+                memcpy(&u32, p, sizeof(u32));
+                p += sizeof(u32);
+                emit_const(jc, false, u32);
+                break;
+        case 0x44: /* f64.const */
+                memcpy(&u64, p, sizeof(u64));
+                p += sizeof(u64);
+                emit_const(jc, true, u64);
+                break;
+
+        case 0x45: /* i32.eqz */
+                emit_int_unop_eqz(jc, false);
+                break;
+        case 0x46: /* i32.eq */
+        case 0x47: /* i32.ne */
+        case 0x48: /* i32.lt_s */
+        case 0x49: /* i32.lt_u */
+        case 0x4a: /* i32.gt_s */
+        case 0x4b: /* i32.gt_u */
+        case 0x4c: /* i32.le_s */
+        case 0x4d: /* i32.le_u */
+        case 0x4e: /* i32.ge_s */
+        case 0x4f: /* i32.ge_u */
+        case 0x51: /* i64.eq */
+        case 0x52: /* i64.ne */
+        case 0x53: /* i64.lt_s */
+        case 0x54: /* i64.lt_u */
+        case 0x55: /* i64.gt_s */
+        case 0x56: /* i64.gt_u */
+        case 0x57: /* i64.le_s */
+        case 0x58: /* i64.le_u */
+        case 0x59: /* i64.ge_s */
+        case 0x5a: /* i64.ge_u */
+        {
+                static const enum cc ccs[] = {
+                        CC_E, CC_NE, CC_L,  CC_B,  CC_G,
+                        CC_A, CC_LE, CC_BE, CC_GE, CC_AE,
+                };
+                if (op <= 0x4f) {
+                        emit_int_cmp(jc, false, ccs[op - 0x46]);
+                } else {
+                        emit_int_cmp(jc, true, ccs[op - 0x51]);
+                }
+                break;
+        }
+        case 0x50: /* i64.eqz */
+                emit_int_unop_eqz(jc, true);
+                break;
+        case 0x5b: /* f32.eq */
+        case 0x5c: /* f32.ne */
+        case 0x5d: /* f32.lt */
+        case 0x5e: /* f32.gt */
+        case 0x5f: /* f32.le */
+        case 0x60: /* f32.ge */
+                emit_float_cmp(jc, false, (enum fcmp)(op - 0x5b));
+                break;
+        case 0x61: /* f64.eq */
+        case 0x62: /* f64.ne */
+        case 0x63: /* f64.lt */
+        case 0x64: /* f64.gt */
+        case 0x65: /* f64.le */
+        case 0x66: /* f64.ge */
+                emit_float_cmp(jc, true, (enum fcmp)(op - 0x61));
+                break;
+
+        case 0x67: /* i32.clz */
+                emit_int_clz(jc, false);
+                break;
+        case 0x68: /* i32.ctz */
+                emit_int_ctz(jc, false);
+                break;
+        case 0x69: /* i32.popcnt */
+                emit_unop_helper(jc, jit_insn_i32_popcnt, NULL, c32, c32);
+                break;
+        case 0x6a: /* i32.add */
+                emit_int_binop(jc, false, OP_ADD);
+                break;
+        case 0x6b: /* i32.sub */
+                emit_int_binop(jc, false, OP_SUB);
+                break;
+        case 0x6c: /* i32.mul */
+                emit_int_binop(jc, false, OP_IMUL);
+                break;
+        case 0x6d: /* i32.div_s */
+                emit_int_divrem(jc, p, false, true, false);
+                break;
+        case 0x6e: /* i32.div_u */
+                emit_int_divrem(jc, p, false, false, false);
+                break;
+        case 0x6f: /* i32.rem_s */
+                emit_int_divrem(jc, p, false, true, true);
+                break;
+        case 0x70: /* i32.rem_u */
+                emit_int_divrem(jc, p, false, false, true);
+                break;
+        case 0x71: /* i32.and */
+                emit_int_binop(jc, false, OP_AND);
+                break;
+        case 0x72: /* i32.or */
+                emit_int_binop(jc, false, OP_OR);
+                break;
+        case 0x73: /* i32.xor */
+                emit_int_binop(jc, false, OP_XOR);
+                break;
+        case 0x74: /* i32.shl */
+                emit_int_shift(jc, false, GRP2_SHL);
+                break;
+        case 0x75: /* i32.shr_s */
+                emit_int_shift(jc, false, GRP2_SAR);
+                break;
+        case 0x76: /* i32.shr_u */
+                emit_int_shift(jc, false, GRP2_SHR);
+                break;
+        case 0x77: /* i32.rotl */
+                emit_int_shift(jc, false, GRP2_ROL);
+                break;
+        case 0x78: /* i32.rotr */
+                emit_int_shift(jc, false, GRP2_ROR);
+                break;
+
+        case 0x79: /* i64.clz */
+                emit_int_clz(jc, true);
+                break;
+        case 0x7a: /* i64.ctz */
+                emit_int_ctz(jc, true);
+                break;
+        case 0x7b: /* i64.popcnt */
+                emit_unop_helper(jc, jit_insn_i64_popcnt, NULL, c64, c64);
+                break;
+        case 0x7c: /* i64.add */
+                emit_int_binop(jc, true, OP_ADD);
+                break;
+        case 0x7d: /* i64.sub */
+                emit_int_binop(jc, true, OP_SUB);
+                break;
+        case 0x7e: /* i64.mul */
+                emit_int_binop(jc, true, OP_IMUL);
+                break;
+        case 0x7f: /* i64.div_s */
+                emit_int_divrem(jc, p, true, true, false);
+                break;
+        case 0x80: /* i64.div_u */
+                emit_int_divrem(jc, p, true, false, false);
+                break;
+        case 0x81: /* i64.rem_s */
+                emit_int_divrem(jc, p, true, true, true);
+                break;
+        case 0x82: /* i64.rem_u */
+                emit_int_divrem(jc, p, true, false, true);
+                break;
+        case 0x83: /* i64.and */
+                emit_int_binop(jc, true, OP_AND);
+                break;
+        case 0x84: /* i64.or */
+                emit_int_binop(jc, true, OP_OR);
+                break;
+        case 0x85: /* i64.xor */
+                emit_int_binop(jc, true, OP_XOR);
+                break;
+        case 0x86: /* i64.shl */
+                emit_int_shift(jc, true, GRP2_SHL);
+                break;
+        case 0x87: /* i64.shr_s */
+                emit_int_shift(jc, true, GRP2_SAR);
+                break;
+        case 0x88: /* i64.shr_u */
+                emit_int_shift(jc, true, GRP2_SHR);
+                break;
+        case 0x89: /* i64.rotl */
+                emit_int_shift(jc, true, GRP2_ROL);
+                break;
+        case 0x8a: /* i64.rotr */
+                emit_int_shift(jc, true, GRP2_ROR);
+                break;
+
+        case 0x8b: /* f32.abs */
+                emit_float_sign(jc, false, GRP1_AND, 0x7f);
+                break;
+        case 0x8c: /* f32.neg */
+                emit_float_sign(jc, false, GRP1_XOR, 0x80);
+                break;
+        case 0x8d: /* f32.ceil */
+                emit_unop_helper(jc, jit_insn_f32_ceil, NULL, c32, c32);
+                break;
+        case 0x8e: /* f32.floor */
+                emit_unop_helper(jc, jit_insn_f32_floor, NULL, c32, c32);
+                break;
+        case 0x8f: /* f32.trunc */
+                emit_unop_helper(jc, jit_insn_f32_trunc, NULL, c32, c32);
+                break;
+        case 0x90: /* f32.nearest */
+                emit_unop_helper(jc, jit_insn_f32_nearest, NULL, c32, c32);
+                break;
+        case 0x91: /* f32.sqrt */
+                emit_float_sqrt(jc, false);
+                break;
+        case 0x92: /* f32.add */
+                emit_float_binop(jc, false, OP_SSE_ADD);
+                break;
+        case 0x93: /* f32.sub */
+                emit_float_binop(jc, false, OP_SSE_SUB);
+                break;
+        case 0x94: /* f32.mul */
+                emit_float_binop(jc, false, OP_SSE_MUL);
+                break;
+        case 0x95: /* f32.div */
+                emit_float_binop(jc, false, OP_SSE_DIV);
+                break;
+        case 0x96: /* f32.min */
+                emit_binop_helper(jc, jit_insn_f32_min, false);
+                break;
+        case 0x97: /* f32.max */
+                emit_binop_helper(jc, jit_insn_f32_max, false);
+                break;
+        case 0x98: /* f32.copysign */
+                emit_float_copysign(jc, false);
+                break;
+
+        case 0x99: /* f64.abs */
+                emit_float_sign(jc, true, GRP1_AND, 0x7f);
+                break;
+        case 0x9a: /* f64.neg */
+                emit_float_sign(jc, true, GRP1_XOR, 0x80);
+                break;
+        case 0x9b: /* f64.ceil */
+                emit_unop_helper(jc, jit_insn_f64_ceil, NULL, c64, c64);
+                break;
+        case 0x9c: /* f64.floor */
+                emit_unop_helper(jc, jit_insn_f64_floor, NULL, c64, c64);
+                break;
+        case 0x9d: /* f64.trunc */
+                emit_unop_helper(jc, jit_insn_f64_trunc, NULL, c64, c64);
+                break;
+        case 0x9e: /* f64.nearest */
+                emit_unop_helper(jc, jit_insn_f64_nearest, NULL, c64, c64);
+                break;
+        case 0x9f: /* f64.sqrt */
+                emit_float_sqrt(jc, true);
+                break;
+        case 0xa0: /* f64.add */
+                emit_float_binop(jc, true, OP_SSE_ADD);
+                break;
+        case 0xa1: /* f64.sub */
+                emit_float_binop(jc, true, OP_SSE_SUB);
+                break;
+        case 0xa2: /* f64.mul */
+                emit_float_binop(jc, true, OP_SSE_MUL);
+                break;
+        case 0xa3: /* f64.div */
+                emit_float_binop(jc, true, OP_SSE_DIV);
+                break;
+        case 0xa4: /* f64.min */
+                emit_binop_helper(jc, jit_insn_f64_min, true);
+                break;
+        case 0xa5: /* f64.max */
+                emit_binop_helper(jc, jit_insn_f64_max, true);
+                break;
+        case 0xa6: /* f64.copysign */
+                emit_float_copysign(jc, true);
+                break;
+
+        case 0xa7: /* i32.wrap_i64 */
+                /* the lower 32 bits are already in place */
+                jc->height = jc->height - c64 + c32;
+                break;
+        case 0xa8: /* i32.trunc_f32_s */
+                emit_unop_helper(jc, jit_insn_i32_trunc_f32_s, p, c32, c32);
+                break;
+        case 0xa9: /* i32.trunc_f32_u */
+                emit_unop_helper(jc, jit_insn_i32_trunc_f32_u, p, c32, c32);
+                break;
+        case 0xaa: /* i32.trunc_f64_s */
+                emit_unop_helper(jc, jit_insn_i32_trunc_f64_s, p, c64, c32);
+                break;
+        case 0xab: /* i32.trunc_f64_u */
+                emit_unop_helper(jc, jit_insn_i32_trunc_f64_u, p, c64, c32);
+                break;
+        case 0xac: /* i64.extend_i32_s */
+                emit_op_mem(jc, PREFIX_NONE, true, OP_MOVSXD, RAX, R12,
+                            S(jc->height - c32));
+                emit_store(jc, true, R12, S(jc->height - c32), RAX);
+                jc->height = jc->height - c32 + c64;
+                break;
+        case 0xad: /* i64.extend_i32_u */
+                emit_load(jc, false, RAX, R12, S(jc->height - c32));
+                emit_store(jc, true, R12, S(jc->height - c32), RAX);
+                jc->height = jc->height - c32 + c64;
+                break;
+        case 0xae: /* i64.trunc_f32_s */
+                emit_unop_helper(jc, jit_insn_i64_trunc_f32_s, p, c32, c64);
+                break;
+        case 0xaf: /* i64.trunc_f32_u */
+                emit_unop_helper(jc, jit_insn_i64_trunc_f32_u, p, c32, c64);
+                break;
+        case 0xb0: /* i64.trunc_f64_s */
+                emit_unop_helper(jc, jit_insn_i64_trunc_f64_s, p, c64, c64);
+                break;
+        case 0xb1: /* i64.trunc_f64_u */
+                emit_unop_helper(jc, jit_insn_i64_trunc_f64_u, p, c64, c64);
+                break;
+        case 0xb2: /* f32.convert_i32_s */
+                emit_float_convert(jc, false, false, false);
+                break;
+        case 0xb3: /* f32.convert_i32_u */
+                emit_float_convert(jc, false, false, true);
+                break;
+        case 0xb4: /* f32.convert_i64_s */
+                emit_float_convert(jc, false, true, false);
+                break;
+        case 0xb5: /* f32.convert_i64_u */
+                emit_unop_helper(jc, jit_insn_f32_convert_i64_u, NULL, c64,
+                                 c32);
+                break;
+        case 0xb6: /* f32.demote_f64 */
+                emit_float_cvt(jc, false);
+                break;
+        case 0xb7: /* f64.convert_i32_s */
+                emit_float_convert(jc, true, false, false);
+                break;
+        case 0xb8: /* f64.convert_i32_u */
+                emit_float_convert(jc, true, false, true);
+                break;
+        case 0xb9: /* f64.convert_i64_s */
+                emit_float_convert(jc, true, true, false);
+                break;
+        case 0xba: /* f64.convert_i64_u */
+                emit_unop_helper(jc, jit_insn_f64_convert_i64_u, NULL, c64,
+                                 c64);
+                break;
+        case 0xbb: /* f64.promote_f32 */
+                emit_float_cvt(jc, true);
+                break;
+        case 0xbc: /* i32.reinterpret_f32 */
+        case 0xbd: /* i64.reinterpret_f64 */
+        case 0xbe: /* f32.reinterpret_i32 */
+        case 0xbf: /* f64.reinterpret_i64 */
+                break;
+        case 0xc0: /* i32.extend8_s */
+                emit_int_extend(jc, false, OP_MOVSX8);
+                break;
+        case 0xc1: /* i32.extend16_s */
+                emit_int_extend(jc, false, OP_MOVSX16);
+                break;
+        case 0xc2: /* i64.extend8_s */
+                emit_int_extend(jc, true, OP_MOVSX8);
+                break;
+        case 0xc3: /* i64.extend16_s */
+                emit_int_extend(jc, true, OP_MOVSX16);
+                break;
+        case 0xc4: /* i64.extend32_s */
+                emit_int_extend(jc, true, OP_MOVSXD);
+                break;
+        case 0xfc:
+                ret = compile_fc(jc, &p);
+                if (ret != 0) {
+                        return ret;
+                }
+                break;
+        default:
+                xlog_trace("jit: unsupported opcode %02" PRIx32
+                           " at %06" PRIx32,
+                           (uint32_t)op, ptr2pc(m, insn));
+                return ENOTSUP;
+        }
+        *pp = p;
+        return 0;
+}
+
+int
+jit_arch_compile_func(struct jit_compile_context *jc, uint32_t funcidx)
+{
+        const struct module *m = jc->m;
+        const struct func *func = &m->funcs[funcidx];
+        const uint8_t *p = func->e.start;
+        int ret;
+
+        jc->ft = module_functype(m, m->nimportedfuncs + funcidx);
+        jc->lt = &func->localtype;
+        jc->ei = &func->e.ei;
+        jc->has_memory = false;
+        if (m->nimportedmems + m->nmems > 0) {
+                const struct memtype *mt = module_memtype(m, 0);
+                jc->has_memory =
+                        (mt->flags &
+                         (MEMTYPE_FLAG_SHARED | MEMTYPE_FLAG_64)) == 0;
+        }
+        jc->blocks.lsize = 0;
+        jc->fixups.lsize = 0;
+        jc->height = 0;
+        jc->dead = false;
+        jc->dead_depth = 0;
+        jc->error = 0;
+        ret = push_block(jc, 0, INT64_MAX);
+        if (ret != 0) {
+                return ret;
+        }
+        add_entry(jc, p);
+        while (true) {
+                if (jc->dead) {
+                        /*
+                         * skip unreachable code until the "else" or "end"
+                         * of the current block.
+                         */
+                        uint8_t op = *p;
+                        if (op == FRAME_OP_BLOCK || op == FRAME_OP_LOOP ||
+                            op == FRAME_OP_IF || op == FRAME_OP_TRY_TABLE) {
+                                jc->dead_depth++;
+                        } else if (op == FRAME_OP_ELSE &&
+                                   jc->dead_depth == 0) {
+                                goto compile;
+                        } else if (op == FRAME_OP_END) {
+                                if (jc->dead_depth == 0) {
+                                        goto compile;
+                                }
+                                jc->dead_depth--;
+                        }
+                        skip_insn(&p);
+                        continue;
+                }
+compile:
+                ret = compile_insn(jc, &p);
+                if (jc->error != 0) {
+                        return jc->error;
+                }
+                if (ret == -1) {
+                        break;
+                }
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        assert(jc->fixups.lsize == 0);
+        return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * lazy validation of function bodies
+ *
+ * when load_options::lazy_validation is set, module_load only checks
+ * the framing of function bodies in the code section. (the size and
+ * the local declarations) the validation of the instructions and
+ * the construction of the side tables for the execution
+ * (expr_exec_info, ie. the jump table and the type annotations)
+ * are deferred until the first call of the function.
+ *
+ * it makes the startup of a large module, which only executes a small
+ * part of its code, cheaper.
+ *
+ * the validation of a function body only depends on the module-level
+ * information which is available at the beginning of the code section.
+ * (C.refs and the data count) we keep a copy of it in
+ * struct lazy_validation.
+ *
+ * a module can be shared among threads. (eg. wasi-threads)
+ * the first call of a function validates it with the lock held and
+ * publishes the result with a release store. the exec logic checks
+ * the state with an acquire load. (lazy_validation_done)
+ *
+ * Note: a module with an invalid function body is not rejected on load.
+ * instead, a call to the function traps. the spec explicitly allows
+ * such a lazy validation:
+ * https://webassembly.github.io/spec/core/appendix/implementation.html#validation
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "expr.h"
+#include "lazy_validation.h"
+#include "mem.h"
+#include "report.h"
+#include "type.h"
+#include "xlog.h"
+
+int
+lazy_validation_create(struct load_context *ctx)
+{
+        struct mem_context *mctx = load_mctx(ctx);
+        struct module *m = ctx->module;
+        struct lazy_validation *lz;
+        uint32_t i;
+        int ret;
+
+        assert(m->lazy == NULL);
+        lz = mem_zalloc(mctx, sizeof(*lz));
+        if (lz == NULL) {
+                return ENOMEM;
+        }
+        load_context_init(&lz->lctx, mctx);
+        toywasm_mutex_init(&lz->lock);
+        lz->nfuncs = m->nfuncs;
+        m->lazy = lz;
+        if (m->nfuncs > 0) {
+                lz->states = mem_calloc(mctx, m->nfuncs, sizeof(*lz->states));
+                lz->ends = mem_calloc(mctx, m->nfuncs, sizeof(*lz->ends));
+                if (lz->states == NULL || lz->ends == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+        }
+        struct load_context *lctx = &lz->lctx;
+        lctx->module = m;
+        lctx->options = ctx->options;
+        lctx->has_datacount = ctx->has_datacount;
+        lctx->ndatas_in_datacount = ctx->ndatas_in_datacount;
+        ret = bitmap_alloc(mctx, &lctx->refs, ctx->refs_size);
+        if (ret != 0) {
+                goto fail;
+        }
+        lctx->refs_size = ctx->refs_size;
+        for (i = 0; i < ctx->refs_size; i++) {
+                if (bitmap_test(&ctx->refs, i)) {
+                        bitmap_set(&lctx->refs, i);
+                }
+        }
+        return 0;
+fail:
+        /* lazy_validation_destroy frees the rest */
+        return ret;
+}
+
+void
+lazy_validation_destroy(struct mem_context *mctx, struct module *m)
+{
+        struct lazy_validation *lz = m->lazy;
+
+        if (lz == NULL) {
+                return;
+        }
+        assert(lz->lctx.mctx == mctx);
+        toywasm_mutex_destroy(&lz->lock);
+        load_context_clear(&lz->lctx);
+        mem_free(mctx, lz->states, lz->nfuncs * sizeof(*lz->states));
+        mem_free(mctx, lz->ends, lz->nfuncs * sizeof(*lz->ends));
+        mem_free(mctx, lz, sizeof(*lz));
+        m->lazy = NULL;
+}
+
+void
+lazy_validation_defer(struct lazy_validation *lz, uint32_t idx,
+                      struct expr *expr, const uint8_t *p, const uint8_t *ep)
+{
+        assert(idx < lz->nfuncs);
+        expr->start = p;
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+        expr->end = ep;
+#endif
+        lz->ends[idx] = ep;
+}
+
+/*
+ * validate the deferred body of module::funcs[idx] with the given
+ * load context. the caller should serialize calls for the same function.
+ */
+int
+lazy_validation_validate_body(const struct module *m, uint32_t idx,
+                              struct load_context *lctx)
+{
+        struct lazy_validation *lz = m->lazy;
+        struct func *func = &m->funcs[idx];
+        struct localtype *lt = &func->localtype;
+        struct functype *ft = &m->types[m->functypeidxes[idx]];
+        const uint8_t *p = func->e.start;
+        const uint8_t *ep = lz->ends[idx];
+        int ret;
+
+        assert(idx < lz->nfuncs);
+        ret = read_expr(&p, ep, &func->e, lt->nlocals, lt->localchunks,
+                        &ft->parameter, &ft->result, lctx);
+        if (ret == 0 && p != ep) {
+                xlog_trace("func has %zu trailing bytes", ep - p);
+                report_error(&lctx->report, "trailing bytes");
+                ret = EINVAL;
+        }
+        return ret;
+}
+
+/*
+ * validate module::funcs[idx] if it hasn't been done yet.
+ *
+ * returns EINVAL with a message in the report if the function is invalid.
+ */
+int
+lazy_validate_func(const struct module *m, uint32_t idx,
+                   struct report *report)
+{
+        struct lazy_validation *lz = m->lazy;
+        int ret;
+
+        assert(lz != NULL);
+        assert(idx < lz->nfuncs);
+        toywasm_mutex_lock(&lz->lock);
+        switch (atomic_load_explicit(&lz->states[idx],
+                                     memory_order_relaxed)) {
+        case LAZY_VALIDATION_VALID:
+                ret = 0;
+                goto done;
+        case LAZY_VALIDATION_INVALID:
+                report_error(report, "func %" PRIu32 " is invalid",
+                             m->nimportedfuncs + idx);
+                ret = EINVAL;
+                goto done;
+        default:
+                break;
+        }
+        xlog_trace("lazy validation of func %" PRIu32,
+                   m->nimportedfuncs + idx);
+        struct load_context *lctx = &lz->lctx;
+        ret = lazy_validation_validate_body(m, idx, lctx);
+        if (ret != 0) {
+                /*
+                 * Note: the partially built expr_exec_info is
+                 * freed by module_unload.
+                 */
+                report_error(report, "func %" PRIu32 " is invalid: %s",
+                             m->nimportedfuncs + idx,
+                             report_getmessage(&lctx->report));
+                report_clear(&lctx->report);
+                atomic_store_explicit(&lz->states[idx],
+                                      LAZY_VALIDATION_INVALID,
+                                      memory_order_relaxed);
+                if (ret != ENOMEM) {
+                        ret = EINVAL;
+                }
+                goto done;
+        }
+        atomic_store_explicit(&lz->states[idx], LAZY_VALIDATION_VALID,
+                              memory_order_release);
+done:
+        toywasm_mutex_unlock(&lz->lock);
+        return ret;
+}
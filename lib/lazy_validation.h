@@ -0,0 +1,69 @@
+#if __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "load_context.h"
+#include "lock.h"
+#include "platform.h"
+
+struct expr;
+struct mem_context;
+struct module;
+struct report;
+
+enum lazy_validation_state {
+        LAZY_VALIDATION_PENDING = 0,
+        LAZY_VALIDATION_VALID,
+        LAZY_VALIDATION_INVALID,
+};
+
+/*
+ * the state to validate function bodies on their first calls.
+ * see load_options::lazy_validation.
+ *
+ * states[i] and ends[i] are for module::funcs[i].
+ * states[i] is an enum lazy_validation_state. it's only updated with
+ * the lock held. once it becomes other than LAZY_VALIDATION_PENDING,
+ * it never changes.
+ *
+ * lctx is a copy of the load context at the beginning of the code
+ * section. it's only used with the lock held.
+ */
+struct lazy_validation {
+        uint32_t nfuncs;
+        _Atomic uint8_t *states;
+        const uint8_t **ends;
+        TOYWASM_MUTEX_DEFINE(lock);
+        struct load_context lctx;
+};
+
+__BEGIN_EXTERN_C
+
+int lazy_validation_create(struct load_context *ctx);
+void lazy_validation_destroy(struct mem_context *mctx, struct module *m);
+void lazy_validation_defer(struct lazy_validation *lz, uint32_t idx,
+                           struct expr *expr, const uint8_t *p,
+                           const uint8_t *ep);
+int lazy_validation_validate_body(const struct module *m, uint32_t idx,
+                                  struct load_context *lctx);
+int lazy_validate_func(const struct module *m, uint32_t idx,
+                       struct report *report);
+
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+/* parallel_validation.c */
+int parallel_validation(struct load_context *ctx, uint32_t nthreads);
+#endif
+
+__END_EXTERN_C
+
+/*
+ * returns true if module::funcs[idx] has been validated successfully.
+ */
+static inline bool
+lazy_validation_done(const struct lazy_validation *lz, uint32_t idx)
+{
+        return atomic_load_explicit(&lz->states[idx], memory_order_acquire) ==
+               LAZY_VALIDATION_VALID;
+}
@@ -1,3 +1,6 @@
+#if !defined(_TOYWASM_LOAD_CONTEXT_H)
+#define _TOYWASM_LOAD_CONTEXT_H
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -16,6 +19,12 @@ struct load_context {
         struct load_options options;
         struct mem_context *mctx;
         struct validation_context *vctx;
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        struct module_cache *cache;
+#endif
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        struct module_stream *stream;
+#endif
 };
 
 #define load_mctx(l) (l)->mctx
@@ -26,3 +35,5 @@ void load_context_init(struct load_context *ctx, struct mem_context *mctx);
 void load_context_clear(struct load_context *ctx);
 
 __END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_LOAD_CONTEXT_H) */
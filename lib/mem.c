@@ -70,7 +70,7 @@ mem_reserve_one(struct mem_context *ctx, size_t diff)
 }
 #endif
 
-static void
+void
 mem_unreserve(struct mem_context *ctx, size_t diff)
 {
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -81,7 +81,7 @@ mem_unreserve(struct mem_context *ctx, size_t diff)
 #endif
 }
 
-static int
+int
 mem_reserve(struct mem_context *ctx, size_t diff)
 {
 #if defined(TOYWASM_ENABLE_HEAP_TRACKING)
@@ -129,6 +129,22 @@ mem_context_clear(struct mem_context *ctx)
         assert(ctx->allocated == 0);
 }
 
+/*
+ * hand the memory allocated with a child context over to its parent.
+ * after this, the memory should be freed with the parent context.
+ *
+ * because mem_alloc charges the parent as well, the parent already
+ * accounts the memory. we only need to forget it here.
+ */
+void
+mem_context_merge(struct mem_context *ctx)
+{
+        assert(ctx->parent != NULL);
+#if defined(TOYWASM_ENABLE_HEAP_TRACKING)
+        ctx->allocated = 0;
+#endif
+}
+
 int
 mem_context_setlimit(struct mem_context *ctx, size_t limit)
 {
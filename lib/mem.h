@@ -21,6 +21,7 @@ __BEGIN_EXTERN_C
 
 void mem_context_init(struct mem_context *ctx);
 void mem_context_clear(struct mem_context *ctx);
+void mem_context_merge(struct mem_context *ctx);
 int __must_check mem_context_setlimit(struct mem_context *ctx, size_t limit);
 void *__must_check mem_alloc(struct mem_context *ctx, size_t sz) __malloc_like
         __alloc_size(2);
@@ -36,6 +37,13 @@ void *__must_check mem_extend_zero(struct mem_context *ctx, void *p,
 void *__must_check mem_shrink(struct mem_context *ctx, void *p, size_t oldsz,
                               size_t newsz) __malloc_like __alloc_size(4);
 
+/*
+ * account memory which is not allocated with the above functions.
+ * (eg. mmap)
+ */
+int __must_check mem_reserve(struct mem_context *ctx, size_t sz);
+void mem_unreserve(struct mem_context *ctx, size_t sz);
+
 __END_EXTERN_C
 
 #endif /* !defined(_TOYWASM_MEM_H) */
@@ -0,0 +1,217 @@
+/*
+ * guard-page based linear memory
+ *
+ * with TOYWASM_USE_GUARD_PAGES, memory_instance_create reserves the
+ * address space for every possible effective address of a 32-bit memory
+ * (ptr + offset + access size, ie. a bit more than 8GB) with PROT_NONE
+ * and only makes the current size of the memory accessible.
+ * it's the same as TOYWASM_USE_RESERVED_MEMORY (memory_reserve.c)
+ * except the size of the reservation.
+ *
+ * it allows the plain load/store instructions to skip the bounds
+ * checks. (memory_access_getptr) an out of bounds access hits the
+ * inaccessible part of the reservation and raises SIGSEGV. the signal
+ * handler longjmps back to memory_guard_exec, which converts it to
+ * TRAP_OUT_OF_BOUNDS_MEMORY_ACCESS of the exec_context.
+ *
+ * the other accesses (bulk memory instructions, atomics, host functions)
+ * still use memory_getptr, which checks the bounds explicitly.
+ * so do the unaligned plain accesses, which might straddle the end of
+ * the memory. (see memory_access_getptr)
+ *
+ * a memory can't have the guard pages when:
+ * - its page size is smaller than the host page size. (custom-page-sizes)
+ * - the reservation fails. (eg. RLIMIT_AS)
+ * in that case, memory_instance_create falls back to the smaller
+ * reservation of TOYWASM_USE_RESERVED_MEMORY.
+ *
+ * Note: the signal handler only handles faults within the reservations
+ * of the memories of the instance being executed by the thread.
+ * other faults are passed to the previous handler.
+ */
+
+#define _DEFAULT_SOURCE /* SA_NODEFER */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "exec.h"
+#include "mem.h"
+#include "memory_guard.h"
+#include "memory_reserve.h"
+#include "type.h"
+#include "xlog.h"
+
+/*
+ * ptr (u32) + offset (u32) + the largest access size, rounded up to
+ * the wasm page size.
+ */
+#define MEMORY_GUARD_RESERVE_SIZE                                             \
+        (((size_t)2 << 32) + ((size_t)1 << WASM_PAGE_SHIFT))
+
+ctassert(MEMORY_GUARD_MAX_ACCESS_SIZE <= (1 << WASM_PAGE_SHIFT));
+
+struct memory_guard_frame {
+        sigjmp_buf jmpbuf;
+        struct exec_context *ctx;
+        struct memory_guard_frame *prev;
+
+        /* set by the signal handler */
+        volatile uint32_t memidx;
+        volatile uint64_t offset;
+};
+
+static _Thread_local struct memory_guard_frame *memory_guard_current;
+
+static pthread_once_t memory_guard_once = PTHREAD_ONCE_INIT;
+static int memory_guard_install_error;
+static struct sigaction memory_guard_oact_segv;
+static struct sigaction memory_guard_oact_bus;
+
+static void
+memory_guard_handler(int signo, siginfo_t *info, void *uctx)
+{
+        struct memory_guard_frame *frame = memory_guard_current;
+
+        if (frame != NULL) {
+                const struct instance *inst = frame->ctx->instance;
+                uintptr_t addr = (uintptr_t)info->si_addr;
+                uint32_t i;
+                for (i = 0; i < inst->mems.lsize; i++) {
+                        const struct meminst *mi = VEC_ELEM(inst->mems, i);
+                        if (!mi->guarded) {
+                                continue;
+                        }
+                        uintptr_t start = (uintptr_t)mi->data;
+                        if (addr >= start && addr - start < mi->reserved) {
+                                frame->memidx = i;
+                                frame->offset = addr - start;
+                                siglongjmp(frame->jmpbuf, 1);
+                        }
+                }
+        }
+
+        /* not ours. */
+        const struct sigaction *oact = (signo == SIGSEGV)
+                                               ? &memory_guard_oact_segv
+                                               : &memory_guard_oact_bus;
+        if (oact->sa_handler != SIG_DFL && oact->sa_handler != SIG_IGN) {
+                if ((oact->sa_flags & SA_SIGINFO) != 0) {
+                        oact->sa_sigaction(signo, info, uctx);
+                } else {
+                        oact->sa_handler(signo);
+                }
+                return;
+        }
+        /*
+         * restore the default action and re-raise the signal to kill
+         * the process. SIG_IGN is treated the same way because
+         * ignoring a fault would re-execute the faulting instruction
+         * forever. (SA_NODEFER allows the delivery within the handler.)
+         */
+        signal(signo, SIG_DFL);
+        raise(signo);
+}
+
+static void
+memory_guard_install(void)
+{
+        struct sigaction act;
+
+        memset(&act, 0, sizeof(act));
+        act.sa_sigaction = memory_guard_handler;
+        /*
+         * SA_NODEFER because we leave the handler with siglongjmp
+         * without restoring the signal mask.
+         */
+        act.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&act.sa_mask);
+        if (sigaction(SIGSEGV, &act, &memory_guard_oact_segv) != 0 ||
+            sigaction(SIGBUS, &act, &memory_guard_oact_bus) != 0) {
+                memory_guard_install_error = errno;
+                xlog_error("failed to install the signal handler: %d",
+                           memory_guard_install_error);
+        }
+}
+
+/*
+ * try to set up the guard pages for the memory.
+ *
+ * returns ENOTSUP if the memory can't have guard pages.
+ * in that case, the caller should fall back to the ordinary allocation.
+ *
+ * the memory is grown and destroyed with memory_reserve_grow and
+ * memory_reserve_destroy.
+ */
+int
+memory_guard_create(struct meminst *mi, size_t size)
+{
+        const uint32_t page_shift = memtype_page_shift(mi->type);
+        long host_page_size = sysconf(_SC_PAGESIZE);
+        int ret;
+
+        assert(!mi->guarded);
+        /*
+         * the guard pages need the end of the memory to be at
+         * a host page boundary.
+         */
+        if (host_page_size <= 0 || ((size_t)1 << page_shift) <
+                                           (unsigned long)host_page_size) {
+                return ENOTSUP;
+        }
+        ret = pthread_once(&memory_guard_once, memory_guard_install);
+        if (ret != 0 || memory_guard_install_error != 0) {
+                return ENOTSUP;
+        }
+        ret = memory_reserve_create(mi, MEMORY_GUARD_RESERVE_SIZE, size);
+        if (ret != 0) {
+                return ret;
+        }
+        mi->guarded = true;
+        return 0;
+}
+
+/*
+ * call fn(ctx) with the signal handler armed for ctx.
+ *
+ * it's used by exec_expr_continue. it can be nested when a host function
+ * executes another exec_context on the same thread.
+ */
+int
+memory_guard_exec(struct exec_context *ctx,
+                  int (*fn)(struct exec_context *ctx))
+{
+        struct memory_guard_frame frame;
+        int ret;
+
+        frame.ctx = ctx;
+        frame.prev = memory_guard_current;
+        /*
+         * Note: 0 to avoid a syscall to save the signal mask.
+         * see SA_NODEFER in memory_guard_install.
+         */
+        if (sigsetjmp(frame.jmpbuf, 0) == 0) {
+                memory_guard_current = &frame;
+                ret = fn(ctx);
+        } else {
+                const struct meminst *mi =
+                        VEC_ELEM(ctx->instance->mems, frame.memidx);
+                ret = trap_with_id(
+                        ctx, TRAP_OUT_OF_BOUNDS_MEMORY_ACCESS,
+                        "invalid memory access at %04" PRIx32
+                        " around %09" PRIx64 ", meminst size %" PRIu32
+                        ", pagesize %" PRIu32,
+                        frame.memidx, frame.offset, mi->size_in_pages,
+                        1 << memtype_page_shift(mi->type));
+        }
+        memory_guard_current = frame.prev;
+        return ret;
+}
@@ -0,0 +1,63 @@
+#if !defined(_TOYWASM_MEMORY_GUARD_H)
+#define _TOYWASM_MEMORY_GUARD_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+#include "type.h"
+
+struct exec_context;
+struct meminst;
+
+/*
+ * the largest access size which can rely on the guard pages. (v128)
+ */
+#define MEMORY_GUARD_MAX_ACCESS_SIZE 16
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_USE_GUARD_PAGES)
+int memory_guard_create(struct meminst *mi, size_t size);
+int memory_guard_exec(struct exec_context *ctx,
+                      int (*fn)(struct exec_context *ctx));
+#endif
+
+__END_EXTERN_C
+
+/*
+ * memory_getptr for the plain load/store instructions.
+ * (the includer should include exec.h for memory_getptr)
+ *
+ * for a memory with guard pages, skip the bounds check.
+ * an out of bounds access faults and memory_guard_exec converts it
+ * to a trap. pc is the instruction pointer to report for the trap,
+ * the same one a bounds check failure would report. (INSN_FAIL)
+ *
+ * an unaligned access can straddle the end of the memory. it's
+ * bounds-checked as usual so that a partially out of bounds store
+ * never modifies the in-bounds part. a naturally aligned access can't
+ * straddle it because the end is at a host page boundary.
+ */
+static inline int
+memory_access_getptr(struct exec_context *ctx, uint32_t memidx, uint32_t ptr,
+                     uint32_t offset, uint32_t size, void **pp,
+                     const uint8_t *pc)
+{
+#if defined(TOYWASM_USE_GUARD_PAGES)
+        const struct meminst *mi = VEC_ELEM(ctx->instance->mems, memidx);
+        const size_t ea = (size_t)ptr + offset;
+        assert(size <= MEMORY_GUARD_MAX_ACCESS_SIZE);
+        assert((size & (size - 1)) == 0);
+        if (__predict_true(mi->guarded && (ea & (size - 1)) == 0)) {
+                ctx->p = pc;
+                *pp = mi->data + ea;
+                return 0;
+        }
+#endif
+        return memory_getptr(ctx, memidx, ptr, offset, size, pp);
+}
+
+#endif /* !defined(_TOYWASM_MEMORY_GUARD_H) */
@@ -0,0 +1,181 @@
+/*
+ * linear memory in a reserved address space
+ *
+ * with TOYWASM_USE_RESERVED_MEMORY, memory_instance_create reserves
+ * the address space for the max size of the memory (memtype::lim.max)
+ * with PROT_NONE and only makes the current size of the memory
+ * accessible with mprotect. memory.grow merely makes more pages
+ * accessible.
+ *
+ * comparing to the malloc-based implementation:
+ *
+ * - memory.grow is O(the number of pages added) instead of
+ *   O(the size of the memory) because nothing is copied.
+ *
+ * - meminst::data never moves. memory.grow on a shared memory doesn't
+ *   need to suspend other threads. it makes
+ *   TOYWASM_PREALLOC_SHARED_MEMORY unnecessary.
+ *
+ * - the newly accessible pages are zero-filled by the kernel.
+ *   pages which are never touched don't consume physical memory.
+ *
+ * a memory falls back to the malloc-based implementation when
+ * the reservation fails. (eg. RLIMIT_AS, or a 32-bit host)
+ *
+ * TOYWASM_USE_GUARD_PAGES uses the same mechanism with a larger
+ * reservation. (see memory_guard.c)
+ *
+ * Note: the accessible part is rounded up to the host page size.
+ * the bounds checks are still done with meminst::size_in_pages.
+ */
+
+#define _DEFAULT_SOURCE  /* MAP_ANON, MAP_NORESERVE */
+#define _DARWIN_C_SOURCE /* MAP_ANON, MAP_NORESERVE */
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "memory_reserve.h"
+#include "type.h"
+#include "xlog.h"
+
+static size_t
+host_page_size(void)
+{
+        long sz = sysconf(_SC_PAGESIZE);
+        if (sz <= 0) {
+                return 4096;
+        }
+        return (size_t)sz;
+}
+
+static size_t
+round_up_to_host_page(size_t sz)
+{
+        size_t pgsz = host_page_size();
+        return (sz + pgsz - 1) / pgsz * pgsz;
+}
+
+/*
+ * reserve "reserve" bytes of the address space for the memory and
+ * make the first "size" bytes of it accessible.
+ *
+ * returns ENOTSUP if the reservation fails.
+ * in that case, the caller should fall back to the ordinary allocation.
+ */
+int
+memory_reserve_create(struct meminst *mi, size_t reserve, size_t size)
+{
+        int ret;
+
+        assert(mi->data == NULL);
+        assert(mi->allocated == 0);
+        assert(mi->reserved == 0);
+        assert(size <= reserve);
+        reserve = round_up_to_host_page(reserve);
+        if (reserve == 0) {
+                return ENOTSUP;
+        }
+        ret = mem_reserve(mi->mctx, size);
+        if (ret != 0) {
+                return ret;
+        }
+        void *p = mmap(NULL, reserve, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+                xlog_trace("%s: mmap failed with %d", __func__, errno);
+                mem_unreserve(mi->mctx, size);
+                return ENOTSUP;
+        }
+        size_t commit = round_up_to_host_page(size);
+        if (commit > 0 && mprotect(p, commit, PROT_READ | PROT_WRITE) != 0) {
+                xlog_trace("%s: mprotect failed with %d", __func__, errno);
+                munmap(p, reserve);
+                mem_unreserve(mi->mctx, size);
+                return ENOTSUP;
+        }
+        mi->data = p;
+        mi->allocated = size;
+        mi->reserved = reserve;
+        xlog_trace("%s: reserved %zu bytes at %p", __func__, mi->reserved,
+                   p);
+        return 0;
+}
+
+/*
+ * make the first "size" bytes of the memory accessible.
+ * the newly accessible part is zero-filled.
+ */
+int
+memory_reserve_grow(struct meminst *mi, size_t size)
+{
+        int ret;
+
+        assert(mi->reserved != 0);
+        if (size <= mi->allocated) {
+                return 0;
+        }
+        if (size > mi->reserved) {
+                return ENOMEM;
+        }
+        ret = mem_reserve(mi->mctx, size - mi->allocated);
+        if (ret != 0) {
+                return ret;
+        }
+        size_t ocommit = round_up_to_host_page(mi->allocated);
+        size_t ncommit = round_up_to_host_page(size);
+        if (ncommit > ocommit &&
+            mprotect(mi->data + ocommit, ncommit - ocommit,
+                     PROT_READ | PROT_WRITE) != 0) {
+                ret = errno;
+                mem_unreserve(mi->mctx, size - mi->allocated);
+                return ret;
+        }
+        mi->allocated = size;
+        return 0;
+}
+
+/*
+ * make the memory after the first "size" bytes inaccessible again
+ * and release its pages. used to reset a memory. (see instance_clone.c)
+ */
+int
+memory_reserve_shrink(struct meminst *mi, size_t size)
+{
+        assert(mi->reserved != 0);
+        if (size >= mi->allocated) {
+                return 0;
+        }
+        size_t ocommit = round_up_to_host_page(mi->allocated);
+        size_t ncommit = round_up_to_host_page(size);
+        if (ocommit > ncommit) {
+                /* replacing the mapping discards the pages */
+                void *p = mmap(mi->data + ncommit, ocommit - ncommit,
+                               PROT_NONE,
+                               MAP_PRIVATE | MAP_ANON | MAP_NORESERVE |
+                                       MAP_FIXED,
+                               -1, 0);
+                if (p == MAP_FAILED) {
+                        return errno;
+                }
+        }
+        mem_unreserve(mi->mctx, mi->allocated - size);
+        mi->allocated = size;
+        return 0;
+}
+
+void
+memory_reserve_destroy(struct meminst *mi)
+{
+        assert(mi->reserved != 0);
+        munmap(mi->data, mi->reserved);
+        mem_unreserve(mi->mctx, mi->allocated);
+        mi->data = NULL;
+        mi->allocated = 0;
+        mi->reserved = 0;
+}
@@ -0,0 +1,17 @@
+#include <stddef.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct meminst;
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+int memory_reserve_create(struct meminst *mi, size_t reserve, size_t size);
+int memory_reserve_grow(struct meminst *mi, size_t size);
+int memory_reserve_shrink(struct meminst *mi, size_t size);
+void memory_reserve_destroy(struct meminst *mi);
+#endif
+
+__END_EXTERN_C
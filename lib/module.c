@@ -19,11 +19,17 @@
 #include "expr.h"
 #include "leb128.h"
 #include "load_context.h"
+#include "jit.h"
+#include "lazy_validation.h"
 #include "mem.h"
 #include "module.h"
+#include "module_cache.h"
+#include "module_stream.h"
 #include "nbio.h"
+#include "predecode.h"
 #include "report.h"
 #include "type.h"
+#include "type_registry.h"
 #include "util.h"
 #include "xlog.h"
 
@@ -266,6 +272,10 @@ read_functype(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                 goto fail;
         }
 
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        ft->canonid = 0;
+        functype_register(load_mctx(ctx), ft);
+#endif
         *pp = p;
 fail:
         return ret;
@@ -274,6 +284,9 @@ fail:
 void
 clear_functype(struct mem_context *mctx, struct functype *ft)
 {
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        functype_unregister(mctx, ft);
+#endif
         clear_resulttype(mctx, &ft->parameter);
         clear_resulttype(mctx, &ft->result);
 }
@@ -1109,6 +1122,16 @@ read_func(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                    "], type[%" PRIu32 "])",
                    funcidx, idx, functypeidx);
 
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        if (ctx->stream != NULL) {
+                /* the size of the code */
+                ret = module_stream_need(ctx->stream,
+                                         (ep - p > 5) ? p + 5 : ep);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
         /* code */
         ret = read_leb_u32(&p, ep, &size);
         if (ret != 0) {
@@ -1120,10 +1143,42 @@ read_func(const uint8_t **pp, const uint8_t *ep, uint32_t idx,
                 ret = EINVAL;
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        if (ctx->stream != NULL) {
+                ret = module_stream_need(ctx->stream, cep);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
         ret = read_locals(&p, cep, func, ctx);
         if (ret != 0) {
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        if (ctx->cache != NULL && module_cache_hit(ctx->cache, m->nfuncs)) {
+                /* the body was validated when the cache was made */
+                ret = module_cache_read_func(load_mctx(ctx), ctx->cache,
+                                             &func->e.ei);
+                if (ret != 0) {
+                        goto fail;
+                }
+                func->e.start = p;
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+                func->e.end = cep;
+#endif
+                *pp = cep;
+                return 0;
+        }
+#endif
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        if (m->lazy != NULL) {
+                /* leave the body to lazy_validate_func */
+                lazy_validation_defer(m->lazy, idx, &func->e, p, cep);
+                *pp = cep;
+                return 0;
+        }
+#endif
         ret = read_expr(&p, cep, &func->e, lt->nlocals, lt->localchunks,
                         &ft->parameter, &ft->result, ctx);
         if (ret != 0) {
@@ -1621,6 +1676,26 @@ read_code_section(const uint8_t **pp, const uint8_t *ep,
 
         assert(m->funcs == NULL);
         uint32_t nfuncs_in_code = 0;
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        bool lazy = ctx->options.lazy_validation;
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        bool parallel = !lazy && ctx->options.validation_threads > 1;
+#else
+        bool parallel = false;
+#endif
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        if (ctx->cache != NULL && module_cache_hit(ctx->cache, m->nfuncs)) {
+                /* no bodies to validate */
+                lazy = parallel = false;
+        }
+#endif
+        if (lazy || parallel) {
+                ret = lazy_validation_create(ctx);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
         ret = read_vec_with_ctx(load_mctx(ctx), &p, ep, sizeof(*m->funcs),
                                 read_func, clear_func, ctx, &nfuncs_in_code,
                                 &m->funcs);
@@ -1634,6 +1709,20 @@ read_code_section(const uint8_t **pp, const uint8_t *ep,
                 ret = EINVAL;
                 goto fail;
         }
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        if (parallel) {
+                /*
+                 * validate the bodies, which read_func has skipped,
+                 * and then forget the deferred state.
+                 */
+                ret = parallel_validation(ctx,
+                                          ctx->options.validation_threads);
+                if (ret != 0) {
+                        goto fail;
+                }
+                lazy_validation_destroy(load_mctx(ctx), m);
+        }
+#endif
 
         uint32_t i;
         for (i = 0; i < m->nfuncs; i++) {
@@ -2198,6 +2287,17 @@ module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
         ctx->module = m;
         m->bin = p;
 
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+        struct module_stream *st = ctx->stream;
+        if (st != NULL) {
+                /* the magic and the version */
+                ret = module_stream_want(st, p + 8);
+                if (ret != 0) {
+                        goto fail;
+                }
+                ep = module_stream_limit(st);
+        }
+#endif
         ret = read_u32(&p, ep, &v);
         if (ret != 0) {
                 goto fail;
@@ -2219,7 +2319,20 @@ module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
         }
 
         uint8_t max_seen_section_id = 0;
-        while (p < ep) {
+        while (true) {
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+                if (st != NULL) {
+                        /* the section id and size */
+                        ret = module_stream_want(st, p + 1 + 5);
+                        if (ret != 0) {
+                                goto fail;
+                        }
+                        ep = module_stream_limit(st);
+                }
+#endif
+                if (p >= ep) {
+                        break;
+                }
                 struct section s;
                 ret = section_load(&s, &p, ep);
                 if (ret != 0) {
@@ -2227,6 +2340,27 @@ module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
                                      "section_load failed with %d", ret);
                         goto fail;
                 }
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+                if (st != NULL) {
+                        /*
+                         * the code section is received function by
+                         * function. (read_func) only wait for the vector
+                         * size here.
+                         */
+                        const uint8_t *need = s.data + s.size;
+                        if (s.id == SECTION_ID_code && s.size > 5) {
+                                need = s.data + 5;
+                        }
+                        ret = module_stream_need(st, need);
+                        if (ret != 0) {
+                                report_error(&ctx->report,
+                                             "failed to receive section %u "
+                                             "with %d",
+                                             s.id, ret);
+                                goto fail;
+                        }
+                }
+#endif
                 const struct section_type *t = get_section_type(s.id);
 
                 if (t == NULL) {
@@ -2334,6 +2468,41 @@ module_load_into(struct module *m, const uint8_t *p, const uint8_t *ep,
         }
 #endif
 
+#if defined(TOYWASM_USE_PREDECODE) || defined(TOYWASM_ENABLE_JIT)
+        /*
+         * pre-decoding and jit need validated function bodies.
+         */
+        bool validated = true;
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        if (m->lazy != NULL) {
+                xlog_trace("lazy validation: skipping pre-decoding and jit");
+                validated = false;
+        }
+#endif
+#endif
+
+#if defined(TOYWASM_USE_PREDECODE)
+        if (validated && ctx->options.generate_predecoded_code) {
+                ret = predecode_module(m, ep, ctx->mctx);
+                if (ret == ENOTSUP) {
+                        /* fall back to the in-place execution */
+                        xlog_trace("pre-decoding is not supported for "
+                                   "the module");
+                } else if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
+
+#if defined(TOYWASM_ENABLE_JIT)
+        if (validated && ctx->options.generate_jit_code) {
+                ret = jit_module(m, ctx->mctx);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+#endif
+
         ret = 0;
 fail:
         return ret;
@@ -2360,7 +2529,30 @@ module_create(struct module **mp, const uint8_t *p, const uint8_t *ep,
         if (ret != 0) {
                 return ret;
         }
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        if (ctx->options.module_cache_dir != NULL) {
+                ret = module_cache_open(ctx, p, ep);
+                if (ret != 0) {
+                        module_destroy(mctx, m);
+                        return ret;
+                }
+        }
+#endif
         ret = module_load_into(m, p, ep, ctx);
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        if (ctx->cache != NULL) {
+                if (ret == 0) {
+                        /* a failure to save is not fatal */
+                        int ret1 = module_cache_save(ctx, m);
+                        if (ret1 != 0) {
+                                xlog_trace("module_cache_save failed "
+                                           "with %d",
+                                           ret1);
+                        }
+                }
+                module_cache_close(ctx);
+        }
+#endif
         if (ret != 0) {
                 module_destroy(mctx, m);
                 return ret;
@@ -2369,6 +2561,37 @@ module_create(struct module **mp, const uint8_t *p, const uint8_t *ep,
         return 0;
 }
 
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+/*
+ * load a module while receiving its binary from the stream.
+ * see module_stream.c.
+ *
+ * Note: load_options::module_cache_dir is ignored because the cache
+ * is keyed by the hash of the whole binary.
+ */
+int
+module_create_from_stream(struct module **mp, struct module_stream *st,
+                          struct load_context *ctx)
+{
+        struct mem_context *mctx = ctx->mctx;
+        struct module *m;
+        int ret = module_create0(mctx, &m);
+        if (ret != 0) {
+                return ret;
+        }
+        assert(ctx->stream == NULL);
+        ctx->stream = st;
+        ret = module_load_into(m, st->buf, module_stream_limit(st), ctx);
+        ctx->stream = NULL;
+        if (ret != 0) {
+                module_destroy(mctx, m);
+                return ret;
+        }
+        *mp = m;
+        return 0;
+}
+#endif
+
 static void
 module_unload(struct mem_context *mctx, struct module *m)
 {
@@ -2425,6 +2648,18 @@ module_unload(struct mem_context *mctx, struct module *m)
         }
 #endif
 
+#if defined(TOYWASM_USE_PREDECODE)
+        predecoded_code_free(mctx, m);
+#endif
+
+#if defined(TOYWASM_ENABLE_JIT)
+        jit_code_free(mctx, m);
+#endif
+
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        lazy_validation_destroy(mctx, m);
+#endif
+
         memset(m, 0, sizeof(*m));
 }
 
@@ -2455,12 +2690,15 @@ module_print_stats(const struct module *m)
         nbio_printf("=== module memory usage statistics ===\n");
         uint32_t i;
         size_t jump_table_size = 0;
+        size_t jump_nextidx_size = 0;
 #if defined(TOYWASM_ENABLE_WRITER)
         size_t code_size = 0;
 #endif
         size_t type_annotation_size = 0;
         size_t localtype_cellidx_size = 0;
         size_t resulttype_cellidx_size = 0;
+        size_t predecoded_code_size = 0;
+        size_t jit_code_size = 0;
         for (i = 0; i < m->nfuncs; i++) {
                 const struct func *func = &m->funcs[i];
                 const struct expr *e = &func->e;
@@ -2469,6 +2707,8 @@ module_print_stats(const struct module *m)
                 jump_table_size += sizeof(ei->njumps);
                 if (ei->jumps != NULL) {
                         jump_table_size += ei->njumps * sizeof(*ei->jumps);
+                        jump_nextidx_size +=
+                                ei->njumps * sizeof(ei->jumps->nextidx);
                 }
                 code_size += expr_end(e) - e->start;
 #if defined(TOYWASM_USE_SMALL_CELLS)
@@ -2491,15 +2731,28 @@ module_print_stats(const struct module *m)
                 resulttype_cellidx_size += resulttype_overhead(&ft->parameter);
                 resulttype_cellidx_size += resulttype_overhead(&ft->result);
         }
+#endif
+#if defined(TOYWASM_USE_PREDECODE)
+        predecoded_code_size = m->npredecoded * sizeof(*m->predecoded);
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        if (m->jit != NULL) {
+                jit_code_size = m->jit->size;
+        }
 #endif
         nbio_printf("%30s %12zu bytes\n", "wasm instructions to annotate",
                     code_size);
         nbio_printf("%30s %12zu bytes\n", "jump table overhead",
                     jump_table_size);
+        nbio_printf("%30s %12zu bytes\n", "(direct jump index)",
+                    jump_nextidx_size);
         nbio_printf("%30s %12zu bytes\n", "type annotation overhead",
                     type_annotation_size);
         nbio_printf("%30s %12zu bytes\n", "local type cell idx overhead",
                     localtype_cellidx_size);
         nbio_printf("%30s %12zu bytes\n", "result type cell idx overhead",
                     resulttype_cellidx_size);
+        nbio_printf("%30s %12zu bytes\n", "pre-decoded code",
+                    predecoded_code_size);
+        nbio_printf("%30s %12zu bytes\n", "jit code", jit_code_size);
 }
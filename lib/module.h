@@ -1,9 +1,11 @@
 #include <stdint.h>
 
 #include "platform.h"
+#include "toywasm_config.h"
 
 struct load_context;
 struct module;
+struct module_stream;
 struct name;
 struct mem_context;
 
@@ -11,6 +13,10 @@ __BEGIN_EXTERN_C
 
 int module_create(struct module **mp, const uint8_t *p, const uint8_t *ep,
                   struct load_context *ctx);
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+int module_create_from_stream(struct module **mp, struct module_stream *st,
+                              struct load_context *ctx);
+#endif
 void module_destroy(struct mem_context *mctx, struct module *m);
 int module_find_export(const struct module *m, const struct name *name,
                        uint32_t type, uint32_t *idxp);
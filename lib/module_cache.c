@@ -0,0 +1,530 @@
+/*
+ * an on-disk cache of the side tables of validated function bodies
+ *
+ * the most expensive part of module loading is the validation of
+ * function bodies, which also builds their side tables for the execution.
+ * (expr_exec_info, ie. the jump table and the type annotations)
+ * they only depend on the module binary, the build configuration
+ * and a few load options.
+ *
+ * when load_options::module_cache_dir is set, module_create looks up
+ * a cache file for the module in the directory. the file is named after
+ * the hash of the module binary. on a hit, read_func takes the side
+ * tables from the cache instead of validating the body.
+ * on a miss, module_create saves the side tables after a successful load.
+ *
+ * the file is only used if its header matches:
+ *
+ *   - magic and format version
+ *   - the hash of the toywasm version, the build configuration
+ *     (toywasm_config_string) and the relevant load options
+ *   - the size and the hash of the module binary
+ *   - the copy of the module binary in the file (compared with memcmp)
+ *   - the hash of the payload
+ *
+ * otherwise, it's ignored and overwritten by the next save.
+ * the payload is also checked to be well-formed and to only refer to
+ * offsets within the module before it's used.
+ *
+ * the module binary is compared byte-by-byte because a hit skips
+ * the validation of the function bodies. a hash collision, either
+ * accidental or crafted by the author of the module, must not make us
+ * execute an unvalidated body.
+ *
+ * the file layout is:
+ *
+ *   header, the module binary, zero padding to 4 bytes, the payload
+ *
+ * the payload is a sequence of uint32_t in the host byte order.
+ * for each function in the code section:
+ *
+ *   maxlabels maxcells njumps (pc targetpc nextidx){njumps}
+ *   default_size ntypes (pc size){ntypes}   (TOYWASM_USE_SMALL_CELLS)
+ *
+ * the other validation-derived data (local and result cellidx, sorted
+ * exports) are cheap to build from the module. they are not cached.
+ *
+ * Note: the function bodies are not validated on a hit. while a module
+ * can't fake a hit, the cache files themselves are trusted. the cache
+ * directory should be writable only by the users of the cache.
+ *
+ * Note: a module loaded with load_options::lazy_validation doesn't
+ * produce a cache file because its bodies are not validated yet.
+ */
+
+#define _DARWIN_C_SOURCE /* mkstemp */
+#define _XOPEN_SOURCE 500 /* mkstemp */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fileio.h"
+#include "load_context.h"
+#include "mem.h"
+#include "module_cache.h"
+#include "toywasm_version.h"
+#include "type.h"
+#include "xlog.h"
+
+#define MODULE_CACHE_MAGIC 0x434d5754 /* "TWMC" in little endian */
+#define MODULE_CACHE_VERSION 2
+
+struct module_cache_header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t config_hash;
+        uint64_t module_size;
+        uint64_t module_hash;
+        uint32_t nfuncs;
+        uint32_t reserved;
+        uint64_t payload_size; /* in bytes */
+        uint64_t payload_hash;
+};
+
+struct module_cache {
+        uint64_t config_hash;
+        uint64_t module_size;
+        uint64_t module_hash;
+        const uint8_t *module;
+        char *path;
+        size_t pathsize;
+
+        /* the mapped cache file, or NULL on a miss */
+        void *map;
+        size_t mapsize;
+        uint32_t nfuncs;
+        const uint32_t *cur;
+        const uint32_t *end;
+};
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(uint64_t h, const void *vp, size_t sz)
+{
+        const uint8_t *p = vp;
+        size_t i;
+        for (i = 0; i < sz; i++) {
+                h ^= p[i];
+                h *= UINT64_C(0x100000001b3);
+        }
+        return h;
+}
+
+#define HASH_INIT UINT64_C(0xcbf29ce484222325)
+
+static uint64_t
+config_hash(const struct load_options *opts)
+{
+        extern const char *toywasm_config_string;
+        uint64_t h = HASH_INIT;
+#if defined(TOYWASM_VERSION)
+        h = hash_bytes(h, TOYWASM_VERSION, strlen(TOYWASM_VERSION));
+#endif
+        h = hash_bytes(h, toywasm_config_string,
+                       strlen(toywasm_config_string));
+        uint8_t jump_table = opts->generate_jump_table;
+        h = hash_bytes(h, &jump_table, sizeof(jump_table));
+        return h;
+}
+
+static size_t
+module_copy_size(uint64_t module_size)
+{
+        return (module_size + sizeof(uint32_t) - 1) &
+               ~(uint64_t)(sizeof(uint32_t) - 1);
+}
+
+/*
+ * check the structure of the payload.
+ */
+static int
+check_payload(const struct module_cache *c)
+{
+        const uint32_t *p = c->cur;
+        const uint32_t *ep = c->end;
+        uint32_t i;
+        uint32_t j;
+
+        for (i = 0; i < c->nfuncs; i++) {
+                if (ep - p < 3) {
+                        return EINVAL;
+                }
+                uint32_t njumps = p[2];
+                p += 3;
+                if ((size_t)(ep - p) / 3 < njumps) {
+                        return EINVAL;
+                }
+                for (j = 0; j < njumps; j++, p += 3) {
+                        if (p[0] >= c->module_size ||
+                            p[1] >= c->module_size) {
+                                return EINVAL;
+                        }
+                }
+#if defined(TOYWASM_USE_SMALL_CELLS)
+                if (ep - p < 2) {
+                        return EINVAL;
+                }
+                uint32_t ntypes = p[1];
+                p += 2;
+                if ((size_t)(ep - p) / 2 < ntypes) {
+                        return EINVAL;
+                }
+                for (j = 0; j < ntypes; j++, p += 2) {
+                        if (p[0] >= c->module_size) {
+                                return EINVAL;
+                        }
+                }
+#endif
+        }
+        if (p != ep) {
+                return EINVAL;
+        }
+        return 0;
+}
+
+static int
+map_cache(struct module_cache *c)
+{
+        const struct module_cache_header *h;
+        void *vp;
+        size_t sz;
+        int ret;
+
+        ret = map_file(c->path, &vp, &sz);
+        if (ret != 0) {
+                return ret;
+        }
+        if (sz < sizeof(*h)) {
+                ret = EINVAL;
+                goto fail;
+        }
+        h = vp;
+        if (h->magic != MODULE_CACHE_MAGIC ||
+            h->version != MODULE_CACHE_VERSION) {
+                xlog_trace("module cache: unknown format");
+                ret = EINVAL;
+                goto fail;
+        }
+        if (h->config_hash != c->config_hash) {
+                xlog_trace("module cache: config mismatch");
+                ret = EINVAL;
+                goto fail;
+        }
+        if (h->module_size != c->module_size ||
+            h->module_hash != c->module_hash) {
+                xlog_trace("module cache: module mismatch");
+                ret = EINVAL;
+                goto fail;
+        }
+        const size_t copysize = module_copy_size(c->module_size);
+        if (sz - sizeof(*h) < copysize ||
+            h->payload_size != sz - sizeof(*h) - copysize ||
+            h->payload_size % sizeof(uint32_t) != 0) {
+                xlog_trace("module cache: truncated");
+                ret = EINVAL;
+                goto fail;
+        }
+        const uint8_t *copy = (const uint8_t *)(h + 1);
+        if (memcmp(copy, c->module, c->module_size) != 0) {
+                xlog_trace("module cache: module mismatch");
+                ret = EINVAL;
+                goto fail;
+        }
+        const uint8_t *payload = copy + copysize;
+        if (hash_bytes(HASH_INIT, payload, h->payload_size) !=
+            h->payload_hash) {
+                xlog_trace("module cache: checksum mismatch");
+                ret = EINVAL;
+                goto fail;
+        }
+        c->nfuncs = h->nfuncs;
+        c->cur = (const uint32_t *)payload;
+        c->end = (const uint32_t *)(payload + h->payload_size);
+        ret = check_payload(c);
+        if (ret != 0) {
+                xlog_trace("module cache: broken payload");
+                goto fail;
+        }
+        c->map = vp;
+        c->mapsize = sz;
+        return 0;
+fail:
+        unmap_file(vp, sz);
+        return ret;
+}
+
+/*
+ * look up the cache file for the module binary [p, ep).
+ *
+ * on success, ctx->cache is set regardless of a hit or a miss.
+ * it should be released with module_cache_close.
+ */
+int
+module_cache_open(struct load_context *ctx, const uint8_t *p,
+                  const uint8_t *ep)
+{
+        struct mem_context *mctx = load_mctx(ctx);
+        const char *dir = ctx->options.module_cache_dir;
+        struct module_cache *c;
+        int ret;
+
+        assert(dir != NULL);
+        assert(ctx->cache == NULL);
+        c = mem_zalloc(mctx, sizeof(*c));
+        if (c == NULL) {
+                return ENOMEM;
+        }
+        c->config_hash = config_hash(&ctx->options);
+        c->module_size = ep - p;
+        c->module_hash = hash_bytes(HASH_INIT, p, ep - p);
+        c->module = p;
+        /* DIR/HASH.twcache and a suffix for a temporary file (mkstemp) */
+        c->pathsize = strlen(dir) + 1 + 16 + 8 + 1 + 20 + 1;
+        c->path = mem_alloc(mctx, c->pathsize);
+        if (c->path == NULL) {
+                mem_free(mctx, c, sizeof(*c));
+                return ENOMEM;
+        }
+        snprintf(c->path, c->pathsize, "%s/%016" PRIx64 ".twcache", dir,
+                 c->module_hash);
+        ctx->cache = c;
+        ret = map_cache(c);
+        if (ret != 0) {
+                xlog_trace("module cache: miss %s (%d)", c->path, ret);
+                return 0;
+        }
+        xlog_trace("module cache: hit %s", c->path);
+        return 0;
+}
+
+void
+module_cache_close(struct load_context *ctx)
+{
+        struct mem_context *mctx = load_mctx(ctx);
+        struct module_cache *c = ctx->cache;
+
+        if (c == NULL) {
+                return;
+        }
+        if (c->map != NULL) {
+                unmap_file(c->map, c->mapsize);
+        }
+        mem_free(mctx, c->path, c->pathsize);
+        mem_free(mctx, c, sizeof(*c));
+        ctx->cache = NULL;
+}
+
+/*
+ * returns true if the function bodies can be taken from the cache.
+ */
+bool
+module_cache_hit(const struct module_cache *c, uint32_t nfuncs)
+{
+        return c->map != NULL && c->nfuncs == nfuncs;
+}
+
+/*
+ * fill the expr_exec_info of the next function in the code section.
+ */
+int
+module_cache_read_func(struct mem_context *mctx, struct module_cache *c,
+                       struct expr_exec_info *ei)
+{
+        const uint32_t *p = c->cur;
+
+        /* check_payload has checked the bounds */
+        memset(ei, 0, sizeof(*ei));
+        ei->maxlabels = p[0];
+        ei->maxcells = p[1];
+        ei->njumps = p[2];
+        p += 3;
+        if (ei->njumps > 0) {
+                ei->jumps = mem_alloc(mctx, ei->njumps * sizeof(*ei->jumps));
+                if (ei->jumps == NULL) {
+                        ei->njumps = 0;
+                        return ENOMEM;
+                }
+                uint32_t i;
+                for (i = 0; i < ei->njumps; i++, p += 3) {
+                        ei->jumps[i].pc = p[0];
+                        ei->jumps[i].targetpc = p[1];
+                        ei->jumps[i].nextidx = p[2];
+                }
+        }
+#if defined(TOYWASM_USE_SMALL_CELLS)
+        struct type_annotations *an = &ei->type_annotations;
+        an->default_size = p[0];
+        an->ntypes = p[1];
+        p += 2;
+        if (an->ntypes > 0) {
+                an->types = mem_alloc(mctx, an->ntypes * sizeof(*an->types));
+                if (an->types == NULL) {
+                        an->ntypes = 0;
+                        return ENOMEM;
+                }
+                uint32_t i;
+                for (i = 0; i < an->ntypes; i++, p += 2) {
+                        an->types[i].pc = p[0];
+                        an->types[i].size = p[1];
+                }
+        }
+#endif
+        assert(p <= c->end);
+        c->cur = p;
+        return 0;
+}
+
+static int
+write_u32(FILE *fp, uint64_t *hp, uint32_t v)
+{
+        *hp = hash_bytes(*hp, &v, sizeof(v));
+        if (fwrite(&v, sizeof(v), 1, fp) != 1) {
+                return EIO;
+        }
+        return 0;
+}
+
+static int
+write_payload(FILE *fp, const struct module *m, uint64_t *hp)
+{
+        uint32_t i;
+        uint32_t j;
+        int ret = 0;
+
+        for (i = 0; i < m->nfuncs; i++) {
+                const struct expr_exec_info *ei = &m->funcs[i].e.ei;
+                ret |= write_u32(fp, hp, ei->maxlabels);
+                ret |= write_u32(fp, hp, ei->maxcells);
+                ret |= write_u32(fp, hp, ei->njumps);
+                for (j = 0; j < ei->njumps; j++) {
+                        const struct jump *jump = &ei->jumps[j];
+                        ret |= write_u32(fp, hp, jump->pc);
+                        ret |= write_u32(fp, hp, jump->targetpc);
+                        ret |= write_u32(fp, hp, jump->nextidx);
+                }
+#if defined(TOYWASM_USE_SMALL_CELLS)
+                const struct type_annotations *an = &ei->type_annotations;
+                ret |= write_u32(fp, hp, an->default_size);
+                ret |= write_u32(fp, hp, an->ntypes);
+                for (j = 0; j < an->ntypes; j++) {
+                        ret |= write_u32(fp, hp, an->types[j].pc);
+                        ret |= write_u32(fp, hp, an->types[j].size);
+                }
+#endif
+                if (ret != 0) {
+                        return EIO;
+                }
+        }
+        return 0;
+}
+
+/*
+ * write the cache file for the successfully loaded module.
+ *
+ * the file is written to a temporary name and then renamed so that
+ * a concurrent module_cache_open never sees a partially written file.
+ */
+int
+module_cache_save(struct load_context *ctx, const struct module *m)
+{
+        struct mem_context *mctx = load_mctx(ctx);
+        struct module_cache *c = ctx->cache;
+        struct module_cache_header h;
+        char *tmppath;
+        FILE *fp;
+        int ret;
+
+        assert(c != NULL);
+        if (c->map != NULL) {
+                /* a hit. nothing to do */
+                return 0;
+        }
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        if (m->lazy != NULL) {
+                return 0;
+        }
+#endif
+        tmppath = mem_alloc(mctx, c->pathsize);
+        if (tmppath == NULL) {
+                return ENOMEM;
+        }
+        /*
+         * a unique name because other threads and processes can be
+         * saving the same module concurrently.
+         */
+        snprintf(tmppath, c->pathsize, "%s.XXXXXX", c->path);
+        int fd = mkstemp(tmppath);
+        if (fd == -1) {
+                ret = errno;
+                xlog_trace("module cache: failed to create %s (%d)", tmppath,
+                           ret);
+                goto fail;
+        }
+        fp = fdopen(fd, "wb");
+        if (fp == NULL) {
+                ret = errno;
+                close(fd);
+                goto fail_remove;
+        }
+        memset(&h, 0, sizeof(h));
+        h.magic = MODULE_CACHE_MAGIC;
+        h.version = MODULE_CACHE_VERSION;
+        h.config_hash = c->config_hash;
+        h.module_size = c->module_size;
+        h.module_hash = c->module_hash;
+        h.nfuncs = m->nfuncs;
+        h.payload_hash = HASH_INIT;
+        /* write the payload first to know its size and hash */
+        if (fseek(fp, sizeof(h), SEEK_SET) != 0) {
+                ret = errno;
+                goto fail_close;
+        }
+        const size_t copysize = module_copy_size(c->module_size);
+        const uint8_t zero[sizeof(uint32_t)] = {0};
+        if (fwrite(c->module, 1, c->module_size, fp) != c->module_size ||
+            fwrite(zero, 1, copysize - c->module_size, fp) !=
+                    copysize - c->module_size) {
+                ret = EIO;
+                goto fail_close;
+        }
+        ret = write_payload(fp, m, &h.payload_hash);
+        if (ret != 0) {
+                goto fail_close;
+        }
+        long off = ftell(fp);
+        if (off < 0) {
+                ret = errno;
+                goto fail_close;
+        }
+        h.payload_size = (uint64_t)off - sizeof(h) - copysize;
+        if (fseek(fp, 0, SEEK_SET) != 0 ||
+            fwrite(&h, sizeof(h), 1, fp) != 1) {
+                ret = EIO;
+                goto fail_close;
+        }
+        if (fclose(fp) != 0) {
+                ret = errno;
+                goto fail_remove;
+        }
+        if (rename(tmppath, c->path) != 0) {
+                ret = errno;
+                xlog_trace("module cache: failed to rename %s (%d)", tmppath,
+                           ret);
+                goto fail_remove;
+        }
+        xlog_trace("module cache: saved %s", c->path);
+        mem_free(mctx, tmppath, c->pathsize);
+        return 0;
+fail_close:
+        fclose(fp);
+fail_remove:
+        remove(tmppath);
+fail:
+        mem_free(mctx, tmppath, c->pathsize);
+        return ret;
+}
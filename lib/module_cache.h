@@ -0,0 +1,30 @@
+#if !defined(_TOYWASM_MODULE_CACHE_H)
+#define _TOYWASM_MODULE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct expr_exec_info;
+struct load_context;
+struct mem_context;
+struct module;
+struct module_cache;
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+int module_cache_open(struct load_context *ctx, const uint8_t *p,
+                      const uint8_t *ep);
+void module_cache_close(struct load_context *ctx);
+bool module_cache_hit(const struct module_cache *c, uint32_t nfuncs);
+int module_cache_read_func(struct mem_context *mctx, struct module_cache *c,
+                           struct expr_exec_info *ei);
+int module_cache_save(struct load_context *ctx, const struct module *m);
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_MODULE_CACHE_H) */
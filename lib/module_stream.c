@@ -0,0 +1,251 @@
+/*
+ * loading a module from a stream
+ *
+ * module_create_from_stream loads a module while its binary is still
+ * being received via a read callback. (eg. from a pipe or a socket)
+ * each section is parsed as soon as it has been received. the code
+ * section is processed function by function. this way, the parsing and
+ * the validation overlap with the transfer.
+ *
+ * because struct module keeps pointers into the binary (eg. expr::start)
+ * and uses offsets from module::bin as "pc", the binary should be
+ * contiguous and never move. the buffer is allocated as:
+ *
+ *   - with a size hint: a buffer of the hinted size.
+ *     the stream is an error if it's longer than the hint.
+ *
+ *   - otherwise, where mmap is available: a reserved address space
+ *     of MODULE_STREAM_MAX_SIZE. pages are only allocated as the binary
+ *     is received. on the end of the stream, the unused part is released
+ *     and the rest is made read-only.
+ *
+ *   - otherwise: the whole stream is read into a growing buffer
+ *     before parsing. (no overlap)
+ *
+ * Note: the module keeps referring to the buffer, including the data
+ * segments and the custom sections. the peak memory is still the size
+ * of the binary. data segments are not copied to linear memory on load
+ * because it's done by instantiation, which is separate from loading.
+ */
+
+#define _DEFAULT_SOURCE  /* MAP_ANON, MAP_NORESERVE */
+#define _DARWIN_C_SOURCE /* MAP_ANON, MAP_NORESERVE */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "module_stream.h"
+#include "xlog.h"
+
+#if defined(__wasi__) || defined(__NuttX__) || defined(_WIN32)
+#define MODULE_STREAM_NO_MMAP
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define MODULE_STREAM_MAX_SIZE                                                \
+        ((sizeof(size_t) >= 8) ? ((size_t)1 << 32) : ((size_t)1 << 28))
+
+#define MODULE_STREAM_INITIAL_SIZE (64 * 1024)
+
+#if !defined(MODULE_STREAM_NO_MMAP)
+static size_t
+round_up_to_host_page(size_t sz)
+{
+        long pgsz = sysconf(_SC_PAGESIZE);
+        if (pgsz <= 0) {
+                pgsz = 4096;
+        }
+        return (sz + pgsz - 1) / pgsz * pgsz;
+}
+#endif
+
+static void
+stream_set_eof(struct module_stream *st)
+{
+        assert(!st->eof);
+        st->eof = true;
+#if !defined(MODULE_STREAM_NO_MMAP)
+        if (st->mapped) {
+                size_t used = round_up_to_host_page(st->filled);
+                if (used < st->capacity) {
+                        munmap(st->buf + used, st->capacity - used);
+                }
+                if (used > 0) {
+                        mprotect(st->buf, used, PROT_READ);
+                }
+        }
+#endif
+        st->capacity = st->filled;
+}
+
+/*
+ * read the next chunk of the stream.
+ */
+static int
+stream_read(struct module_stream *st)
+{
+        size_t nread;
+        int ret;
+
+        assert(!st->eof);
+        if (st->filled == st->capacity) {
+                /* make sure that the stream ends here */
+                uint8_t dummy;
+                ret = st->read(st->read_arg, &dummy, 1, &nread);
+                if (ret != 0) {
+                        return ret;
+                }
+                if (nread != 0) {
+                        xlog_trace("module stream: too large");
+                        return EFBIG;
+                }
+                stream_set_eof(st);
+                return 0;
+        }
+        ret = st->read(st->read_arg, st->buf + st->filled,
+                       st->capacity - st->filled, &nread);
+        if (ret != 0) {
+                return ret;
+        }
+        assert(nread <= st->capacity - st->filled);
+        if (nread == 0) {
+                stream_set_eof(st);
+        } else {
+                st->filled += nread;
+        }
+        return 0;
+}
+
+/*
+ * read the whole stream into a growing buffer.
+ */
+static int
+stream_read_all(struct module_stream *st)
+{
+        int ret;
+
+        while (!st->eof) {
+                if (st->filled == st->capacity) {
+                        if (st->capacity >= MODULE_STREAM_MAX_SIZE / 2) {
+                                return EFBIG;
+                        }
+                        size_t newcap = st->capacity * 2;
+                        if (newcap == 0) {
+                                newcap = MODULE_STREAM_INITIAL_SIZE;
+                        }
+                        void *p = realloc(st->buf, newcap);
+                        if (p == NULL) {
+                                return ENOMEM;
+                        }
+                        st->buf = p;
+                        st->capacity = newcap;
+                }
+                ret = stream_read(st);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        return 0;
+}
+
+int
+module_stream_create(struct module_stream **stp, size_t size_hint,
+                     module_stream_read_fn read, void *arg)
+{
+        struct module_stream *st;
+        int ret;
+
+        st = calloc(1, sizeof(*st));
+        if (st == NULL) {
+                return ENOMEM;
+        }
+        st->read = read;
+        st->read_arg = arg;
+        if (size_hint > 0) {
+                st->buf = malloc(size_hint);
+                if (st->buf == NULL) {
+                        ret = ENOMEM;
+                        goto fail;
+                }
+                st->capacity = size_hint;
+                *stp = st;
+                return 0;
+        }
+#if !defined(MODULE_STREAM_NO_MMAP)
+        void *p = mmap(NULL, MODULE_STREAM_MAX_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+        if (p != MAP_FAILED) {
+                st->buf = p;
+                st->capacity = MODULE_STREAM_MAX_SIZE;
+                st->mapped = true;
+                *stp = st;
+                return 0;
+        }
+        xlog_trace("module stream: failed to reserve the address space");
+#endif
+        ret = stream_read_all(st);
+        if (ret != 0) {
+                goto fail;
+        }
+        *stp = st;
+        return 0;
+fail:
+        module_stream_destroy(st);
+        return ret;
+}
+
+void
+module_stream_destroy(struct module_stream *st)
+{
+#if !defined(MODULE_STREAM_NO_MMAP)
+        if (st->mapped) {
+                if (st->capacity > 0) {
+                        munmap(st->buf, st->capacity);
+                }
+                free(st);
+                return;
+        }
+#endif
+        free(st->buf);
+        free(st);
+}
+
+/*
+ * receive the binary up to "end", or until the end of the stream.
+ */
+int
+module_stream_want(struct module_stream *st, const uint8_t *end)
+{
+        int ret;
+
+        while (!st->eof && st->buf + st->filled < end) {
+                ret = stream_read(st);
+                if (ret != 0) {
+                        return ret;
+                }
+        }
+        return 0;
+}
+
+/*
+ * receive the binary up to "end".
+ * returns EINVAL if the stream ends before it.
+ */
+int
+module_stream_need(struct module_stream *st, const uint8_t *end)
+{
+        int ret = module_stream_want(st, end);
+        if (ret != 0) {
+                return ret;
+        }
+        if (st->buf + st->filled < end) {
+                xlog_trace("module stream: truncated");
+                return EINVAL;
+        }
+        return 0;
+}
@@ -0,0 +1,59 @@
+#if !defined(_TOYWASM_MODULE_STREAM_H)
+#define _TOYWASM_MODULE_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+
+/*
+ * read up to "size" bytes into "buf" and return the number of bytes
+ * read with "*nreadp". 0 means the end of the stream.
+ * returns an errno value on an error.
+ */
+typedef int (*module_stream_read_fn)(void *arg, void *buf, size_t size,
+                                     size_t *nreadp);
+
+/*
+ * the module binary being received by module_create_from_stream.
+ * see module_stream.c.
+ *
+ * the module keeps pointers into the buffer. the stream should be
+ * destroyed after the module.
+ */
+struct module_stream {
+        module_stream_read_fn read;
+        void *read_arg;
+
+        uint8_t *buf;
+        size_t capacity; /* the max size of the binary */
+        size_t filled;   /* the bytes received so far */
+        bool eof;
+        bool mapped; /* buf is a reserved address space */
+};
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_MODULE_STREAM)
+int module_stream_create(struct module_stream **stp, size_t size_hint,
+                         module_stream_read_fn read, void *arg);
+void module_stream_destroy(struct module_stream *st);
+
+int module_stream_want(struct module_stream *st, const uint8_t *end);
+int module_stream_need(struct module_stream *st, const uint8_t *end);
+
+/*
+ * the end of the binary if known. otherwise, the end of the buffer.
+ */
+static inline const uint8_t *
+module_stream_limit(const struct module_stream *st)
+{
+        return st->buf + (st->eof ? st->filled : st->capacity);
+}
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_MODULE_STREAM_H) */
@@ -50,6 +50,9 @@ write_to_file(struct writer *w, const void *p, size_t sz)
         if (UINT32_MAX - w->size < sz) {
                 w->error = EOVERFLOW;
         }
+        if (sz == 0) {
+                return;
+        }
         size_t result = fwrite(p, sz, 1, w->fp);
         if (result != 1) {
                 w->error = ferror(w->fp);
@@ -280,7 +283,11 @@ write_element(struct writer *w, const struct element *e)
         /* suppress warnings */
         type = 0;
 #endif
-        if (e->funcs != NULL) {
+        /*
+         * Note: funcs and init_exprs can both be NULL for an empty segment.
+         */
+        if (e->funcs != NULL ||
+            (e->init_exprs == NULL && e->type == TYPE_funcref)) {
                 switch (e->mode) {
                 case ELEM_MODE_ACTIVE: /* 0, 2 */
                         if (e->table != 0 || e->type != TYPE_funcref) {
@@ -298,7 +305,7 @@ write_element(struct writer *w, const struct element *e)
                         break;
                 }
         } else {
-                assert(e->init_exprs != NULL);
+                assert(e->init_exprs != NULL || e->init_size == 0);
                 /* 4, 5, 6, 7 */
                 switch (e->mode) {
                 case ELEM_MODE_ACTIVE: /* 4, 6 */
@@ -378,6 +385,7 @@ write_element(struct writer *w, const struct element *e)
                 for (i = 0; i < e->init_size; i++) {
                         write_expr(w, &e->init_exprs[i]);
                 }
+                break;
         default:
                 assert(0);
         }
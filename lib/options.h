@@ -9,6 +9,47 @@
 
 struct load_options {
         bool generate_jump_table;
+#if defined(TOYWASM_USE_PREDECODE)
+        /*
+         * translate function bodies into the pre-decoded form on load.
+         * see predecode.c.
+         */
+        bool generate_predecoded_code;
+#endif
+#if defined(TOYWASM_ENABLE_JIT)
+        /*
+         * compile function bodies into machine code on load.
+         * see jit.c.
+         */
+        bool generate_jit_code;
+#endif
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        /*
+         * defer the validation of function bodies and the generation
+         * of their jump tables and type annotations until their first
+         * calls. see lazy_validation.c.
+         *
+         * generate_predecoded_code and generate_jit_code are ignored
+         * when this is set.
+         */
+        bool lazy_validation;
+#endif
+#if defined(TOYWASM_ENABLE_PARALLEL_VALIDATION)
+        /*
+         * the number of threads to validate function bodies with.
+         * 0 and 1 mean to validate them in the calling thread.
+         * ignored when lazy_validation is set.
+         * see parallel_validation.c.
+         */
+        uint32_t validation_threads;
+#endif
+#if defined(TOYWASM_ENABLE_MODULE_CACHE)
+        /*
+         * the directory to cache the validated function bodies in,
+         * or NULL to disable the cache. see module_cache.c.
+         */
+        const char *module_cache_dir;
+#endif
 #if defined(TOYWASM_USE_RESULTTYPE_CELLIDX)
         bool generate_resulttype_cellidx;
 #endif
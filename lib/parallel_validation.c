@@ -0,0 +1,204 @@
+/*
+ * parallel validation of function bodies
+ *
+ * when load_options::validation_threads is larger than 1, read_code_section
+ * only reads the framing of function bodies as it does for
+ * load_options::lazy_validation. then parallel_validation validates
+ * the bodies and builds their expr_exec_info with the given number of
+ * threads, including the calling thread.
+ *
+ * the functions are distributed to the threads dynamically with
+ * an atomic counter because their sizes vary a lot.
+ *
+ * each thread has its own load_context, validation_context and
+ * mem_context. the mem_context of a thread is a child of the one for
+ * the module so that the limit of the latter is enforced. after joining
+ * the threads, the memory allocated by them for the module is handed
+ * over to the module's mem_context. (mem_context_merge)
+ *
+ * unlike lazy validation, an invalid function makes the load fail.
+ * the error for the function with the smallest index is reported
+ * so that the result doesn't depend on the scheduling.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#if __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
+#include <stdbool.h>
+#include <string.h>
+
+#include "lazy_validation.h"
+#include "mem.h"
+#include "report.h"
+#include "type.h"
+#include "xlog.h"
+
+struct parallel_validation_state {
+        const struct module *module;
+        atomic_uint next;        /* the next function to validate */
+        atomic_uint failed_idx;  /* UINT32_MAX if none */
+};
+
+struct validation_worker {
+        struct parallel_validation_state *state;
+        struct mem_context mctx;
+        struct load_context lctx;
+        pthread_t thread;
+        bool started;
+
+        /* the results */
+        int error;
+        uint32_t error_idx;
+        uint32_t nvalidated;
+};
+
+static void *
+validation_worker_main(void *vp)
+{
+        struct validation_worker *w = vp;
+        struct parallel_validation_state *st = w->state;
+        const struct module *m = st->module;
+        uint32_t nfuncs = m->nfuncs;
+
+        while (true) {
+                uint32_t idx = atomic_fetch_add(&st->next, 1);
+                if (idx >= nfuncs) {
+                        break;
+                }
+                /*
+                 * once a function failed, only the functions with
+                 * smaller indexes can change the result.
+                 */
+                if (idx > atomic_load(&st->failed_idx)) {
+                        break;
+                }
+                int ret = lazy_validation_validate_body(m, idx, &w->lctx);
+                if (ret != 0) {
+                        w->error = ret;
+                        w->error_idx = idx;
+                        uint32_t old = atomic_load(&st->failed_idx);
+                        while (idx < old &&
+                               !atomic_compare_exchange_weak(&st->failed_idx,
+                                                             &old, idx)) {
+                        }
+                        break;
+                }
+                w->nvalidated++;
+        }
+        return NULL;
+}
+
+static void
+validation_worker_init(struct validation_worker *w,
+                       struct parallel_validation_state *st,
+                       struct load_context *ctx)
+{
+        const struct load_context *lctx0 = &ctx->module->lazy->lctx;
+
+        memset(w, 0, sizeof(*w));
+        w->state = st;
+        mem_context_init(&w->mctx);
+        w->mctx.parent = load_mctx(ctx);
+        load_context_init(&w->lctx, &w->mctx);
+        w->lctx.module = ctx->module;
+        w->lctx.options = lctx0->options;
+        w->lctx.has_datacount = lctx0->has_datacount;
+        w->lctx.ndatas_in_datacount = lctx0->ndatas_in_datacount;
+        /* share C.refs, which is read-only for the validation */
+        w->lctx.refs = lctx0->refs;
+        w->lctx.refs_size = lctx0->refs_size;
+}
+
+static void
+validation_worker_clear(struct validation_worker *w)
+{
+        /* C.refs is owned by the lazy_validation */
+        w->lctx.refs.data = NULL;
+        w->lctx.refs_size = 0;
+        load_context_clear(&w->lctx);
+#if defined(TOYWASM_ENABLE_HEAP_TRACKING)
+        xlog_trace("validation worker: %" PRIu32 " funcs, %zu bytes",
+                   w->nvalidated, (size_t)w->mctx.allocated);
+#endif
+        mem_context_merge(&w->mctx);
+        mem_context_clear(&w->mctx);
+}
+
+int
+parallel_validation(struct load_context *ctx, uint32_t nthreads)
+{
+        struct mem_context *mctx = load_mctx(ctx);
+        struct module *m = ctx->module;
+        struct parallel_validation_state st;
+        struct validation_worker *workers;
+        uint32_t i;
+        int ret;
+
+        assert(m->lazy != NULL);
+        assert(nthreads > 1);
+        if (nthreads > m->nfuncs) {
+                nthreads = m->nfuncs;
+        }
+        if (nthreads == 0) {
+                return 0;
+        }
+        workers = mem_calloc(mctx, nthreads, sizeof(*workers));
+        if (workers == NULL) {
+                return ENOMEM;
+        }
+        st.module = m;
+        atomic_init(&st.next, 0);
+        atomic_init(&st.failed_idx, UINT32_MAX);
+        for (i = 0; i < nthreads; i++) {
+                validation_worker_init(&workers[i], &st, ctx);
+        }
+        /* workers[0] is the calling thread */
+        for (i = 1; i < nthreads; i++) {
+                struct validation_worker *w = &workers[i];
+                ret = pthread_create(&w->thread, NULL, validation_worker_main,
+                                     w);
+                if (ret != 0) {
+                        /* not fatal. go on with fewer threads. */
+                        xlog_trace("pthread_create failed with %d", ret);
+                        break;
+                }
+                w->started = true;
+        }
+        validation_worker_main(&workers[0]);
+        for (i = 1; i < nthreads; i++) {
+                struct validation_worker *w = &workers[i];
+                if (!w->started) {
+                        break;
+                }
+                ret = pthread_join(w->thread, NULL);
+                assert(ret == 0);
+        }
+        /*
+         * all threads are joined. collect the results.
+         */
+        uint32_t failed_idx = atomic_load(&st.failed_idx);
+        ret = 0;
+        for (i = 0; i < nthreads; i++) {
+                struct validation_worker *w = &workers[i];
+                if (w->error != 0 && w->error_idx == failed_idx) {
+                        ret = w->error;
+                        /* eg. ENOMEM doesn't have a message */
+                        if (w->lctx.report.msg != NULL) {
+                                report_error(&ctx->report, "%s",
+                                             w->lctx.report.msg);
+                        }
+                }
+                validation_worker_clear(w);
+        }
+        mem_free(mctx, workers, nthreads * sizeof(*workers));
+        if (ret != 0) {
+                xlog_trace("parallel validation failed on func %" PRIu32
+                           " with %d",
+                           m->nimportedfuncs + failed_idx, ret);
+        }
+        return ret;
+}
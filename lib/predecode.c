@@ -0,0 +1,445 @@
+/*
+ * pre-decoded code
+ *
+ * by default, toywasm executes the wasm binary in-place. it's
+ * memory-efficient, but it involves decoding of LEB128 immediates etc
+ * every time an instruction is executed.
+ *
+ * when load_options::generate_predecoded_code is set, module_load
+ * translates function bodies into a sequence of 32-bit words:
+ *
+ * - an opcode word, which is an index in the flat opcode space.
+ *   (PREDECODED_OP_xxx in insn.h)
+ *
+ * - decoded immediates. each of them occupies fixed number of words.
+ *   (eg. i64.const has two words.)
+ *
+ * a few instructions are translated differently:
+ *
+ * - blocktypes of block-starting instructions (block, loop, if) are
+ *   replaced with struct predecoded_block, which contains resolved
+ *   branch targets and arities. it allows the exec logic to branch
+ *   without jump table lookups.
+ *
+ * - value-polymorphic instructions (drop and select) have an extra
+ *   word for the cell size of the operand, which otherwise is looked up
+ *   from the type annotations.
+ *
+ * the translation is implemented with the "predecode" callbacks in
+ * insn.c, which reuse the instruction implementations with the
+ * immediate decoding functions replaced.
+ *
+ * the pre-decoded code and the original binary share the pc space.
+ * see module::predecoded_pcbase.
+ *
+ * when TOYWASM_USE_SUPERINSTRUCTIONS is enabled, a few common instruction
+ * sequences are fused into superinstructions. (insn_list_fused.h)
+ * it's safe to fuse straight-line instructions this way because
+ * a branch target is always next to a control instruction.
+ *
+ * the fusion also produces register-operand forms of binary instructions
+ * (insn_list_reg.h) for sequences like
+ * "local.get; local.get; i32.add; local.set". they read and write
+ * function locals directly, using the cell indexes resolved here,
+ * instead of moving the operands through the operand stack.
+ *
+ * we don't support the pre-decoded form of try_table, which requires
+ * the exception logic (find_catch) to parse the instruction.
+ * if a module has it, the whole module is executed in-place.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cell.h"
+#include "context.h"
+#include "exec.h"
+#include "insn.h"
+#include "leb128.h"
+#include "mem.h"
+#include "predecode.h"
+#include "type.h"
+#include "util.h"
+#include "xlog.h"
+
+void
+predecode_emit_u32(struct predecode_context *ctx, uint32_t v)
+{
+        if (ctx->code.lsize == ctx->code.psize) {
+                uint32_t n = ctx->code.psize;
+                if (n < 64) {
+                        n = 64;
+                }
+                int ret = VEC_PREALLOC(ctx->mctx, ctx->code, n);
+                if (ret != 0) {
+                        /* predecode_expr checks this after each insn */
+                        ctx->error = ret;
+                        return;
+                }
+        }
+        *VEC_PUSH(ctx->code) = v;
+}
+
+void
+predecode_emit_u64(struct predecode_context *ctx, uint64_t v)
+{
+        predecode_emit_bytes(ctx, (const void *)&v, sizeof(v));
+}
+
+void
+predecode_emit_bytes(struct predecode_context *ctx, const uint8_t *p,
+                     uint32_t len)
+{
+        assert(len % sizeof(uint32_t) == 0);
+        uint32_t i;
+        for (i = 0; i < len; i += sizeof(uint32_t)) {
+                uint32_t v;
+                memcpy(&v, p + i, sizeof(v));
+                predecode_emit_u32(ctx, v);
+        }
+}
+
+static uint32_t
+predecoded_pc(const struct module *m, uint32_t idx)
+{
+        return m->predecoded_pcbase + idx * sizeof(uint32_t);
+}
+
+static struct predecoded_block *
+predecoded_block(struct predecode_context *ctx, uint32_t descidx)
+{
+        assert(descidx + PREDECODED_BLOCK_NWORDS <= ctx->code.lsize);
+        return (void *)&VEC_ELEM(ctx->code, descidx);
+}
+
+#if defined(TOYWASM_USE_SMALL_CELLS)
+/*
+ * cf. find_type_annotation
+ */
+static uint32_t
+lookup_type_annotation(const struct expr_exec_info *ei, uint32_t pc)
+{
+        const struct type_annotations *an = &ei->type_annotations;
+        if (an->default_size == 0) {
+                /*
+                 * all drop/select in the function are unreachable.
+                 * (record_type_annotation doesn't record them.)
+                 * any size is fine as they are never executed.
+                 */
+                return 1;
+        }
+        uint32_t i;
+        for (i = 0; i < an->ntypes; i++) {
+                if (pc < an->types[i].pc) {
+                        break;
+                }
+        }
+        if (i == 0) {
+                return an->default_size;
+        }
+        return an->types[i - 1].size;
+}
+#endif
+
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+/* these should match insn_list_fused.h */
+#define FUSED_LOCAL_GET2 (PREDECODED_OP_FUSED + 0x00)
+#define FUSED_LOCAL_GET_I32_CONST (PREDECODED_OP_FUSED + 0x01)
+#define FUSED_I32_CONST_ADD (PREDECODED_OP_FUSED + 0x02)
+#define FUSED_LOCAL_GET_I64_CONST (PREDECODED_OP_FUSED + 0x03)
+
+/*
+ * "prev" followed by "op" is replaced with "fused".
+ * longer sequences are built incrementally from shorter ones.
+ *
+ * cellidx_mask: the immediates to convert from localidx to
+ * the cell index of the local. bit N is the Nth word after the
+ * opcode word of the fused instruction.
+ *
+ * negate_imm: "i32.const c; i32.sub" is handled as
+ * "i32.const -c; i32.add".
+ */
+static const struct fusion_rule {
+        uint16_t prev;
+        uint16_t op;
+        uint16_t fused;
+        uint8_t cellidx_mask;
+        bool negate_imm;
+} fusion_rules[] = {
+        {0x20, 0x20, FUSED_LOCAL_GET2, 0, false},
+        {0x20, 0x41, FUSED_LOCAL_GET_I32_CONST, 0, false},
+        {0x20, 0x42, FUSED_LOCAL_GET_I64_CONST, 0, false},
+        {0x41, 0x6a, FUSED_I32_CONST_ADD, 0, false},
+        {0x41, 0x6b, FUSED_I32_CONST_ADD, 0, true},
+#define REG_INSTRUCTION(idx, op, n, f, BITS)                                  \
+        {FUSED_LOCAL_GET2, op,                                                \
+         PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR), 0x3, false},         \
+        {FUSED_LOCAL_GET_I##BITS##_CONST, op,                                 \
+         PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI), 0x1, false},         \
+        {PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR), 0x21,                \
+         PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RR_R), 1 << 2, false},    \
+        {PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI), 0x21,                \
+         PREDECODED_REG_OP(idx, PREDECODED_REG_FORM_RI_R),                    \
+         1 << (1 + (BITS) / 32), false},
+#include "insn_list_reg.h"
+#undef REG_INSTRUCTION
+};
+
+/*
+ * cf. frame_locals_cellidx
+ */
+static uint32_t
+predecode_local_cellidx(const struct predecode_context *ctx,
+                        uint32_t localidx)
+{
+        const struct resulttype *pt = &ctx->ft->parameter;
+        uint32_t csz;
+        if (localidx < pt->ntypes) {
+                return resulttype_cellidx(pt, localidx, &csz);
+        }
+        return resulttype_cellsize(pt) +
+               localtype_cellidx(ctx->lt, localidx - pt->ntypes, &csz);
+}
+
+static void
+predecode_apply_fusion(struct predecode_context *ctx,
+                       const struct fusion_rule *r, uint32_t opidx)
+{
+        uint32_t *code = ctx->code.p;
+        uint32_t i;
+
+        assert(ctx->last_opidx < opidx);
+        assert(opidx < ctx->code.lsize);
+        /*
+         * drop the opcode word of the instruction so that
+         * its immediates follow the ones of the previous instruction.
+         */
+        memmove(&code[opidx], &code[opidx + 1],
+                (ctx->code.lsize - opidx - 1) * sizeof(*code));
+        ctx->code.lsize--;
+        if (r->negate_imm) {
+                /* the i32.const immediate is the last word */
+                assert(opidx > ctx->last_opidx + 1);
+                code[opidx - 1] = -code[opidx - 1];
+        }
+        for (i = 0; i < 8; i++) {
+                if ((r->cellidx_mask & (1 << i)) != 0) {
+                        uint32_t *wp = &code[ctx->last_opidx + 1 + i];
+                        assert(wp < &code[ctx->code.lsize]);
+                        *wp = predecode_local_cellidx(ctx, *wp);
+                }
+        }
+        code[ctx->last_opidx] = r->fused;
+        ctx->last_op = r->fused;
+}
+
+/*
+ * try to fuse the instruction just emitted at opidx with the previous one.
+ */
+static void
+predecode_fuse(struct predecode_context *ctx, uint32_t op, uint32_t opidx)
+{
+        size_t i;
+        if (ctx->last_op >= PREDECODED_OP_FUSED || ctx->last_op == 0x20 ||
+            ctx->last_op == 0x41) {
+                for (i = 0; i < ARRAYCOUNT(fusion_rules); i++) {
+                        const struct fusion_rule *r = &fusion_rules[i];
+                        if (r->prev == ctx->last_op && r->op == op) {
+                                predecode_apply_fusion(ctx, r, opidx);
+                                return;
+                        }
+                }
+        }
+        ctx->last_op = op;
+        ctx->last_opidx = opidx;
+}
+#endif /* defined(TOYWASM_USE_SUPERINSTRUCTIONS) */
+
+static int
+predecode_expr(struct predecode_context *ctx, const struct module *m,
+               const struct expr *expr, const uint8_t *ep)
+{
+        const uint8_t *p = expr->start;
+        int ret;
+
+        assert(ctx->blocks.lsize == 0);
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+        ctx->last_op = PREDECODED_NOPS; /* matches nothing */
+#endif
+        while (true) {
+                uint32_t op = *p++;
+                uint32_t idx = op;
+                switch (op) {
+                case 0xfc:
+                        idx = PREDECODED_OP_FC + read_leb_u32_nocheck(&p);
+                        break;
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+                case 0xfd:
+                        idx = PREDECODED_OP_FD + read_leb_u32_nocheck(&p);
+                        break;
+#endif
+#if defined(TOYWASM_ENABLE_WASM_THREADS)
+                case 0xfe:
+                        idx = PREDECODED_OP_FE + read_leb_u32_nocheck(&p);
+                        break;
+#endif
+                case FRAME_OP_TRY_TABLE:
+                        xlog_trace("%s: try_table is not supported", __func__);
+                        return ENOTSUP;
+                default:
+                        break;
+                }
+                assert(idx < PREDECODED_NOPS);
+                const struct predecode_instruction_desc *desc =
+                        &predecode_instructions[idx];
+                assert(desc->predecode != NULL);
+                /* the pc next to the opcode. cf. record_type_annotation */
+                const uint32_t srcpc __unused = ptr2pc(m, p);
+                predecode_emit_u32(ctx, idx);
+                const uint32_t descidx = ctx->code.lsize;
+                ret = desc->predecode(&p, ep, ctx);
+                assert(ret == 0);
+                if (ctx->error != 0) {
+                        return ctx->error;
+                }
+                struct predecode_block_info *bi;
+                struct predecoded_block *b;
+                switch (op) {
+                case FRAME_OP_BLOCK:
+                case FRAME_OP_LOOP:
+                case FRAME_OP_IF:
+                        ret = VEC_PREALLOC(ctx->mctx, ctx->blocks, 1);
+                        if (ret != 0) {
+                                return ret;
+                        }
+                        bi = VEC_PUSH(ctx->blocks);
+                        bi->op = op;
+                        bi->descidx = descidx;
+                        b = predecoded_block(ctx, descidx);
+                        get_arity_for_blocktype(m, ctx->blocktype,
+                                                &b->param_arity, &b->arity);
+                        if (op == FRAME_OP_LOOP) {
+                                b->targetpc = predecoded_pc(m, descidx - 1);
+                        }
+                        break;
+                case FRAME_OP_ELSE:
+                        assert(ctx->blocks.lsize > 0);
+                        bi = &VEC_LASTELEM(ctx->blocks);
+                        assert(bi->op == FRAME_OP_IF);
+                        b = predecoded_block(ctx, bi->descidx);
+                        b->elsepc = predecoded_pc(m, ctx->code.lsize);
+                        break;
+                case FRAME_OP_END:
+                        if (ctx->blocks.lsize == 0) {
+                                /* the end of the expr */
+                                return 0;
+                        }
+                        bi = VEC_POP(ctx->blocks);
+                        if (bi->op != FRAME_OP_LOOP) {
+                                b = predecoded_block(ctx, bi->descidx);
+                                b->targetpc =
+                                        predecoded_pc(m, ctx->code.lsize);
+                        }
+                        break;
+#if defined(TOYWASM_USE_SMALL_CELLS)
+                case 0x1a: /* drop */
+                case 0x1b: /* select */
+                        predecode_emit_u32(
+                                ctx,
+                                lookup_type_annotation(&expr->ei, srcpc));
+                        if (ctx->error != 0) {
+                                return ctx->error;
+                        }
+                        break;
+#endif
+                default:
+                        break;
+                }
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+                predecode_fuse(ctx, idx, descidx - 1);
+#endif
+        }
+}
+
+int
+predecode_module(struct module *m, const uint8_t *ep,
+                 struct mem_context *mctx)
+{
+        struct predecode_context ctx;
+        uint32_t *starts = NULL;
+        uint32_t i;
+        int ret;
+
+        assert(m->predecoded == NULL);
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.mctx = mctx;
+        if (m->nfuncs == 0) {
+                return 0;
+        }
+        ret = ARRAY_EXTEND(mctx, starts, 0, m->nfuncs);
+        if (ret != 0) {
+                goto fail;
+        }
+        assert(ep > m->bin);
+        m->predecoded_pcbase = ep - m->bin;
+        for (i = 0; i < m->nfuncs; i++) {
+                const struct func *func = &m->funcs[i];
+                starts[i] = ctx.code.lsize;
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+                ctx.ft = module_functype(m, m->nimportedfuncs + i);
+                ctx.lt = &func->localtype;
+#endif
+                ret = predecode_expr(&ctx, m, &func->e, ep);
+                if (ret != 0) {
+                        goto fail;
+                }
+                /* the pc space should not overflow */
+                if (ctx.code.lsize >
+                    (UINT32_MAX - m->predecoded_pcbase) / sizeof(uint32_t)) {
+                        ret = EOVERFLOW;
+                        goto fail;
+                }
+        }
+        /* trim the buffer as we never extend it */
+        ret = array_shrink(mctx, (void **)&ctx.code.p, sizeof(*ctx.code.p),
+                           ctx.code.psize, ctx.code.lsize);
+        if (ret != 0) {
+                goto fail;
+        }
+        ctx.code.psize = ctx.code.lsize;
+        m->predecoded = ctx.code.p;
+        m->npredecoded = ctx.code.lsize;
+        for (i = 0; i < m->nfuncs; i++) {
+                struct func *func = &m->funcs[i];
+                func->e.ei.predecoded = m->predecoded + starts[i];
+        }
+        xlog_trace("%s: %" PRIu32 " words of pre-decoded code", __func__,
+                   m->npredecoded);
+        VEC_INIT(ctx.code);
+        ret = 0;
+fail:
+        if (starts != NULL) {
+                mem_free(mctx, starts, m->nfuncs * sizeof(*starts));
+        }
+        VEC_FREE(mctx, ctx.code);
+        VEC_FREE(mctx, ctx.blocks);
+        if (ret != 0) {
+                m->predecoded_pcbase = 0;
+        }
+        return ret;
+}
+
+void
+predecoded_code_free(struct mem_context *mctx, struct module *m)
+{
+        if (m->predecoded == NULL) {
+                return;
+        }
+        mem_free(mctx, m->predecoded,
+                 m->npredecoded * sizeof(*m->predecoded));
+        m->predecoded = NULL;
+        m->npredecoded = 0;
+}
@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+#include "vec.h"
+
+struct functype;
+struct localtype;
+struct mem_context;
+struct module;
+
+/*
+ * the pre-decoded form of the blocktype immediate of
+ * block-starting instructions. (block, loop, if)
+ *
+ * targetpc: the pc to jump on "br" to the block.
+ *           for a loop, the pc of the loop instruction itself.
+ * elsepc:   the pc next to the corresponding "else", or 0 if none.
+ *           only used for "if".
+ * param_arity, arity: cell sizes of the block parameters and results.
+ */
+struct predecoded_block {
+        uint32_t targetpc;
+        uint32_t elsepc;
+        uint32_t param_arity;
+        uint32_t arity;
+};
+
+#define PREDECODED_BLOCK_NWORDS                                               \
+        (sizeof(struct predecoded_block) / sizeof(uint32_t))
+
+struct predecode_block_info {
+        uint32_t op;
+        uint32_t descidx; /* the word index of struct predecoded_block */
+};
+
+struct predecode_context {
+        struct mem_context *mctx;
+        VEC(, uint32_t) code;
+        VEC(, struct predecode_block_info) blocks;
+        int64_t blocktype; /* the last blocktype seen */
+#if defined(TOYWASM_USE_SUPERINSTRUCTIONS)
+        /* the function being translated */
+        const struct functype *ft;
+        const struct localtype *lt;
+        uint32_t last_op;    /* the last (maybe fused) opcode emitted */
+        uint32_t last_opidx; /* the word index of last_op */
+#endif
+        int error;
+};
+
+__BEGIN_EXTERN_C
+
+void predecode_emit_u32(struct predecode_context *ctx, uint32_t v);
+void predecode_emit_u64(struct predecode_context *ctx, uint64_t v);
+void predecode_emit_bytes(struct predecode_context *ctx, const uint8_t *p,
+                          uint32_t len);
+
+int predecode_module(struct module *m, const uint8_t *ep,
+                     struct mem_context *mctx);
+void predecoded_code_free(struct mem_context *mctx, struct module *m);
+
+__END_EXTERN_C
@@ -0,0 +1,352 @@
+/*
+ * a sampling profiler for wasm code
+ *
+ * with TOYWASM_ENABLE_PROFILER, profiler_start arms ITIMER_PROF.
+ * on each SIGPROF, the signal handler walks the frames (exec_context::frames)
+ * of the exec_context running on the interrupted thread (profiler_current)
+ * and appends the (module, funcidx) of each frame to a preallocated
+ * sample buffer.
+ *
+ * profiler_write resolves the function names with the name section
+ * (lib/name.c) and writes the samples in the "folded" format, which
+ * flamegraph.pl consumes. ie. a line per distinct stack, from the outermost
+ * frame to the innermost, separated by semicolons, followed by the number
+ * of the samples:
+ *
+ *   module:main;module:foo;module:bar 123
+ *
+ * samples taken outside of wasm code (eg. module loading) are
+ * attributed to "[toywasm]". host functions are attributed to their
+ * wasm callers.
+ *
+ * the overhead when the profiler is not running is a few stores on
+ * exec_expr_continue and frame_enter.
+ *
+ * Note: the signal handler only reads the frames. frame_enter sets
+ * exec_context::frames_busy while it might be reallocating them.
+ * a sample which hits it is dropped. frame_enter fills a new frame before
+ * incrementing frames.lsize. the ordering against the handler on the
+ * same thread is kept with atomic_signal_fence.
+ *
+ * Note: the modules referenced by the samples should be kept loaded
+ * until profiler_write.
+ *
+ * Note: SIGPROF can interrupt system calls made by host functions.
+ * the handler is installed with SA_RESTART, which doesn't cover all
+ * system calls. (eg. nanosleep and poll) the blocking paths used by
+ * the host functions (timespec_sleep, wasi_poll) retry on EINTR.
+ */
+
+#define _DEFAULT_SOURCE /* SA_RESTART */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "exec_context.h"
+#include "instance.h"
+#include "name.h"
+#include "profiler.h"
+#include "type.h"
+#include "xlog.h"
+
+/*
+ * the sample buffer is an array of entries.
+ * a sample is a header entry followed by nframes entries for the frames,
+ * from the outermost to the innermost.
+ */
+struct profiler_entry {
+        const struct module *module;
+        uint32_t funcidx; /* nframes for a header */
+};
+
+/*
+ * the header of a sample is written last. a zero header terminates
+ * the buffer. (eg. a sample being written by another thread)
+ */
+#define PROFILER_HEADER_VALID 0x80000000
+#define PROFILER_HEADER_TRUNCATED 0x40000000
+#define PROFILER_HEADER_NFRAMES_MASK 0x0000ffff
+
+/* deeper stacks are truncated, keeping the innermost frames */
+#define PROFILER_MAX_FRAMES 256
+
+#define PROFILER_BUFFER_ENTRIES (1024 * 1024)
+
+_Thread_local struct exec_context *profiler_current;
+
+static struct profiler_entry *g_profiler_buf;
+static size_t g_profiler_bufsize;
+static atomic_size_t g_profiler_used;
+static atomic_uint g_profiler_nsamples;
+static atomic_uint g_profiler_ndropped;
+static bool g_profiler_running;
+static struct sigaction g_profiler_oact;
+
+static void
+profiler_handler(int signo)
+{
+        const struct exec_context *ctx = profiler_current;
+        uint32_t nframes = 0;
+        uint32_t flags = 0;
+        int saved_errno = errno;
+
+        (void)signo;
+        if (ctx != NULL) {
+                if (ctx->frames_busy) {
+                        atomic_fetch_add(&g_profiler_ndropped, 1);
+                        goto done;
+                }
+                nframes = ctx->frames.lsize;
+                if (nframes > PROFILER_MAX_FRAMES) {
+                        nframes = PROFILER_MAX_FRAMES;
+                        flags |= PROFILER_HEADER_TRUNCATED;
+                }
+                /* pairs with the release fences in frame_enter */
+                atomic_signal_fence(memory_order_acquire);
+        }
+        size_t off = atomic_fetch_add(&g_profiler_used, 1 + nframes);
+        if (off >= g_profiler_bufsize ||
+            g_profiler_bufsize - off < 1 + nframes) {
+                atomic_fetch_add(&g_profiler_ndropped, 1);
+                goto done;
+        }
+        struct profiler_entry *sample = &g_profiler_buf[off];
+        uint32_t i;
+        for (i = 0; i < nframes; i++) {
+                const struct funcframe *fp =
+                        &ctx->frames.p[ctx->frames.lsize - nframes + i];
+                sample[1 + i].module = fp->instance->module;
+                sample[1 + i].funcidx = fp->funcidx;
+        }
+        sample[0].module = NULL;
+        atomic_signal_fence(memory_order_release);
+        sample[0].funcidx = PROFILER_HEADER_VALID | flags | nframes;
+        atomic_fetch_add(&g_profiler_nsamples, 1);
+done:
+        errno = saved_errno;
+}
+
+/*
+ * start sampling at the given frequency.
+ *
+ * the samples are accumulated until profiler_clear.
+ */
+int
+profiler_start(unsigned int hz)
+{
+        struct sigaction act;
+        struct itimerval it;
+        int ret;
+
+        if (g_profiler_running || hz == 0 || hz > 1000000) {
+                return EINVAL;
+        }
+        if (g_profiler_buf == NULL) {
+                g_profiler_buf = calloc(PROFILER_BUFFER_ENTRIES,
+                                        sizeof(*g_profiler_buf));
+                if (g_profiler_buf == NULL) {
+                        return ENOMEM;
+                }
+                g_profiler_bufsize = PROFILER_BUFFER_ENTRIES;
+        }
+        memset(&act, 0, sizeof(act));
+        act.sa_handler = profiler_handler;
+        act.sa_flags = SA_RESTART;
+        sigemptyset(&act.sa_mask);
+        if (sigaction(SIGPROF, &act, &g_profiler_oact) != 0) {
+                ret = errno;
+                xlog_error("failed to install the signal handler: %d", ret);
+                return ret;
+        }
+        memset(&it, 0, sizeof(it));
+        /* setitimer rejects tv_usec >= 1000000, eg. for hz == 1 */
+        unsigned int usec = 1000000 / hz;
+        it.it_interval.tv_sec = usec / 1000000;
+        it.it_interval.tv_usec = usec % 1000000;
+        it.it_value = it.it_interval;
+        if (setitimer(ITIMER_PROF, &it, NULL) != 0) {
+                ret = errno;
+                xlog_error("setitimer failed: %d", ret);
+                sigaction(SIGPROF, &g_profiler_oact, NULL);
+                return ret;
+        }
+        g_profiler_running = true;
+        return 0;
+}
+
+void
+profiler_stop(void)
+{
+        struct itimerval it;
+
+        if (!g_profiler_running) {
+                return;
+        }
+        memset(&it, 0, sizeof(it));
+        setitimer(ITIMER_PROF, &it, NULL);
+        sigaction(SIGPROF, &g_profiler_oact, NULL);
+        g_profiler_running = false;
+}
+
+static const struct profiler_entry *
+next_sample(size_t *offp)
+{
+        size_t used = atomic_load(&g_profiler_used);
+        size_t off = *offp;
+        if (used > g_profiler_bufsize) {
+                used = g_profiler_bufsize;
+        }
+        if (off >= used) {
+                return NULL;
+        }
+        const struct profiler_entry *sample = &g_profiler_buf[off];
+        if ((sample->funcidx & PROFILER_HEADER_VALID) == 0) {
+                return NULL;
+        }
+        *offp = off + 1 + (sample->funcidx & PROFILER_HEADER_NFRAMES_MASK);
+        return sample;
+}
+
+static int
+cmp_sample(const void *a, const void *b)
+{
+        const struct profiler_entry *sa = *(const struct profiler_entry **)a;
+        const struct profiler_entry *sb = *(const struct profiler_entry **)b;
+        uint32_t n = sa->funcidx & PROFILER_HEADER_NFRAMES_MASK;
+        uint32_t i;
+        if (sa->funcidx != sb->funcidx) {
+                return (sa->funcidx < sb->funcidx) ? -1 : 1;
+        }
+        for (i = 1; i <= n; i++) {
+                if (sa[i].module != sb[i].module) {
+                        return ((uintptr_t)sa[i].module <
+                                (uintptr_t)sb[i].module)
+                                       ? -1
+                                       : 1;
+                }
+                if (sa[i].funcidx != sb[i].funcidx) {
+                        return (sa[i].funcidx < sb[i].funcidx) ? -1 : 1;
+                }
+        }
+        return 0;
+}
+
+static void
+write_name(FILE *fp, const struct name *name)
+{
+        /* ';' is the separator of the folded format */
+        uint32_t i;
+        for (i = 0; i < name->nbytes; i++) {
+                char ch = name->data[i];
+                fputc((ch == ';') ? '_' : ch, fp);
+        }
+}
+
+static void
+write_stack(FILE *fp, struct nametable *table,
+            const struct profiler_entry *sample)
+{
+        uint32_t nframes = sample->funcidx & PROFILER_HEADER_NFRAMES_MASK;
+        uint32_t i;
+        if (nframes == 0) {
+                fputs("[toywasm]", fp);
+                return;
+        }
+        if ((sample->funcidx & PROFILER_HEADER_TRUNCATED) != 0) {
+                fputs("[truncated];", fp);
+        }
+        for (i = 1; i <= nframes; i++) {
+                const struct module *m = sample[i].module;
+                struct name module_name;
+                struct name func_name;
+                nametable_lookup_module(table, m, &module_name);
+                nametable_lookup_func(table, m, sample[i].funcidx, &func_name);
+                if (i > 1) {
+                        fputc(';', fp);
+                }
+                write_name(fp, &module_name);
+                fputc(':', fp);
+                write_name(fp, &func_name);
+                fprintf(fp, "[%" PRIu32 "]", sample[i].funcidx);
+        }
+}
+
+/*
+ * write the samples in the folded format.
+ */
+int
+profiler_write(FILE *fp)
+{
+        const struct profiler_entry **samples = NULL;
+        const struct profiler_entry *sample;
+        struct nametable table;
+        size_t nsamples = 0;
+        size_t off;
+        size_t i;
+
+        if (g_profiler_buf == NULL) {
+                return 0;
+        }
+        off = 0;
+        while (next_sample(&off) != NULL) {
+                nsamples++;
+        }
+        if (nsamples > 0) {
+                samples = malloc(nsamples * sizeof(*samples));
+                if (samples == NULL) {
+                        return ENOMEM;
+                }
+        }
+        off = 0;
+        for (i = 0; i < nsamples; i++) {
+                samples[i] = next_sample(&off);
+                assert(samples[i] != NULL);
+        }
+        qsort(samples, nsamples, sizeof(*samples), cmp_sample);
+        nametable_init(&table);
+        for (i = 0; i < nsamples;) {
+                sample = samples[i];
+                size_t count = 1;
+                while (i + count < nsamples &&
+                       cmp_sample(&samples[i], &samples[i + count]) == 0) {
+                        count++;
+                }
+                write_stack(fp, &table, sample);
+                fprintf(fp, " %zu\n", count);
+                i += count;
+        }
+        nametable_clear(&table);
+        free(samples);
+        unsigned int ndropped = atomic_load(&g_profiler_ndropped);
+        if (ndropped > 0) {
+                xlog_printf("profiler: %u samples, %u dropped\n",
+                            atomic_load(&g_profiler_nsamples), ndropped);
+        }
+        if (ferror(fp)) {
+                return EIO;
+        }
+        return 0;
+}
+
+/*
+ * discard the samples and free the buffer.
+ */
+void
+profiler_clear(void)
+{
+        assert(!g_profiler_running);
+        free(g_profiler_buf);
+        g_profiler_buf = NULL;
+        g_profiler_bufsize = 0;
+        atomic_store(&g_profiler_used, 0);
+        atomic_store(&g_profiler_nsamples, 0);
+        atomic_store(&g_profiler_ndropped, 0);
+}
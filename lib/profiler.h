@@ -0,0 +1,38 @@
+#if !defined(_TOYWASM_PROFILER_H)
+#define _TOYWASM_PROFILER_H
+
+#include <stdio.h>
+
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct exec_context;
+
+#define PROFILER_DEFAULT_HZ 997
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_PROFILER)
+int profiler_start(unsigned int hz);
+void profiler_stop(void);
+int profiler_write(FILE *fp);
+void profiler_clear(void);
+
+/*
+ * the exec_context being executed by the thread.
+ * maintained by exec_expr_continue for the signal handler.
+ */
+extern _Thread_local struct exec_context *profiler_current;
+
+static inline struct exec_context *
+profiler_set_current(struct exec_context *ctx)
+{
+        struct exec_context *prev = profiler_current;
+        profiler_current = ctx;
+        return prev;
+}
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_PROFILER_H) */
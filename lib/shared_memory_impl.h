@@ -1,4 +1,7 @@
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
+#if __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
 #include <stdint.h>
 
 #include "lock.h"
@@ -8,6 +11,15 @@ struct shared_meminst {
         /* atomic operations, esp. wait/notify */
         struct waiter_list_table tab;
 
+#if defined(TOYWASM_USE_FUTEX)
+        /*
+         * the number of threads in memory.atomic.wait64, which still
+         * uses the waiter lists. it allows memory_notify to skip the
+         * lock when it's zero. (see memory_notify_futex)
+         */
+        atomic_uint nwaiters64;
+#endif
+
         /*
          * to serialize memory.grow etc on a shared memory.
          */
@@ -0,0 +1,775 @@
+#if !defined(_TOYWASM_SIMD_HOST_H)
+#define _TOYWASM_SIMD_HOST_H
+
+/*
+ * host-vectorized implementations of wasm SIMD operations.
+ * (TOYWASM_USE_HOST_SIMD)
+ *
+ * insn_impl_simd.h uses HOST_xxx defined here instead of its own
+ * portable xxx via SIMD_HOST(xxx) and SIMD_HOST_LANES_OPn.
+ *
+ * the base implementation uses the GCC/Clang vector extensions:
+ * https://gcc.gnu.org/onlinedocs/gcc/Vector-Extensions.html
+ * https://clang.llvm.org/docs/LanguageExtensions.html#vectors-and-extended-vectors
+ *
+ * a few operations which are hard to express with them, like saturating
+ * narrowing, rounding and table lookups, use the host intrinsics when
+ * the compiler target has them: (thus you might want to build toywasm
+ * with eg. -march=native)
+ *
+ *   x86: SSE2, SSSE3, SSE4.1
+ *
+ * otherwise, they fall back to the portable implementations in
+ * insn_impl_simd.h.
+ *
+ * Note: 256-bit extensions like AVX2 are not useful here as wasm SIMD
+ * is 128-bit wide. the compiler still uses the VEX encoding of
+ * the 128-bit instructions for the vector extensions when it's enabled.
+ *
+ * Note: union v128 is in little endian. a vector type is loaded from it
+ * with memcpy, which assumes a little endian host.
+ *
+ * Note: the operations which are implementation-defined or undefined in C
+ * (eg. signed overflow, float-to-int conversion of out-of-range values)
+ * are avoided by using unsigned types or explicit checks.
+ */
+
+#include <string.h>
+
+#include "type.h"
+
+#if !defined(__GNUC__)
+#error TOYWASM_USE_HOST_SIMD requires GCC or Clang
+#endif
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error TOYWASM_USE_HOST_SIMD requires a little endian host
+#endif
+
+/*
+ * HOST_SIMD_GENERIC_ONLY disables the intrinsics.
+ * it's useful to test the generic code on x86.
+ */
+#if !defined(HOST_SIMD_GENERIC_ONLY)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HOST_SSE2
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define HOST_SSSE3
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#define HOST_SSE41
+#endif
+#endif
+
+/* GCC's __builtin_shuffle takes non-constant masks. clang doesn't have it. */
+#if !defined(__clang__)
+#define HOST_HAVE_BUILTIN_SHUFFLE
+#endif
+
+#define HOST_VECTOR_TYPE(T, E, N)                                             \
+        typedef E host_##T __attribute__((vector_size(N)));                   \
+        static inline host_##T host_load_##T(const struct val *v)             \
+        {                                                                     \
+                host_##T x;                                                   \
+                memcpy(&x, &v->u.v128, sizeof(x));                            \
+                return x;                                                     \
+        }                                                                     \
+        static inline host_##T host_load_lo_##T(const struct val *v)          \
+        {                                                                     \
+                host_##T x;                                                   \
+                memcpy(&x, &v->u.v128, sizeof(x));                            \
+                return x;                                                     \
+        }                                                                     \
+        static inline host_##T host_load_hi_##T(const struct val *v)          \
+        {                                                                     \
+                host_##T x;                                                   \
+                memcpy(&x, (const uint8_t *)&v->u.v128 + 16 - sizeof(x),      \
+                       sizeof(x));                                            \
+                return x;                                                     \
+        }
+
+HOST_VECTOR_TYPE(i8x16, int8_t, 16)
+HOST_VECTOR_TYPE(u8x16, uint8_t, 16)
+HOST_VECTOR_TYPE(i16x8, int16_t, 16)
+HOST_VECTOR_TYPE(u16x8, uint16_t, 16)
+HOST_VECTOR_TYPE(i32x4, int32_t, 16)
+HOST_VECTOR_TYPE(u32x4, uint32_t, 16)
+HOST_VECTOR_TYPE(i64x2, int64_t, 16)
+HOST_VECTOR_TYPE(u64x2, uint64_t, 16)
+HOST_VECTOR_TYPE(f32x4, float, 16)
+HOST_VECTOR_TYPE(f64x2, double, 16)
+
+/* the low or high half of a v128 */
+HOST_VECTOR_TYPE(i8x8, int8_t, 8)
+HOST_VECTOR_TYPE(u8x8, uint8_t, 8)
+HOST_VECTOR_TYPE(i16x4, int16_t, 8)
+HOST_VECTOR_TYPE(u16x4, uint16_t, 8)
+HOST_VECTOR_TYPE(i32x2, int32_t, 8)
+HOST_VECTOR_TYPE(u32x2, uint32_t, 8)
+HOST_VECTOR_TYPE(f32x2, float, 8)
+
+#define HOST_STORE(c, EXPR)                                                   \
+        do {                                                                  \
+                const __typeof__(EXPR) _r = (EXPR);                           \
+                ctassert(sizeof(_r) == 16);                                   \
+                memcpy(&(c)->u.v128, &_r, 16);                                \
+        } while (0)
+
+#define HOST_STORE_HALVES(c, LO, HI)                                          \
+        do {                                                                  \
+                const __typeof__(LO) _lo = (LO);                              \
+                const __typeof__(HI) _hi = (HI);                              \
+                ctassert(sizeof(_lo) == 8);                                   \
+                ctassert(sizeof(_hi) == 8);                                   \
+                memcpy(&(c)->u.v128, &_lo, 8);                                \
+                memcpy((uint8_t *)&(c)->u.v128 + 8, &_hi, 8);                 \
+        } while (0)
+
+/* lanes of x where the mask m is set, otherwise y */
+#define HOST_SELECT(T, m, x, y)                                               \
+        ((host_##T)(((host_u64x2)(m) & (host_u64x2)(x)) |                     \
+                    (~(host_u64x2)(m) & (host_u64x2)(y))))
+
+#define HOST_ZERO(T) ((host_##T){0})
+
+/*
+ * HOST_OP1 and HOST_OP2 define a function with the calling convention of
+ * the OP argument of SIMD_OP1 and SIMD_OP2.
+ * the operands are available as a and b of the vector type T.
+ */
+#define HOST_OP1(NAME, T, EXPR)                                               \
+        static inline void NAME(struct val *c, const struct val *va)          \
+        {                                                                     \
+                const host_##T a = host_load_##T(va);                         \
+                HOST_STORE(c, EXPR);                                          \
+        }
+
+#define HOST_OP2(NAME, T, EXPR)                                               \
+        static inline void NAME(struct val *c, const struct val *va,          \
+                                const struct val *vb)                         \
+        {                                                                     \
+                const host_##T a = host_load_##T(va);                         \
+                const host_##T b = host_load_##T(vb);                         \
+                HOST_STORE(c, EXPR);                                          \
+        }
+
+/* the OP argument of SIMD_SHIFTOP. the count is i32. */
+#define HOST_SHIFTOP(NAME, T, LS, OP)                                         \
+        static inline void NAME(struct val *c, const struct val *va,          \
+                                const struct val *vb)                         \
+        {                                                                     \
+                const host_##T a = host_load_##T(va);                         \
+                HOST_STORE(c, a OP(int)(vb->u.i32 % LS));                     \
+        }
+
+/*
+ * bitwise operations
+ */
+
+HOST_OP1(HOST_V128_NOT, u64x2, ~a)
+HOST_OP2(HOST_V128_AND, u64x2, a & b)
+HOST_OP2(HOST_V128_OR, u64x2, a | b)
+HOST_OP2(HOST_V128_XOR, u64x2, a ^ b)
+HOST_OP2(HOST_V128_ANDNOT, u64x2, a & ~b)
+
+static inline void
+HOST_V128_BITSELECT(struct val *r, const struct val *va, const struct val *vb,
+                    const struct val *vc)
+{
+        const host_u64x2 a = host_load_u64x2(va);
+        const host_u64x2 b = host_load_u64x2(vb);
+        const host_u64x2 c = host_load_u64x2(vc);
+        HOST_STORE(r, HOST_SELECT(u64x2, c, a, b));
+}
+
+/*
+ * splat
+ *
+ * the OP argument of SPLAT_nn in insn_impl_simd.h. (union v128 *, le value)
+ */
+
+#define HOST_SPLAT(NAME, T, ET)                                               \
+        static inline void NAME(union v128 *d, const void *s)                 \
+        {                                                                     \
+                ET x;                                                         \
+                memcpy(&x, s, sizeof(x));                                     \
+                const host_##T v = HOST_ZERO(T) + x;                          \
+                memcpy(d, &v, sizeof(v));                                     \
+        }
+
+HOST_SPLAT(HOST_SPLAT_8, u8x16, uint8_t)
+HOST_SPLAT(HOST_SPLAT_16, u16x8, uint16_t)
+HOST_SPLAT(HOST_SPLAT_32, u32x4, uint32_t)
+HOST_SPLAT(HOST_SPLAT_64, u64x2, uint64_t)
+
+/*
+ * shifts
+ */
+
+HOST_SHIFTOP(HOST_SHL_8, u8x16, 8, <<)
+HOST_SHIFTOP(HOST_SHL_16, u16x8, 16, <<)
+HOST_SHIFTOP(HOST_SHL_32, u32x4, 32, <<)
+HOST_SHIFTOP(HOST_SHL_64, u64x2, 64, <<)
+HOST_SHIFTOP(HOST_SHR_s_8, i8x16, 8, >>)
+HOST_SHIFTOP(HOST_SHR_s_16, i16x8, 16, >>)
+HOST_SHIFTOP(HOST_SHR_s_32, i32x4, 32, >>)
+HOST_SHIFTOP(HOST_SHR_s_64, i64x2, 64, >>)
+HOST_SHIFTOP(HOST_SHR_u_8, u8x16, 8, >>)
+HOST_SHIFTOP(HOST_SHR_u_16, u16x8, 16, >>)
+HOST_SHIFTOP(HOST_SHR_u_32, u32x4, 32, >>)
+HOST_SHIFTOP(HOST_SHR_u_64, u64x2, 64, >>)
+
+/*
+ * integer arithmetic
+ *
+ * Note: use unsigned types to get the wrap-around behavior.
+ */
+
+HOST_OP2(HOST_ADD_8x16, u8x16, a + b)
+HOST_OP2(HOST_ADD_16x8, u16x8, a + b)
+HOST_OP2(HOST_ADD_32x4, u32x4, a + b)
+HOST_OP2(HOST_ADD_64x2, u64x2, a + b)
+HOST_OP2(HOST_SUB_8x16, u8x16, a - b)
+HOST_OP2(HOST_SUB_16x8, u16x8, a - b)
+HOST_OP2(HOST_SUB_32x4, u32x4, a - b)
+HOST_OP2(HOST_SUB_64x2, u64x2, a - b)
+HOST_OP2(HOST_MUL_16x8, u16x8, a * b)
+HOST_OP2(HOST_MUL_32x4, u32x4, a * b)
+HOST_OP2(HOST_MUL_64x2, u64x2, a * b)
+
+HOST_OP1(HOST_LANE_NEG_i8, u8x16, -a)
+HOST_OP1(HOST_LANE_NEG_i16, u16x8, -a)
+HOST_OP1(HOST_LANE_NEG_i32, u32x4, -a)
+HOST_OP1(HOST_LANE_NEG_i64, u64x2, -a)
+
+/* m = a >> (LS - 1) is all ones for negative lanes. |a| = (a ^ m) - m */
+#define HOST_ABS(U, LS, a)                                                    \
+        ((host_##U)((a) ^ ((a) >> (LS - 1))) - (host_##U)((a) >> (LS - 1)))
+
+HOST_OP1(HOST_LANE_ABS_i8, i8x16, HOST_ABS(u8x16, 8, a))
+HOST_OP1(HOST_LANE_ABS_i16, i16x8, HOST_ABS(u16x8, 16, a))
+HOST_OP1(HOST_LANE_ABS_i32, i32x4, HOST_ABS(u32x4, 32, a))
+HOST_OP1(HOST_LANE_ABS_i64, i64x2, HOST_ABS(u64x2, 64, a))
+
+HOST_OP2(HOST_MIN_s_8x16, i8x16, HOST_SELECT(i8x16, a < b, a, b))
+HOST_OP2(HOST_MIN_s_16x8, i16x8, HOST_SELECT(i16x8, a < b, a, b))
+HOST_OP2(HOST_MIN_s_32x4, i32x4, HOST_SELECT(i32x4, a < b, a, b))
+HOST_OP2(HOST_MIN_u_8x16, u8x16, HOST_SELECT(u8x16, a < b, a, b))
+HOST_OP2(HOST_MIN_u_16x8, u16x8, HOST_SELECT(u16x8, a < b, a, b))
+HOST_OP2(HOST_MIN_u_32x4, u32x4, HOST_SELECT(u32x4, a < b, a, b))
+HOST_OP2(HOST_MAX_s_8x16, i8x16, HOST_SELECT(i8x16, a > b, a, b))
+HOST_OP2(HOST_MAX_s_16x8, i16x8, HOST_SELECT(i16x8, a > b, a, b))
+HOST_OP2(HOST_MAX_s_32x4, i32x4, HOST_SELECT(i32x4, a > b, a, b))
+HOST_OP2(HOST_MAX_u_8x16, u8x16, HOST_SELECT(u8x16, a > b, a, b))
+HOST_OP2(HOST_MAX_u_16x8, u16x8, HOST_SELECT(u16x8, a > b, a, b))
+HOST_OP2(HOST_MAX_u_32x4, u32x4, HOST_SELECT(u32x4, a > b, a, b))
+
+/* (a + b + 1) / 2 without overflow */
+HOST_OP2(HOST_LANE_AVGR_i8, u8x16, (a | b) - ((a ^ b) >> 1))
+HOST_OP2(HOST_LANE_AVGR_i16, u16x8, (a | b) - ((a ^ b) >> 1))
+
+
+/*
+ * saturating arithmetic
+ */
+
+/*
+ * a signed addition (subtraction) overflows iff the operands have
+ * the same (different) signs and the sign of the result differs from a.
+ * in that case, the result is saturated toward the sign of a.
+ */
+#define HOST_SAT_S_GENERIC(NAME, S, U, LS, OP, OVERFLOW)                      \
+        static inline host_##S NAME(host_##S a, host_##S b)                   \
+        {                                                                     \
+                const host_##S r = (host_##S)((host_##U)a OP(host_##U) b);    \
+                const host_##S ov = (host_##S)((OVERFLOW) < HOST_ZERO(S));    \
+                const host_##S max = (host_##S)(~HOST_ZERO(U) >> 1);          \
+                const host_##S sat = (a >> (LS - 1)) ^ max;                   \
+                return HOST_SELECT(S, ov, sat, r);                            \
+        }
+
+HOST_SAT_S_GENERIC(host_add_sat_s8, i8x16, u8x16, 8, +, (a ^ r) & (b ^ r))
+HOST_SAT_S_GENERIC(host_add_sat_s16, i16x8, u16x8, 16, +, (a ^ r) & (b ^ r))
+HOST_SAT_S_GENERIC(host_sub_sat_s8, i8x16, u8x16, 8, -, (a ^ b) & (a ^ r))
+HOST_SAT_S_GENERIC(host_sub_sat_s16, i16x8, u16x8, 16, -, (a ^ b) & (a ^ r))
+
+/* an unsigned addition (subtraction) wraps iff r < a (r > a) */
+static inline host_u8x16
+host_add_sat_u8(host_u8x16 a, host_u8x16 b)
+{
+        const host_u8x16 r = a + b;
+        return r | (host_u8x16)(r < a);
+}
+
+static inline host_u16x8
+host_add_sat_u16(host_u16x8 a, host_u16x8 b)
+{
+        const host_u16x8 r = a + b;
+        return r | (host_u16x8)(r < a);
+}
+
+static inline host_u8x16
+host_sub_sat_u8(host_u8x16 a, host_u8x16 b)
+{
+        const host_u8x16 r = a - b;
+        return r & (host_u8x16)(r <= a);
+}
+
+static inline host_u16x8
+host_sub_sat_u16(host_u16x8 a, host_u16x8 b)
+{
+        const host_u16x8 r = a - b;
+        return r & (host_u16x8)(r <= a);
+}
+
+#if defined(HOST_SSE2)
+#define HOST_SAT_OP(NAME, T, SSE, GENERIC)                                    \
+        HOST_OP2(NAME, T, (host_##T)SSE((__m128i)a, (__m128i)b))
+#else
+#define HOST_SAT_OP(NAME, T, SSE, GENERIC) HOST_OP2(NAME, T, GENERIC(a, b))
+#endif
+
+HOST_SAT_OP(HOST_ADD_SAT_8_s, i8x16, _mm_adds_epi8, host_add_sat_s8)
+HOST_SAT_OP(HOST_ADD_SAT_16_s, i16x8, _mm_adds_epi16, host_add_sat_s16)
+HOST_SAT_OP(HOST_SUB_SAT_8_s, i8x16, _mm_subs_epi8, host_sub_sat_s8)
+HOST_SAT_OP(HOST_SUB_SAT_16_s, i16x8, _mm_subs_epi16, host_sub_sat_s16)
+HOST_SAT_OP(HOST_ADD_SAT_8_u, u8x16, _mm_adds_epu8, host_add_sat_u8)
+HOST_SAT_OP(HOST_ADD_SAT_16_u, u16x8, _mm_adds_epu16, host_add_sat_u16)
+HOST_SAT_OP(HOST_SUB_SAT_8_u, u8x16, _mm_subs_epu8, host_sub_sat_u8)
+HOST_SAT_OP(HOST_SUB_SAT_16_u, u16x8, _mm_subs_epu16, host_sub_sat_u16)
+
+/*
+ * round(a * b / 2^15) with saturation.
+ * the only case to saturate is -0x8000 * -0x8000.
+ */
+static inline void
+HOST_LANE_Q15MULR_i16(struct val *c, const struct val *va,
+                      const struct val *vb)
+{
+#if defined(HOST_SSSE3)
+        const __m128i a = (__m128i)host_load_i16x8(va);
+        const __m128i b = (__m128i)host_load_i16x8(vb);
+        const __m128i r = _mm_mulhrs_epi16(a, b);
+        /* 0x8000 -> 0x7fff */
+        const __m128i ov = _mm_cmpeq_epi16(r, _mm_set1_epi16(INT16_MIN));
+        HOST_STORE(c, (host_i16x8)_mm_xor_si128(r, ov));
+#else
+        /* process the even and odd lanes separately in 32-bit */
+        const host_i32x4 a = host_load_i32x4(va);
+        const host_i32x4 b = host_load_i32x4(vb);
+        const host_i32x4 max = HOST_ZERO(i32x4) + INT16_MAX;
+        const host_i32x4 ae = (host_i32x4)((host_u32x4)a << 16) >> 16;
+        const host_i32x4 be = (host_i32x4)((host_u32x4)b << 16) >> 16;
+        const host_i32x4 ao = a >> 16;
+        const host_i32x4 bo = b >> 16;
+        host_i32x4 re = (ae * be + 0x4000) >> 15;
+        host_i32x4 ro = (ao * bo + 0x4000) >> 15;
+        re = HOST_SELECT(i32x4, re > max, max, re);
+        ro = HOST_SELECT(i32x4, ro > max, max, ro);
+        HOST_STORE(c, ((host_u32x4)re & 0xffff) | ((host_u32x4)ro << 16));
+#endif
+}
+
+/*
+ * narrowing
+ *
+ * Note: the input lanes are always interpreted signed.
+ */
+
+#define HOST_CLAMP(T, x, MIN, MAX)                                            \
+        HOST_SELECT(T, (x) < (MIN), MIN,                                      \
+                    HOST_SELECT(T, (x) > (MAX), MAX, x))
+
+#define HOST_NARROW_GENERIC(NAME, S, HALF, MIN, MAX)                          \
+        static inline void NAME(struct val *c, const struct val *va,          \
+                                const struct val *vb)                         \
+        {                                                                     \
+                const host_##S min = HOST_ZERO(S) + (MIN);                    \
+                const host_##S max = HOST_ZERO(S) + (MAX);                    \
+                const host_##S a = host_load_##S(va);                         \
+                const host_##S b = host_load_##S(vb);                         \
+                HOST_STORE_HALVES(                                            \
+                        c,                                                    \
+                        __builtin_convertvector(HOST_CLAMP(S, a, min, max),   \
+                                                host_##HALF),                 \
+                        __builtin_convertvector(HOST_CLAMP(S, b, min, max),   \
+                                                host_##HALF));                \
+        }
+
+#if defined(HOST_SSE2)
+HOST_OP2(HOST_NARROW_8_s, i16x8,
+         (host_i8x16)_mm_packs_epi16((__m128i)a, (__m128i)b))
+HOST_OP2(HOST_NARROW_8_u, i16x8,
+         (host_u8x16)_mm_packus_epi16((__m128i)a, (__m128i)b))
+HOST_OP2(HOST_NARROW_16_s, i32x4,
+         (host_i16x8)_mm_packs_epi32((__m128i)a, (__m128i)b))
+#else
+HOST_NARROW_GENERIC(HOST_NARROW_8_s, i16x8, i8x8, INT8_MIN, INT8_MAX)
+HOST_NARROW_GENERIC(HOST_NARROW_8_u, i16x8, u8x8, 0, UINT8_MAX)
+HOST_NARROW_GENERIC(HOST_NARROW_16_s, i32x4, i16x4, INT16_MIN, INT16_MAX)
+#endif
+
+#if defined(HOST_SSE41)
+HOST_OP2(HOST_NARROW_16_u, i32x4,
+         (host_u16x8)_mm_packus_epi32((__m128i)a, (__m128i)b))
+#else
+HOST_NARROW_GENERIC(HOST_NARROW_16_u, i32x4, u16x4, 0, UINT16_MAX)
+#endif
+
+/*
+ * widening
+ */
+
+/* HOST_OP1 and HOST_OP2 for the low or high half of the operands */
+#define HOST_HALF_OP1(NAME, LO_OR_HI, T, EXPR)                                \
+        static inline void NAME(struct val *c, const struct val *va)          \
+        {                                                                     \
+                const host_##T a = host_load_##LO_OR_HI##_##T(va);            \
+                HOST_STORE(c, EXPR);                                          \
+        }
+
+#define HOST_HALF_OP2(NAME, LO_OR_HI, T, EXPR)                                \
+        static inline void NAME(struct val *c, const struct val *va,          \
+                                const struct val *vb)                         \
+        {                                                                     \
+                const host_##T a = host_load_##LO_OR_HI##_##T(va);            \
+                const host_##T b = host_load_##LO_OR_HI##_##T(vb);            \
+                HOST_STORE(c, EXPR);                                          \
+        }
+
+#define HOST_EXTEND(NAME, LO_OR_HI, T, WIDE)                                  \
+        HOST_HALF_OP1(NAME, LO_OR_HI, T,                                      \
+                      __builtin_convertvector(a, host_##WIDE))
+
+/* Note: the products never overflow */
+#define HOST_EXTMUL(NAME, LO_OR_HI, T, WIDE)                                  \
+        HOST_HALF_OP2(NAME, LO_OR_HI, T,                                      \
+                      __builtin_convertvector(a, host_##WIDE) *               \
+                              __builtin_convertvector(b, host_##WIDE))
+
+HOST_EXTEND(HOST_EXTEND_LOW_16_s, lo, i8x8, i16x8)
+HOST_EXTEND(HOST_EXTEND_HIGH_16_s, hi, i8x8, i16x8)
+HOST_EXTEND(HOST_EXTEND_LOW_16_u, lo, u8x8, u16x8)
+HOST_EXTEND(HOST_EXTEND_HIGH_16_u, hi, u8x8, u16x8)
+HOST_EXTEND(HOST_EXTEND_LOW_32_s, lo, i16x4, i32x4)
+HOST_EXTEND(HOST_EXTEND_HIGH_32_s, hi, i16x4, i32x4)
+HOST_EXTEND(HOST_EXTEND_LOW_32_u, lo, u16x4, u32x4)
+HOST_EXTEND(HOST_EXTEND_HIGH_32_u, hi, u16x4, u32x4)
+HOST_EXTEND(HOST_EXTEND_LOW_64_s, lo, i32x2, i64x2)
+HOST_EXTEND(HOST_EXTEND_HIGH_64_s, hi, i32x2, i64x2)
+HOST_EXTEND(HOST_EXTEND_LOW_64_u, lo, u32x2, u64x2)
+HOST_EXTEND(HOST_EXTEND_HIGH_64_u, hi, u32x2, u64x2)
+
+HOST_EXTMUL(HOST_EXTMUL_LOW_16_s, lo, i8x8, i16x8)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_16_s, hi, i8x8, i16x8)
+HOST_EXTMUL(HOST_EXTMUL_LOW_16_u, lo, u8x8, u16x8)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_16_u, hi, u8x8, u16x8)
+HOST_EXTMUL(HOST_EXTMUL_LOW_32_s, lo, i16x4, i32x4)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_32_s, hi, i16x4, i32x4)
+HOST_EXTMUL(HOST_EXTMUL_LOW_32_u, lo, u16x4, u32x4)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_32_u, hi, u16x4, u32x4)
+HOST_EXTMUL(HOST_EXTMUL_LOW_64_s, lo, i32x2, i64x2)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_64_s, hi, i32x2, i64x2)
+HOST_EXTMUL(HOST_EXTMUL_LOW_64_u, lo, u32x2, u64x2)
+HOST_EXTMUL(HOST_EXTMUL_HIGH_64_u, hi, u32x2, u64x2)
+
+/*
+ * pairwise operations.
+ * view the operands as the wide lanes and split them into
+ * the even (low) and odd (high) narrow lanes.
+ */
+
+#define HOST_EVEN_s(T, U, HALFBITS, a)                                        \
+        ((host_##T)((host_##U)(a) << HALFBITS) >> HALFBITS)
+#define HOST_ODD_s(T, U, HALFBITS, a) ((a) >> HALFBITS)
+
+HOST_OP1(HOST_EXTADD_16_s, i16x8,
+         HOST_EVEN_s(i16x8, u16x8, 8, a) + HOST_ODD_s(i16x8, u16x8, 8, a))
+HOST_OP1(HOST_EXTADD_16_u, u16x8, (a & 0xff) + (a >> 8))
+HOST_OP1(HOST_EXTADD_32_s, i32x4,
+         HOST_EVEN_s(i32x4, u32x4, 16, a) + HOST_ODD_s(i32x4, u32x4, 16, a))
+HOST_OP1(HOST_EXTADD_32_u, u32x4, (a & 0xffff) + (a >> 16))
+
+/* Note: the sum can overflow. (-0x8000 * -0x8000 * 2) */
+HOST_OP2(HOST_DOT32, i32x4,
+         (host_u32x4)(HOST_EVEN_s(i32x4, u32x4, 16, a) *
+                      HOST_EVEN_s(i32x4, u32x4, 16, b)) +
+                 (host_u32x4)(HOST_ODD_s(i32x4, u32x4, 16, a) *
+                              HOST_ODD_s(i32x4, u32x4, 16, b)))
+
+/*
+ * comparisons
+ */
+
+#define HOST_CMP_INT(LS, S, U)                                                \
+        HOST_OP2(HOST_EQ_i##LS, U, a == b)                                    \
+        HOST_OP2(HOST_NE_i##LS, U, a != b)                                    \
+        HOST_OP2(HOST_LT_S_i##LS, S, a < b)                                   \
+        HOST_OP2(HOST_GT_S_i##LS, S, a > b)                                   \
+        HOST_OP2(HOST_LE_S_i##LS, S, a <= b)                                  \
+        HOST_OP2(HOST_GE_S_i##LS, S, a >= b)                                  \
+        HOST_OP2(HOST_LT_i##LS, U, a < b)                                     \
+        HOST_OP2(HOST_GT_i##LS, U, a > b)                                     \
+        HOST_OP2(HOST_LE_i##LS, U, a <= b)                                    \
+        HOST_OP2(HOST_GE_i##LS, U, a >= b)
+
+#define HOST_CMP_FLOAT(LS, T)                                                 \
+        HOST_OP2(HOST_EQ_f##LS, T, a == b)                                    \
+        HOST_OP2(HOST_NE_f##LS, T, a != b)                                    \
+        HOST_OP2(HOST_LT_f##LS, T, a < b)                                     \
+        HOST_OP2(HOST_GT_f##LS, T, a > b)                                     \
+        HOST_OP2(HOST_LE_f##LS, T, a <= b)                                    \
+        HOST_OP2(HOST_GE_f##LS, T, a >= b)
+
+HOST_CMP_INT(8, i8x16, u8x16)
+HOST_CMP_INT(16, i16x8, u16x8)
+HOST_CMP_INT(32, i32x4, u32x4)
+HOST_CMP_INT(64, i64x2, u64x2)
+HOST_CMP_FLOAT(32, f32x4)
+HOST_CMP_FLOAT(64, f64x2)
+
+/*
+ * floating point arithmetic
+ *
+ * Note: wasm fmin/fmax have NaN and -0 rules which don't map to
+ * simple vector operations. we keep the portable implementations for them.
+ */
+
+HOST_OP2(HOST_FADD_32x4, f32x4, a + b)
+HOST_OP2(HOST_FADD_64x2, f64x2, a + b)
+HOST_OP2(HOST_FSUB_32x4, f32x4, a - b)
+HOST_OP2(HOST_FSUB_64x2, f64x2, a - b)
+HOST_OP2(HOST_FMUL_32x4, f32x4, a * b)
+HOST_OP2(HOST_FMUL_64x2, f64x2, a * b)
+HOST_OP2(HOST_FDIV_32x4, f32x4, a / b)
+HOST_OP2(HOST_FDIV_64x2, f64x2, a / b)
+
+HOST_OP2(HOST_FPMIN_32x4, f32x4, HOST_SELECT(f32x4, b < a, b, a))
+HOST_OP2(HOST_FPMIN_64x2, f64x2, HOST_SELECT(f64x2, b < a, b, a))
+HOST_OP2(HOST_FPMAX_32x4, f32x4, HOST_SELECT(f32x4, a < b, b, a))
+HOST_OP2(HOST_FPMAX_64x2, f64x2, HOST_SELECT(f64x2, a < b, b, a))
+
+/* only touch the sign bit, as the scalar fabs and fneg do */
+HOST_OP1(HOST_FABS_32, u32x4, a & 0x7fffffff)
+HOST_OP1(HOST_FABS_64, u64x2, a & 0x7fffffffffffffff)
+HOST_OP1(HOST_FNEG_32, u32x4, a ^ 0x80000000)
+HOST_OP1(HOST_FNEG_64, u64x2, a ^ 0x8000000000000000)
+
+#if defined(HOST_SSE2)
+HOST_OP1(HOST_FSQRT_32, f32x4, (host_f32x4)_mm_sqrt_ps((__m128)a))
+HOST_OP1(HOST_FSQRT_64, f64x2, (host_f64x2)_mm_sqrt_pd((__m128d)a))
+#else
+#define HOST_FSQRT_32 FSQRT_32
+#define HOST_FSQRT_64 FSQRT_64
+#endif
+
+#if defined(HOST_SSE41)
+#define HOST_ROUND(NAME, T, MT, ROUND, MODE)                                  \
+        HOST_OP1(NAME, T,                                                     \
+                 (host_##T)ROUND((MT)a, _MM_FROUND_##MODE | _MM_FROUND_NO_EXC))
+HOST_ROUND(HOST_LANE_CEILF_f32, f32x4, __m128, _mm_round_ps, TO_POS_INF)
+HOST_ROUND(HOST_LANE_FLOORF_f32, f32x4, __m128, _mm_round_ps, TO_NEG_INF)
+HOST_ROUND(HOST_LANE_TRUNCF_f32, f32x4, __m128, _mm_round_ps, TO_ZERO)
+HOST_ROUND(HOST_LANE_NEARESTF_f32, f32x4, __m128, _mm_round_ps,
+           TO_NEAREST_INT)
+HOST_ROUND(HOST_LANE_CEIL_f64, f64x2, __m128d, _mm_round_pd, TO_POS_INF)
+HOST_ROUND(HOST_LANE_FLOOR_f64, f64x2, __m128d, _mm_round_pd, TO_NEG_INF)
+HOST_ROUND(HOST_LANE_TRUNC_f64, f64x2, __m128d, _mm_round_pd, TO_ZERO)
+HOST_ROUND(HOST_LANE_NEAREST_f64, f64x2, __m128d, _mm_round_pd,
+           TO_NEAREST_INT)
+#else
+#define HOST_ROUND(a, b, OP, I_OR_F, LS)                                      \
+        FOREACH_LANES2_2(I_OR_F, LS, a, b, OP)
+#define HOST_LANE_CEILF_f32(a, b) HOST_ROUND(a, b, LANE_CEILF, f, 32)
+#define HOST_LANE_FLOORF_f32(a, b) HOST_ROUND(a, b, LANE_FLOORF, f, 32)
+#define HOST_LANE_TRUNCF_f32(a, b) HOST_ROUND(a, b, LANE_TRUNCF, f, 32)
+#define HOST_LANE_NEARESTF_f32(a, b) HOST_ROUND(a, b, LANE_NEARESTF, f, 32)
+#define HOST_LANE_CEIL_f64(a, b) HOST_ROUND(a, b, LANE_CEIL, f, 64)
+#define HOST_LANE_FLOOR_f64(a, b) HOST_ROUND(a, b, LANE_FLOOR, f, 64)
+#define HOST_LANE_TRUNC_f64(a, b) HOST_ROUND(a, b, LANE_TRUNC, f, 64)
+#define HOST_LANE_NEAREST_f64(a, b) HOST_ROUND(a, b, LANE_NEAREST, f, 64)
+#endif
+
+/*
+ * conversions
+ */
+
+HOST_OP1(HOST_CONVERT_32_s, i32x4, __builtin_convertvector(a, host_f32x4))
+HOST_OP1(HOST_CONVERT_32_u, u32x4, __builtin_convertvector(a, host_f32x4))
+HOST_HALF_OP1(HOST_CONVERT_LOW_64_s, lo, i32x2,
+              __builtin_convertvector(a, host_f64x2))
+HOST_HALF_OP1(HOST_CONVERT_LOW_64_u, lo, u32x2,
+              __builtin_convertvector(a, host_f64x2))
+HOST_HALF_OP1(HOST_PROMOTE_LOW_64, lo, f32x2,
+              __builtin_convertvector(a, host_f64x2))
+
+static inline void
+HOST_DEMOTE_32(struct val *c, const struct val *va)
+{
+        const host_f64x2 a = host_load_f64x2(va);
+        HOST_STORE_HALVES(c, __builtin_convertvector(a, host_f32x2),
+                          HOST_ZERO(f32x2));
+}
+
+/*
+ * Note: a float-to-int conversion of an out-of-range value is undefined
+ * in C. the vector extensions are not usable here.
+ */
+#if defined(HOST_SSE2)
+/*
+ * cvttps2dq returns INT32_MIN for NaN and out-of-range values.
+ * fix up positive overflows and NaN.
+ */
+static inline void
+HOST_TRUNC_SAT_32_s(struct val *c, const struct val *va)
+{
+        const __m128 a = (__m128)host_load_f32x4(va);
+        __m128i r = _mm_cvttps_epi32(a);
+        const __m128 ov = _mm_cmpge_ps(a, _mm_set1_ps(2147483648.0f));
+        const __m128 ord = _mm_cmpord_ps(a, a);
+        r = _mm_xor_si128(r, _mm_castps_si128(ov));
+        r = _mm_and_si128(r, _mm_castps_si128(ord));
+        HOST_STORE(c, (host_i32x4)r);
+}
+#else
+#define HOST_TRUNC_SAT_32_s TRUNC_SAT_32_s
+#endif
+#define HOST_TRUNC_SAT_32_u TRUNC_SAT_32_u
+#define HOST_TRUNC_SAT_64_s TRUNC_SAT_64_s
+#define HOST_TRUNC_SAT_64_u TRUNC_SAT_64_u
+
+/*
+ * lane-wise bit operations
+ */
+
+static inline void
+HOST_LANE_POPCNT_i8(struct val *c, const struct val *va)
+{
+        host_u8x16 a = host_load_u8x16(va);
+        a = a - ((a >> 1) & 0x55);
+        a = (a & 0x33) + ((a >> 2) & 0x33);
+        a = (a + (a >> 4)) & 0x0f;
+        HOST_STORE(c, a);
+}
+
+/*
+ * all_true and bitmask
+ *
+ * the OP argument of SIMD_BOOLOP. (uint32_t, const struct val *)
+ */
+
+#define HOST_ALL_TRUE(T)                                                      \
+        static inline uint32_t host_all_true_##T(const struct val *v)         \
+        {                                                                     \
+                const host_##T a = host_load_##T(v);                          \
+                const host_u64x2 z = (host_u64x2)(a == HOST_ZERO(T));         \
+                return (z[0] | z[1]) == 0;                                    \
+        }
+
+HOST_ALL_TRUE(u8x16)
+HOST_ALL_TRUE(u16x8)
+HOST_ALL_TRUE(u32x4)
+HOST_ALL_TRUE(u64x2)
+
+#define HOST_ALL_TRUE_8x16(r, v) r = host_all_true_u8x16(v)
+#define HOST_ALL_TRUE_16x8(r, v) r = host_all_true_u16x8(v)
+#define HOST_ALL_TRUE_32x4(r, v) r = host_all_true_u32x4(v)
+#define HOST_ALL_TRUE_64x2(r, v) r = host_all_true_u64x2(v)
+
+#if defined(HOST_SSE2)
+static inline uint32_t
+host_bitmask_8x16(const struct val *v)
+{
+        return (uint32_t)_mm_movemask_epi8((__m128i)host_load_i8x16(v));
+}
+
+static inline uint32_t
+host_bitmask_16x8(const struct val *v)
+{
+        const __m128i a = (__m128i)host_load_i16x8(v);
+        /* the signed saturation preserves the sign */
+        return (uint32_t)_mm_movemask_epi8(
+                _mm_packs_epi16(a, _mm_setzero_si128()));
+}
+
+static inline uint32_t
+host_bitmask_32x4(const struct val *v)
+{
+        return (uint32_t)_mm_movemask_ps((__m128)host_load_i32x4(v));
+}
+
+static inline uint32_t
+host_bitmask_64x2(const struct val *v)
+{
+        return (uint32_t)_mm_movemask_pd((__m128d)host_load_i64x2(v));
+}
+#endif
+
+#if defined(HOST_SSE2)
+#define HOST_BITMASK_8x16(r, v) r = host_bitmask_8x16(v)
+#define HOST_BITMASK_16x8(r, v) r = host_bitmask_16x8(v)
+#define HOST_BITMASK_32x4(r, v) r = host_bitmask_32x4(v)
+#define HOST_BITMASK_64x2(r, v) r = host_bitmask_64x2(v)
+#else
+#define HOST_BITMASK_8x16 BITMASK_8x16
+#define HOST_BITMASK_16x8 BITMASK_16x8
+#define HOST_BITMASK_32x4 BITMASK_32x4
+#define HOST_BITMASK_64x2 BITMASK_64x2
+#endif
+
+/*
+ * swizzle and shuffle
+ */
+
+/* the lanes with out-of-range indexes are 0. */
+#if defined(HOST_SSSE3)
+HOST_OP2(HOST_LANE_SWIZZLE_i8, u8x16,
+         (host_u8x16)_mm_shuffle_epi8(
+                 (__m128i)a,
+                 /* set the MSB, which means 0, for the indexes >= 16 */
+                 _mm_adds_epu8((__m128i)b, _mm_set1_epi8(0x70))))
+#elif defined(HOST_HAVE_BUILTIN_SHUFFLE)
+HOST_OP2(HOST_LANE_SWIZZLE_i8, u8x16,
+         __builtin_shuffle(a, b) & (host_u8x16)(b < 16))
+#else
+#define HOST_LANE_SWIZZLE_i8(a, b, c)                                         \
+        FOREACH_LANES3_2(i, 8, a, b, c, LANE_SWIZZLE)
+#endif
+
+/*
+ * the OP argument of SHUFFLE in insn_impl_simd.h.
+ * (uint8_t *result, const uint8_t *a, const uint8_t *b, uint8_t lane[16])
+ * the lane indexes have been validated to be < 32.
+ */
+#if defined(HOST_SSSE3) || defined(HOST_HAVE_BUILTIN_SHUFFLE)
+static inline void
+HOST_SHUFFLE(uint8_t *result, const uint8_t *ap, const uint8_t *bp,
+             const uint8_t *lane)
+{
+        host_u8x16 a;
+        host_u8x16 b;
+        host_u8x16 l;
+        host_u8x16 r;
+        memcpy(&a, ap, 16);
+        memcpy(&b, bp, 16);
+        memcpy(&l, lane, 16);
+#if defined(HOST_SSSE3)
+        /* 0-15 from a, 16-31 from b. the MSB of an index means 0. */
+        const __m128i ra = _mm_shuffle_epi8(
+                (__m128i)a, _mm_adds_epu8((__m128i)l, _mm_set1_epi8(0x70)));
+        const __m128i rb = _mm_shuffle_epi8((__m128i)b, (__m128i)(l - 16));
+        r = (host_u8x16)_mm_or_si128(ra, rb);
+#else
+        r = __builtin_shuffle(a, b, l);
+#endif
+        memcpy(result, &r, 16);
+}
+#else
+#define HOST_SHUFFLE SHUFFLE
+#endif
+
+#endif /* !defined(_TOYWASM_SIMD_HOST_H) */
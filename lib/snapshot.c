@@ -0,0 +1,581 @@
+/*
+ * instance snapshot
+ *
+ * instance_snapshot_write writes a module which is same as the module
+ * of the given instance, except that instantiating it reproduces the
+ * current state of the instance. it can be used to pre-initialize
+ * a module: run its initialization code once, take a snapshot, and
+ * ship the snapshot instead. (like wizer)
+ *
+ * the state of the instance is captured as:
+ *
+ *   - defined memories: an active data segment for each run of non-zero
+ *     bytes. the minimum size of the memory is updated to the current size.
+ *
+ *   - defined mutable globals: constant initializer expressions.
+ *
+ *   - defined tables: an active element segment for each run of non-null
+ *     entries. the minimum size of the table is updated to the current
+ *     size.
+ *
+ * the segments in the original module are kept to preserve their indexes,
+ * which are referenced by instructions like memory.init. the ones which
+ * have been applied or dropped are replaced with empty passive segments.
+ * the new segments are appended after them.
+ *
+ * the start function is removed because its effect is in the snapshot.
+ *
+ * limitations:
+ *
+ *   - imported memories, tables and globals are not captured.
+ *
+ *   - host state, like wasi file descriptors, is not captured.
+ *
+ *   - non-null externref values and references to functions which
+ *     don't belong to the instance (except imported ones) can't be
+ *     represented in a module. ENOTSUP.
+ *
+ *   - custom sections, including the name section, are not preserved.
+ *     (module_write doesn't write them)
+ *
+ *   - the instance should not be running. (eg. on other threads)
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "context.h"
+#include "endian.h"
+#include "instance.h"
+#include "mem.h"
+#include "module_writer.h"
+#include "snapshot.h"
+#include "type.h"
+#include "xlog.h"
+
+/* the longest one is v128.const */
+#define SNAPSHOT_EXPR_MAX 20
+
+/*
+ * a data segment costs a few bytes for its header.
+ * merge runs of non-zero bytes separated by a shorter gap.
+ */
+#define SNAPSHOT_DATA_MIN_GAP 16
+
+struct snapshot {
+        const struct instance *inst;
+        struct mem_context *mctx;
+        struct module m;
+
+        uint8_t *exprs;
+        size_t exprs_size;
+        size_t exprs_used;
+
+        uint32_t *funcs;
+        uint32_t nfuncs;
+        uint32_t funcs_used;
+};
+
+static uint8_t *
+emit_leb_u(uint8_t *p, uint64_t v)
+{
+        do {
+                uint8_t u8 = v & 0x7f;
+                v >>= 7;
+                if (v != 0) {
+                        u8 |= 0x80;
+                }
+                *p++ = u8;
+        } while (v != 0);
+        return p;
+}
+
+static uint8_t *
+emit_leb_s(uint8_t *p, int64_t v)
+{
+        bool more;
+        do {
+                uint8_t u8 = v & 0x7f;
+                /* Note: assuming an arithmetic shift */
+                v >>= 7;
+                more = !((v == 0 && (u8 & 0x40) == 0) ||
+                         (v == -1 && (u8 & 0x40) != 0));
+                if (more) {
+                        u8 |= 0x80;
+                }
+                *p++ = u8;
+        } while (more);
+        return p;
+}
+
+static uint8_t *
+expr_begin(struct snapshot *s, struct expr *e)
+{
+        assert(s->exprs_size - s->exprs_used >= SNAPSHOT_EXPR_MAX);
+        memset(e, 0, sizeof(*e));
+        e->start = s->exprs + s->exprs_used;
+        return s->exprs + s->exprs_used;
+}
+
+static void
+expr_finish(struct snapshot *s, struct expr *e, uint8_t *p)
+{
+        *p++ = FRAME_OP_END;
+        assert(p - e->start <= SNAPSHOT_EXPR_MAX);
+#if defined(TOYWASM_MAINTAIN_EXPR_END)
+        e->end = p;
+#endif
+        s->exprs_used += p - e->start;
+}
+
+static void
+snapshot_offset_expr(struct snapshot *s, struct expr *e, uint32_t offset)
+{
+        uint8_t *p = expr_begin(s, e);
+        *p++ = 0x41; /* i32.const */
+        p = emit_leb_s(p, (int32_t)offset);
+        expr_finish(s, e, p);
+}
+
+/*
+ * map a funcref value to a function index of the instance.
+ */
+static int
+snapshot_funcidx(const struct instance *inst, const struct funcinst *fi,
+                 uint32_t *funcidxp)
+{
+        if (!fi->is_host && fi->u.wasm.instance == inst) {
+                *funcidxp = fi->u.wasm.funcidx;
+                return 0;
+        }
+        uint32_t i;
+        for (i = 0; i < inst->module->nimportedfuncs; i++) {
+                if (VEC_ELEM(inst->funcs, i) == fi) {
+                        *funcidxp = i;
+                        return 0;
+                }
+        }
+        xlog_trace("snapshot: a funcref to another instance");
+        return ENOTSUP;
+}
+
+static int
+snapshot_global(struct snapshot *s, const struct globalinst *gi,
+                struct expr *e)
+{
+        const struct val *val = &gi->val;
+        uint8_t *p = expr_begin(s, e);
+        uint32_t funcidx;
+        int ret;
+
+        switch (gi->type->t) {
+        case TYPE_i32:
+                *p++ = 0x41; /* i32.const */
+                p = emit_leb_s(p, (int32_t)val->u.i32);
+                break;
+        case TYPE_i64:
+                *p++ = 0x42; /* i64.const */
+                p = emit_leb_s(p, (int64_t)val->u.i64);
+                break;
+        case TYPE_f32:
+                *p++ = 0x43; /* f32.const */
+                le32_encode(p, val->u.i32);
+                p += 4;
+                break;
+        case TYPE_f64:
+                *p++ = 0x44; /* f64.const */
+                le64_encode(p, val->u.i64);
+                p += 8;
+                break;
+#if defined(TOYWASM_ENABLE_WASM_SIMD)
+        case TYPE_v128:
+                *p++ = 0xfd; /* v128.const */
+                p = emit_leb_u(p, 12);
+                memcpy(p, &val->u.v128, 16);
+                p += 16;
+                break;
+#endif
+        case TYPE_funcref:
+                if (val->u.funcref.func == NULL) {
+                        *p++ = 0xd0; /* ref.null */
+                        *p++ = TYPE_funcref;
+                        break;
+                }
+                ret = snapshot_funcidx(s->inst, val->u.funcref.func,
+                                       &funcidx);
+                if (ret != 0) {
+                        return ret;
+                }
+                *p++ = 0xd2; /* ref.func */
+                p = emit_leb_u(p, funcidx);
+                break;
+        case TYPE_externref:
+                if (val->u.externref == NULL) {
+                        *p++ = 0xd0; /* ref.null */
+                        *p++ = TYPE_externref;
+                        break;
+                }
+                xlog_trace("snapshot: a non-null externref global");
+                return ENOTSUP;
+        default:
+                xlog_trace("snapshot: unsupported global type %02x",
+                           (unsigned int)gi->type->t);
+                return ENOTSUP;
+        }
+        expr_finish(s, e, p);
+        return 0;
+}
+
+/*
+ * find runs of non-zero bytes in the memory.
+ * if datas is not NULL, fill a data segment for each of them.
+ * returns the number of the runs.
+ */
+static uint32_t
+snapshot_memory(struct snapshot *s, uint32_t memidx, struct data *datas)
+{
+        const struct meminst *mi = VEC_ELEM(s->inst->mems, memidx);
+        const uint8_t *p = mi->data;
+        uint64_t size_in_bytes = (uint64_t)mi->size_in_pages
+                                 << memtype_page_shift(mi->type);
+        size_t sz = mi->allocated;
+        if (sz > size_in_bytes) {
+                sz = size_in_bytes;
+        }
+        uint32_t n = 0;
+        size_t i = 0;
+        while (true) {
+                while (i < sz && p[i] == 0) {
+                        i++;
+                }
+                if (i == sz) {
+                        break;
+                }
+                size_t start = i;
+                size_t end;
+                while (true) {
+                        while (i < sz && p[i] != 0) {
+                                i++;
+                        }
+                        end = i;
+                        while (i < sz && p[i] == 0 &&
+                               i - end < SNAPSHOT_DATA_MIN_GAP) {
+                                i++;
+                        }
+                        if (i == sz || p[i] == 0) {
+                                break;
+                        }
+                }
+                if (datas != NULL) {
+                        struct data *d = &datas[n];
+                        memset(d, 0, sizeof(*d));
+                        d->mode = DATA_MODE_ACTIVE;
+                        d->memory = memidx;
+                        d->init = p + start;
+                        d->init_size = end - start;
+                        snapshot_offset_expr(s, &d->offset, start);
+                }
+                n++;
+        }
+        return n;
+}
+
+/*
+ * find runs of non-null entries in the table.
+ * if elems is not NULL, fill an element segment for each of them.
+ * returns the number of the runs. the number of the entries is added
+ * to *nfuncsp.
+ */
+static int
+snapshot_table(struct snapshot *s, uint32_t tableidx, struct element *elems,
+               uint32_t *nrunsp, uint32_t *nfuncsp)
+{
+        struct tableinst *ti = VEC_ELEM(s->inst->tables, tableidx);
+        uint32_t n = 0;
+        uint32_t nfuncs = 0;
+        uint32_t i = 0;
+        struct val val;
+        int ret;
+        while (true) {
+                while (i < ti->size) {
+                        table_get(ti, i, &val);
+                        if (val.u.funcref.func != NULL) {
+                                break;
+                        }
+                        i++;
+                }
+                if (i == ti->size) {
+                        break;
+                }
+                if (ti->type->et != TYPE_funcref) {
+                        xlog_trace("snapshot: a non-null externref in "
+                                   "table %" PRIu32,
+                                   tableidx);
+                        return ENOTSUP;
+                }
+                uint32_t start = i;
+                struct element *e = NULL;
+                if (elems != NULL) {
+                        e = &elems[n];
+                        memset(e, 0, sizeof(*e));
+                        e->funcs = &s->funcs[s->funcs_used];
+                        e->type = TYPE_funcref;
+                        e->mode = ELEM_MODE_ACTIVE;
+                        e->table = tableidx;
+                        snapshot_offset_expr(s, &e->offset, start);
+                }
+                while (i < ti->size) {
+                        table_get(ti, i, &val);
+                        if (val.u.funcref.func == NULL) {
+                                break;
+                        }
+                        if (e != NULL) {
+                                ret = snapshot_funcidx(s->inst,
+                                                       val.u.funcref.func,
+                                                       &e->funcs[i - start]);
+                                if (ret != 0) {
+                                        return ret;
+                                }
+                        }
+                        i++;
+                }
+                if (e != NULL) {
+                        e->init_size = i - start;
+                        s->funcs_used += e->init_size;
+                }
+                nfuncs += i - start;
+                n++;
+        }
+        *nrunsp = n;
+        *nfuncsp += nfuncs;
+        return 0;
+}
+
+static void
+snapshot_clear(struct snapshot *s)
+{
+        struct mem_context *mctx = s->mctx;
+        struct module *m = &s->m;
+        const struct module *om = s->inst->module;
+        if (m->mems != NULL && m->mems != om->mems) {
+                mem_free(mctx, m->mems, m->nmems * sizeof(*m->mems));
+        }
+        if (m->tables != NULL && m->tables != om->tables) {
+                mem_free(mctx, m->tables, m->ntables * sizeof(*m->tables));
+        }
+        if (m->globals != NULL && m->globals != om->globals) {
+                mem_free(mctx, m->globals, m->nglobals * sizeof(*m->globals));
+        }
+        if (m->elems != NULL && m->elems != om->elems) {
+                mem_free(mctx, m->elems, m->nelems * sizeof(*m->elems));
+        }
+        if (m->datas != NULL && m->datas != om->datas) {
+                mem_free(mctx, m->datas, m->ndatas * sizeof(*m->datas));
+        }
+        if (m->exports != NULL && m->exports != om->exports) {
+                mem_free(mctx, m->exports, m->nexports * sizeof(*m->exports));
+        }
+        if (s->exprs != NULL) {
+                mem_free(mctx, s->exprs, s->exprs_size);
+        }
+        if (s->funcs != NULL) {
+                mem_free(mctx, s->funcs, s->nfuncs * sizeof(*s->funcs));
+        }
+}
+
+#define ALLOC_ARRAY(p, n)                                                     \
+        do {                                                                  \
+                if ((n) > 0) {                                                \
+                        (p) = mem_calloc(mctx, (n), sizeof(*(p)));            \
+                        if ((p) == NULL) {                                    \
+                                ret = ENOMEM;                                 \
+                                goto fail;                                    \
+                        }                                                     \
+                }                                                             \
+        } while (0)
+
+int
+instance_snapshot_write(const char *filename, const struct instance *inst,
+                        const struct name *removed_export)
+{
+        struct snapshot s0;
+        struct snapshot *s = &s0;
+        struct mem_context *mctx = inst->mctx;
+        const struct module *om = inst->module;
+        struct module *m = &s->m;
+        uint32_t i;
+        int ret;
+
+        memset(s, 0, sizeof(*s));
+        s->inst = inst;
+        s->mctx = mctx;
+        *m = *om;
+        m->has_start = false;
+
+        /*
+         * count the new segments
+         */
+        uint32_t ndatas = 0;
+        for (i = om->nimportedmems; i < om->nimportedmems + om->nmems; i++) {
+                ndatas += snapshot_memory(s, i, NULL);
+        }
+        uint32_t nelems = 0;
+        for (i = om->nimportedtables; i < om->nimportedtables + om->ntables;
+             i++) {
+                uint32_t n;
+                ret = snapshot_table(s, i, NULL, &n, &s->nfuncs);
+                if (ret != 0) {
+                        goto fail;
+                }
+                nelems += n;
+        }
+        if (UINT32_MAX - om->ndatas < ndatas ||
+            UINT32_MAX - om->nelems < nelems) {
+                ret = EOVERFLOW;
+                goto fail;
+        }
+        s->exprs_size =
+                ((size_t)om->nglobals + ndatas + nelems) * SNAPSHOT_EXPR_MAX;
+        ALLOC_ARRAY(s->exprs, s->exprs_size);
+        ALLOC_ARRAY(s->funcs, s->nfuncs);
+
+        /*
+         * memories and tables
+         */
+        m->mems = NULL;
+        m->tables = NULL;
+        ALLOC_ARRAY(m->mems, om->nmems);
+        for (i = 0; i < om->nmems; i++) {
+                const struct meminst *mi =
+                        VEC_ELEM(inst->mems, om->nimportedmems + i);
+                m->mems[i] = om->mems[i];
+                m->mems[i].lim.min = mi->size_in_pages;
+        }
+        ALLOC_ARRAY(m->tables, om->ntables);
+        for (i = 0; i < om->ntables; i++) {
+                const struct tableinst *ti =
+                        VEC_ELEM(inst->tables, om->nimportedtables + i);
+                m->tables[i] = om->tables[i];
+                m->tables[i].lim.min = ti->size;
+        }
+
+        /*
+         * globals
+         */
+        m->globals = NULL;
+        ALLOC_ARRAY(m->globals, om->nglobals);
+        for (i = 0; i < om->nglobals; i++) {
+                const struct globalinst *gi =
+                        VEC_ELEM(inst->globals, om->nimportedglobals + i);
+                m->globals[i] = om->globals[i];
+                if (gi->type->mut != GLOBAL_VAR) {
+                        continue;
+                }
+                ret = snapshot_global(s, gi, &m->globals[i].init);
+                if (ret != 0) {
+                        goto fail;
+                }
+        }
+
+        /*
+         * data segments
+         */
+        m->datas = NULL;
+        m->ndatas = 0;
+        ALLOC_ARRAY(m->datas, om->ndatas + ndatas);
+        m->ndatas = om->ndatas + ndatas;
+        for (i = 0; i < om->ndatas; i++) {
+                const struct data *od = &om->datas[i];
+                struct data *d = &m->datas[i];
+                *d = *od;
+                if (od->mode == DATA_MODE_ACTIVE &&
+                    od->memory < om->nimportedmems) {
+                        continue;
+                }
+                if (od->mode == DATA_MODE_ACTIVE ||
+                    bitmap_test(&inst->data_dropped, i)) {
+                        memset(d, 0, sizeof(*d));
+                        d->mode = DATA_MODE_PASSIVE;
+                }
+        }
+        struct data *d = &m->datas[om->ndatas];
+        for (i = om->nimportedmems; i < om->nimportedmems + om->nmems; i++) {
+                d += snapshot_memory(s, i, d);
+        }
+        assert(d == &m->datas[m->ndatas]);
+
+        /*
+         * element segments
+         */
+        m->elems = NULL;
+        m->nelems = 0;
+        ALLOC_ARRAY(m->elems, om->nelems + nelems);
+        m->nelems = om->nelems + nelems;
+        for (i = 0; i < om->nelems; i++) {
+                const struct element *oe = &om->elems[i];
+                struct element *e = &m->elems[i];
+                *e = *oe;
+                if (oe->mode == ELEM_MODE_ACTIVE &&
+                    oe->table < om->nimportedtables) {
+                        continue;
+                }
+                if (oe->mode == ELEM_MODE_ACTIVE ||
+                    (oe->mode == ELEM_MODE_PASSIVE &&
+                     bitmap_test(&inst->elem_dropped, i))) {
+                        e->mode = ELEM_MODE_PASSIVE;
+                        e->init_size = 0;
+                        memset(&e->offset, 0, sizeof(e->offset));
+                }
+        }
+        struct element *e = &m->elems[om->nelems];
+        for (i = om->nimportedtables; i < om->nimportedtables + om->ntables;
+             i++) {
+                uint32_t n;
+                uint32_t dummy = 0;
+                ret = snapshot_table(s, i, e, &n, &dummy);
+                if (ret != 0) {
+                        goto fail;
+                }
+                e += n;
+        }
+        assert(e == &m->elems[m->nelems]);
+        assert(s->funcs_used == s->nfuncs);
+
+        /*
+         * exports
+         */
+        if (removed_export != NULL) {
+                m->exports = NULL;
+                m->nexports = 0;
+                uint32_t j = 0;
+                for (i = 0; i < om->nexports; i++) {
+                        if (!compare_name(&om->exports[i].name,
+                                          removed_export)) {
+                                break;
+                        }
+                }
+                if (i == om->nexports) {
+                        ret = ENOENT;
+                        goto fail;
+                }
+                ALLOC_ARRAY(m->exports, om->nexports - 1);
+                m->nexports = om->nexports - 1;
+                for (i = 0; i < om->nexports; i++) {
+                        if (!compare_name(&om->exports[i].name,
+                                          removed_export)) {
+                                continue;
+                        }
+                        m->exports[j++] = om->exports[i];
+                }
+                assert(j == m->nexports);
+        }
+
+        ret = module_write(filename, m);
+fail:
+        snapshot_clear(s);
+        return ret;
+}
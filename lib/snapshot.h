@@ -0,0 +1,23 @@
+#if !defined(_TOYWASM_SNAPSHOT_H)
+#define _TOYWASM_SNAPSHOT_H
+
+#include "platform.h"
+
+__BEGIN_EXTERN_C
+
+struct instance;
+struct name;
+
+/*
+ * write a module which reproduces the current state of the instance
+ * on instantiation. see snapshot.c.
+ *
+ * if removed_export is not NULL, the export with the name is removed.
+ * (eg. the initialization function which has already been run)
+ */
+int instance_snapshot_write(const char *filename, const struct instance *inst,
+                            const struct name *removed_export);
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_SNAPSHOT_H) */
@@ -87,6 +87,9 @@ retry:
         struct timespec end;
         timespec_now(CLOCK_REALTIME, &start);
         c->suspend_state = SUSPEND_STATE_STOPPING;
+#if defined(TOYWASM_USE_FUTEX)
+        futex_waiters_kick(&c->futex);
+#endif
         while (c->nrunners != c->nparked + 1) {
                 xlog_trace("%s: waiting %" PRIu32 " / %" PRIu32, __func__,
                            c->nparked, c->nrunners);
@@ -5,6 +5,7 @@
 
 #include "mem.h"
 #include "type.h"
+#include "type_registry.h"
 #include "xlog.h"
 
 bool
@@ -348,6 +349,9 @@ functype_from_string(struct mem_context *mctx, const char *p,
         if (ret != 0) {
                 goto fail;
         }
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        functype_register(mctx, ft);
+#endif
         *resultp = ft;
         return 0;
 fail:
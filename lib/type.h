@@ -19,10 +19,15 @@
 
 /*
  * jump table. see doc/annotations.md
+ *
+ * the entries are sorted by pc. nextidx is the index of the first
+ * entry after targetpc. it's used to keep exec_context::jumpidx
+ * up to date after a jump.
  */
 struct jump {
         uint32_t pc;
         uint32_t targetpc;
+        uint32_t nextidx;
 };
 
 /*
@@ -53,6 +58,22 @@ struct expr_exec_info {
          */
         struct type_annotations type_annotations;
 #endif
+
+#if defined(TOYWASM_USE_PREDECODE)
+        /*
+         * the start of the pre-decoded code of the expr, or NULL.
+         * it points into module::predecoded.
+         */
+        const uint32_t *predecoded;
+#endif
+
+#if defined(TOYWASM_ENABLE_JIT)
+        /*
+         * the entry points of the generated code of the expr, or NULL
+         * if the expr is not compiled. see jit.c.
+         */
+        const struct jit_func *jit;
+#endif
 };
 
 /*
@@ -129,6 +150,13 @@ struct resulttype {
 struct functype {
         struct resulttype parameter;
         struct resulttype result;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        /*
+         * the canonical id of the functype. structurally equal functypes
+         * have the same id. 0 if unknown. see type_registry.c.
+         */
+        uint32_t canonid;
+#endif
 };
 
 struct funcref {
@@ -514,6 +542,37 @@ struct module {
 
         const uint8_t *bin;
 
+#if defined(TOYWASM_USE_PREDECODE)
+        /*
+         * pre-decoded code for all functions in the module.
+         * see predecode.c.
+         *
+         * pc values for the pre-decoded code are
+         * predecoded_pcbase + byte offset in the buffer.
+         * predecoded_pcbase is the size of the module binary so that
+         * the pc spaces for the original binary and the pre-decoded code
+         * don't overlap.
+         */
+        uint32_t *predecoded;
+        uint32_t npredecoded;
+        uint32_t predecoded_pcbase;
+#endif
+
+#if defined(TOYWASM_ENABLE_JIT)
+        /*
+         * the generated code for the module. see jit.c.
+         */
+        struct jit_code *jit;
+#endif
+
+#if defined(TOYWASM_ENABLE_LAZY_VALIDATION)
+        /*
+         * non-NULL if the validation of function bodies is deferred
+         * until their first calls. see lazy_validation.c.
+         */
+        struct lazy_validation *lazy;
+#endif
+
 #if defined(TOYWASM_ENABLE_WASM_NAME_SECTION)
         /*
          * Unlike other sections, we don't parse the name section
@@ -540,17 +599,76 @@ typedef int (*host_func_t)(struct exec_context *, struct host_instance *hi,
                            const struct functype *ft,
                            const struct cell *params, struct cell *results);
 
+/*
+ * typed host functions
+ *
+ * a host function with one of the following signatures can provide
+ * an additional entry point, which takes the parameters as C values
+ * and stores the result to *resultp. the interpreter calls it directly
+ * with the values on the operand stack. (host_func_call_typed)
+ *
+ * the names are in the notation of functype_from_string.
+ * eg. iIi_i is (i32, i64, i32) -> i32.
+ */
+enum host_func_sig {
+        HOST_FUNC_SIG_GENERIC = 0, /* no typed entry point */
+        HOST_FUNC_SIG_i_i,
+        HOST_FUNC_SIG_ii_i,
+        HOST_FUNC_SIG_iii_i,
+        HOST_FUNC_SIG_iiii_i,
+        HOST_FUNC_SIG_iIi_i,
+        HOST_FUNC_SIG_iIii_i,
+};
+
+typedef int host_func_i_i_t(struct exec_context *, struct host_instance *hi,
+                            uint32_t, uint32_t *resultp);
+typedef int host_func_ii_i_t(struct exec_context *, struct host_instance *hi,
+                             uint32_t, uint32_t, uint32_t *resultp);
+typedef int host_func_iii_i_t(struct exec_context *, struct host_instance *hi,
+                              uint32_t, uint32_t, uint32_t, uint32_t *resultp);
+typedef int host_func_iiii_i_t(struct exec_context *, struct host_instance *hi,
+                               uint32_t, uint32_t, uint32_t, uint32_t,
+                               uint32_t *resultp);
+typedef int host_func_iIi_i_t(struct exec_context *, struct host_instance *hi,
+                              uint32_t, uint64_t, uint32_t, uint32_t *resultp);
+typedef int host_func_iIii_i_t(struct exec_context *, struct host_instance *hi,
+                               uint32_t, uint64_t, uint32_t, uint32_t,
+                               uint32_t *resultp);
+
+union host_func_typed {
+        host_func_i_i_t *i_i;
+        host_func_ii_i_t *ii_i;
+        host_func_iii_i_t *iii_i;
+        host_func_iiii_i_t *iiii_i;
+        host_func_iIi_i_t *iIi_i;
+        host_func_iIii_i_t *iIii_i;
+};
+
 struct funcinst {
         bool is_host;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+        /* a copy of funcinst_functype(fi)->canonid */
+        uint32_t canonid;
+#endif
         union {
                 struct {
                         struct instance *instance;
                         uint32_t funcidx;
+#if defined(TOYWASM_ENABLE_INSN_STATS)
+                        /*
+                         * Note: these counters are not atomic.
+                         * they can be inaccurate with threads.
+                         */
+                        uint64_t ncalls;
+                        uint64_t ninsns; /* excluding callees */
+#endif
                 } wasm;
                 struct {
                         struct host_instance *instance;
                         const struct functype *type;
                         host_func_t func;
+                        enum host_func_sig sig;
+                        union host_func_typed typed; /* unless GENERIC */
                 } host;
         } u;
 };
@@ -570,6 +688,19 @@ struct meminst {
         size_t allocated;
         const struct memtype *type;
 
+#if defined(TOYWASM_USE_RESERVED_MEMORY)
+        /*
+         * the size of the address space reserved for the memory.
+         * non-zero if the memory is in a reserved address space.
+         * see memory_reserve.c.
+         */
+        size_t reserved;
+#endif
+#if defined(TOYWASM_USE_GUARD_PAGES)
+        /* true if the memory is protected with guard pages */
+        bool guarded;
+#endif
+
 #if defined(TOYWASM_ENABLE_WASM_THREADS)
         /*
          * extra info for shared memory instance.
@@ -597,6 +728,13 @@ struct globalinst {
 struct tableinst {
         struct cell *cells;
         uint32_t size; /* overrides type->min */
+#if TOYWASM_CALL_INDIRECT_CACHE_SIZE > 0
+        /*
+         * incremented on every modification of the table.
+         * see table_modified and get_func_indirect.
+         */
+        uint32_t gen;
+#endif
         const struct tabletype *type;
         struct mem_context *mctx;
 };
@@ -0,0 +1,301 @@
+/*
+ * a process-wide registry of functypes
+ *
+ * with TOYWASM_USE_TYPE_REGISTRY, every functype read from a module or
+ * created by functype_from_string is interned here and gets a canonical
+ * id. (functype::canonid) structurally equal functypes get the same id,
+ * regardless of which module or host module they belong to.
+ * funcinst::canonid caches the id of the function's type.
+ *
+ * it allows call_indirect to check the signature with an integer
+ * comparison instead of compare_functype. because the registry is
+ * process-wide, it works across modules as well. (eg. libdyld)
+ *
+ * the ids are reference-counted. an id is released when the last
+ * functype with it is cleared. (clear_functype)
+ *
+ * canonid 0 means "not registered". registration can fail. (eg. ENOMEM)
+ * it isn't an error because the users fall back to compare_functype.
+ *
+ * because the entries are shared among modules, they are allocated
+ * from the registry's own mem_context. in addition, every registration
+ * charges the size of the entry to the caller's mem_context so that
+ * the embedder's limit and accounting still cover it. the caller should
+ * pass the same mem_context to functype_unregister.
+ *
+ * the hash table is doubled when the average chain length exceeds
+ * TYPE_REGISTRY_LOAD_FACTOR.
+ *
+ * Note: like the rest of toywasm, the registry is protected with
+ * toywasm_mutex, which is a no-op without TOYWASM_ENABLE_WASM_THREADS.
+ * embedders which load modules on multiple host threads need to
+ * enable it.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lock.h"
+#include "mem.h"
+#include "type.h"
+#include "type_registry.h"
+#include "xlog.h"
+
+struct type_registry_entry {
+        struct type_registry_entry *next;
+        uint32_t hash;
+        uint32_t canonid;
+        uint32_t refcount;
+        uint32_t nparams;
+        uint32_t nresults;
+        enum valtype types[]; /* parameters followed by results */
+};
+
+#define TYPE_REGISTRY_MIN_NBUCKETS 64
+#define TYPE_REGISTRY_LOAD_FACTOR 2
+
+struct type_registry {
+        struct mem_context mctx;
+        bool initialized;
+        struct type_registry_entry **buckets;
+        uint32_t nbuckets; /* 0 or a power of 2 */
+        uint32_t nentries;
+        uint32_t nextid;
+};
+
+#if defined(USE_PTHREAD)
+static TOYWASM_MUTEX_DEFINE(g_type_registry_lock) = {
+        PTHREAD_MUTEX_INITIALIZER,
+};
+#endif
+static struct type_registry g_type_registry;
+
+static uint32_t
+hash_resulttype(uint32_t h, const struct resulttype *rt)
+{
+        /* FNV-1a */
+        uint32_t i;
+        h = (h ^ rt->ntypes) * 16777619;
+        for (i = 0; i < rt->ntypes; i++) {
+                h = (h ^ (uint32_t)rt->types[i]) * 16777619;
+        }
+        return h;
+}
+
+static uint32_t
+hash_functype(const struct functype *ft)
+{
+        uint32_t h = 2166136261;
+        h = hash_resulttype(h, &ft->parameter);
+        h = hash_resulttype(h, &ft->result);
+        return h;
+}
+
+static bool
+entry_matches(const struct type_registry_entry *e, uint32_t hash,
+              const struct functype *ft)
+{
+        const struct resulttype *p = &ft->parameter;
+        const struct resulttype *r = &ft->result;
+        if (e->hash != hash || e->nparams != p->ntypes ||
+            e->nresults != r->ntypes) {
+                return false;
+        }
+        if (p->ntypes > 0 &&
+            memcmp(e->types, p->types, p->ntypes * sizeof(*p->types))) {
+                return false;
+        }
+        if (r->ntypes > 0 && memcmp(&e->types[p->ntypes], r->types,
+                                    r->ntypes * sizeof(*r->types))) {
+                return false;
+        }
+        return true;
+}
+
+static size_t
+entry_size(const struct functype *ft)
+{
+        size_t ntypes = (size_t)ft->parameter.ntypes + ft->result.ntypes;
+        return sizeof(struct type_registry_entry) +
+               ntypes * sizeof(enum valtype);
+}
+
+static struct type_registry_entry **
+bucket_head(struct type_registry *reg, uint32_t hash)
+{
+        assert(reg->nbuckets > 0);
+        return &reg->buckets[hash & (reg->nbuckets - 1)];
+}
+
+/*
+ * double the hash table. on failure, keep using the current one.
+ */
+static int
+type_registry_grow(struct type_registry *reg)
+{
+        struct type_registry_entry **nbuckets;
+        uint32_t n;
+        uint32_t i;
+
+        if (reg->nbuckets == 0) {
+                n = TYPE_REGISTRY_MIN_NBUCKETS;
+        } else {
+                if (reg->nbuckets > UINT32_MAX / 2) {
+                        return EOVERFLOW;
+                }
+                n = reg->nbuckets * 2;
+        }
+        nbuckets = mem_calloc(&reg->mctx, n, sizeof(*nbuckets));
+        if (nbuckets == NULL) {
+                return ENOMEM;
+        }
+        for (i = 0; i < reg->nbuckets; i++) {
+                struct type_registry_entry *e;
+                while ((e = reg->buckets[i]) != NULL) {
+                        reg->buckets[i] = e->next;
+                        struct type_registry_entry **headp =
+                                &nbuckets[e->hash & (n - 1)];
+                        e->next = *headp;
+                        *headp = e;
+                }
+        }
+        if (reg->buckets != NULL) {
+                mem_free(&reg->mctx, reg->buckets,
+                         reg->nbuckets * sizeof(*reg->buckets));
+        }
+        reg->buckets = nbuckets;
+        reg->nbuckets = n;
+        return 0;
+}
+
+static struct type_registry_entry *
+entry_alloc(struct type_registry *reg, uint32_t hash,
+            const struct functype *ft)
+{
+        const struct resulttype *p = &ft->parameter;
+        const struct resulttype *r = &ft->result;
+        struct type_registry_entry *e;
+        e = mem_alloc(&reg->mctx, entry_size(ft));
+        if (e == NULL) {
+                return NULL;
+        }
+        e->hash = hash;
+        e->refcount = 1;
+        e->nparams = p->ntypes;
+        e->nresults = r->ntypes;
+        if (p->ntypes > 0) {
+                memcpy(e->types, p->types, p->ntypes * sizeof(*p->types));
+        }
+        if (r->ntypes > 0) {
+                memcpy(&e->types[p->ntypes], r->types,
+                       r->ntypes * sizeof(*r->types));
+        }
+        return e;
+}
+
+/*
+ * assign the canonical id to the functype.
+ */
+void
+functype_register(struct mem_context *mctx, struct functype *ft)
+{
+        struct type_registry *reg = &g_type_registry;
+        uint32_t hash = hash_functype(ft);
+        size_t sz = entry_size(ft);
+        struct type_registry_entry **headp;
+        struct type_registry_entry *e;
+
+        assert(ft->canonid == 0);
+        if (mem_reserve(mctx, sz)) {
+                xlog_trace("%s: failed to reserve memory", __func__);
+                return;
+        }
+        toywasm_mutex_lock(&g_type_registry_lock);
+        if (!reg->initialized) {
+                mem_context_init(&reg->mctx);
+                reg->nextid = 1;
+                reg->initialized = true;
+        }
+        if (reg->nbuckets > 0) {
+                headp = bucket_head(reg, hash);
+                for (e = *headp; e != NULL; e = e->next) {
+                        if (entry_matches(e, hash, ft)) {
+                                assert(e->refcount < UINT32_MAX);
+                                e->refcount++;
+                                ft->canonid = e->canonid;
+                                goto done;
+                        }
+                }
+        }
+        if (reg->nextid == 0) {
+                /* ran out of ids. */
+                xlog_trace("%s: no canonical id available", __func__);
+                goto done;
+        }
+        if (reg->nentries >= reg->nbuckets * TYPE_REGISTRY_LOAD_FACTOR) {
+                /*
+                 * a failure is fatal only for the first table.
+                 * otherwise, we just have longer chains.
+                 */
+                if (type_registry_grow(reg) != 0 && reg->nbuckets == 0) {
+                        xlog_trace("%s: failed to allocate buckets",
+                                   __func__);
+                        goto done;
+                }
+        }
+        e = entry_alloc(reg, hash, ft);
+        if (e == NULL) {
+                xlog_trace("%s: failed to allocate an entry", __func__);
+                goto done;
+        }
+        e->canonid = reg->nextid++;
+        headp = bucket_head(reg, hash);
+        e->next = *headp;
+        *headp = e;
+        reg->nentries++;
+        ft->canonid = e->canonid;
+done:
+        toywasm_mutex_unlock(&g_type_registry_lock);
+        if (ft->canonid == 0) {
+                mem_unreserve(mctx, sz);
+        }
+}
+
+/*
+ * release the canonical id of the functype, if any.
+ */
+void
+functype_unregister(struct mem_context *mctx, struct functype *ft)
+{
+        if (ft->canonid == 0) {
+                return;
+        }
+        struct type_registry *reg = &g_type_registry;
+        uint32_t hash = hash_functype(ft);
+        size_t sz = entry_size(ft);
+        struct type_registry_entry **ep;
+        struct type_registry_entry *e;
+
+        toywasm_mutex_lock(&g_type_registry_lock);
+        ep = bucket_head(reg, hash);
+        while ((e = *ep) != NULL) {
+                if (e->canonid == ft->canonid) {
+                        break;
+                }
+                ep = &e->next;
+        }
+        assert(e != NULL);
+        assert(entry_matches(e, hash, ft));
+        assert(e->refcount > 0);
+        if (--e->refcount == 0) {
+                *ep = e->next;
+                assert(reg->nentries > 0);
+                reg->nentries--;
+                mem_free(&reg->mctx, e, sz);
+        }
+        toywasm_mutex_unlock(&g_type_registry_lock);
+        mem_unreserve(mctx, sz);
+        ft->canonid = 0;
+}
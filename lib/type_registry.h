@@ -0,0 +1,14 @@
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct functype;
+struct mem_context;
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+void functype_register(struct mem_context *mctx, struct functype *ft);
+void functype_unregister(struct mem_context *mctx, struct functype *ft);
+#endif
+
+__END_EXTERN_C
@@ -9,24 +9,35 @@
  * real host thread is too expensive. in that case, it's probably better
  * to implement a bit more serious scheduler though.
  *
- * this is not efficient because of a few reasons:
+ * runnable threads are scheduled in a round-robin manner.
+ * reschedule requests are based on periodic polling. (check_interrupt)
  *
- * - sleeping threads do not yield the scheduler. there is no concept
- *   like runnable threads. all threads are equally scheduled in a
- *   round-robin manner.
+ * a thread which would block (poll_oneoff, blocking i/o, and
+ * memory.atomic.wait) registers what it waits for with sched_block
+ * and yields the cpu. blocked threads are not scheduled until:
  *
- * - reschedule requests are based on periodic polling. (check_interrupt)
- *   because of that, long sleep request is divided into small intervals
- *   so that the thread have a chances to check reschedule requests
- *   frequently enough.
+ * - the timeout passes. blocked threads with timeouts are kept in
+ *   a binary heap ordered by the timeout.
  *
- * - no real i/o wait. when a thread wants to block on an i/o event, it just
- *   yields the cpu to other threads. when the thread is scheduled next time,
- *   it simply polls the event again. an ideal scheduler implementation
- *   would have a list of event sources to poll on instead.
+ * - one of the fds it waits for becomes ready.
+ *
+ * - another thread wakes it up with sched_wakeup_wchan.
+ *   (memory.atomic.notify)
+ *
+ * when there are no runnable threads, the scheduler sleeps in a single
+ * poll(2) call on all the fds registered by the blocked threads, with
+ * the timeout of the nearest timer.
+ *
+ * Note: we use poll(2) rather than epoll. it's available on wasi as well.
+ * the fd set is rebuilt for each poll(2) call. it's fine for a small
+ * number of threads, which is the target of this scheduler.
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <string.h>
 
 #include "exec.h"
 #include "instance.h"
@@ -34,15 +45,218 @@
 #include "usched.h"
 #include "xlog.h"
 
+#define RR_INTERVAL_MS 100
+
+static bool
+timer_less(const struct exec_context *a, const struct exec_context *b)
+{
+        return timespec_cmp(&a->sched_wait.abstimeout,
+                            &b->sched_wait.abstimeout) < 0;
+}
+
+static void
+timer_set(struct sched *sched, uint32_t idx, struct exec_context *ctx)
+{
+        VEC_ELEM(sched->timers, idx) = ctx;
+        ctx->sched_wait.heapidx = idx;
+}
+
+static void
+timer_up(struct sched *sched, uint32_t idx)
+{
+        struct exec_context *ctx = VEC_ELEM(sched->timers, idx);
+        while (idx > 0) {
+                uint32_t parent = (idx - 1) / 2;
+                struct exec_context *p = VEC_ELEM(sched->timers, parent);
+                if (!timer_less(ctx, p)) {
+                        break;
+                }
+                timer_set(sched, idx, p);
+                idx = parent;
+        }
+        timer_set(sched, idx, ctx);
+}
+
+static void
+timer_down(struct sched *sched, uint32_t idx)
+{
+        const uint32_t n = sched->timers.lsize;
+        struct exec_context *ctx = VEC_ELEM(sched->timers, idx);
+        while (true) {
+                uint32_t child = idx * 2 + 1;
+                if (child >= n) {
+                        break;
+                }
+                if (child + 1 < n &&
+                    timer_less(VEC_ELEM(sched->timers, child + 1),
+                               VEC_ELEM(sched->timers, child))) {
+                        child++;
+                }
+                struct exec_context *c = VEC_ELEM(sched->timers, child);
+                if (!timer_less(c, ctx)) {
+                        break;
+                }
+                timer_set(sched, idx, c);
+                idx = child;
+        }
+        timer_set(sched, idx, ctx);
+}
+
+static void
+timer_remove(struct sched *sched, struct exec_context *ctx)
+{
+        uint32_t idx = ctx->sched_wait.heapidx;
+        assert(idx < sched->timers.lsize);
+        assert(VEC_ELEM(sched->timers, idx) == ctx);
+        struct exec_context *last = *VEC_POP(sched->timers);
+        if (last == ctx) {
+                return;
+        }
+        timer_set(sched, idx, last);
+        timer_up(sched, idx);
+        timer_down(sched, last->sched_wait.heapidx);
+}
+
+static struct exec_context *
+timer_first(struct sched *sched)
+{
+        if (sched->timers.lsize == 0) {
+                return NULL;
+        }
+        return VEC_ELEM(sched->timers, 0);
+}
+
+static void
+make_runnable(struct sched *sched, struct exec_context *ctx,
+              enum sched_wakeup reason)
+{
+        struct sched_wait *w = &ctx->sched_wait;
+        assert(w->blocked);
+        xlog_trace("%s: waking up ctx %p reason %u", __func__, (void *)ctx,
+                   (unsigned int)reason);
+        LIST_REMOVE(&sched->waitq, ctx, rq);
+        if (w->has_timeout) {
+                timer_remove(sched, ctx);
+        }
+        assert(sched->nblocked > 0);
+        sched->nblocked--;
+        assert(sched->nfds >= w->fds.lsize);
+        sched->nfds -= w->fds.lsize;
+        w->blocked = false;
+        w->wakeup = reason;
+        LIST_INSERT_TAIL(&sched->runq, ctx, rq);
+}
+
 void
 sched_enqueue(struct sched *sched, struct exec_context *ctx)
 {
-        xlog_trace("%s: enqueueing ctx %p", __func__, (void *)ctx);
         assert(sched == ctx->sched);
+        struct sched_wait *w = &ctx->sched_wait;
+        if (w->blocked) {
+                xlog_trace("%s: blocking ctx %p", __func__, (void *)ctx);
+                LIST_INSERT_TAIL(&sched->waitq, ctx, rq);
+                sched->nblocked++;
+                sched->nfds += w->fds.lsize;
+                if (w->has_timeout) {
+                        *VEC_PUSH(sched->timers) = ctx;
+                        timer_up(sched, sched->timers.lsize - 1);
+                }
+                return;
+        }
+        xlog_trace("%s: enqueueing ctx %p", __func__, (void *)ctx);
         LIST_INSERT_TAIL(&sched->runq, ctx, rq);
 }
 
-#define RR_INTERVAL_MS 100
+/*
+ * check the events the blocked contexts are waiting for and make them
+ * runnable as necessary.
+ * if block is true, sleep until at least one of them becomes runnable.
+ */
+static void
+sched_poll(struct sched *sched, bool block)
+{
+        struct exec_context *ctx;
+        struct exec_context *next;
+        struct pollfd *pfd;
+        int timeout_ms = 0;
+        int ret;
+
+        assert(sched->nblocked > 0);
+        if (block) {
+                ctx = timer_first(sched);
+                if (ctx == NULL) {
+                        timeout_ms = -1;
+                } else {
+                        ret = abstime_to_reltime_ms_roundup(
+                                CLOCK_REALTIME, &ctx->sched_wait.abstimeout,
+                                &timeout_ms);
+                        if (ret != 0) {
+                                xlog_error("%s: "
+                                           "abstime_to_reltime_ms_roundup "
+                                           "failed with %d",
+                                           __func__, ret);
+                                timeout_ms = RR_INTERVAL_MS;
+                        }
+                }
+        }
+        /* the array was sized by sched_block */
+        assert(sched->pollfds.psize >= sched->nfds);
+        pfd = sched->pollfds.p;
+        LIST_FOREACH(ctx, &sched->waitq, rq) {
+                const struct pollfd *fd;
+                VEC_FOREACH(fd, ctx->sched_wait.fds) {
+                        *pfd++ = *fd;
+                }
+        }
+        assert(pfd == sched->pollfds.p + sched->nfds);
+        xlog_trace("%s: polling %" PRIu32 " fds timeout %d ms", __func__,
+                   sched->nfds, timeout_ms);
+        ret = poll(sched->pollfds.p, sched->nfds, timeout_ms);
+        if (ret < 0) {
+                ret = errno;
+                if (ret != EINTR) {
+                        xlog_error("%s: poll failed with %d", __func__, ret);
+                }
+                /*
+                 * let the blocked contexts retry. they will see the error
+                 * or the interrupt by themselves.
+                 */
+                sched_wakeup_all(sched);
+                return;
+        }
+        if (ret > 0) {
+                pfd = sched->pollfds.p;
+                for (ctx = LIST_FIRST(&sched->waitq); ctx != NULL;
+                     ctx = next) {
+                        const uint32_t nfds = ctx->sched_wait.fds.lsize;
+                        bool ready = false;
+                        uint32_t i;
+                        next = LIST_NEXT(ctx, rq);
+                        for (i = 0; i < nfds; i++) {
+                                if (pfd[i].revents != 0) {
+                                        ready = true;
+                                }
+                        }
+                        pfd += nfds;
+                        if (ready) {
+                                make_runnable(sched, ctx, SCHED_WAKEUP_EVENT);
+                        }
+                }
+        }
+        if (timer_first(sched) != NULL) {
+                struct timespec now;
+                ret = timespec_now(CLOCK_REALTIME, &now);
+                if (ret != 0) {
+                        xlog_error("%s: timespec_now failed with %d",
+                                   __func__, ret);
+                        return;
+                }
+                while ((ctx = timer_first(sched)) != NULL &&
+                       timespec_cmp(&ctx->sched_wait.abstimeout, &now) <= 0) {
+                        make_runnable(sched, ctx, SCHED_WAKEUP_TIMEOUT);
+                }
+        }
+}
 
 void
 sched_run(struct sched *sched, struct exec_context *caller)
@@ -50,7 +264,21 @@ sched_run(struct sched *sched, struct exec_context *caller)
         struct runq *q = &sched->runq;
         struct exec_context *ctx;
 
-        while ((ctx = LIST_FIRST(q)) != NULL) {
+        while (true) {
+                if (sched->nblocked > 0) {
+                        /*
+                         * pick up the blocked contexts which became
+                         * runnable. sleep if nothing else to run.
+                         */
+                        sched_poll(sched, LIST_EMPTY(q));
+                }
+                ctx = LIST_FIRST(q);
+                if (ctx == NULL) {
+                        if (sched->nblocked > 0) {
+                                continue;
+                        }
+                        break;
+                }
                 int ret;
                 LIST_REMOVE(q, ctx, rq);
                 xlog_trace("%s: running ctx %p", __func__, (void *)ctx);
@@ -71,9 +299,10 @@ sched_run(struct sched *sched, struct exec_context *caller)
                 if (IS_RESTARTABLE(ret) && ret != ETOYWASMUSERINTERRUPT) {
                         xlog_trace("%s: re-enqueueing ctx %p", __func__,
                                    (void *)ctx);
-                        LIST_INSERT_TAIL(q, ctx, rq);
+                        sched_enqueue(sched, ctx);
                         continue;
                 }
+                assert(!ctx->sched_wait.blocked);
                 xlog_trace("%s: finishing ctx %p", __func__, (void *)ctx);
                 ctx->exec_ret = ret;
                 if (ctx == caller) {
@@ -85,14 +314,23 @@ sched_run(struct sched *sched, struct exec_context *caller)
 }
 
 void
-sched_init(struct sched *sched)
+sched_init(struct sched *sched, struct mem_context *mctx)
 {
         LIST_HEAD_INIT(&sched->runq);
+        LIST_HEAD_INIT(&sched->waitq);
+        sched->nblocked = 0;
+        sched->nfds = 0;
+        VEC_INIT(sched->timers);
+        VEC_INIT(sched->pollfds);
+        sched->mctx = mctx;
 }
 
 void
 sched_clear(struct sched *sched)
 {
+        assert(sched->nblocked == 0);
+        VEC_FREE(sched->mctx, sched->timers);
+        VEC_FREE(sched->mctx, sched->pollfds);
 }
 
 bool
@@ -102,7 +340,7 @@ sched_need_resched(struct sched *sched)
         int ret;
 
         /* if we are the only thread, no point to resched. */
-        if (LIST_FIRST(&sched->runq) == NULL) {
+        if (LIST_FIRST(&sched->runq) == NULL && sched->nblocked == 0) {
                 return false;
         }
 
@@ -118,8 +356,97 @@ sched_need_resched(struct sched *sched)
                 xlog_error("%s: timespec_now failed with %d", __func__, ret);
                 return true;
         }
-        if (timespec_cmp(&sched->next_resched, &now) <= 0) {
-                return true;
+        if (timespec_cmp(&sched->next_resched, &now) > 0) {
+                return false;
+        }
+        if (LIST_FIRST(&sched->runq) == NULL) {
+                /*
+                 * only blocked threads. check if any of them became
+                 * runnable. if not, keep running until the next slice.
+                 */
+                sched_poll(sched, false);
+                if (LIST_FIRST(&sched->runq) == NULL) {
+                        ret = abstime_from_reltime_ms(CLOCK_MONOTONIC,
+                                                      &sched->next_resched,
+                                                      RR_INTERVAL_MS);
+                        if (ret != 0) {
+                                xlog_error("%s: abstime_from_reltime_ms "
+                                           "failed with %d",
+                                           __func__, ret);
+                        }
+                        return false;
+                }
+        }
+        return true;
+}
+
+int
+sched_block(struct sched *sched, struct exec_context *ctx,
+            const struct pollfd *fds, uint32_t nfds,
+            const struct timespec *abstimeout, const void *wchan)
+{
+        struct sched_wait *w = &ctx->sched_wait;
+        int ret;
+
+        assert(sched == ctx->sched);
+        assert(!w->blocked);
+        /*
+         * allocate everything we need here so that sched_enqueue and
+         * sched_poll never fail.
+         */
+        ret = VEC_RESIZE(ctx->mctx, w->fds, nfds);
+        if (ret != 0) {
+                return ret;
+        }
+        ret = VEC_PREALLOC(sched->mctx, sched->pollfds, sched->nfds + nfds);
+        if (ret != 0) {
+                return ret;
+        }
+        if (abstimeout != NULL) {
+                ret = VEC_PREALLOC(sched->mctx, sched->timers, 1);
+                if (ret != 0) {
+                        return ret;
+                }
+                w->abstimeout = *abstimeout;
+        }
+        uint32_t i;
+        for (i = 0; i < nfds; i++) {
+                VEC_ELEM(w->fds, i) = fds[i];
+                VEC_ELEM(w->fds, i).revents = 0;
+        }
+        w->has_timeout = abstimeout != NULL;
+        w->wchan = wchan;
+        w->wakeup = SCHED_WAKEUP_NONE;
+        w->blocked = true;
+        xlog_trace("%s: ctx %p nfds %" PRIu32 " timeout %u wchan %p",
+                   __func__, (void *)ctx, nfds, (unsigned int)w->has_timeout,
+                   wchan);
+        return 0;
+}
+
+uint32_t
+sched_wakeup_wchan(struct sched *sched, const void *wchan, uint32_t count)
+{
+        struct exec_context *ctx;
+        struct exec_context *next;
+        uint32_t n = 0;
+
+        for (ctx = LIST_FIRST(&sched->waitq); ctx != NULL && n < count;
+             ctx = next) {
+                next = LIST_NEXT(ctx, rq);
+                if (ctx->sched_wait.wchan == wchan) {
+                        make_runnable(sched, ctx, SCHED_WAKEUP_EVENT);
+                        n++;
+                }
+        }
+        return n;
+}
+
+void
+sched_wakeup_all(struct sched *sched)
+{
+        struct exec_context *ctx;
+        while ((ctx = LIST_FIRST(&sched->waitq)) != NULL) {
+                make_runnable(sched, ctx, SCHED_WAKEUP_NONE);
         }
-        return false;
 }
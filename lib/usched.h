@@ -1,22 +1,98 @@
+#if !defined(_TOYWASM_USCHED_H)
+#define _TOYWASM_USCHED_H
+
+#include <poll.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "list.h"
 #include "platform.h"
+#include "vec.h"
 
 struct exec_context;
+struct mem_context;
+
+enum sched_wakeup {
+        SCHED_WAKEUP_NONE,
+        SCHED_WAKEUP_EVENT,   /* fd readiness or sched_wakeup_wchan */
+        SCHED_WAKEUP_TIMEOUT, /* abstimeout passed */
+};
+
+/*
+ * per exec_context state of a blocking wait. (exec_context::sched_wait)
+ */
+struct sched_wait {
+        bool blocked;
+        bool has_timeout;
+        struct timespec abstimeout; /* CLOCK_REALTIME */
+        const void *wchan;          /* for sched_wakeup_wchan */
+        VEC(, struct pollfd) fds;
+
+        /* the index in sched::timers */
+        uint32_t heapidx;
+
+        /* why the last wait ended. consumed by the blocking code. */
+        enum sched_wakeup wakeup;
+};
 
 struct sched {
         LIST_HEAD_NAMED(struct exec_context, runq) runq;
+
+        /* blocked contexts, including the ones in timers */
+        LIST_HEAD_NAMED(struct exec_context, sched_waitq) waitq;
+        uint32_t nblocked;
+        uint32_t nfds; /* the sum of sched_wait::fds of blocked contexts */
+
+        /* a binary heap of blocked contexts ordered by abstimeout */
+        VEC(, struct exec_context *) timers;
+
+        /* the array passed to poll(2) */
+        VEC(, struct pollfd) pollfds;
+
         struct timespec next_resched;
+        struct mem_context *mctx;
 };
 
 __BEGIN_EXTERN_C
 
 void sched_enqueue(struct sched *sched, struct exec_context *ctx);
-void sched_run(struct sched *sched, struct exec_context *ctx);
-void sched_init(struct sched *sched);
+void sched_run(struct sched *sched, struct exec_context *caller);
+void sched_init(struct sched *sched, struct mem_context *mctx);
 void sched_clear(struct sched *sched);
 bool sched_need_resched(struct sched *sched);
 
+/*
+ * sched_block: make the running context wait for an event.
+ *
+ * the context is not scheduled until one of the following happens:
+ *
+ * - one of fds becomes ready. (POLLIN/POLLOUT)
+ * - abstimeout (CLOCK_REALTIME) passes if it's not NULL.
+ * - sched_wakeup_wchan is called for wchan if it's not NULL.
+ * - sched_wakeup_all is called.
+ *
+ * the caller should return ETOYWASMRESTART after a successful call
+ * of this function. the blocking operation is retried when the context
+ * is scheduled again. sched_wait::wakeup tells the reason of the wakeup.
+ */
+int sched_block(struct sched *sched, struct exec_context *ctx,
+                const struct pollfd *fds, uint32_t nfds,
+                const struct timespec *abstimeout, const void *wchan);
+
+/*
+ * wake up at most count contexts blocked on the wchan.
+ * returns the number of contexts woken.
+ */
+uint32_t sched_wakeup_wchan(struct sched *sched, const void *wchan,
+                            uint32_t count);
+
+/*
+ * wake up all blocked contexts.
+ * eg. to let them notice an interrupt. (cluster_set_interrupt)
+ */
+void sched_wakeup_all(struct sched *sched);
+
 __END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_USCHED_H) */
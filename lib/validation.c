@@ -216,6 +216,7 @@ push_ctrlframe(uint32_t pc, enum ctrlframe_op op, uint32_t jumpslot,
                 ei->njumps += nslots;
                 ei->jumps[jumpslot].pc = pc;
                 ei->jumps[jumpslot].targetpc = 0;
+                ei->jumps[jumpslot].nextidx = 0;
                 if (nslots == 2) {
                         /*
                          * the slot for "if -> else".
@@ -224,6 +225,7 @@ push_ctrlframe(uint32_t pc, enum ctrlframe_op op, uint32_t jumpslot,
                          */
                         ei->jumps[jumpslot + 1].pc = pc + 1;
                         ei->jumps[jumpslot + 1].targetpc = 0;
+                        ei->jumps[jumpslot + 1].nextidx = 0;
                 }
         }
         cframe = VEC_PUSH(ctx->cframes);
@@ -271,6 +273,11 @@ pop_ctrlframe(uint32_t pc, bool is_else, struct ctrlframe *cframep,
                 } else {
                         jump->targetpc = pc;
                 }
+                /*
+                 * all the blocks before the target have their
+                 * entries by now.
+                 */
+                jump->nextidx = ctx->ei->njumps;
         }
         ret = pop_valtypes(cframe->end_types, ctx);
         if (ret != 0) {
@@ -0,0 +1,441 @@
+/*
+ * a multi-threaded work-stealing scheduler
+ *
+ * unlike usched.c, which multiplexes the threads of a wasi-threads
+ * process on a single host thread, this scheduler runs many independent
+ * exec_contexts (eg. one per instance) on a pool of host threads.
+ * it's an M:N scheduler for embedders which have many more concurrent
+ * wasm executions than cpus.
+ *
+ * - each worker thread has its own run queue. a worker takes tasks
+ *   from the head of its own queue. when it's empty, the worker steals
+ *   a task from the tail of another worker's queue.
+ *
+ * - a task runs until it returns a restartable error. (ETOYWASMRESTART,
+ *   which is what the interpreter returns from its suspension points)
+ *   then the task is put back to the tail of the run queue of the worker.
+ *
+ * - to preempt long-running tasks, a ticker thread sets the preemption
+ *   flag (exec_context::preempt) of all workers every WSCHED_SLICE_MS
+ *   if there are tasks waiting in run queues. check_interrupt notices
+ *   the flag and returns ETOYWASMRESTART.
+ *
+ * - idle workers sleep on a condition variable.
+ *
+ * limitations:
+ *
+ * - blocking host functions (eg. wasi poll_oneoff) block the worker
+ *   thread. there is no i/o integration.
+ *
+ * - ETOYWASMUSERINTERRUPT is not handled by the scheduler. the task
+ *   finishes with it.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "exec_context.h"
+#include "instance.h"
+#include "mem.h"
+#include "nbio.h"
+#include "timeutil.h"
+#include "wsched.h"
+#include "xlog.h"
+
+struct wsched_worker {
+        struct wsched *s;
+        unsigned int idx;
+        pthread_t thread;
+
+        pthread_mutex_t lock;
+        LIST_HEAD(struct wsched_task) runq;
+        atomic_uint nqueued; /* the length of runq */
+
+        atomic_uint preempt;
+
+        /* only updated by the worker itself */
+        struct wsched_stats stats;
+};
+
+struct wsched {
+        struct mem_context *mctx;
+        unsigned int nworkers;
+        struct wsched_worker *workers;
+
+        /* the number of tasks in all run queues */
+        atomic_uint nqueued;
+        /* the number of workers sleeping or about to sleep on cv */
+        atomic_uint nidle;
+        /* for round-robin wsched_submit from non-worker threads */
+        atomic_uint next_worker;
+
+        pthread_mutex_t lock;
+        pthread_cond_t cv;      /* idle workers */
+        pthread_cond_t done_cv; /* wsched_wait */
+        pthread_cond_t tick_cv; /* the ticker */
+        uint64_t npending;      /* submitted and not finished yet */
+        bool stopping;
+        pthread_t ticker;
+        unsigned int nthreads; /* started workers */
+        bool ticker_started;
+        uint64_t npreempt;
+};
+
+static _Thread_local struct wsched_worker *wsched_current_worker;
+
+static void
+wakeup_idle(struct wsched *s)
+{
+        if (atomic_load(&s->nidle) > 0) {
+                pthread_mutex_lock(&s->lock);
+                pthread_cond_signal(&s->cv);
+                pthread_mutex_unlock(&s->lock);
+        }
+}
+
+static void
+enqueue(struct wsched_worker *w, struct wsched_task *task)
+{
+        pthread_mutex_lock(&w->lock);
+        LIST_INSERT_TAIL(&w->runq, task, q);
+        atomic_fetch_add(&w->nqueued, 1);
+        pthread_mutex_unlock(&w->lock);
+        atomic_fetch_add(&w->s->nqueued, 1);
+        wakeup_idle(w->s);
+}
+
+static struct wsched_task *
+dequeue_head(struct wsched_worker *w)
+{
+        struct wsched_task *task;
+        pthread_mutex_lock(&w->lock);
+        task = LIST_FIRST(&w->runq);
+        if (task != NULL) {
+                LIST_REMOVE(&w->runq, task, q);
+                atomic_fetch_sub(&w->nqueued, 1);
+        }
+        pthread_mutex_unlock(&w->lock);
+        if (task != NULL) {
+                atomic_fetch_sub(&w->s->nqueued, 1);
+        }
+        return task;
+}
+
+static struct wsched_task *
+dequeue_tail(struct wsched_worker *w)
+{
+        struct wsched_task *task;
+        /* avoid contending on the lock of an empty queue */
+        if (atomic_load(&w->nqueued) == 0) {
+                return NULL;
+        }
+        pthread_mutex_lock(&w->lock);
+        task = LIST_LAST(&w->runq, struct wsched_task, q);
+        if (task != NULL) {
+                LIST_REMOVE(&w->runq, task, q);
+                atomic_fetch_sub(&w->nqueued, 1);
+        }
+        pthread_mutex_unlock(&w->lock);
+        if (task != NULL) {
+                atomic_fetch_sub(&w->s->nqueued, 1);
+        }
+        return task;
+}
+
+static struct wsched_task *
+steal(struct wsched_worker *w)
+{
+        struct wsched *s = w->s;
+        unsigned int i;
+        for (i = 1; i < s->nworkers; i++) {
+                struct wsched_worker *victim =
+                        &s->workers[(w->idx + i) % s->nworkers];
+                struct wsched_task *task = dequeue_tail(victim);
+                if (task != NULL) {
+                        w->stats.nsteal++;
+                        return task;
+                }
+        }
+        return NULL;
+}
+
+/*
+ * returns false when the scheduler is stopping and there is
+ * no work left.
+ */
+static bool
+wait_for_work(struct wsched *s)
+{
+        bool cont = true;
+        pthread_mutex_lock(&s->lock);
+        atomic_fetch_add(&s->nidle, 1);
+        while (atomic_load(&s->nqueued) == 0) {
+                if (s->stopping) {
+                        cont = false;
+                        break;
+                }
+                pthread_cond_wait(&s->cv, &s->lock);
+        }
+        atomic_fetch_sub(&s->nidle, 1);
+        pthread_mutex_unlock(&s->lock);
+        return cont;
+}
+
+static void
+run_task(struct wsched_worker *w, struct wsched_task *task)
+{
+        struct wsched *s = w->s;
+        struct exec_context *ctx = task->ctx;
+        int ret;
+
+        atomic_store(&w->preempt, 0);
+        ctx->preempt = &w->preempt;
+        w->stats.nslice++;
+        ret = instance_execute_handle_restart_once(ctx, task->ret);
+        ctx->preempt = NULL;
+        if (IS_RESTARTABLE(ret) && ret != ETOYWASMUSERINTERRUPT) {
+                w->stats.nyield++;
+                task->ret = ret;
+                enqueue(w, task);
+                return;
+        }
+        w->stats.ndone++;
+        /* Note: the callback might free or resubmit the task */
+        task->done(task, ret);
+        pthread_mutex_lock(&s->lock);
+        assert(s->npending > 0);
+        s->npending--;
+        if (s->npending == 0) {
+                pthread_cond_broadcast(&s->done_cv);
+        }
+        pthread_mutex_unlock(&s->lock);
+}
+
+static void *
+worker_main(void *vp)
+{
+        struct wsched_worker *w = vp;
+        struct wsched *s = w->s;
+
+        wsched_current_worker = w;
+        while (true) {
+                struct wsched_task *task = dequeue_head(w);
+                if (task == NULL) {
+                        task = steal(w);
+                }
+                if (task == NULL) {
+                        if (!wait_for_work(s)) {
+                                break;
+                        }
+                        continue;
+                }
+                run_task(w, task);
+        }
+        wsched_current_worker = NULL;
+        return NULL;
+}
+
+static void *
+ticker_main(void *vp)
+{
+        struct wsched *s = vp;
+        struct timespec abstime;
+
+        pthread_mutex_lock(&s->lock);
+        while (!s->stopping) {
+                if (abstime_from_reltime_ms(CLOCK_REALTIME, &abstime,
+                                            WSCHED_SLICE_MS) != 0) {
+                        break;
+                }
+                pthread_cond_timedwait(&s->tick_cv, &s->lock, &abstime);
+                if (atomic_load(&s->nqueued) == 0) {
+                        continue;
+                }
+                unsigned int i;
+                for (i = 0; i < s->nworkers; i++) {
+                        atomic_store(&s->workers[i].preempt, 1);
+                }
+                s->npreempt++;
+        }
+        pthread_mutex_unlock(&s->lock);
+        return NULL;
+}
+
+static void
+stop(struct wsched *s)
+{
+        unsigned int i;
+
+        pthread_mutex_lock(&s->lock);
+        s->stopping = true;
+        pthread_cond_broadcast(&s->cv);
+        pthread_cond_signal(&s->tick_cv);
+        pthread_mutex_unlock(&s->lock);
+        for (i = 0; i < s->nthreads; i++) {
+                pthread_join(s->workers[i].thread, NULL);
+        }
+        if (s->ticker_started) {
+                pthread_join(s->ticker, NULL);
+        }
+}
+
+int
+wsched_create(struct mem_context *mctx, unsigned int nworkers,
+              struct wsched **sp)
+{
+        struct wsched *s;
+        unsigned int i;
+        int ret;
+
+        if (nworkers == 0) {
+                return EINVAL;
+        }
+        s = mem_zalloc(mctx, sizeof(*s));
+        if (s == NULL) {
+                return ENOMEM;
+        }
+        s->workers = mem_calloc(mctx, nworkers, sizeof(*s->workers));
+        if (s->workers == NULL) {
+                mem_free(mctx, s, sizeof(*s));
+                return ENOMEM;
+        }
+        s->mctx = mctx;
+        s->nworkers = nworkers;
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->cv, NULL);
+        pthread_cond_init(&s->done_cv, NULL);
+        pthread_cond_init(&s->tick_cv, NULL);
+        for (i = 0; i < nworkers; i++) {
+                struct wsched_worker *w = &s->workers[i];
+                w->s = s;
+                w->idx = i;
+                pthread_mutex_init(&w->lock, NULL);
+                LIST_HEAD_INIT(&w->runq);
+        }
+        for (i = 0; i < nworkers; i++) {
+                struct wsched_worker *w = &s->workers[i];
+                ret = pthread_create(&w->thread, NULL, worker_main, w);
+                if (ret != 0) {
+                        xlog_trace("pthread_create failed with %d", ret);
+                        goto fail;
+                }
+                s->nthreads++;
+        }
+        ret = pthread_create(&s->ticker, NULL, ticker_main, s);
+        if (ret != 0) {
+                xlog_trace("pthread_create failed with %d", ret);
+                goto fail;
+        }
+        s->ticker_started = true;
+        *sp = s;
+        return 0;
+fail:
+        s->npending = 0;
+        wsched_destroy(s);
+        return ret;
+}
+
+void
+wsched_destroy(struct wsched *s)
+{
+        struct mem_context *mctx = s->mctx;
+        unsigned int i;
+
+        wsched_wait(s);
+        stop(s);
+        for (i = 0; i < s->nworkers; i++) {
+                struct wsched_worker *w = &s->workers[i];
+                assert(LIST_EMPTY(&w->runq));
+                pthread_mutex_destroy(&w->lock);
+        }
+        pthread_cond_destroy(&s->tick_cv);
+        pthread_cond_destroy(&s->done_cv);
+        pthread_cond_destroy(&s->cv);
+        pthread_mutex_destroy(&s->lock);
+        mem_free(mctx, s->workers, s->nworkers * sizeof(*s->workers));
+        mem_free(mctx, s, sizeof(*s));
+}
+
+int
+wsched_submit(struct wsched *s, struct wsched_task *task, uint32_t funcidx)
+{
+        struct exec_context *ctx = task->ctx;
+        struct wsched_worker *w;
+        int ret;
+
+        /* this only sets up the call. the execution starts on a worker. */
+        ret = instance_execute_func_nocheck(ctx, funcidx);
+        if (!IS_RESTARTABLE(ret)) {
+                assert(ret != 0);
+                return ret;
+        }
+        task->ret = ret;
+        pthread_mutex_lock(&s->lock);
+        s->npending++;
+        pthread_mutex_unlock(&s->lock);
+        w = wsched_current_worker;
+        if (w == NULL || w->s != s) {
+                unsigned int idx = atomic_fetch_add(&s->next_worker, 1);
+                w = &s->workers[idx % s->nworkers];
+        }
+        enqueue(w, task);
+        return 0;
+}
+
+void
+wsched_wait(struct wsched *s)
+{
+        pthread_mutex_lock(&s->lock);
+        while (s->npending > 0) {
+                pthread_cond_wait(&s->done_cv, &s->lock);
+        }
+        pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * Note: the statistics are updated by the workers without locks.
+ * the result is accurate only when no tasks are running.
+ * (eg. after wsched_wait)
+ */
+void
+wsched_get_stats(struct wsched *s, struct wsched_stats *stats)
+{
+        unsigned int i;
+
+        memset(stats, 0, sizeof(*stats));
+        for (i = 0; i < s->nworkers; i++) {
+                const struct wsched_stats *ws = &s->workers[i].stats;
+                stats->nslice += ws->nslice;
+                stats->nyield += ws->nyield;
+                stats->nsteal += ws->nsteal;
+                stats->ndone += ws->ndone;
+        }
+        pthread_mutex_lock(&s->lock);
+        stats->npreempt = s->npreempt;
+        pthread_mutex_unlock(&s->lock);
+}
+
+void
+wsched_print_stats(struct wsched *s)
+{
+        struct wsched_stats st;
+        unsigned int i;
+
+        wsched_get_stats(s, &st);
+        nbio_printf("=== wsched statistics ===\n");
+        nbio_printf("workers %u\n", s->nworkers);
+        nbio_printf("done %" PRIu64 " slices %" PRIu64 " yields %" PRIu64
+                    " preemption requests %" PRIu64 " steals %" PRIu64 "\n",
+                    st.ndone, st.nslice, st.nyield, st.npreempt, st.nsteal);
+        for (i = 0; i < s->nworkers; i++) {
+                const struct wsched_stats *ws = &s->workers[i].stats;
+                nbio_printf("worker %u: done %" PRIu64 " slices %" PRIu64
+                            " steals %" PRIu64 "\n",
+                            i, ws->ndone, ws->nslice, ws->nsteal);
+        }
+}
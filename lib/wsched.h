@@ -0,0 +1,85 @@
+#if !defined(_TOYWASM_WSCHED_H)
+#define _TOYWASM_WSCHED_H
+
+#include <stdint.h>
+
+#include "list.h"
+#include "platform.h"
+#include "toywasm_config.h"
+
+struct exec_context;
+struct mem_context;
+struct wsched;
+
+/* the time slice for preemption */
+#define WSCHED_SLICE_MS 10
+
+/*
+ * a unit of work for wsched: a call of a wasm function in an
+ * exec_context.
+ */
+struct wsched_task {
+        struct exec_context *ctx;
+
+        /*
+         * called on a worker thread when the call has finished.
+         * ret is the result of the execution.
+         * (0, ETOYWASMTRAP, ETOYWASMUSERINTERRUPT, ...)
+         * on success, the results of the function are on the stack of
+         * ctx. (exec_pop_vals)
+         * the callback can submit another task, including this one.
+         */
+        void (*done)(struct wsched_task *task, int ret);
+        void *user;
+
+        /* private */
+        int ret;
+        LIST_ENTRY(struct wsched_task) q;
+};
+
+struct wsched_stats {
+        uint64_t nslice;   /* instance_execute_continue calls */
+        uint64_t nyield;   /* slices which ended with a restartable error */
+        uint64_t npreempt; /* preemption requests */
+        uint64_t nsteal;   /* tasks stolen from other workers */
+        uint64_t ndone;    /* finished tasks */
+};
+
+__BEGIN_EXTERN_C
+
+#if defined(TOYWASM_ENABLE_WSCHED)
+/*
+ * create a scheduler with nworkers host threads.
+ * see wsched.c.
+ */
+int wsched_create(struct mem_context *mctx, unsigned int nworkers,
+                  struct wsched **sp);
+
+/*
+ * wait for the submitted tasks to finish and destroy the scheduler.
+ */
+void wsched_destroy(struct wsched *s);
+
+/*
+ * start a call of the function in task->ctx.
+ * the parameters of the function should have been pushed to the
+ * stack of the exec_context. (exec_push_vals)
+ *
+ * on success, task->done is called later on a worker thread.
+ * on an error, this function returns it without calling task->done.
+ */
+int wsched_submit(struct wsched *s, struct wsched_task *task,
+                  uint32_t funcidx);
+
+/*
+ * wait until all the submitted tasks finish.
+ */
+void wsched_wait(struct wsched *s);
+
+void wsched_get_stats(struct wsched *s, struct wsched_stats *stats);
+void wsched_print_stats(struct wsched *s);
+#endif
+
+__END_EXTERN_C
+
+#endif /* !defined(_TOYWASM_WSCHED_H) */
@@ -460,6 +460,9 @@ dyld_create_got(struct dyld *d, struct dyld_object *obj)
                         fi->u.host.instance = (void *)plt;
                         fi->u.host.type = &m->types[im->desc.u.typeidx];
                         fi->u.host.func = dyld_plt;
+#if defined(TOYWASM_USE_TYPE_REGISTRY)
+                        fi->canonid = fi->u.host.type->canonid;
+#endif
 
                         e->module_name = &im->module_name;
                         e->name = &im->name;
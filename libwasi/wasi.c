@@ -43,6 +43,7 @@
 
 #define WASI_API(a, b) WASI_HOST_FUNC(a, b),
 #define WASI_API2(a, b, c) WASI_HOST_FUNC2(a, b, c),
+#define WASI_API_TYPED(a, s, b) WASI_HOST_FUNC_TYPED(a, s, b),
 const struct host_func wasi_funcs[] = {
 #include "wasi_preview1.h"
 };
@@ -63,6 +64,7 @@ const struct host_func wasi_unstable_funcs[] = {
 };
 #undef WASI_API
 #undef WASI_API2
+#undef WASI_API_TYPED
 
 int
 wasi_instance_add_hostfd(struct wasi_instance *inst, uint32_t wasmfd,
@@ -48,18 +48,13 @@ fail:
 }
 
 int
-wasi_clock_time_get(struct exec_context *ctx, struct host_instance *hi,
-                    const struct functype *ft, const struct cell *params,
-                    struct cell *results)
+wasi_clock_time_get_typed(struct exec_context *ctx, struct host_instance *hi,
+                          uint32_t clockid, uint64_t precision, uint32_t retp,
+                          uint32_t *resultp)
 {
-        WASI_TRACE;
+        WASI_TYPED_TRACE;
         struct wasi_instance *wasi = (void *)hi;
-        HOST_FUNC_CONVERT_PARAMS(ft, params);
-        uint32_t clockid = HOST_FUNC_PARAM(ft, params, 0, i32);
-#if 0 /* REVISIT what to do with the precision? */
-        uint64_t precision = HOST_FUNC_PARAM(ft, params, 1, i64);
-#endif
-        uint32_t retp = HOST_FUNC_PARAM(ft, params, 2, i32);
+        /* REVISIT what to do with the precision? */
         clockid_t hostclockid;
         int host_ret = 0;
         int ret;
@@ -79,9 +74,9 @@ wasi_clock_time_get(struct exec_context *ctx, struct host_instance *hi,
                                 sizeof(result), WASI_U64_ALIGN);
 fail:
         if (host_ret == 0) {
-                HOST_FUNC_RESULT_SET(ft, results, 0, i32,
-                                     wasi_convert_errno(ret));
+                *resultp = wasi_convert_errno(ret);
         }
-        HOST_FUNC_FREE_CONVERTED_PARAMS();
         return host_ret;
 }
+
+HOST_FUNC_TYPED_WRAPPER(wasi_clock_time_get, iIi_i, wasi_clock_time_get_typed)
@@ -168,17 +168,12 @@ fail:
 }
 
 int
-wasi_fd_write(struct exec_context *ctx, struct host_instance *hi,
-              const struct functype *ft, const struct cell *params,
-              struct cell *results)
+wasi_fd_write_typed(struct exec_context *ctx, struct host_instance *hi,
+                    uint32_t wasifd, uint32_t iov_addr, uint32_t iov_count,
+                    uint32_t retp, uint32_t *resultp)
 {
-        WASI_TRACE;
+        WASI_TYPED_TRACE;
         struct wasi_instance *wasi = (void *)hi;
-        HOST_FUNC_CONVERT_PARAMS(ft, params);
-        uint32_t wasifd = HOST_FUNC_PARAM(ft, params, 0, i32);
-        uint32_t iov_addr = HOST_FUNC_PARAM(ft, params, 1, i32);
-        uint32_t iov_count = HOST_FUNC_PARAM(ft, params, 2, i32);
-        uint32_t retp = HOST_FUNC_PARAM(ft, params, 3, i32);
         struct iovec *hostiov = NULL;
         struct wasi_fdinfo *fdinfo = NULL;
         int host_ret = 0;
@@ -217,14 +212,14 @@ retry:
 fail:
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
-                HOST_FUNC_RESULT_SET(ft, results, 0, i32,
-                                     wasi_convert_errno(ret));
+                *resultp = wasi_convert_errno(ret);
         }
         free(hostiov);
-        HOST_FUNC_FREE_CONVERTED_PARAMS();
         return host_ret;
 }
 
+HOST_FUNC_TYPED_WRAPPER(wasi_fd_write, iiii_i, wasi_fd_write_typed)
+
 int
 wasi_fd_pwrite(struct exec_context *ctx, struct host_instance *hi,
                const struct functype *ft, const struct cell *params,
@@ -285,17 +280,12 @@ fail:
 }
 
 int
-wasi_fd_read(struct exec_context *ctx, struct host_instance *hi,
-             const struct functype *ft, const struct cell *params,
-             struct cell *results)
+wasi_fd_read_typed(struct exec_context *ctx, struct host_instance *hi,
+                   uint32_t wasifd, uint32_t iov_addr, uint32_t iov_count,
+                   uint32_t retp, uint32_t *resultp)
 {
-        WASI_TRACE;
+        WASI_TYPED_TRACE;
         struct wasi_instance *wasi = (void *)hi;
-        HOST_FUNC_CONVERT_PARAMS(ft, params);
-        uint32_t wasifd = HOST_FUNC_PARAM(ft, params, 0, i32);
-        uint32_t iov_addr = HOST_FUNC_PARAM(ft, params, 1, i32);
-        uint32_t iov_count = HOST_FUNC_PARAM(ft, params, 2, i32);
-        uint32_t retp = HOST_FUNC_PARAM(ft, params, 3, i32);
         struct iovec *hostiov = NULL;
         struct wasi_fdinfo *fdinfo = NULL;
         int host_ret = 0;
@@ -351,14 +341,14 @@ tty_hack:
 fail:
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
-                HOST_FUNC_RESULT_SET(ft, results, 0, i32,
-                                     wasi_convert_errno(ret));
+                *resultp = wasi_convert_errno(ret);
         }
         free(hostiov);
-        HOST_FUNC_FREE_CONVERTED_PARAMS();
         return host_ret;
 }
 
+HOST_FUNC_TYPED_WRAPPER(wasi_fd_read, iiii_i, wasi_fd_read_typed)
+
 int
 wasi_fd_pread(struct exec_context *ctx, struct host_instance *hi,
               const struct functype *ft, const struct cell *params,
@@ -691,17 +681,12 @@ fail:
 }
 
 int
-wasi_fd_seek(struct exec_context *ctx, struct host_instance *hi,
-             const struct functype *ft, const struct cell *params,
-             struct cell *results)
+wasi_fd_seek_typed(struct exec_context *ctx, struct host_instance *hi,
+                   uint32_t wasifd, uint64_t offset, uint32_t whence,
+                   uint32_t retp, uint32_t *resultp)
 {
-        WASI_TRACE;
+        WASI_TYPED_TRACE;
         struct wasi_instance *wasi = (void *)hi;
-        HOST_FUNC_CONVERT_PARAMS(ft, params);
-        uint32_t wasifd = HOST_FUNC_PARAM(ft, params, 0, i32);
-        int64_t offset = (int64_t)HOST_FUNC_PARAM(ft, params, 1, i64);
-        uint32_t whence = HOST_FUNC_PARAM(ft, params, 2, i32);
-        uint32_t retp = HOST_FUNC_PARAM(ft, params, 3, i32);
         struct wasi_fdinfo *fdinfo = NULL;
         int host_ret = 0;
         int ret;
@@ -723,7 +708,7 @@ wasi_fd_seek(struct exec_context *ctx, struct host_instance *hi,
                 goto fail;
         }
         wasi_off_t off;
-        ret = wasi_vfs_fd_lseek(fdinfo, offset, whence, &off);
+        ret = wasi_vfs_fd_lseek(fdinfo, (int64_t)offset, whence, &off);
         if (ret != 0) {
                 goto fail;
         }
@@ -733,13 +718,13 @@ wasi_fd_seek(struct exec_context *ctx, struct host_instance *hi,
 fail:
         wasi_fdinfo_release(wasi, fdinfo);
         if (host_ret == 0) {
-                HOST_FUNC_RESULT_SET(ft, results, 0, i32,
-                                     wasi_convert_errno(ret));
+                *resultp = wasi_convert_errno(ret);
         }
-        HOST_FUNC_FREE_CONVERTED_PARAMS();
         return host_ret;
 }
 
+HOST_FUNC_TYPED_WRAPPER(wasi_fd_seek, iIii_i, wasi_fd_seek_typed)
+
 int
 wasi_unstable_fd_seek(struct exec_context *ctx, struct host_instance *hi,
                       const struct functype *ft, const struct cell *params,
@@ -1,8 +1,12 @@
 #define WASI_API(a, b) HOST_FUNC_DECL(wasi_##a);
 #define WASI_API2(a, b, c) HOST_FUNC_DECL(b);
+#define WASI_API_TYPED(a, s, b)                                               \
+        HOST_FUNC_DECL(wasi_##a);                                             \
+        host_func_##s##_t wasi_##a##_typed;
 
 #include "wasi_preview1.h"
 #include "wasi_unstable.h"
 
 #undef WASI_API
 #undef WASI_API2
+#undef WASI_API_TYPED
@@ -66,7 +66,10 @@ struct wasi_instance {
 
 #define WASI_HOST_FUNC(NAME, TYPE) HOST_FUNC_PREFIX(wasi_, NAME, TYPE)
 #define WASI_HOST_FUNC2(NAME, FUNC, TYPE) HOST_FUNC(NAME, FUNC, TYPE)
+#define WASI_HOST_FUNC_TYPED(NAME, SIG, TYPE)                                 \
+        HOST_FUNC_PREFIX_TYPED(wasi_, NAME, SIG, TYPE)
 #define WASI_TRACE HOST_FUNC_TRACE
+#define WASI_TYPED_TRACE HOST_FUNC_TYPED_TRACE
 
 uint32_t wasi_convert_errno(int host_errno);
 
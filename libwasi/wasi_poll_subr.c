@@ -11,6 +11,46 @@
 #include "wasi_impl.h"
 #include "wasi_poll_subr.h"
 
+#if defined(TOYWASM_USE_USER_SCHED)
+static int
+wasi_poll_sched(struct exec_context *ctx, struct pollfd *fds, nfds_t nfds,
+                const struct timespec *abstimeout, int *retp, int *neventsp)
+{
+        int ret;
+
+        ret = poll(fds, nfds, 0);
+        if (ret < 0) {
+                ret = errno;
+                assert(ret > 0);
+                goto done;
+        }
+        if (ret > 0) {
+                *neventsp = ret;
+                ret = 0;
+                goto done;
+        }
+        if (abstimeout != NULL) {
+                struct timespec now;
+                ret = timespec_now(CLOCK_REALTIME, &now);
+                if (ret != 0) {
+                        goto done;
+                }
+                if (timespec_cmp(abstimeout, &now) <= 0) {
+                        ret = ETIMEDOUT;
+                        goto done;
+                }
+        }
+        ret = sched_block(ctx->sched, ctx, fds, nfds, abstimeout, NULL);
+        if (ret != 0) {
+                goto done;
+        }
+        return ETOYWASMRESTART;
+done:
+        *retp = ret;
+        return 0;
+}
+#endif
+
 int
 wasi_poll(struct exec_context *ctx, struct pollfd *fds, nfds_t nfds,
           int timeout_ms, int *retp, int *neventsp)
@@ -95,6 +135,20 @@ wasi_poll(struct exec_context *ctx, struct pollfd *fds, nfds_t nfds,
                         }
                         goto fail;
                 }
+#if defined(TOYWASM_USE_USER_SCHED)
+                if (ctx->sched != NULL) {
+                        /*
+                         * instead of blocking the whole process in poll,
+                         * register the fds to the scheduler and yield.
+                         */
+                        host_ret = wasi_poll_sched(ctx, fds, nfds, abstimeout,
+                                                   &ret, neventsp);
+                        if (IS_RESTARTABLE(host_ret) && abstimeout != NULL) {
+                                restart->restart_type = RESTART_TIMER;
+                        }
+                        goto fail;
+                }
+#endif
                 if (abstimeout == NULL) {
                         next_timeout_ms = interval_ms;
                 } else {
@@ -119,6 +173,14 @@ wasi_poll(struct exec_context *ctx, struct pollfd *fds, nfds_t nfds,
                 if (ret < 0) {
                         ret = errno;
                         assert(ret > 0);
+                        if (ret == EINTR) {
+                                /*
+                                 * eg. SIGPROF from the profiler.
+                                 * the timeout is recalculated from
+                                 * abstimeout.
+                                 */
+                                continue;
+                        }
                         goto fail;
                 }
                 if (ret > 0) {
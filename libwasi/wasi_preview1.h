@@ -6,7 +6,7 @@ WASI_API(args_sizes_get, "(ii)i")
 
 /* clock */
 WASI_API(clock_res_get, "(ii)i")
-WASI_API(clock_time_get, "(iIi)i")
+WASI_API_TYPED(clock_time_get, iIi_i, "(iIi)i")
 
 /* environ */
 WASI_API(environ_get, "(ii)i")
@@ -27,13 +27,13 @@ WASI_API(fd_pread, "(iiiIi)i")
 WASI_API(fd_prestat_dir_name, "(iii)i")
 WASI_API(fd_prestat_get, "(ii)i")
 WASI_API(fd_pwrite, "(iiiIi)i")
-WASI_API(fd_read, "(iiii)i")
+WASI_API_TYPED(fd_read, iiii_i, "(iiii)i")
 WASI_API(fd_readdir, "(iiiIi)i")
 WASI_API(fd_renumber, "(ii)i")
-WASI_API(fd_seek, "(iIii)i")
+WASI_API_TYPED(fd_seek, iIii_i, "(iIii)i")
 WASI_API(fd_sync, "(i)i")
 WASI_API(fd_tell, "(ii)i")
-WASI_API(fd_write, "(iiii)i")
+WASI_API_TYPED(fd_write, iiii_i, "(iiii)i")
 
 /* path */
 WASI_API(path_create_directory, "(iii)i")
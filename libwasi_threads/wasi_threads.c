@@ -105,7 +105,7 @@ wasi_threads_instance_create(struct mem_context *mctx,
         idalloc_init(&inst->tids, 1, 0x1fffffff);
         cluster_init(&inst->cluster);
 #if defined(TOYWASM_USE_USER_SCHED)
-        sched_init(&inst->sched);
+        sched_init(&inst->sched, mctx);
 #endif
         *instp = inst;
         return 0;
@@ -230,6 +230,8 @@ wasi_threads_instance_join(struct wasi_threads_instance *wasi)
         cluster_remove_thread(&wasi->cluster); /* remove ourselves */
         toywasm_mutex_unlock(&wasi->cluster.lock);
 #if defined(TOYWASM_USE_USER_SCHED)
+        /* let blocked threads notice the interrupt */
+        sched_wakeup_all(&wasi->sched);
         sched_run(&wasi->sched, NULL);
 #endif
         cluster_join(&wasi->cluster);
@@ -268,6 +270,10 @@ wasi_threads_propagate_trap(struct wasi_threads_instance *wasi,
         if (cluster_set_interrupt(&wasi->cluster)) {
                 xlog_trace("propagating a trap %u", trap->trapid);
                 wasi->trap = *trap;
+#if defined(TOYWASM_USE_USER_SCHED)
+                /* let blocked threads notice the interrupt */
+                sched_wakeup_all(&wasi->sched);
+#endif
         } else {
                 xlog_trace("interrupt already active");
         }
@@ -0,0 +1,29 @@
+#! /bin/sh
+
+# usage: module-cache-test.sh TOYWASM_COMMAND...
+#
+# load a module twice with a fresh cache directory and check that
+# the second load is a hit.
+#
+# a miss saves the cache file by renaming a new file over it.
+# a hit leaves the file as it is. compare its inode number.
+
+set -e
+
+DIR=$(mktemp -d)
+trap 'rm -rf "${DIR}"' EXIT
+
+run() {
+	"$@" --module-cache="${DIR}" --load=spectest.wasm \
+		"--invoke=print_i32 123"
+}
+
+run "$@"
+CACHE=$(ls "${DIR}"/*.twcache)
+INODE1=$(ls -i "${CACHE}" | awk '{print $1}')
+run "$@"
+INODE2=$(ls -i "${CACHE}" | awk '{print $1}')
+if [ "${INODE1}" != "${INODE2}" ]; then
+	echo "the second load didn't hit the cache"
+	exit 1
+fi
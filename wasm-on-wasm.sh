@@ -2,7 +2,7 @@
 
 set -e
 
-#EXTRA_CMAKE_OPTIONS="-DTOYWASM_USE_JUMP_CACHE=ON -DTOYWASM_USE_JUMP_CACHE2=OFF"
+#EXTRA_CMAKE_OPTIONS="-DTOYWASM_JUMP_CACHE2_SIZE=0"
 
 #EXTRA_CMAKE_OPTIONS="-DTOYWASM_ENABLE_WASM_TAILCALL=ON" USE_TAILCALL=ON
 
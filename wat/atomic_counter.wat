@@ -0,0 +1,21 @@
+;; a contended atomic counter workload.
+;; (see examples/waitbench)
+;;
+;; each iteration of "run" increments the counter with
+;; i32.atomic.rmw.add. "count" returns the counter.
+;;
+;; unlike atomic_mutex.wat, it doesn't use memory.atomic.wait32/notify.
+;; it measures the atomic read-modify-write instructions themselves.
+
+(module
+  (import "env" "memory" (memory 1 1 shared))
+  (func (export "run") (param $n i32)
+    (block $done
+      (loop $again
+        (br_if $done (i32.eqz (local.get $n)))
+        (drop (i32.atomic.rmw.add (i32.const 4) (i32.const 1)))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $again))))
+  (func (export "count") (result i32)
+    (i32.atomic.load (i32.const 4)))
+)
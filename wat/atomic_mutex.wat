@@ -0,0 +1,53 @@
+;; a mutex contention workload for memory.atomic.wait32/notify.
+;; (see examples/waitbench)
+;;
+;; each iteration of "run" takes the mutex, increments the counter,
+;; and releases the mutex. "count" returns the counter.
+;;
+;; the mutex is the classic three-state futex mutex.
+;; (Ulrich Drepper, "Futexes Are Tricky", Mutex, Take 2)
+;;
+;;   0: unlocked
+;;   1: locked, no waiters
+;;   2: locked, possibly with waiters
+
+(module
+  (import "env" "memory" (memory 1 1 shared))
+  (func $lock
+    (local $c i32)
+    ;; fast path: 0 -> 1
+    (local.set $c
+      (i32.atomic.rmw.cmpxchg (i32.const 0) (i32.const 0) (i32.const 1)))
+    (if (local.get $c)
+      (then
+        (if (i32.ne (local.get $c) (i32.const 2))
+          (then
+            (local.set $c (i32.atomic.rmw.xchg (i32.const 0) (i32.const 2)))))
+        (block $done
+          (loop $again
+            (br_if $done (i32.eqz (local.get $c)))
+            (drop
+              (memory.atomic.wait32 (i32.const 0) (i32.const 2)
+                                    (i64.const -1)))
+            (local.set $c (i32.atomic.rmw.xchg (i32.const 0) (i32.const 2)))
+            (br $again))))))
+  (func $unlock
+    (if (i32.ne (i32.atomic.rmw.sub (i32.const 0) (i32.const 1))
+                (i32.const 1))
+      (then
+        (i32.atomic.store (i32.const 0) (i32.const 0))
+        (drop (memory.atomic.notify (i32.const 0) (i32.const 1))))))
+  (func (export "run") (param $n i32)
+    (block $done
+      (loop $again
+        (br_if $done (i32.eqz (local.get $n)))
+        (call $lock)
+        ;; a non-atomic increment protected by the mutex
+        (i32.store (i32.const 4)
+                   (i32.add (i32.load (i32.const 4)) (i32.const 1)))
+        (call $unlock)
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $again))))
+  (func (export "count") (result i32)
+    (i32.atomic.load (i32.const 4)))
+)
@@ -0,0 +1,38 @@
+;; calls at the edges of the jit-compiled code.
+;;
+;; the jit exits to the interpreter at a call and at the end of
+;; a function. these pcs are also entries of the compiled code.
+
+(module
+  (func $one (result i32)
+    i32.const 1
+  )
+
+  ;; a call as the first instruction
+  (func $first (result i32)
+    call $one
+  )
+
+  ;; a call followed by the end of the function
+  (func $last (result i32)
+    call $one
+    drop
+    call $one
+  )
+
+  ;; back-to-back calls
+  (func $back_to_back (result i32)
+    call $one
+    call $one
+    i32.add
+  )
+
+  ;; returns 4
+  (func (export "run") (result i32)
+    call $first
+    call $last
+    i32.add
+    call $back_to_back
+    i32.add
+  )
+)
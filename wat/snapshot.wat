@@ -0,0 +1,129 @@
+;; a module to test --snapshot
+;;
+;; "init" modifies the state of the instance. "check" traps
+;; unless the state has been modified by "init".
+
+(module
+  (type $t (func (result i32)))
+  (memory 1)
+  (table $tab 1 funcref)
+  (global $g (mut i32) (i32.const 0))
+  (global $gf (mut f64) (f64.const 0))
+  (global $g64 (mut i64) (i64.const 0))
+  (global $gref (mut funcref) (ref.null func))
+  (data (i32.const 0) "hello")
+  (data $passive "xyz")
+  (elem declare func $seven)
+
+  (func $seven (type $t)
+    i32.const 7
+  )
+
+  (func (export "init")
+    i32.const 100
+    i32.const 0x12345678
+    i32.store
+    ;; copy "xyz" to 2000
+    i32.const 2000
+    i32.const 0
+    i32.const 3
+    memory.init $passive
+    data.drop $passive
+    i32.const 42
+    global.set $g
+    f64.const 1.5
+    global.set $gf
+    i64.const -5
+    global.set $g64
+    ref.func $seven
+    global.set $gref
+    ;; the table has 4 entries after this
+    ref.null func
+    i32.const 3
+    table.grow $tab
+    drop
+    i32.const 2
+    ref.func $seven
+    table.set $tab
+    ;; the memory has 2 pages after this
+    i32.const 1
+    memory.grow
+    drop
+    i32.const 70000
+    i32.const 9
+    i32.store8
+  )
+
+  (func (export "check")
+    i32.const 0
+    i32.load8_u
+    i32.const 0x68 ;; 'h'
+    i32.ne
+    if
+      unreachable
+    end
+    i32.const 100
+    i32.load
+    i32.const 0x12345678
+    i32.ne
+    if
+      unreachable
+    end
+    i32.const 2001
+    i32.load8_u
+    i32.const 0x79 ;; 'y'
+    i32.ne
+    if
+      unreachable
+    end
+    i32.const 70000
+    i32.load8_u
+    i32.const 9
+    i32.ne
+    if
+      unreachable
+    end
+    memory.size
+    i32.const 2
+    i32.ne
+    if
+      unreachable
+    end
+    global.get $g
+    i32.const 42
+    i32.ne
+    if
+      unreachable
+    end
+    global.get $gf
+    f64.const 1.5
+    f64.ne
+    if
+      unreachable
+    end
+    global.get $g64
+    i64.const -5
+    i64.ne
+    if
+      unreachable
+    end
+    table.size $tab
+    i32.const 4
+    i32.ne
+    if
+      unreachable
+    end
+    i32.const 2
+    call_indirect (type $t)
+    i32.const 7
+    i32.ne
+    if
+      unreachable
+    end
+    global.get $gref
+    ref.is_null
+    if
+      unreachable
+    end
+  )
+)